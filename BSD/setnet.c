@@ -25,7 +25,7 @@
  */
 
 #include "rcprl.h"
-#include "resolvconf.h"
+#include "../resolvconf.h"
 #include "exec.h"
 #include "../netinfo.h"
 #include "../namelist.h"
@@ -1,9 +1,10 @@
 #include "../rcconf.h"
 #include "../rcconf_list.h"
 #include "../rcconf_sublist.h"
-#include "../resolvconf.h"
+#include "../../resolvconf.h"
 #include <sys/stat.h>
 #include <stdio.h>
+#include <unistd.h>
 #include <errno.h>
 
 #define CHEAT_NO_MATH
@@ -19,6 +20,8 @@ CHEAT_DECLARE(
 	#define RCCONF_HEADER   "*** HEADER ***"
 	#undef RESOLVCONF_PATH
 	#define RESOLVCONF_PATH TMP_PATH "/resolv.conf"
+	#define RESOLVCONF_LINK TMP_PATH "/resolv.conf.lnk"
+	#define DHCLIENT_PATH   TMP_PATH "/dhclient.conf"
 )
 
 CHEAT_TEST(rcconf,
@@ -372,9 +375,15 @@ CHEAT_TEST(resolvconf,
 
 	resolvconf_init(&head);
 
-	sprintf(buf, "%256s", "*");
+	/* long list is not limited */
+	for (i = 0; i < 40; i++)
+		sprintf(buf + i * 10, "d%03d.xy.z ", i);
+	buf[399] = '\0';
 	res = resolvconf_set_search_list(&head, buf);
-	cheat_assert_int(res, -EINVAL);
+	cheat_assert_int(res, 0);
+	search = resolvconf_get_search_list(&head);
+	cheat_assert_string(search, buf);
+	resolvconf_free(&head);
 
 	res = resolvconf_set_namserver(&head, "1.1.1.1");
 	cheat_assert_int(res, 0);
@@ -394,3 +403,128 @@ CHEAT_TEST(resolvconf,
 
 	resolvconf_free(&head);
 )
+
+CHEAT_TEST(resolvconf_edit,
+	#define OUT3 "# comment\nsearching\noptions rotate\nnameserver 5.5.5.5\nnameserver ::1\n"
+	#define OUT4 "send host-name = gethostname();\nprepend domain-name-servers 5.5.5.5, ::1;\nprepend domain-search \"a.b\", \"c.d\";\n"
+
+	struct resolvconf_line head;
+	const char *path;
+	char buf[512];
+	struct stat st;
+	FILE *f;
+	int i, res;
+
+	mkdir(TMP_PATH, 0777);
+
+	f = fopen(RESOLVCONF_PATH, "w");
+	fprintf(f, "# comment\n");
+	fprintf(f, "nameserver 1.1.1.1\n");
+	fprintf(f, "  search a.b.c\n");
+	fprintf(f, "searching\n");
+	fprintf(f, "nameserver 2.2.2.2\n");
+	fprintf(f, "options rotate");
+	fclose(f);
+
+	res = resolvconf_load__(&head, RESOLVCONF_PATH);
+	cheat_assert_int(res, 0);
+
+	res = resolvconf_set_nameservers(NULL, "1.1.1.1");
+	cheat_assert_int(res, -EINVAL);
+	res = resolvconf_set_nameservers(&head, NULL);
+	cheat_assert_int(res, -EINVAL);
+	res = resolvconf_set_nameservers(&head, "01234567890123456789012345678901234567890123456789");
+	cheat_assert_int(res, -EINVAL);
+	res = resolvconf_set_nameservers(&head, "  5.5.5.5   ::1 ");
+	cheat_assert_int(res, 0);
+
+	res = resolvconf_del_search_list(NULL);
+	cheat_assert_int(res, -EINVAL);
+	res = resolvconf_del_search_list(&head);
+	cheat_assert_int(res, 0);
+	cheat_assert_pointer(resolvconf_get_search_list(&head), NULL);
+
+	/* link is replaced, file it points to is kept */
+	unlink(RESOLVCONF_LINK);
+	res = symlink("resolv.conf", RESOLVCONF_LINK);
+	cheat_assert_int(res, 0);
+	res = resolvconf_save__(&head, RESOLVCONF_LINK);
+	cheat_assert_int(res, 0);
+	resolvconf_free(&head);
+	cheat_assert_pointer(head.next, NULL);
+
+	res = lstat(RESOLVCONF_LINK, &st);
+	cheat_assert_int(S_ISREG(st.st_mode), 1);
+	cheat_assert_int(st.st_mode & 0777, 0644);
+	res = access(RESOLVCONF_LINK ".tmp", F_OK);
+	cheat_assert_int(res, -1);
+
+	f = fopen(RESOLVCONF_PATH, "r");
+	res = fread(buf, 1, sizeof(buf), f);
+	buf[res] = '\0';
+	fclose(f);
+
+	cheat_assert_int(strncmp(buf, "# comment\nnameserver 1.1.1.1\n", 29), 0);
+
+	f = fopen(RESOLVCONF_LINK, "r");
+	res = fread(buf, 1, sizeof(buf), f);
+	buf[res] = '\0';
+	fclose(f);
+
+	cheat_assert_string(OUT3, buf);
+
+	/* removal of all nameservers */
+	res = resolvconf_load__(&head, RESOLVCONF_PATH);
+	cheat_assert_int(res, 0);
+	res = resolvconf_set_nameservers(&head, "");
+	cheat_assert_int(res, 0);
+	i = 0;
+	resolvconf_dns_foreach(&head, path)
+		i++;
+	cheat_assert_int(i, 0);
+	resolvconf_free(&head);
+
+	f = fopen(DHCLIENT_PATH, "w");
+	fprintf(f, "prepend domain-search \"x.y\";\n");
+	fprintf(f, "send host-name = gethostname();\n");
+	fprintf(f, "  prepend   domain-name-servers 8.8.8.8;\n");
+	fclose(f);
+
+	res = resolvconf_load__(&head, DHCLIENT_PATH);
+	cheat_assert_int(res, 0);
+
+	res = resolvconf_set_prepend(NULL, "domain-search", "a.b", 1);
+	cheat_assert_int(res, -EINVAL);
+	res = resolvconf_set_prepend(&head, NULL, "a.b", 1);
+	cheat_assert_int(res, -EINVAL);
+	res = resolvconf_set_prepend(&head, "domain-search", NULL, 1);
+	cheat_assert_int(res, -EINVAL);
+	res = resolvconf_set_prepend(&head, "domain-name-servers", "5.5.5.5 ::1", 0);
+	cheat_assert_int(res, 0);
+	res = resolvconf_set_prepend(&head, "domain-search", "", 1);
+	cheat_assert_int(res, 0);
+	res = resolvconf_set_prepend(&head, "domain-search", " a.b  c.d ", 1);
+	cheat_assert_int(res, 0);
+
+	res = resolvconf_save__(&head, DHCLIENT_PATH);
+	cheat_assert_int(res, 0);
+	resolvconf_free(&head);
+
+	f = fopen(DHCLIENT_PATH, "r");
+	res = fread(buf, 1, sizeof(buf), f);
+	buf[res] = '\0';
+	fclose(f);
+
+	cheat_assert_string(OUT4, buf);
+
+	unlink(RESOLVCONF_LINK);
+	res = symlink("resolv.conf", RESOLVCONF_LINK);
+	cheat_assert_int(res, 0);
+
+	path = resolvconf_base__(RESOLVCONF_PATH, "resolv.conf", DHCLIENT_PATH);
+	cheat_assert_string(path, RESOLVCONF_PATH);
+	path = resolvconf_base__(RESOLVCONF_LINK, "other.conf", DHCLIENT_PATH);
+	cheat_assert_string(path, RESOLVCONF_LINK);
+	path = resolvconf_base__(RESOLVCONF_LINK, "resolv.conf", DHCLIENT_PATH);
+	cheat_assert_string(path, DHCLIENT_PATH);
+)
@@ -0,0 +1,1055 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2019 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * minimal client of D-Bus: messages are marshalled by signatures of values,
+ * only method calls of the client and replies to them are handled
+ */
+
+#include "../common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "dbus.h"
+
+#define DBUS_MAX_MESSAGE	(128 * 1024 * 1024)
+#define DBUS_MAX_DEPTH		64
+#define DBUS_MAX_SIGNATURE	255
+
+#define DBUS_SERVICE	"org.freedesktop.DBus"
+#define DBUS_PATH	"/org/freedesktop/DBus"
+
+enum { MSG_CALL = 1, MSG_RETURN, MSG_ERROR, MSG_SIGNAL };
+
+enum { FIELD_PATH = 1, FIELD_INTERFACE, FIELD_MEMBER, FIELD_ERROR_NAME,
+	FIELD_REPLY_SERIAL, FIELD_DESTINATION, FIELD_SENDER, FIELD_SIGNATURE };
+
+struct dbus_conn
+{
+	int fd;
+	unsigned int serial;
+	char error[512];
+};
+
+/* marshalled data, values are aligned relative to its start */
+struct dbus_buf
+{
+	unsigned char *data;
+	size_t len, size;
+	int failed;
+};
+
+struct dbus_reader
+{
+	const unsigned char *data;
+	size_t len, pos;
+	int swap;	/* byte order of message is not the one of host */
+	int failed;
+};
+
+static char host_order(void)
+{
+	const uint16_t one = 1;
+
+	return *(const unsigned char *)&one ? 'l' : 'B';
+}
+
+static int is_string(char type)
+{
+	return type == 's' || type == 'o' || type == 'g';
+}
+
+/* length of the first complete type of sig, 0 if it is not valid */
+static size_t sig_len(const char *sig)
+{
+	size_t n, len;
+	char close;
+
+	switch (*sig) {
+	case 'y': case 'b': case 'n': case 'q': case 'i': case 'u':
+	case 'x': case 't': case 'd': case 's': case 'o': case 'g':
+	case 'v':
+		return 1;
+	case 'a':
+		n = sig_len(sig + 1);
+		return n ? n + 1 : 0;
+	case '(':
+	case '{':
+		close = (*sig == '(') ? ')' : '}';
+		for (n = 1; sig[n] != close; n += len)
+			if ((len = sig_len(sig + n)) == 0)
+				return 0;
+		return n > 1 ? n + 1 : 0;
+	}
+
+	return 0;
+}
+
+static size_t type_align(char type)
+{
+	switch (type) {
+	case 'n': case 'q':
+		return 2;
+	case 'b': case 'i': case 'u': case 's': case 'o': case 'a':
+		return 4;
+	case 'x': case 't': case 'd': case '(': case '{':
+		return 8;
+	}
+
+	return 1;
+}
+
+static struct dbus_value *value_alloc(const char *sig, size_t len)
+{
+	struct dbus_value *v;
+
+	v = (struct dbus_value *)calloc(1, sizeof(*v));
+	if (v == NULL)
+		return NULL;
+	v->sig = strndup(sig, len);
+	if (v->sig == NULL) {
+		free(v);
+		return NULL;
+	}
+
+	return v;
+}
+
+static void add_child(struct dbus_value *parent, struct dbus_value *item)
+{
+	if (parent->last != NULL)
+		parent->last->next = item;
+	else
+		parent->child = item;
+	parent->last = item;
+}
+
+struct dbus_value *dbus_new(const char *sig)
+{
+	struct dbus_value *v = value_alloc(sig, strlen(sig));
+
+	if (v != NULL && is_string(*sig) && (v->v.s = strdup("")) == NULL) {
+		dbus_free(v);
+		return NULL;
+	}
+
+	return v;
+}
+
+struct dbus_value *dbus_new_uint(char type, unsigned long long u)
+{
+	char sig[2] = {type, '\0'};
+	struct dbus_value *v = value_alloc(sig, 1);
+
+	if (v != NULL)
+		v->v.u = u;
+
+	return v;
+}
+
+struct dbus_value *dbus_new_string(char type, const char *s)
+{
+	char sig[2] = {type, '\0'};
+	struct dbus_value *v = value_alloc(sig, 1);
+
+	if (v != NULL && (v->v.s = strdup(s)) == NULL) {
+		dbus_free(v);
+		return NULL;
+	}
+
+	return v;
+}
+
+struct dbus_value *dbus_new_variant(struct dbus_value *value)
+{
+	struct dbus_value *v;
+
+	if (value == NULL)
+		return NULL;
+
+	v = value_alloc("v", 1);
+	if (v == NULL) {
+		dbus_free(value);
+		return NULL;
+	}
+	add_child(v, value);
+
+	return v;
+}
+
+int dbus_add(struct dbus_value *parent, struct dbus_value *item)
+{
+	if (item == NULL)
+		return -1;
+	if (parent == NULL) {
+		dbus_free(item);
+		return -1;
+	}
+	add_child(parent, item);
+
+	return 0;
+}
+
+struct dbus_value *dbus_copy(const struct dbus_value *value)
+{
+	struct dbus_value *v, *it;
+
+	v = value_alloc(value->sig, strlen(value->sig));
+	if (v == NULL)
+		return NULL;
+
+	v->v = value->v;
+	if (is_string(*v->sig) && (v->v.s = strdup(value->v.s)) == NULL) {
+		free(v->sig);
+		free(v);
+		return NULL;
+	}
+	for (it = value->child; it != NULL; it = it->next) {
+		if (dbus_add(v, dbus_copy(it))) {
+			dbus_free(v);
+			return NULL;
+		}
+	}
+
+	return v;
+}
+
+void dbus_free(struct dbus_value *value)
+{
+	struct dbus_value *next;
+
+	for (; value != NULL; value = next) {
+		next = value->next;
+		dbus_free(value->child);
+		if (is_string(*value->sig))
+			free(value->v.s);
+		free(value->sig);
+		free(value);
+	}
+}
+
+static struct dbus_value *dict_entry(const struct dbus_value *dict, const char *key,
+		struct dbus_value **prev)
+{
+	struct dbus_value *entry;
+
+	*prev = NULL;
+	for (entry = dict->child; entry != NULL; *prev = entry, entry = entry->next)
+		if (is_string(*entry->child->sig) && !strcmp(entry->child->v.s, key))
+			return entry;
+
+	return NULL;
+}
+
+struct dbus_value *dbus_dict_get(const struct dbus_value *dict, const char *key)
+{
+	struct dbus_value *entry, *prev, *value;
+
+	if (dict == NULL || (entry = dict_entry(dict, key, &prev)) == NULL)
+		return NULL;
+
+	value = entry->child->next;
+	return (*value->sig == 'v') ? value->child : value;
+}
+
+int dbus_dict_set(struct dbus_value *dict, const char *key, struct dbus_value *value)
+{
+	struct dbus_value *entry, *prev;
+
+	if (value == NULL)
+		return -1;
+	//dict is a{s<type>}
+	if (dict->sig[3] == 'v' && *value->sig != 'v' &&
+			(value = dbus_new_variant(value)) == NULL)
+		return -1;
+
+	entry = dict_entry(dict, key, &prev);
+	if (entry != NULL) {
+		dbus_free(entry->child->next);
+		entry->child->next = value;
+		entry->last = value;
+		return 0;
+	}
+
+	entry = dbus_new(dict->sig + 1);
+	if (dbus_add(entry, dbus_new_string('s', key))) {
+		dbus_free(entry);
+		dbus_free(value);
+		return -1;
+	}
+	dbus_add(entry, value);
+	add_child(dict, entry);
+
+	return 0;
+}
+
+void dbus_dict_del(struct dbus_value *dict, const char *key)
+{
+	struct dbus_value *entry, *prev;
+
+	if (dict == NULL || (entry = dict_entry(dict, key, &prev)) == NULL)
+		return;
+
+	if (prev != NULL)
+		prev->next = entry->next;
+	else
+		dict->child = entry->next;
+	if (dict->last == entry)
+		dict->last = prev;
+	entry->next = NULL;
+	dbus_free(entry);
+}
+
+const char *dbus_dict_string(const struct dbus_value *dict, const char *key)
+{
+	struct dbus_value *value = dbus_dict_get(dict, key);
+
+	return (value != NULL && is_string(*value->sig)) ? value->v.s : NULL;
+}
+
+static void buf_put(struct dbus_buf *b, const void *data, size_t len)
+{
+	unsigned char *p;
+	size_t size;
+
+	if (b->failed)
+		return;
+
+	if (b->len + len > b->size) {
+		for (size = b->size ? b->size : 256; size < b->len + len; size *= 2)
+			;
+		p = (unsigned char *)realloc(b->data, size);
+		if (p == NULL) {
+			b->failed = 1;
+			return;
+		}
+		b->data = p;
+		b->size = size;
+	}
+
+	if (data != NULL)
+		memcpy(b->data + b->len, data, len);
+	else
+		memset(b->data + b->len, 0, len);
+	b->len += len;
+}
+
+static void buf_align(struct dbus_buf *b, size_t align)
+{
+	buf_put(b, NULL, (align - b->len % align) % align);
+}
+
+/* integer of size bytes in byte order of host */
+static void put_uint(struct dbus_buf *b, unsigned long long u, size_t size)
+{
+	uint8_t u8 = u;
+	uint16_t u16 = u;
+	uint32_t u32 = u;
+	uint64_t u64 = u;
+
+	buf_align(b, size);
+	switch (size) {
+	case 1:
+		buf_put(b, &u8, 1);
+		break;
+	case 2:
+		buf_put(b, &u16, 2);
+		break;
+	case 4:
+		buf_put(b, &u32, 4);
+		break;
+	default:
+		buf_put(b, &u64, 8);
+	}
+}
+
+static void marshal(struct dbus_buf *b, const struct dbus_value *v)
+{
+	const struct dbus_value *it;
+	size_t at, start;
+	uint32_t len;
+
+	switch (*v->sig) {
+	case 'y':
+		put_uint(b, v->v.u, 1);
+		break;
+	case 'n': case 'q':
+		put_uint(b, v->v.u, 2);
+		break;
+	case 'b': case 'i': case 'u':
+		put_uint(b, v->v.u, 4);
+		break;
+	case 'x': case 't':
+		put_uint(b, v->v.u, 8);
+		break;
+	case 'd':
+		buf_align(b, 8);
+		buf_put(b, &v->v.d, 8);
+		break;
+	case 's': case 'o':
+		put_uint(b, strlen(v->v.s), 4);
+		buf_put(b, v->v.s, strlen(v->v.s) + 1);
+		break;
+	case 'g':
+		put_uint(b, strlen(v->v.s), 1);
+		buf_put(b, v->v.s, strlen(v->v.s) + 1);
+		break;
+	case 'a':
+		put_uint(b, 0, 4);
+		at = b->len - 4;
+		buf_align(b, type_align(v->sig[1]));
+		start = b->len;
+		for (it = v->child; it != NULL; it = it->next)
+			marshal(b, it);
+		if (!b->failed) {
+			len = b->len - start;
+			memcpy(b->data + at, &len, 4);
+		}
+		break;
+	case '(': case '{':
+		buf_align(b, 8);
+		for (it = v->child; it != NULL; it = it->next)
+			marshal(b, it);
+		break;
+	case 'v':
+		put_uint(b, strlen(v->child->sig), 1);
+		buf_put(b, v->child->sig, strlen(v->child->sig) + 1);
+		marshal(b, v->child);
+		break;
+	default:
+		b->failed = 1;
+	}
+}
+
+static void rd_align(struct dbus_reader *r, size_t align)
+{
+	size_t pos = (r->pos + align - 1) & ~(align - 1);
+
+	if (pos > r->len)
+		r->failed = 1;
+	else
+		r->pos = pos;
+}
+
+static unsigned long long get_uint(struct dbus_reader *r, size_t size)
+{
+	unsigned char b[8], t;
+	uint16_t u16;
+	uint32_t u32;
+	uint64_t u64;
+	size_t i;
+
+	rd_align(r, size);
+	if (r->failed || r->len - r->pos < size) {
+		r->failed = 1;
+		return 0;
+	}
+	memcpy(b, r->data + r->pos, size);
+	r->pos += size;
+
+	for (i = 0; r->swap && i < size / 2; i++) {
+		t = b[i];
+		b[i] = b[size - 1 - i];
+		b[size - 1 - i] = t;
+	}
+
+	switch (size) {
+	case 1:
+		return b[0];
+	case 2:
+		memcpy(&u16, b, 2);
+		return u16;
+	case 4:
+		memcpy(&u32, b, 4);
+		return u32;
+	}
+	memcpy(&u64, b, 8);
+	return u64;
+}
+
+static char *get_string(struct dbus_reader *r, size_t len)
+{
+	char *s;
+
+	if (r->failed || r->len - r->pos <= len || r->data[r->pos + len] != '\0') {
+		r->failed = 1;
+		return NULL;
+	}
+	s = strndup((const char *)r->data + r->pos, len);
+	if (s == NULL)
+		r->failed = 1;
+	r->pos += len + 1;
+
+	return s;
+}
+
+/* value of the complete type sig of len */
+static struct dbus_value *unmarshal(struct dbus_reader *r, const char *sig, size_t len,
+		int depth)
+{
+	struct dbus_value *v, *item;
+	unsigned long long u;
+	size_t n, end;
+	char *s;
+
+	if (depth > DBUS_MAX_DEPTH || (v = value_alloc(sig, len)) == NULL) {
+		r->failed = 1;
+		return NULL;
+	}
+
+	switch (*sig) {
+	case 'y':
+		v->v.u = get_uint(r, 1);
+		break;
+	case 'n':
+		v->v.u = (long long)(int16_t)get_uint(r, 2);
+		break;
+	case 'q':
+		v->v.u = get_uint(r, 2);
+		break;
+	case 'i':
+		v->v.u = (long long)(int32_t)get_uint(r, 4);
+		break;
+	case 'b': case 'u':
+		v->v.u = get_uint(r, 4);
+		break;
+	case 'x': case 't':
+		v->v.u = get_uint(r, 8);
+		break;
+	case 'd':
+		u = get_uint(r, 8);
+		memcpy(&v->v.d, &u, 8);
+		break;
+	case 's': case 'o':
+		n = get_uint(r, 4);
+		v->v.s = get_string(r, n);
+		break;
+	case 'g':
+		n = get_uint(r, 1);
+		v->v.s = get_string(r, n);
+		break;
+	case 'a':
+		n = get_uint(r, 4);
+		rd_align(r, type_align(sig[1]));
+		if (r->failed || n > r->len - r->pos) {
+			r->failed = 1;
+			break;
+		}
+		end = r->pos + n;
+		while (!r->failed && r->pos < end)
+			if ((item = unmarshal(r, sig + 1, len - 1, depth + 1)) != NULL)
+				add_child(v, item);
+		if (r->pos != end)
+			r->failed = 1;
+		break;
+	case '(': case '{':
+		rd_align(r, 8);
+		for (s = (char *)sig + 1; !r->failed && *s != ')' && *s != '}'; s += n) {
+			n = sig_len(s);
+			if ((item = unmarshal(r, s, n, depth + 1)) != NULL)
+				add_child(v, item);
+		}
+		break;
+	case 'v':
+		n = get_uint(r, 1);
+		s = get_string(r, n);
+		if (s == NULL || n == 0 || sig_len(s) != n) {
+			r->failed = 1;
+		} else if ((item = unmarshal(r, s, n, depth + 1)) != NULL) {
+			add_child(v, item);
+		}
+		free(s);
+		break;
+	default:
+		r->failed = 1;
+	}
+
+	if (r->failed) {
+		dbus_free(v);
+		return NULL;
+	}
+
+	return v;
+}
+
+/* values of all complete types of signature */
+static struct dbus_value *unmarshal_body(struct dbus_reader *r, const char *sig)
+{
+	struct dbus_value *head = NULL, **tail = &head;
+	size_t n;
+
+	for (; *sig && !r->failed; sig += n) {
+		n = sig_len(sig);
+		if (n == 0)
+			r->failed = 1;
+		else if ((*tail = unmarshal(r, sig, n, 0)) != NULL)
+			tail = &(*tail)->next;
+	}
+
+	if (r->failed) {
+		dbus_free(head);
+		return NULL;
+	}
+
+	return head;
+}
+
+static long long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* wait for events of socket until deadline */
+static int wait_fd(int fd, short events, long long deadline)
+{
+	struct pollfd pfd = {fd, events, 0};
+	long long left;
+	int rc;
+
+	for (;;) {
+		left = deadline - now_ms();
+		if (left <= 0) {
+			errno = ETIMEDOUT;
+			return -1;
+		}
+		rc = poll(&pfd, 1, left > INT_MAX ? INT_MAX : (int)left);
+		if (rc > 0)
+			return 0;
+		if (rc < 0 && errno != EINTR)
+			return -1;
+	}
+}
+
+static int send_all(struct dbus_conn *conn, const void *data, size_t len, long long deadline)
+{
+	const char *p = (const char *)data;
+	ssize_t n;
+
+	while (len > 0) {
+		n = send(conn->fd, p, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if ((errno == EAGAIN || errno == EWOULDBLOCK) &&
+					!wait_fd(conn->fd, POLLOUT, deadline))
+				continue;
+			return -1;
+		}
+		p += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int recv_all(struct dbus_conn *conn, void *data, size_t len, long long deadline)
+{
+	char *p = (char *)data;
+	ssize_t n;
+
+	while (len > 0) {
+		if (wait_fd(conn->fd, POLLIN, deadline))
+			return -1;
+		n = recv(conn->fd, p, len, MSG_DONTWAIT);
+		if (n == 0) {
+			errno = ECONNRESET;
+			return -1;
+		}
+		if (n < 0) {
+			if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+				continue;
+			return -1;
+		}
+		p += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/* SASL EXTERNAL with effective uid, line of reply is read byte by byte,
+   nothing is sent by bus after it until BEGIN */
+static int authenticate(struct dbus_conn *conn, long long deadline)
+{
+	char buf[512], uid[32], *p;
+	size_t len;
+
+	snprintf(uid, sizeof(uid), "%u", (unsigned int)geteuid());
+	buf[0] = '\0';
+	len = 1 + snprintf(buf + 1, sizeof(buf) - 1, "AUTH EXTERNAL ");
+	for (p = uid; *p; p++)
+		len += snprintf(buf + len, sizeof(buf) - len, "%02x", (unsigned char)*p);
+	len += snprintf(buf + len, sizeof(buf) - len, "\r\n");
+	if (send_all(conn, buf, len, deadline))
+		goto err;
+
+	for (len = 0; len < sizeof(buf) - 1; len++) {
+		if (recv_all(conn, buf + len, 1, deadline))
+			goto err;
+		if (buf[len] == '\n')
+			break;
+	}
+	buf[len] = '\0';
+	if (strncmp(buf, "OK ", 3)) {
+		error(0, "D-Bus authentication is rejected: %s", buf);
+		return -1;
+	}
+
+	if (send_all(conn, "BEGIN\r\n", 7, deadline))
+		goto err;
+
+	return 0;
+err:
+	error(errno, "D-Bus authentication failed");
+	return -1;
+}
+
+static int add_field(struct dbus_value *fields, int code, struct dbus_value *value)
+{
+	struct dbus_value *field = dbus_new("(yv)");
+
+	if (field == NULL) {
+		dbus_free(value);
+		return -1;
+	}
+	if (dbus_add(field, dbus_new_uint('y', code)) ||
+			dbus_add(field, dbus_new_variant(value))) {
+		dbus_free(field);
+		return -1;
+	}
+
+	return dbus_add(fields, field);
+}
+
+static int send_call(struct dbus_conn *conn, const char *dest, const char *path,
+		const char *iface, const char *member, const struct dbus_value *args,
+		long long deadline)
+{
+	struct dbus_buf body = {NULL, 0, 0, 0}, msg = {NULL, 0, 0, 0};
+	const struct dbus_value *it;
+	struct dbus_value *fields;
+	char sig[DBUS_MAX_SIGNATURE + 1] = "";
+	size_t len = 0;
+	int rc = -1;
+
+	for (it = args; it != NULL; it = it->next) {
+		if (len + strlen(it->sig) > DBUS_MAX_SIGNATURE) {
+			error(0, "Too many arguments of D-Bus method %s", member);
+			return -1;
+		}
+		strcpy(sig + len, it->sig);
+		len += strlen(it->sig);
+		marshal(&body, it);
+	}
+
+	fields = dbus_new("a(yv)");
+	if (add_field(fields, FIELD_PATH, dbus_new_string('o', path)) ||
+			(dest && add_field(fields, FIELD_DESTINATION, dbus_new_string('s', dest))) ||
+			(iface && add_field(fields, FIELD_INTERFACE, dbus_new_string('s', iface))) ||
+			add_field(fields, FIELD_MEMBER, dbus_new_string('s', member)) ||
+			(len && add_field(fields, FIELD_SIGNATURE, dbus_new_string('g', sig))))
+		goto out;
+
+	if (++conn->serial == 0)
+		conn->serial = 1;
+	put_uint(&msg, host_order(), 1);
+	put_uint(&msg, MSG_CALL, 1);
+	put_uint(&msg, 0, 1);
+	put_uint(&msg, 1, 1);
+	put_uint(&msg, body.len, 4);
+	put_uint(&msg, conn->serial, 4);
+	marshal(&msg, fields);
+	buf_align(&msg, 8);
+	buf_put(&msg, body.data, body.len);
+	if (body.failed || msg.failed || body.len > DBUS_MAX_MESSAGE) {
+		error(0, "Can't build D-Bus message %s", member);
+		goto out;
+	}
+
+	rc = send_all(conn, msg.data, msg.len, deadline);
+	if (rc)
+		error(errno, "Can't send D-Bus message %s", member);
+out:
+	dbus_free(fields);
+	free(body.data);
+	free(msg.data);
+
+	return rc;
+}
+
+/* wait for reply to serial, other messages are dropped */
+static int read_reply(struct dbus_conn *conn, const char *member,
+		struct dbus_value **reply, long long deadline)
+{
+	unsigned char fixed[16], *data;
+	struct dbus_reader r = {NULL, 0, 0, 0, 0};
+	struct dbus_value *fields, *it, *body;
+	unsigned int reply_serial;
+	size_t header_len, body_len;
+	const char *sig, *name;
+	int type;
+
+	for (;;) {
+		if (recv_all(conn, fixed, sizeof(fixed), deadline)) {
+			error(errno, "Can't receive reply to D-Bus message %s", member);
+			return -1;
+		}
+		if ((fixed[0] != 'l' && fixed[0] != 'B') || fixed[3] != 1) {
+			error(0, "Invalid D-Bus message in reply to %s", member);
+			return -1;
+		}
+
+		r.data = fixed;
+		r.len = sizeof(fixed);
+		r.pos = 4;
+		r.failed = 0;
+		r.swap = (fixed[0] != host_order());
+		body_len = get_uint(&r, 4);
+		r.pos = 12;
+		header_len = get_uint(&r, 4);
+		header_len = (16 + header_len + 7) & ~(size_t)7;
+		if (body_len > DBUS_MAX_MESSAGE || header_len > DBUS_MAX_MESSAGE) {
+			error(0, "Too long D-Bus message in reply to %s", member);
+			return -1;
+		}
+
+		data = (unsigned char *)malloc(header_len + body_len);
+		if (data == NULL) {
+			error(errno, "Can't allocate memory for D-Bus message");
+			return -1;
+		}
+		memcpy(data, fixed, sizeof(fixed));
+		if (recv_all(conn, data + sizeof(fixed),
+					header_len + body_len - sizeof(fixed), deadline)) {
+			error(errno, "Can't receive reply to D-Bus message %s", member);
+			free(data);
+			return -1;
+		}
+
+		r.data = data;
+		r.len = header_len;
+		r.pos = 12;
+		fields = unmarshal(&r, "a(yv)", 5, 0);
+		if (fields == NULL) {
+			error(0, "Invalid D-Bus message in reply to %s", member);
+			free(data);
+			return -1;
+		}
+
+		type = fixed[1];
+		reply_serial = 0;
+		sig = "";
+		name = "";
+		for (it = fields->child; it != NULL; it = it->next) {
+			const struct dbus_value *value = it->child->next->child;
+
+			if (it->child->v.u == FIELD_REPLY_SERIAL && *value->sig == 'u')
+				reply_serial = value->v.u;
+			else if (it->child->v.u == FIELD_SIGNATURE && *value->sig == 'g')
+				sig = value->v.s;
+			else if (it->child->v.u == FIELD_ERROR_NAME && *value->sig == 's')
+				name = value->v.s;
+		}
+
+		if ((type != MSG_RETURN && type != MSG_ERROR) || reply_serial != conn->serial) {
+			dbus_free(fields);
+			free(data);
+			continue;
+		}
+
+		r.data = data + header_len;
+		r.len = body_len;
+		r.pos = 0;
+		r.failed = 0;
+		body = unmarshal_body(&r, sig);
+		if (r.failed) {
+			error(0, "Invalid D-Bus message in reply to %s", member);
+			dbus_free(fields);
+			free(data);
+			return -1;
+		}
+
+		if (type == MSG_ERROR) {
+			snprintf(conn->error, sizeof(conn->error), "%s%s%s", name,
+				(body && *body->sig == 's') ? ": " : "",
+				(body && *body->sig == 's') ? body->v.s : "");
+			debug("D-Bus %s failed: %s", member, conn->error);
+			dbus_free(body);
+		} else if (reply != NULL) {
+			*reply = body;
+		} else {
+			dbus_free(body);
+		}
+		dbus_free(fields);
+		free(data);
+
+		return (type == MSG_ERROR) ? 1 : 0;
+	}
+}
+
+int dbus_call(struct dbus_conn *conn, const char *dest, const char *path,
+		const char *iface, const char *member, struct dbus_value *args,
+		struct dbus_value **reply)
+{
+	long long deadline = now_ms() + DBUS_TIMEOUT;
+	int rc;
+
+	conn->error[0] = '\0';
+	if (reply != NULL)
+		*reply = NULL;
+
+	rc = send_call(conn, dest, path, iface, member, args, deadline);
+	dbus_free(args);
+	if (rc)
+		return -1;
+
+	return read_reply(conn, member, reply, deadline);
+}
+
+const char *dbus_error(const struct dbus_conn *conn)
+{
+	return conn->error;
+}
+
+static int unhex(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/* socket of the first unix: address of list, value of path or abstract
+   key is %-escaped, abstract name starts with '\0' */
+static int parse_address(const char *address, struct sockaddr_un *addr, socklen_t *addr_len)
+{
+	char buf[1024], *entry, *key, *save1, *save2, *value;
+	size_t len;
+	int abstract;
+
+	snprintf(buf, sizeof(buf), "%s", address);
+	for (entry = strtok_r(buf, ";", &save1); entry != NULL;
+			entry = strtok_r(NULL, ";", &save1)) {
+		if (strncmp(entry, "unix:", 5))
+			continue;
+
+		for (key = strtok_r(entry + 5, ",", &save2); key != NULL;
+				key = strtok_r(NULL, ",", &save2)) {
+			if (!strncmp(key, "path=", 5))
+				abstract = 0;
+			else if (!strncmp(key, "abstract=", 9))
+				abstract = 1;
+			else
+				continue;
+
+			memset(addr, 0, sizeof(*addr));
+			addr->sun_family = AF_UNIX;
+			len = abstract;
+			for (value = strchr(key, '=') + 1; *value; value++) {
+				if (len >= sizeof(addr->sun_path) - 1)
+					return -1;
+				if (*value == '%' && unhex(value[1]) >= 0 && unhex(value[2]) >= 0) {
+					addr->sun_path[len++] = unhex(value[1]) * 16 + unhex(value[2]);
+					value += 2;
+				} else {
+					addr->sun_path[len++] = *value;
+				}
+			}
+			*addr_len = offsetof(struct sockaddr_un, sun_path) + len + !abstract;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+struct dbus_conn *dbus_connect(void)
+{
+	const char *address = getenv(DBUS_BUS_ENV);
+	struct dbus_conn *conn;
+	struct sockaddr_un addr;
+	socklen_t addr_len;
+
+	if (address == NULL || *address == '\0')
+		address = DBUS_SYSTEM_BUS;
+	if (parse_address(address, &addr, &addr_len)) {
+		error(0, "Unsupported address of D-Bus: %s", address);
+		return NULL;
+	}
+
+	conn = (struct dbus_conn *)calloc(1, sizeof(*conn));
+	if (conn == NULL) {
+		error(errno, "Can't allocate memory");
+		return NULL;
+	}
+
+	conn->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (conn->fd < 0) {
+		error(errno, "Can't create socket");
+		free(conn);
+		return NULL;
+	}
+
+	if (connect(conn->fd, (struct sockaddr *)&addr, addr_len)) {
+		error(errno, "Can't connect to D-Bus %s", address);
+		goto err;
+	}
+
+	if (authenticate(conn, now_ms() + DBUS_TIMEOUT))
+		goto err;
+
+	if (dbus_call(conn, DBUS_SERVICE, DBUS_PATH, DBUS_SERVICE, "Hello", NULL, NULL)) {
+		error(0, "Can't register on D-Bus %s %s", address, conn->error);
+		goto err;
+	}
+
+	return conn;
+err:
+	dbus_disconnect(conn);
+	return NULL;
+}
+
+void dbus_disconnect(struct dbus_conn *conn)
+{
+	if (conn == NULL)
+		return;
+
+	close(conn->fd);
+	free(conn);
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2019 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * minimal client of D-Bus: method calls over unix socket of system bus
+ */
+
+#ifndef __DBUS_H__
+#define __DBUS_H__
+
+#include <stddef.h>
+
+/* address of system bus, DBUS_SYSTEM_BUS_ADDRESS overrides it,
+   so private bus of test service may be used */
+#define DBUS_SYSTEM_BUS	"unix:path=/var/run/dbus/system_bus_socket"
+#define DBUS_BUS_ENV	"DBUS_SYSTEM_BUS_ADDRESS"
+
+/* time to wait for reply, ms, the same as default of libdbus */
+#define DBUS_TIMEOUT	25000
+
+/* value of any D-Bus type, items of arrays, fields of structures
+   and dict entries and value of variant are children */
+struct dbus_value
+{
+	char *sig;	/* complete type of value */
+	union {
+		unsigned long long u;	/* y b n q i u x t, signed are sign-extended */
+		double d;
+		char *s;	/* s o g */
+	} v;
+	struct dbus_value *child, *last;
+	struct dbus_value *next;
+};
+
+struct dbus_conn;
+
+/* connect to system bus and register on it, return NULL on error */
+struct dbus_conn *dbus_connect(void);
+
+void dbus_disconnect(struct dbus_conn *conn);
+
+/* call method and wait for its reply, args and values of reply are linked
+   by next, args are freed, reply is set only on success
+return 0 on success, 1 - error reply, see dbus_error(), -1 - failure of
+connection, it should not be used anymore */
+int dbus_call(struct dbus_conn *conn, const char *dest, const char *path,
+		const char *iface, const char *member, struct dbus_value *args,
+		struct dbus_value **reply);
+
+/* name and message of the last error reply */
+const char *dbus_error(const struct dbus_conn *conn);
+
+/* container of sig without items, or basic value 0 */
+struct dbus_value *dbus_new(const char *sig);
+
+/* basic value of type y b n q i u x t */
+struct dbus_value *dbus_new_uint(char type, unsigned long long u);
+
+/* string of type s o g */
+struct dbus_value *dbus_new_string(char type, const char *s);
+
+/* variant holding value */
+struct dbus_value *dbus_new_variant(struct dbus_value *value);
+
+/* append item to array or field to structure,
+return 0 on success, item is freed on error */
+int dbus_add(struct dbus_value *parent, struct dbus_value *item);
+
+struct dbus_value *dbus_copy(const struct dbus_value *value);
+
+/* free value with all values linked after it */
+void dbus_free(struct dbus_value *value);
+
+/* value of key in dict a{s...}, variant is unwrapped, NULL if it is absent */
+struct dbus_value *dbus_dict_get(const struct dbus_value *dict, const char *key);
+
+/* replace value of key in dict, value is wrapped in variant for a{sv}
+return 0 on success, value is freed on error */
+int dbus_dict_set(struct dbus_value *dict, const char *key, struct dbus_value *value);
+
+void dbus_dict_del(struct dbus_value *dict, const char *key);
+
+/* string of value of key of dict, NULL if it is absent or not a string */
+const char *dbus_dict_string(const struct dbus_value *dict, const char *key);
+
+#endif
@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2019 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * native writers of Debian ifupdown configuration: stanzas of all
+ * addresses are printed at once into the model of interfaces files
+ */
+
+#include "../common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "../namelist.h"
+#include "detection.h"
+#include "exec.h"
+#include "ifupdown.h"
+#include "debian.h"
+#include "sysroot.h"
+
+#define DEFAULT_MASK	"255.255.255.255"
+#define DEFAULT_PREFIX6	"64"
+
+/* word of set_ip options, as set_options in functions checks it */
+static int has_opt(const char *opts, const char *name)
+{
+	size_t len = strlen(name);
+	const char *p;
+
+	for (p = opts; (p = strstr(p, name)) != NULL; p += len)
+		if ((p == opts || p[-1] == ' ') && (p[len] == '\0' || p[len] == ' '))
+			return 1;
+
+	return 0;
+}
+
+/* split IP/MASK in place, mask is NULL if it is not given */
+static char *split_mask(char *ip_mask)
+{
+	char *mask = strrchr(ip_mask, '/');
+
+	if (mask == NULL)
+		return NULL;
+
+	mask = (mask[1] != '\0') ? mask + 1 : NULL;
+	*strchr(ip_mask, '/') = '\0';
+
+	return mask;
+}
+
+static void print_ipv6_header(FILE *fp, const char *dev, const char *method,
+		int *auto_set)
+{
+	if (!*auto_set) {
+		*auto_set = 1;
+		fprintf(fp, "auto %s\n", dev);
+	}
+
+	fprintf(fp, "iface %s inet6 %s\n", dev, method);
+	// 2.6.35 kernel doesn't flush IPv6 addresses
+	fprintf(fp, "\tpre-down ip -6 addr flush dev %s scope global || :\n", dev);
+}
+
+/* stanzas of device as print_config of debian-set_ip.sh prints them,
+   to be freed by caller */
+static char *print_config(struct netinfo *if_it, struct namelist *addrs, int dhcp4)
+{
+	const char *dev = if_it->name;
+	struct namelist *it, *ip6 = NULL, **ip6_tail = &ip6;
+	int ifnum = -1, ip4_count = 0, auto_set = 0;
+	char buf[PATH_MAX], alias[NAME_LENGTH + 16];
+	char *text = NULL, *ip, *mask;
+	size_t len = 0;
+	FILE *fp;
+
+	fp = open_memstream(&text, &len);
+	if (fp == NULL) {
+		error(errno, "Can't allocate memory");
+		return NULL;
+	}
+
+	for (it = addrs; it != NULL; it = it->next) {
+		ip = it->name;
+		mask = split_mask(ip);
+
+		if (is_ipv6(ip)) {
+			//secondary addresses are added by "up" lines of one stanza
+			snprintf(buf, sizeof(buf), "%s/%s", ip, mask ? mask : DEFAULT_PREFIX6);
+			namelist_append(buf, &ip6_tail);
+			continue;
+		}
+
+		ifnum++;
+		if (ifnum == 0) {
+			snprintf(alias, sizeof(alias), "%s", dev);
+			auto_set = 1;
+		} else {
+			snprintf(alias, sizeof(alias), "%s:%d", dev, ifnum);
+		}
+		fprintf(fp, "auto %s\n", alias);
+
+		if (!strcmp(ip, "remove")) {
+			fprintf(fp, "\n");
+			continue;
+		}
+		ip4_count++;
+		fprintf(fp, "iface %s inet static\n\taddress %s\n\tnetmask %s\n"
+				"\tbroadcast +\n\n", alias, ip, mask ? mask : DEFAULT_MASK);
+	}
+
+	if (ip6 != NULL) {
+		print_ipv6_header(fp, dev, "static", &auto_set);
+		mask = strrchr(ip6->name, '/');
+		fprintf(fp, "\taddress %.*s\n", (int)(mask - ip6->name), ip6->name);
+		fprintf(fp, "\tnetmask %s\n", mask + 1);
+		for (it = ip6->next; it != NULL; it = it->next)
+			fprintf(fp, "\tup ip addr add %s dev %s\n", it->name, dev);
+		fprintf(fp, "\n\n");
+	}
+
+	if (ip4_count == 0 && dhcp4)
+		fprintf(fp, "\niface %s inet dhcp\n\n", dev);
+
+	// unset IPv6 addresses on interface down
+	if (ip6 == NULL)
+		print_ipv6_header(fp, dev, "manual", &auto_set);
+
+	namelist_clean(&ip6);
+	if (fclose(fp)) {
+		error(errno, "Can't allocate memory");
+		free(text);
+		return NULL;
+	}
+
+	return text;
+}
+
+int debian_set_ip(struct netinfo *if_it, const char *value, const char *opts, int live)
+{
+	struct namelist *addrs = NULL;
+	struct ifupdown *m;
+	char path[PATH_MAX];
+	char *text;
+	int rc;
+
+	m = ifupdown_get();
+	if (m == NULL)
+		return -1;
+
+	namelist_split(&addrs, value);
+	text = print_config(if_it, addrs, has_opt(opts, "dhcp"));
+	namelist_clean(&addrs);
+	if (text == NULL)
+		return -1;
+
+	ifupdown_remove(m, if_it->name);
+	rc = ifupdown_append(m, text);
+	free(text);
+	if (rc == 0)
+		rc = ifupdown_save(m);
+	if (rc)
+		return rc;
+
+	if (!live && !sysroot_offline()) {
+		const char *argv[] = {"ip", "-4", "addr", "flush", "dev", if_it->name, NULL};
+		run_cmdv(argv);
+	}
+
+	if (!live && !exec_is_deferred() &&
+			backend_script(get_backend(), OP_RESTART, path) != NULL) {
+		const char *argv[] = {path, if_it->name, NULL};
+		run_cmdv(argv);
+	}
+
+	return 0;
+}
+
+/* wide-dhcpv6-client lists devices in INTERFACES */
+static int get_wide_dhcpv6(const char *dev)
+{
+	char buf[1024];
+	const char *p;
+	int found = 0;
+	FILE *fp;
+
+	fp = fopen(WIDE_DHCPV6_CONFIG, "r");
+	if (fp == NULL)
+		return 1;
+
+	while (!found && fgets(buf, sizeof(buf), fp) != NULL) {
+		p = buf + strspn(buf, " \t");
+		found = !strncmp(p, "INTERFACES", 10) && strstr(p + 10, dev) != NULL;
+	}
+	fclose(fp);
+
+	return found ? 0 : 1;
+}
+
+int debian_get_dhcp(struct netinfo *if_it, int proto)
+{
+	char method[32];
+	struct ifupdown *m;
+
+	if (proto == 6)
+		return get_wide_dhcpv6(if_it->name);
+
+	m = ifupdown_get();
+	if (m == NULL || !ifupdown_exists(m))
+		return 2;
+
+	if (ifupdown_method(m, if_it->name, "inet", method, sizeof(method)) &&
+			strstr(method, "dhcp") != NULL)
+		return 0;
+
+	return 1;
+}
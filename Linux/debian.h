@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2019 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * native writers of Debian ifupdown configuration
+ */
+
+#ifndef __DEBIAN_H__
+#define __DEBIAN_H__
+
+#include "../netinfo.h"
+
+/* devices with DHCPv6 of wide-dhcpv6-client, it is set by scripts */
+#ifndef WIDE_DHCPV6_CONFIG
+#define WIDE_DHCPV6_CONFIG	"/etc/default/wide-dhcpv6-client"
+#endif
+
+/* replace stanzas of device in interfaces files with addresses of value
+   as debian-set_ip.sh does and restart device unless it is deferred,
+   opts are options of set_ip script, live is set if addresses are
+   already changed in kernel
+return 0 on success */
+int debian_set_ip(struct netinfo *if_it, const char *value, const char *opts, int live);
+
+/* check if device is configured for DHCP of proto 4 or 6
+   as debian-get_dhcp.sh does
+return 0 - enabled, 1 - disabled, 2 - configuration is not found */
+int debian_get_dhcp(struct netinfo *if_it, int proto);
+
+#endif
@@ -21,50 +21,360 @@
  * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
  * Schaffhausen, Switzerland.
  *
- * methods for getting distribution
+ * methods for getting distribution and network controller
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <limits.h>
 #include <sys/stat.h>
 #include <sys/statfs.h>
 #include <string.h>
 
+#include "../common.h"
 #include "detection.h"
+#include "debian.h"
+#include "ledger.h"
+#include "netplan.h"
+#include "nm.h"
+#include "sysconfig.h"
+#include "sysroot.h"
 
 #define RH_RELEASE "/etc/redhat-release"
+#ifndef SUSE_RELEASE
 #define SUSE_RELEASE "/etc/SuSE-release"
+#endif
 #define DEBIAN_RELEASE "/etc/debian_version"
 
-int get_distribution(int *os_vendor, char **os_script_prefix)
+#define NM_SYSTEM_CONF "/etc/NetworkManager/nm-system-settings.conf"
+#define NM_CONF "/etc/NetworkManager/NetworkManager.conf"
+#define NM_PID_FILE "/run/NetworkManager/NetworkManager.pid"
+#define DEBIAN_INTERFACES "/etc/network/interfaces"
+
+/* systemd keeps link for each active unit here since v232 */
+#define SYSTEMD_UNITS "/run/systemd/units"
+#define UNIT_ACTIVE(unit) SYSTEMD_UNITS "/invocation:" unit ".service"
+
+#define FNV_OFFSET	0xcbf29ce484222325ULL
+#define FNV_PRIME	0x100000001b3ULL
+
+/* files which define result of detection */
+static const char *fingerprint_files[] = {
+	RH_RELEASE, SUSE_RELEASE, DEBIAN_RELEASE,
+	NM_SYSTEM_CONF, NM_CONF, NM_PID_FILE, DEBIAN_INTERFACES,
+	"/usr/sbin/netplan", "/usr/bin/netplan", "/sbin/netplan", "/bin/netplan",
+	SYSTEMD_UNITS, UNIT_ACTIVE("NetworkManager"), UNIT_ACTIVE("wickedd"),
+	UNIT_ACTIVE("systemd-networkd"),
+	NULL
+};
+
+static const char *netplan_bins[] = {
+	"/usr/sbin/netplan", "/usr/bin/netplan", "/sbin/netplan", "/bin/netplan", NULL
+};
+
+static const char *controller_names[CONTROLLER_MAX] = {
+	"none", "ifcfg", "ifupdown", "nm", "netplan", "wicked", "networkd"
+};
+
+static const char *op_names[OP_MAX] = {
+	"set_ip", "set_gateway", "set_route", "set_dhcp", "get_dhcp",
+	"set_dns", "activate", "restart"
+};
+
+static struct net_backend backend;
+static const struct net_backend netlink_backend;
+static unsigned long long backend_fingerprint;
+static int backend_detected;
+
+static unsigned long long fnv1a(unsigned long long hash, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+
+	while (len--) {
+		hash ^= *p++;
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+static unsigned long long get_fingerprint(void)
+{
+	unsigned long long hash = FNV_OFFSET;
+	struct stat st;
+	unsigned long long key[3];
+	int i;
+
+	for (i = 0; fingerprint_files[i] != NULL; i++) {
+		memset(key, 0, sizeof(key));
+		if (!lstat(fingerprint_files[i], &st)) {
+			key[0] = st.st_ino;
+			key[1] = st.st_mtime;
+			key[2] = st.st_size;
+		}
+		hash = fnv1a(hash, key, sizeof(key));
+	}
+
+	return hash;
+}
+
+static int is_file(const char *path)
+{
+	struct stat st;
+
+	return !stat(path, &st);
+}
+
+static int is_pid_alive(const char *pid_file)
+{
+	FILE *fp;
+	int pid = 0;
+
+	fp = fopen(pid_file, "r");
+	if (fp == NULL)
+		return 0;
+	if (fscanf(fp, "%d", &pid) != 1)
+		pid = 0;
+	fclose(fp);
+
+	return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+/* same as "systemctl is-active" without running it */
+static int is_unit_active(const char *unit_link, const char *pid_file)
 {
 	struct stat st;
 
+	if (!lstat(SYSTEMD_UNITS, &st))
+		return !lstat(unit_link, &st);
+
+	return pid_file != NULL && is_pid_alive(pid_file);
+}
+
+static int is_netplan_present(void)
+{
+	int i;
+
+	for (i = 0; netplan_bins[i] != NULL; i++)
+		if (!access(netplan_bins[i], X_OK))
+			return 1;
+	return 0;
+}
+
+/* same choice which is made by scripts themselves */
+static void detect(struct net_backend *b)
+{
+	b->vendor = VENDOR_UNKNOWN;
+	b->controller = CONTROLLER_NONE;
+	b->nm_active = is_unit_active(UNIT_ACTIVE("NetworkManager"), NM_PID_FILE);
+
+	if (is_file(RH_RELEASE)) {
+		b->vendor = VENDOR_REDHAT;
+		b->controller = b->nm_active ? CONTROLLER_NM : CONTROLLER_IFCFG;
+	} else if (is_file(SUSE_RELEASE)) {
+		b->vendor = VENDOR_SUSE;
+		if (b->nm_active)
+			b->controller = CONTROLLER_NM;
+		else if (is_unit_active(UNIT_ACTIVE("wickedd"), NULL))
+			b->controller = CONTROLLER_WICKED;
+		else
+			b->controller = CONTROLLER_IFCFG;
+	} else if (is_file(DEBIAN_RELEASE)) {
+		b->vendor = VENDOR_DEBIAN;
+		if (is_netplan_present())
+			b->controller = CONTROLLER_NETPLAN;
+		else if (b->nm_active && (is_file(NM_SYSTEM_CONF) || is_file(NM_CONF)))
+			b->controller = CONTROLLER_NM;
+		else if (!is_file(DEBIAN_INTERFACES) &&
+				is_unit_active(UNIT_ACTIVE("systemd-networkd"), NULL))
+			b->controller = CONTROLLER_NETWORKD;
+		else
+			b->controller = CONTROLLER_IFUPDOWN;
+	}
+}
+
+/* scripts of operations, NetworkManager scripts are called directly
+   where distribution scripts would redirect to them */
+static void fill_ops(struct net_backend *b)
+{
+	int i, nm = (b->controller == CONTROLLER_NM);
+
+	b->prefix = NULL;
+	b->set_ip = NULL;
+	b->get_dhcp = NULL;
+	b->set_gateway = NULL;
+	b->set_route = NULL;
+	b->set_dhcp = NULL;
+	b->restart = NULL;
+	b->activate = NULL;
+	b->commit = NULL;
+	if (b->vendor == VENDOR_REDHAT)
+		b->prefix = "redhat";
+	else if (b->vendor == VENDOR_SUSE)
+		b->prefix = "suse";
+	else if (b->vendor == VENDOR_DEBIAN)
+		b->prefix = "debian";
+
+	for (i = 0; i < OP_MAX; i++)
+		b->ops[i] = b->prefix;
+
+	//set_dns.sh is common for all distributions
+	b->ops[OP_SET_DNS] = b->nm_active ? "nm" : "";
+	if (b->prefix == NULL)
+		return;
+
+	//suse scripts do not use NetworkManager
+	if (nm && b->vendor != VENDOR_SUSE) {
+		b->ops[OP_SET_IP] = "nm";
+		b->ops[OP_SET_GATEWAY] = "nm";
+		b->ops[OP_SET_ROUTE] = "nm";
+		b->ops[OP_SET_DHCP] = "nm";
+		b->ops[OP_GET_DHCP] = "nm";
+		b->ops[OP_ACTIVATE] = "nm";
+		//restart of whole network falls back to init script
+		if (b->vendor == VENDOR_DEBIAN)
+			b->ops[OP_RESTART] = "nm";
+	}
+
+	//ifcfg files are written in process, old RedHat is left to script
+	//which disables NetworkManager
+	if (b->vendor == VENDOR_SUSE)
+		b->set_ip = suse_set_ip;
+	else if (b->vendor == VENDOR_REDHAT && !nm && !redhat_disables_nm())
+		b->set_ip = redhat_set_ip;
+
+	//interfaces files are parsed once, debian scripts hand device to
+	//NetworkManager if it is configured and leave DHCPv6 to wide-dhcpv6
+	if (b->vendor == VENDOR_DEBIAN && b->controller == CONTROLLER_IFUPDOWN) {
+		if (!b->nm_active)
+			b->get_dhcp = debian_get_dhcp;
+		if (access(NM_CONF, F_OK) && access(NM_SYSTEM_CONF, F_OK) &&
+				access(WIDE_DHCPV6_CONFIG, F_OK))
+			b->set_ip = debian_set_ip;
+	}
+
+	//netplan YAML is edited in process instead of netplan-cfg.py
+	if (b->vendor == VENDOR_DEBIAN && b->controller == CONTROLLER_NETPLAN) {
+		b->set_ip = netplan_set_ip;
+		b->set_gateway = netplan_set_gateway;
+		b->set_route = netplan_set_route;
+		b->set_dhcp = netplan_set_dhcp;
+		b->get_dhcp = netplan_get_dhcp;
+		b->restart = netplan_restart;
+		b->commit = netplan_commit;
+	}
+
+	//profiles are changed over D-Bus instead of nmcli calls of nm scripts,
+	//devices are reapplied instead of restart of NetworkManager
+	if (nm && b->vendor != VENDOR_SUSE) {
+		b->set_ip = nm_set_ip;
+		b->set_gateway = nm_set_gateway;
+		b->set_route = nm_set_route;
+		b->set_dhcp = nm_set_dhcp;
+		b->get_dhcp = nm_get_dhcp;
+		b->activate = nm_activate;
+		b->restart = nm_restart;
+		b->commit = nm_commit;
+	}
+}
+
+static int load_cache(unsigned long long fingerprint, struct net_backend *b)
+{
+	FILE *fp;
+	unsigned long long hash;
+	int vendor, controller, nm_active, rc = -1;
+
+	fp = fopen(BACKEND_CACHE, "r");
+	if (fp == NULL)
+		return -1;
+
+	if (fscanf(fp, "%llx %d %d %d", &hash, &vendor, &controller, &nm_active) == 4 &&
+			hash == fingerprint && controller >= 0 && controller < CONTROLLER_MAX) {
+		b->vendor = vendor;
+		b->controller = controller;
+		b->nm_active = nm_active;
+		rc = 0;
+	}
+	fclose(fp);
+
+	return rc;
+}
+
+static void save_cache(unsigned long long fingerprint, const struct net_backend *b)
+{
+	FILE *fp;
+
+	if (mkdir(LEDGER_DIR, 0700) && errno != EEXIST)
+		return;
+
+	fp = fopen(BACKEND_CACHE ".tmp", "w");
+	if (fp == NULL)
+		return;
+
+	fprintf(fp, "%llx %d %d %d\n", fingerprint, b->vendor, b->controller, b->nm_active);
+	if (fclose(fp) || rename(BACKEND_CACHE ".tmp", BACKEND_CACHE)) {
+		debug("Can't save %s: %s", BACKEND_CACHE, strerror(errno));
+		unlink(BACKEND_CACHE ".tmp");
+	}
+}
+
+const struct net_backend *get_backend(void)
+{
+	unsigned long long fingerprint = get_fingerprint();
+
+	if (backend_detected && fingerprint == backend_fingerprint)
+		return &backend;
+
+	if (load_cache(fingerprint, &backend)) {
+		detect(&backend);
+		save_cache(fingerprint, &backend);
+		debug("network backend: vendor %d, %s%s", backend.vendor,
+			controller_names[backend.controller],
+			backend.nm_active ? ", NetworkManager is active" : "");
+	}
+	fill_ops(&backend);
+	backend_fingerprint = fingerprint;
+	backend_detected = 1;
+
+	return &backend;
+}
+
+const struct net_backend *get_netlink_backend(void)
+{
+	return &netlink_backend;
+}
+
+const char *backend_name(const struct net_backend *b)
+{
+	return controller_names[b->controller];
+}
+
+const char *backend_script(const struct net_backend *b, enum BACKEND_OP op, char *path)
+{
+	const char *prefix = b->ops[op];
+
+	if (prefix == NULL)
+		return NULL;
+
+	snprintf(path, PATH_MAX, "%s/%s%s%s.sh", sysroot_script_dir(),
+			prefix, *prefix ? "-" : "", op_names[op]);
+	return path;
+}
+
+int get_distribution(int *os_vendor, char **os_script_prefix)
+{
+	const struct net_backend *b;
+
 	if (os_vendor == NULL)
 		return -1; /*nothing to do*/
 
-	//TODO: add detection distrib
-	if (os_vendor)
-		*os_vendor = VENDOR_UNKNOWN;
+	b = get_backend();
+
+	*os_vendor = b->vendor;
 	if (os_script_prefix)
-		*os_script_prefix = NULL;
-
-	if (!stat(RH_RELEASE, &st)) {
-		if (os_vendor)
-			*os_vendor = VENDOR_REDHAT;
-		if (os_script_prefix)
-			*os_script_prefix = "redhat";
-	} else if (!stat(SUSE_RELEASE, &st)) {
-		if (os_vendor)
-			*os_vendor = VENDOR_SUSE;
-		if (os_script_prefix)
-			*os_script_prefix = "suse";
-	} else if (!stat(DEBIAN_RELEASE, &st)) {
-		if (os_vendor)
-			*os_vendor = VENDOR_DEBIAN;
-		if (os_script_prefix)
-			*os_script_prefix = "debian";
-	} else
-		return -1;
+		*os_script_prefix = (char *)b->prefix;
 
-	return 0;
+	return (b->vendor == VENDOR_UNKNOWN) ? -1 : 0;
 }
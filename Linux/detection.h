@@ -34,6 +34,82 @@ enum OS_VENDOR {
 	VENDOR_DEBIAN = 3 /*debian, ubuntu*/
 };
 
+/* service which brings up devices from configuration */
+enum NET_CONTROLLER {
+	CONTROLLER_NONE = 0, /*unknown distribution, rtnetlink only*/
+	CONTROLLER_IFCFG, /*network-scripts, ifup of suse*/
+	CONTROLLER_IFUPDOWN,
+	CONTROLLER_NM,
+	CONTROLLER_NETPLAN,
+	CONTROLLER_WICKED,
+	CONTROLLER_NETWORKD,
+	CONTROLLER_MAX
+};
+
+/* operations done by scripts of backend */
+enum BACKEND_OP {
+	OP_SET_IP = 0,
+	OP_SET_GATEWAY,
+	OP_SET_ROUTE,
+	OP_SET_DHCP,
+	OP_GET_DHCP,
+	OP_SET_DNS,
+	OP_ACTIVATE,
+	OP_RESTART,
+	OP_MAX
+};
+
+struct netinfo;
+
+struct net_backend {
+	int vendor;
+	int controller;
+	int nm_active; /*NetworkManager service is running*/
+	const char *prefix; /*prefix of distribution scripts, NULL if unknown*/
+	/* prefix of script <prefix>-<op>.sh of each operation,
+	   "" for script without prefix, NULL if there is none */
+	const char *ops[OP_MAX];
+	/* native writer of addresses used instead of set_ip script,
+	   NULL if there is none, see sysconfig.h and debian.h */
+	int (*set_ip)(struct netinfo *if_it, const char *value, const char *opts,
+			int live);
+	/* native probe used instead of get_dhcp script, NULL if there is none
+	   return 0 - DHCP of proto 4 or 6 is enabled, 1 - disabled, 2 - error */
+	int (*get_dhcp)(struct netinfo *if_it, int proto);
+	/* native writers used instead of set_gateway, set_route and set_dhcp
+	   scripts and restart of devices, NULL if there are none, see netplan.h
+	   and nm.h, restart takes NULL-terminated list of names, NULL for
+	   whole network */
+	int (*set_gateway)(struct netinfo *if_it, const char *value, int live);
+	int (*set_route)(struct netinfo *if_it, const char *value, int live);
+	int (*set_dhcp)(struct netinfo *if_it, const char *proto);
+	int (*restart)(const char *const devs[]);
+	/* native activation used instead of activate script, NULL if there is none */
+	int (*activate)(struct netinfo *if_it);
+	/* write configuration kept in memory by native writers during
+	   operations of request, NULL if they write it at once */
+	int (*commit)(void);
+};
+
+/* cache of detected backend, valid while files it was detected by
+   are not changed */
+#define BACKEND_CACHE	"/run/prl_nettool/backend"
+
+/* detect distribution and controller of network, detection is done
+   once and cached in memory and BACKEND_CACHE */
+const struct net_backend *get_backend(void);
+
+/* backend of devices without configuration files: rtnetlink only,
+   no scripts and native writers */
+const struct net_backend *get_netlink_backend(void);
+
+/* name of controller, exported to scripts as PRL_NETTOOL_BACKEND */
+const char *backend_name(const struct net_backend *backend);
+
+/* path of script of operation, NULL if backend has no such script */
+const char *backend_script(const struct net_backend *backend,
+		enum BACKEND_OP op, char *path);
+
 int get_distribution(int *os_vendor, char **os_script_prefix);
 
 #endif
@@ -29,37 +29,489 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
 #include <sys/wait.h>
 #include <syslog.h>
 
 #include "exec.h"
 
-int run_cmd(const char *cmd)
+#ifndef EXEC_PATH
+#define EXEC_PATH	"PATH=/usr/sbin:/usr/bin:/sbin:/bin"
+#endif
+/* variables of prl_nettool environment passed to commands */
+#define EXEC_ENV_PREFIX	"PRL_NETTOOL"
+#define EXEC_ENV_MAX	64
+/* scripts only write configuration, devices are activated later */
+#define EXEC_ENV_DEFER	EXEC_ENV_PREFIX "_DEFER="
+/* controller of network detected by prl_nettool, scripts do not check it */
+#define EXEC_ENV_BACKEND	EXEC_ENV_PREFIX "_BACKEND="
+/* NetworkManager service runs, controller of devices may be other one */
+#define EXEC_ENV_NM_ACTIVE	EXEC_ENV_PREFIX "_NM_ACTIVE="
+/* stderr of failed command reported to user */
+#define EXEC_ERR_SIZE	2048
+/* check for exit of command which left its output open to daemons, ms */
+#define EXEC_POLL_MS	200
+/* time between SIGTERM and SIGKILL to process group of timed out command, ms */
+#define EXEC_KILL_GRACE	2000
+
+/* deadline of one command, s, 0 - no deadline */
+static unsigned int exec_timeout;
+/* end of time budget of whole request, ms of CLOCK_MONOTONIC, 0 - no budget */
+static long long exec_budget_end;
+static int exec_timeouts;
+
+extern char **environ;
+
+static char *exec_envp[EXEC_ENV_MAX + 1];
+static char exec_backend[64] = EXEC_ENV_BACKEND;
+static char *exec_nm_active = EXEC_ENV_NM_ACTIVE;
+
+/* environment of commands: fixed PATH, locale, PRL_NETTOOL_DEFER and
+   PRL_NETTOOL_BACKEND, PRL_NETTOOL_NM_ACTIVE plus other PRL_NETTOOL*
+   variables */
+static char **exec_env(void)
+{
+	char **it;
+	int n = 0;
+
+	if (exec_envp[0] != NULL)
+		return exec_envp;
+
+	exec_envp[n++] = EXEC_PATH;
+	exec_envp[n++] = "LANG=C";
+	exec_envp[n++] = "LC_ALL=C";
+	exec_envp[n++] = EXEC_ENV_DEFER "no";
+	exec_envp[n++] = exec_backend;
+	exec_envp[n++] = exec_nm_active;
+	for (it = environ; *it != NULL && n < EXEC_ENV_MAX; it++)
+		if (!strncmp(*it, EXEC_ENV_PREFIX, strlen(EXEC_ENV_PREFIX)) &&
+				strncmp(*it, EXEC_ENV_DEFER, strlen(EXEC_ENV_DEFER)) &&
+				strncmp(*it, EXEC_ENV_BACKEND, strlen(EXEC_ENV_BACKEND)) &&
+				strncmp(*it, EXEC_ENV_NM_ACTIVE, strlen(EXEC_ENV_NM_ACTIVE)))
+			exec_envp[n++] = *it;
+	exec_envp[n] = NULL;
+
+	return exec_envp;
+}
+
+void exec_set_defer(int defer)
+{
+	exec_env()[3] = defer ? EXEC_ENV_DEFER "yes" : EXEC_ENV_DEFER "no";
+}
+
+int exec_is_deferred(void)
+{
+	return strcmp(exec_env()[3], EXEC_ENV_DEFER "no") != 0;
+}
+
+void exec_set_backend(const char *name)
+{
+	snprintf(exec_backend, sizeof(exec_backend), EXEC_ENV_BACKEND "%s", name);
+}
+
+void exec_set_nm_active(int active)
+{
+	exec_nm_active = active ? EXEC_ENV_NM_ACTIVE "yes" : EXEC_ENV_NM_ACTIVE "no";
+	exec_env()[5] = exec_nm_active;
+}
+
+struct exec_out
+{
+	const char *name;	/* out or err */
+	char buf[1024];
+	size_t len;
+};
+
+/* write complete lines of output to debug log */
+static void log_output(const char *cmd, struct exec_out *out, int flush)
+{
+	size_t start = 0, i;
+
+	for (i = 0; i < out->len; i++) {
+		if (out->buf[i] != '\n')
+			continue;
+		debug("%s %s: %.*s", cmd, out->name, (int)(i - start), out->buf + start);
+		start = i + 1;
+	}
+
+	//end of output or too long line
+	if (start < out->len && (flush || (start == 0 && out->len == sizeof(out->buf)))) {
+		debug("%s %s: %.*s", cmd, out->name, (int)(out->len - start), out->buf + start);
+		start = out->len;
+	}
+
+	out->len -= start;
+	memmove(out->buf, out->buf + start, out->len);
+}
+
+/* append output to buffer of size, the rest is dropped */
+static void add_output(char *dst, size_t size, size_t *dst_len, const char *buf, size_t len)
+{
+	if (len > size - 1 - *dst_len)
+		len = size - 1 - *dst_len;
+	memcpy(dst + *dst_len, buf, len);
+	*dst_len += len;
+	dst[*dst_len] = '\0';
+}
+
+static long long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void exec_set_limits(unsigned int timeout, unsigned int budget)
+{
+	exec_timeout = timeout;
+	exec_budget_end = budget ? now_ms() + (long long)budget * 1000 : 0;
+	exec_timeouts = 0;
+	//commands may be run from several threads later
+	exec_env();
+}
+
+int exec_timed_out(void)
+{
+	return exec_timeouts;
+}
+
+/* nearest of command deadline and end of budget, 0 - none */
+static long long get_deadline(void)
+{
+	long long deadline = 0;
+
+	if (exec_timeout)
+		deadline = now_ms() + (long long)exec_timeout * 1000;
+	if (exec_budget_end && (deadline == 0 || exec_budget_end < deadline))
+		deadline = exec_budget_end;
+
+	return deadline;
+}
+
+/* ms to wait in poll(), limited by step if step > 0 */
+static int wait_time(long long deadline, int step)
 {
-	int ret, status;
+	long long left;
 
-	/* for debug
+	if (deadline == 0)
+		return step > 0 ? step : -1;
+
+	left = deadline - now_ms();
+	if (left < 0)
+		left = 0;
+	if (step > 0 && left > step)
+		left = step;
+
+	return (int)left;
+}
+
+static void log_timeout(const char *cmd, const char *reason)
+{
+	__sync_fetch_and_add(&exec_timeouts, 1);
+
+	werror("%s: %s", cmd, reason);
 	openlog("prl_nettool", LOG_PID | LOG_CONS, LOG_USER);
-	syslog(LOG_ERR | LOG_USER, "run: %s", cmd);
+	syslog(LOG_ERR | LOG_USER, "timeout: %s: %s", cmd, reason);
 	closelog();
-	werror("run: %s", cmd);
-	*/
-
-	status = system(cmd);
-
-	if (status == -1){
-		error(0, "Failed to execute: %s", cmd);
-		ret = -1;
-	} else if (WIFEXITED(status)) {
-		ret = WEXITSTATUS(status);
-		//werror("execCmd: %s [%d]\n", cmd, ret);
-	} else if (WIFSIGNALED(status)) {
-		werror("command %s got signal %d\n", cmd, WTERMSIG(status));
-		ret = -1;
-	} else {
-		werror("run cmd: %s\n", cmd);
+}
+
+/* terminate command with all its children */
+static void kill_child(pid_t pid, const char *cmd)
+{
+	long long end;
+	int status;
+	pid_t ret;
+
+	log_timeout(cmd, exec_budget_end && now_ms() >= exec_budget_end ?
+			"time budget of request is exhausted, killed" :
+			"deadline expired, killed");
+
+	kill(-pid, SIGTERM);
+	end = now_ms() + EXEC_KILL_GRACE;
+	while ((ret = waitpid(pid, &status, WNOHANG)) == 0 && now_ms() < end)
+		poll(NULL, 0, 50);
+
+	//SIGTERM is ignored or children are left in group
+	kill(-pid, SIGKILL);
+	if (ret == 0)
+		while (waitpid(pid, &status, 0) == -1 && errno == EINTR);
+}
+
+/* wait for exit of command until deadline
+return 1 if command is still running */
+static int wait_child(pid_t pid, const char *cmd, long long deadline, int *rc)
+{
+	int status;
+	pid_t ret;
+
+	while ((ret = waitpid(pid, &status, deadline ? WNOHANG : 0)) != pid) {
+		if (ret == -1 && errno != EINTR) {
+			error(errno, "waitpid() failed for %s", cmd);
+			*rc = -1;
+			return 0;
+		}
+		if (ret == 0) {
+			if (wait_time(deadline, 0) == 0)
+				return 1;
+			poll(NULL, 0, wait_time(deadline, 50));
+		}
+	}
+
+	*rc = -1;
+	if (WIFEXITED(status))
+		*rc = WEXITSTATUS(status);
+	else if (WIFSIGNALED(status))
+		werror("command %s got signal %d", cmd, WTERMSIG(status));
+	else
+		werror("run cmd: %s", cmd);
+
+	return 0;
+}
+
+/* write next part of input to stdin of command, close it at the end */
+static void write_input(struct pollfd *fd, const char *input, size_t *pos)
+{
+	size_t len = strlen(input);
+	ssize_t n;
+
+	if (*pos < len) {
+		//command may exit without reading, no SIGPIPE for socket
+		n = send(fd->fd, input + *pos, len - *pos, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (n < 0 && (errno == EAGAIN || errno == EINTR))
+			return;
+		if (n > 0)
+			*pos += n;
+		if (n > 0 && *pos < len)
+			return;
+	}
+
+	close(fd->fd);
+	fd->fd = -1;
+}
+
+//search cmd in directories of EXEC_PATH only, not in PATH of caller
+static int find_cmd(const char *cmd, char *path, size_t size)
+{
+	const char *dir = EXEC_PATH + sizeof("PATH=") - 1;
+	const char *end;
+
+	if (strchr(cmd, '/') != NULL) {
+		if ((size_t)snprintf(path, size, "%s", cmd) >= size)
+			return ENAMETOOLONG;
+		return 0;
+	}
+
+	for (; *dir; dir = (*end) ? end + 1 : end) {
+		end = strchr(dir, ':');
+		if (end == NULL)
+			end = dir + strlen(dir);
+		if ((size_t)snprintf(path, size, "%.*s/%s",
+				(int)(end - dir), dir, cmd) >= size)
+			continue;
+		if (access(path, X_OK) == 0)
+			return 0;
+	}
+	return ENOENT;
+}
+
+static int spawn_cmd(const char *const argv[], char *const envp[], const char *input,
+		char *output, size_t output_size)
+{
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t attr;
+	int out_pipe[2] = {-1, -1}, err_pipe[2] = {-1, -1};
+	int in_sock[2] = {-1, -1};
+	size_t in_pos = 0;
+	struct exec_out out[2] = {{"out", "", 0}, {"err", "", 0}};
+	struct pollfd fds[3];
+	char err[EXEC_ERR_SIZE] = "";
+	size_t err_len = 0, output_len = 0;
+	const char *cmd = argv[0];
+	char path[PATH_MAX];
+	long long deadline;
+	pid_t pid;
+	int rc, i;
+
+	debug("run: %s", cmd);
+	if (output != NULL)
+		output[0] = '\0';
+
+	if (exec_budget_end && now_ms() >= exec_budget_end) {
+		log_timeout(cmd, "time budget of request is exhausted, not started");
 		return -1;
 	}
-	return ret;
+
+	rc = find_cmd(cmd, path, sizeof(path));
+	if (rc) {
+		error(rc, "Failed to execute: %s", cmd);
+		return -1;
+	}
+
+	if (pipe2(out_pipe, O_CLOEXEC) || pipe2(err_pipe, O_CLOEXEC)) {
+		error(errno, "Failed to create pipe for %s", cmd);
+		rc = -1;
+		goto close;
+	}
+
+	//long values are passed on stdin instead of command line
+	if (input != NULL &&
+			socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, in_sock)) {
+		error(errno, "Failed to create socket for input of %s", cmd);
+		rc = -1;
+		goto close;
+	}
+
+	posix_spawn_file_actions_init(&actions);
+	if (input != NULL)
+		posix_spawn_file_actions_adddup2(&actions, in_sock[1], 0);
+	else
+		posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+	posix_spawn_file_actions_adddup2(&actions, out_pipe[1], 1);
+	posix_spawn_file_actions_adddup2(&actions, err_pipe[1], 2);
+
+	//own process group to kill command with its children on timeout
+	posix_spawnattr_init(&attr);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+	posix_spawnattr_setpgroup(&attr, 0);
+
+	rc = posix_spawn(&pid, path, &actions, &attr, (char *const *)argv, envp);
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&actions);
+
+	close(out_pipe[1]);
+	close(err_pipe[1]);
+	out_pipe[1] = err_pipe[1] = -1;
+	if (in_sock[1] != -1) {
+		close(in_sock[1]);
+		in_sock[1] = -1;
+	}
+
+	if (rc) {
+		error(rc, "Failed to execute: %s", cmd);
+		rc = -1;
+		goto close;
+	}
+
+	deadline = get_deadline();
+	fds[0].fd = out_pipe[0];
+	fds[1].fd = err_pipe[0];
+	fds[0].events = fds[1].events = POLLIN;
+	fds[2].fd = in_sock[0];
+	fds[2].events = POLLOUT;
+	fds[2].revents = 0;
+	in_sock[0] = -1;
+
+	while (fds[0].fd != -1 || fds[1].fd != -1) {
+		siginfo_t info;
+		int n = poll(fds, 3, wait_time(deadline, EXEC_POLL_MS));
+
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (n == 0) {
+			if (wait_time(deadline, 0) == 0)
+				break;
+			//command exited, but its output is kept open by children
+			info.si_pid = 0;
+			if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 &&
+					info.si_pid == pid)
+				break;
+			continue;
+		}
+
+		if (fds[2].fd != -1 && fds[2].revents != 0)
+			write_input(&fds[2], input, &in_pos);
+
+		for (i = 0; i < 2; i++) {
+			ssize_t len;
+
+			if (fds[i].fd == -1 || fds[i].revents == 0)
+				continue;
+
+			len = read(fds[i].fd, out[i].buf + out[i].len, sizeof(out[i].buf) - out[i].len);
+			if (len <= 0) {
+				if (len < 0 && errno == EINTR)
+					continue;
+				fds[i].fd = -1;
+				log_output(cmd, &out[i], 1);
+				continue;
+			}
+
+			if (i == 1)
+				add_output(err, sizeof(err), &err_len, out[i].buf + out[i].len, len);
+			else if (output != NULL)
+				add_output(output, output_size, &output_len,
+						out[i].buf + out[i].len, len);
+			out[i].len += len;
+			log_output(cmd, &out[i], 0);
+		}
+	}
+
+	for (i = 0; i < 2; i++)
+		if (fds[i].fd != -1)
+			log_output(cmd, &out[i], 1);
+	if (fds[2].fd != -1)
+		close(fds[2].fd);
+
+	if (wait_child(pid, cmd, deadline, &rc)) {
+		kill_child(pid, cmd);
+		rc = -1;
+	}
+
+	if (rc != 0 && err_len != 0) {
+		//keep errors of failed command visible to user
+		fprintf(stderr, "%s", err);
+		if (err[err_len - 1] != '\n')
+			fprintf(stderr, "\n");
+	}
+
+	debug("%s return %d", cmd, rc);
+close:
+	for (i = 0; i < 2; i++) {
+		if (out_pipe[i] != -1)
+			close(out_pipe[i]);
+		if (err_pipe[i] != -1)
+			close(err_pipe[i]);
+		if (in_sock[i] != -1)
+			close(in_sock[i]);
+	}
+
+	return rc;
+}
+
+int run_cmdv(const char *const argv[])
+{
+	return spawn_cmd(argv, exec_env(), NULL, NULL, 0);
+}
+
+int run_cmdv_input(const char *const argv[], const char *input)
+{
+	return spawn_cmd(argv, exec_env(), input, NULL, 0);
+}
+
+int run_cmdv_live(const char *const argv[], const char *input)
+{
+	char *envp[EXEC_ENV_MAX + 1];
+
+	//own copy, commands of other devices may run at the same time
+	memcpy(envp, exec_env(), sizeof(envp));
+	envp[3] = EXEC_ENV_DEFER "live";
+
+	return spawn_cmd(argv, envp, input, NULL, 0);
 }
 
+int run_cmdv_output(const char *const argv[], char *output, size_t size)
+{
+	return spawn_cmd(argv, exec_env(), NULL, output, size);
+}
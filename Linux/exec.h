@@ -27,6 +27,48 @@
 #ifndef __EXEC_H__
 #define __EXEC_H__
 
-int run_cmd(const char *cmd);
+#include <stddef.h>
+
+/* set deadline of each command and time budget of whole request
+   starting from now, in seconds, 0 - unlimited
+   commands are killed with their process group when time is over */
+void exec_set_limits(unsigned int timeout, unsigned int budget);
+
+/* return number of commands killed or not started because of timeout
+   since last exec_set_limits() */
+int exec_timed_out(void);
+
+/* PRL_NETTOOL_DEFER=yes asks scripts to write configuration
+   without restart of devices, they are brought up by activate script */
+void exec_set_defer(int defer);
+
+/* check if PRL_NETTOOL_DEFER is set, native writers of configuration
+   then leave devices to activate script as scripts do */
+int exec_is_deferred(void);
+
+/* PRL_NETTOOL_BACKEND=name tells scripts controller of network,
+   so they do not query systemd for it again */
+void exec_set_backend(const char *name);
+
+/* PRL_NETTOOL_NM_ACTIVE=yes|no tells scripts if NetworkManager runs,
+   it may run while devices are configured by other controller */
+void exec_set_nm_active(int active);
+
+/* run command without shell, argv[0] is searched in fixed PATH of commands
+   output of command is written to debug log, stderr is shown if it fails
+return exit code of command or -1 */
+int run_cmdv(const char *const argv[]);
+
+/* run_cmdv() with input written to stdin of command,
+   so that long lists of values are not limited by size of argument */
+int run_cmdv_input(const char *const argv[], const char *input);
+
+/* run_cmdv_input() with PRL_NETTOOL_DEFER=live for this command only:
+   device is already configured, script only writes its configuration */
+int run_cmdv_live(const char *const argv[], const char *input);
+
+/* run_cmdv() with stdout of command copied to output,
+   up to size - 1 bytes of it are kept */
+int run_cmdv_output(const char *const argv[], char *output, size_t size);
 
 #endif
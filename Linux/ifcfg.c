@@ -0,0 +1,382 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2019 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * editor of shell variable files: file is loaded once, all changes are
+ * made in memory and it is written back with one write and rename
+ */
+
+#include "../common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <limits.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "ifcfg.h"
+
+#define FNV_OFFSET	0xcbf29ce484222325ULL
+#define FNV_PRIME	0x100000001b3ULL
+
+struct ifcfg_line
+{
+	char *name;	/* NULL if line is not variable */
+	char *value;	/* unquoted value or text of other line */
+	char *raw;	/* loaded text of variable, NULL if it is changed */
+	int deleted;
+};
+
+struct ifcfg
+{
+	char *path;
+	char quote;
+	struct ifcfg_line *lines;
+	int count, size;
+	/* open addressing index of names: number of line + 1, 0 - free */
+	int *index;
+	int index_size;
+};
+
+static unsigned int hash_name(const char *name)
+{
+	unsigned long long hash = FNV_OFFSET;
+
+	for ( ; *name; name++) {
+		hash ^= (unsigned char)*name;
+		hash *= FNV_PRIME;
+	}
+	return (unsigned int)hash;
+}
+
+/* slot of name in index, it is free if name is absent */
+static int find_slot(struct ifcfg *cfg, const char *name)
+{
+	int mask = cfg->index_size - 1;
+	int slot = hash_name(name) & mask;
+
+	while (cfg->index[slot] != 0 &&
+			strcmp(cfg->lines[cfg->index[slot] - 1].name, name))
+		slot = (slot + 1) & mask;
+
+	return slot;
+}
+
+static int grow_index(struct ifcfg *cfg)
+{
+	int i, *old = cfg->index, old_size = cfg->index_size;
+	int size = old_size ? old_size * 2 : 64;
+
+	cfg->index = (int *)calloc(size, sizeof(int));
+	if (cfg->index == NULL) {
+		cfg->index = old;
+		error(errno, "Can't allocate memory");
+		return -1;
+	}
+	cfg->index_size = size;
+
+	for (i = 0; i < old_size; i++)
+		if (old[i] != 0)
+			cfg->index[find_slot(cfg, cfg->lines[old[i] - 1].name)] = old[i];
+	free(old);
+
+	return 0;
+}
+
+/* append line, name is NULL for line which is not variable */
+static int add_line(struct ifcfg *cfg, const char *name, const char *value, size_t len)
+{
+	struct ifcfg_line *line;
+
+	if (cfg->count == cfg->size) {
+		int size = cfg->size ? cfg->size * 2 : 32;
+		line = (struct ifcfg_line *)realloc(cfg->lines, size * sizeof(*line));
+		if (line == NULL) {
+			error(errno, "Can't allocate memory");
+			return -1;
+		}
+		cfg->lines = line;
+		cfg->size = size;
+	}
+
+	line = &cfg->lines[cfg->count];
+	line->deleted = 0;
+	line->name = NULL;
+	line->raw = NULL;
+	line->value = strndup(value, len);
+	if (line->value == NULL)
+		goto nomem;
+	if (name != NULL && (line->name = strdup(name)) == NULL) {
+		free(line->value);
+		goto nomem;
+	}
+	cfg->count++;
+
+	if (name != NULL) {
+		if (cfg->count * 2 > cfg->index_size && grow_index(cfg))
+			return -1;
+		cfg->index[find_slot(cfg, name)] = cfg->count;
+	}
+
+	return 0;
+nomem:
+	error(errno, "Can't allocate memory");
+	return -1;
+}
+
+/* NAME=value, NAME="value" or NAME='value' */
+static int parse_line(struct ifcfg *cfg, char *str)
+{
+	char *name, *eq, *value, *end, *raw;
+	char *p;
+	int rc;
+
+	str[strcspn(str, "\n")] = '\0';
+
+	name = str + strspn(str, " \t");
+	eq = strchr(name, '=');
+	if (eq == NULL || eq == name || (!isalpha(*name) && *name != '_'))
+		return add_line(cfg, NULL, str, strlen(str));
+	for (p = name; p < eq; p++)
+		if (!isalnum(*p) && *p != '_')
+			return add_line(cfg, NULL, str, strlen(str));
+
+	//variable is written back as it was unless it is changed
+	raw = strdup(str);
+	if (raw == NULL) {
+		error(errno, "Can't allocate memory");
+		return -1;
+	}
+
+	*eq = '\0';
+	value = eq + 1;
+	if (*value == '"' || *value == '\'') {
+		char q = *value++;
+		char *out = value;
+
+		for (p = value; *p && *p != q; p++) {
+			if (q == '"' && *p == '\\' && p[1] != '\0')
+				p++;
+			*out++ = *p;
+		}
+		end = out;
+	} else {
+		end = value + strcspn(value, " \t#");
+	}
+
+	rc = add_line(cfg, name, value, end - value);
+	if (rc == 0)
+		cfg->lines[cfg->count - 1].raw = raw;
+	else
+		free(raw);
+
+	return rc;
+}
+
+struct ifcfg *ifcfg_open(const char *path, int load, char quote)
+{
+	struct ifcfg *cfg;
+	FILE *fp;
+	char *buf = NULL;
+	size_t size = 0;
+	int rc = 0;
+
+	cfg = (struct ifcfg *)calloc(1, sizeof(struct ifcfg));
+	if (cfg == NULL || (cfg->path = strdup(path)) == NULL) {
+		error(errno, "Can't allocate memory");
+		free(cfg);
+		return NULL;
+	}
+	cfg->quote = quote;
+
+	if (grow_index(cfg)) {
+		ifcfg_free(cfg);
+		return NULL;
+	}
+
+	if (!load)
+		return cfg;
+
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		if (errno == ENOENT)
+			return cfg;
+		error(errno, "Can't open %s", path);
+		ifcfg_free(cfg);
+		return NULL;
+	}
+
+	//IPV6ADDR_SECONDARIES of thousands of addresses is one line
+	while (rc == 0 && getline(&buf, &size, fp) != -1)
+		rc = parse_line(cfg, buf);
+	free(buf);
+	fclose(fp);
+
+	if (rc) {
+		ifcfg_free(cfg);
+		return NULL;
+	}
+
+	return cfg;
+}
+
+const char *ifcfg_get(struct ifcfg *cfg, const char *name)
+{
+	int i = cfg->index[find_slot(cfg, name)];
+
+	if (i == 0 || cfg->lines[i - 1].deleted)
+		return NULL;
+
+	return cfg->lines[i - 1].value;
+}
+
+int ifcfg_set(struct ifcfg *cfg, const char *name, const char *value)
+{
+	struct ifcfg_line *line;
+	char *copy;
+	int i = cfg->index[find_slot(cfg, name)];
+
+	//deleted variable is added again at the end
+	if (i == 0 || cfg->lines[i - 1].deleted)
+		return add_line(cfg, name, value, strlen(value));
+
+	line = &cfg->lines[i - 1];
+	if (!strcmp(line->value, value))
+		return 0;
+
+	copy = strdup(value);
+	if (copy == NULL) {
+		error(errno, "Can't allocate memory");
+		return -1;
+	}
+	free(line->value);
+	line->value = copy;
+	free(line->raw);
+	line->raw = NULL;
+
+	return 0;
+}
+
+void ifcfg_del(struct ifcfg *cfg, const char *name, int numbered)
+{
+	size_t len = strlen(name);
+	const char *p;
+	int i;
+
+	//all lines of variable are deleted as sed in del_param does
+	for (i = 0; i < cfg->count; i++) {
+		if (cfg->lines[i].name == NULL ||
+				strncmp(cfg->lines[i].name, name, len))
+			continue;
+		for (p = cfg->lines[i].name + len; numbered && isdigit(*p); p++)
+			;
+		if (*p == '\0')
+			cfg->lines[i].deleted = 1;
+	}
+}
+
+static void write_value(FILE *fp, const char *value, char quote)
+{
+	const char *p;
+
+	fputc(quote, fp);
+	for (p = value; *p; p++) {
+		if (quote == '\'' && *p == '\'')
+			fputs("'\\''", fp);
+		else if (quote == '"' && strchr("\"\\$`", *p))
+			fprintf(fp, "\\%c", *p);
+		else
+			fputc(*p, fp);
+	}
+	fputc(quote, fp);
+}
+
+int ifcfg_save(struct ifcfg *cfg)
+{
+	char tmp[PATH_MAX];
+	const char *base;
+	struct stat st;
+	FILE *fp;
+	int i, fd, rc = 0;
+
+	//hidden name is not taken for config by scripts reading ifcfg-*
+	base = strrchr(cfg->path, '/');
+	base = base ? base + 1 : cfg->path;
+	snprintf(tmp, sizeof(tmp), "%.*s.%s.tmp", (int)(base - cfg->path),
+			cfg->path, base);
+
+	fd = open(tmp, O_WRONLY|O_CREAT|O_TRUNC,
+			stat(cfg->path, &st) ? 0644 : (st.st_mode & 07777));
+	if (fd == -1 || (fp = fdopen(fd, "w")) == NULL) {
+		error(errno, "Can't create %s", tmp);
+		if (fd != -1)
+			close(fd);
+		return -1;
+	}
+
+	for (i = 0; i < cfg->count; i++) {
+		struct ifcfg_line *line = &cfg->lines[i];
+
+		if (line->deleted)
+			continue;
+		if (line->name == NULL || line->raw != NULL) {
+			fprintf(fp, "%s\n", line->name ? line->raw : line->value);
+			continue;
+		}
+		fprintf(fp, "%s=", line->name);
+		write_value(fp, line->value, cfg->quote);
+		fputc('\n', fp);
+	}
+
+	if (fclose(fp))
+		rc = -1;
+	if (rc == 0 && rename(tmp, cfg->path))
+		rc = -1;
+	if (rc) {
+		error(errno, "Can't write %s", cfg->path);
+		unlink(tmp);
+	}
+
+	return rc;
+}
+
+void ifcfg_free(struct ifcfg *cfg)
+{
+	int i;
+
+	if (cfg == NULL)
+		return;
+
+	for (i = 0; i < cfg->count; i++) {
+		free(cfg->lines[i].name);
+		free(cfg->lines[i].value);
+		free(cfg->lines[i].raw);
+	}
+	free(cfg->lines);
+	free(cfg->index);
+	free(cfg->path);
+	free(cfg);
+}
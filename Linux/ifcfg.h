@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2019 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * editor of shell variable files: ifcfg-*, /etc/sysconfig/network
+ */
+
+#ifndef __IFCFG_H__
+#define __IFCFG_H__
+
+/* variables of one file in order they are written,
+   lines which are not variables are kept as they are */
+struct ifcfg;
+
+/* open file at path, load its variables if load is set,
+   missing file is empty, values are written with quote character
+return NULL on error */
+struct ifcfg *ifcfg_open(const char *path, int load, char quote);
+
+/* return unquoted value of variable or NULL if it is not set */
+const char *ifcfg_get(struct ifcfg *cfg, const char *name);
+
+/* set variable, new variable is added at the end of file
+return 0 on success */
+int ifcfg_set(struct ifcfg *cfg, const char *name, const char *value);
+
+/* delete variable name and if numbered is set also name<N> */
+void ifcfg_del(struct ifcfg *cfg, const char *name, int numbered);
+
+/* write file at once: temporary file in the same directory
+   is renamed over it, return 0 on success */
+int ifcfg_save(struct ifcfg *cfg);
+
+void ifcfg_free(struct ifcfg *cfg);
+
+#endif
@@ -0,0 +1,597 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2019 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * stanza level model of ifupdown configuration: interfaces file and files
+ * it sources are parsed once, edited in memory and written atomically
+ */
+
+#include "../common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <limits.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../netinfo.h"
+#include "ifupdown.h"
+
+/* nesting of source directives */
+#define MAX_SOURCE_DEPTH	8
+
+enum BLOCK_KIND {
+	BLOCK_NONE = 0,	/* lines before first stanza or after removed one */
+	BLOCK_IFACE,
+	BLOCK_MAPPING,
+	BLOCK_AUTO,	/* auto and allow-* lists of devices */
+	BLOCK_SOURCE,
+	BLOCK_SOURCE_DIR,
+};
+
+/* stanza: top level line and lines which follow it up to the next one */
+struct block
+{
+	int kind;
+	char *head;	/* top level line without newline, NULL for BLOCK_NONE */
+	char *body;	/* following lines with newlines */
+	size_t body_len, body_size;
+	int deleted;
+};
+
+struct config_file
+{
+	char *path;
+	struct stat st;		/* zero if file is missing */
+	struct block *blocks;
+	int count, size;
+	int changed;
+};
+
+struct ifupdown
+{
+	struct config_file *files;	/* interfaces file is the first */
+	int count, size;
+	struct stat dir_st;	/* IFUPDOWN_CONFIG_DIR, new files in it */
+};
+
+static struct ifupdown *ifupdown_model;
+
+/* copy n-th word of line to buf, return 0 if there is no such word */
+static int get_word(const char *line, int n, char *buf, size_t len)
+{
+	size_t wlen;
+
+	for (;;) {
+		line += strspn(line, " \t");
+		if (*line == '\0')
+			return 0;
+		wlen = strcspn(line, " \t");
+		if (n-- == 0)
+			break;
+		line += wlen;
+	}
+
+	if (wlen >= len)
+		wlen = len - 1;
+	memcpy(buf, line, wlen);
+	buf[wlen] = '\0';
+
+	return 1;
+}
+
+/* kind of stanza which starts with line, -1 if line continues stanza */
+static int block_kind(const char *line)
+{
+	char word[32];
+
+	if (!get_word(line, 0, word, sizeof(word)))
+		return -1;
+
+	if (!strcmp(word, "iface"))
+		return BLOCK_IFACE;
+	if (!strcmp(word, "mapping"))
+		return BLOCK_MAPPING;
+	if (!strcmp(word, "auto") || !strncmp(word, "allow-", 6))
+		return BLOCK_AUTO;
+	if (!strcmp(word, "source"))
+		return BLOCK_SOURCE;
+	if (!strcmp(word, "source-directory"))
+		return BLOCK_SOURCE_DIR;
+
+	return -1;
+}
+
+static struct block *add_block(struct config_file *f, int kind, const char *head)
+{
+	struct block *b;
+
+	if (f->count == f->size) {
+		int size = f->size ? f->size * 2 : 16;
+		b = (struct block *)realloc(f->blocks, size * sizeof(*b));
+		if (b == NULL)
+			goto nomem;
+		f->blocks = b;
+		f->size = size;
+	}
+
+	b = &f->blocks[f->count];
+	memset(b, 0, sizeof(*b));
+	b->kind = kind;
+	if (head != NULL && (b->head = strdup(head)) == NULL)
+		goto nomem;
+	f->count++;
+
+	return b;
+nomem:
+	error(errno, "Can't allocate memory");
+	return NULL;
+}
+
+static int append_body(struct block *b, const char *line)
+{
+	size_t len = strlen(line);
+
+	if (b->body_len + len + 2 > b->body_size) {
+		size_t size = (b->body_len + len + 2) * 2;
+		char *body = (char *)realloc(b->body, size);
+		if (body == NULL) {
+			error(errno, "Can't allocate memory");
+			return -1;
+		}
+		b->body = body;
+		b->body_size = size;
+	}
+
+	memcpy(b->body + b->body_len, line, len);
+	b->body_len += len;
+	b->body[b->body_len++] = '\n';
+	b->body[b->body_len] = '\0';
+
+	return 0;
+}
+
+/* add line without newline to the last stanza of file or start new one */
+static int parse_line(struct config_file *f, const char *line)
+{
+	int kind = block_kind(line);
+	struct block *b;
+
+	if (kind >= 0)
+		return add_block(f, kind, line) ? 0 : -1;
+
+	//lines after removed stanza are not removed with it
+	if ((f->count == 0 || f->blocks[f->count - 1].deleted) &&
+			add_block(f, BLOCK_NONE, NULL) == NULL)
+		return -1;
+	b = &f->blocks[f->count - 1];
+
+	return append_body(b, line);
+}
+
+static void free_file(struct config_file *f)
+{
+	int i;
+
+	for (i = 0; i < f->count; i++) {
+		free(f->blocks[i].head);
+		free(f->blocks[i].body);
+	}
+	free(f->blocks);
+	free(f->path);
+}
+
+static void free_model(struct ifupdown *m)
+{
+	int i;
+
+	if (m == NULL)
+		return;
+
+	for (i = 0; i < m->count; i++)
+		free_file(&m->files[i]);
+	free(m->files);
+	free(m);
+}
+
+static int load_file(struct ifupdown *m, const char *path, int depth);
+
+/* source directive: glob relative to directory of file with it */
+static int load_source(struct ifupdown *m, struct config_file *f,
+		struct block *b, int depth)
+{
+	char arg[PATH_MAX], pattern[PATH_MAX];
+	const char *slash;
+	glob_t g;
+	size_t i;
+	int len, rc = 0;
+
+	if (!get_word(b->head, 1, arg, sizeof(arg)))
+		return 0;
+
+	slash = strrchr(f->path, '/');
+	if (arg[0] == '/' || slash == NULL)
+		len = snprintf(pattern, sizeof(pattern), "%s", arg);
+	else
+		len = snprintf(pattern, sizeof(pattern), "%.*s/%s",
+				(int)(slash - f->path), f->path, arg);
+	if (len >= (int)sizeof(pattern)) {
+		error(0, "Path of %s is too long", arg);
+		return -1;
+	}
+
+	if (b->kind == BLOCK_SOURCE_DIR) {
+		struct dirent **list;
+		int n, j;
+
+		//files are taken as run-parts does
+		n = scandir(pattern, &list, NULL, alphasort);
+		for (j = 0; j < n; j++) {
+			char path[PATH_MAX];
+			const char *p = list[j]->d_name;
+
+			if (rc == 0 && p[strspn(p, "abcdefghijklmnopqrstuvwxyz"
+						"ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-")] == '\0') {
+				if (snprintf(path, sizeof(path), "%s/%s", pattern, p) <
+						(int)sizeof(path))
+					rc = load_file(m, path, depth + 1);
+			}
+			free(list[j]);
+		}
+		if (n >= 0)
+			free(list);
+		return rc;
+	}
+
+	if (glob(pattern, 0, NULL, &g) != 0)
+		return 0;
+	for (i = 0; i < g.gl_pathc && rc == 0; i++)
+		rc = load_file(m, g.gl_pathv[i], depth + 1);
+	globfree(&g);
+
+	return rc;
+}
+
+static int load_file(struct ifupdown *m, const char *path, int depth)
+{
+	struct config_file *f;
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	FILE *fp;
+	int i, n, rc = 0;
+
+	if (depth > MAX_SOURCE_DEPTH)
+		return 0;
+	for (i = 0; i < m->count; i++)
+		if (!strcmp(m->files[i].path, path))
+			return 0;
+
+	if (m->count == m->size) {
+		int new_size = m->size ? m->size * 2 : 8;
+		f = (struct config_file *)realloc(m->files, new_size * sizeof(*f));
+		if (f == NULL) {
+			error(errno, "Can't allocate memory");
+			return -1;
+		}
+		m->files = f;
+		m->size = new_size;
+	}
+	f = &m->files[m->count];
+	memset(f, 0, sizeof(*f));
+	if ((f->path = strdup(path)) == NULL) {
+		error(errno, "Can't allocate memory");
+		return -1;
+	}
+	n = m->count++;
+
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		if (errno == ENOENT)
+			return 0;
+		error(errno, "Can't open %s", path);
+		return -1;
+	}
+	fstat(fileno(fp), &f->st);
+
+	while (rc == 0 && (len = getline(&line, &size, fp)) != -1) {
+		if (len > 0 && line[len - 1] == '\n')
+			line[len - 1] = '\0';
+		rc = parse_line(f, line);
+	}
+	free(line);
+	fclose(fp);
+
+	//files array may be moved by sourced files
+	for (i = 0; i < m->files[n].count && rc == 0; i++) {
+		struct block *b = &m->files[n].blocks[i];
+
+		if (b->kind == BLOCK_SOURCE || b->kind == BLOCK_SOURCE_DIR)
+			rc = load_source(m, &m->files[n], b, depth);
+	}
+
+	return rc;
+}
+
+static int same_stat(const struct stat *a, const struct stat *b)
+{
+	return a->st_ino == b->st_ino && a->st_size == b->st_size &&
+		a->st_mtim.tv_sec == b->st_mtim.tv_sec &&
+		a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+/* model is valid while none of its files is changed */
+static int is_fresh(struct ifupdown *m)
+{
+	struct stat st;
+	int i;
+
+	for (i = 0; i < m->count; i++) {
+		if (stat(m->files[i].path, &st))
+			memset(&st, 0, sizeof(st));
+		if (!same_stat(&st, &m->files[i].st))
+			return 0;
+	}
+
+	if (stat(IFUPDOWN_CONFIG_DIR, &st))
+		memset(&st, 0, sizeof(st));
+
+	return same_stat(&st, &m->dir_st);
+}
+
+struct ifupdown *ifupdown_get(void)
+{
+	struct ifupdown *m;
+	glob_t g;
+	size_t i;
+	int rc;
+
+	if (ifupdown_model != NULL && is_fresh(ifupdown_model))
+		return ifupdown_model;
+	free_model(ifupdown_model);
+	ifupdown_model = NULL;
+
+	m = (struct ifupdown *)calloc(1, sizeof(struct ifupdown));
+	if (m == NULL) {
+		error(errno, "Can't allocate memory");
+		return NULL;
+	}
+	if (stat(IFUPDOWN_CONFIG_DIR, &m->dir_st))
+		memset(&m->dir_st, 0, sizeof(m->dir_st));
+
+	rc = load_file(m, IFUPDOWN_CONFIG, 0);
+
+	//scripts edit all files of interfaces.d even if they are not sourced
+	if (rc == 0 && glob(IFUPDOWN_CONFIG_DIR "/*", 0, NULL, &g) == 0) {
+		for (i = 0; i < g.gl_pathc && rc == 0; i++)
+			rc = load_file(m, g.gl_pathv[i], 0);
+		globfree(&g);
+	}
+
+	if (rc) {
+		free_model(m);
+		return NULL;
+	}
+
+	ifupdown_model = m;
+	return m;
+}
+
+int ifupdown_exists(struct ifupdown *m)
+{
+	return m->files[0].st.st_ino != 0 || m->files[0].changed;
+}
+
+int ifupdown_method(struct ifupdown *m, const char *dev, const char *family,
+		char *method, size_t len)
+{
+	char word[NAME_LENGTH];
+	int i, j;
+
+	for (i = 0; i < m->count; i++) {
+		for (j = 0; j < m->files[i].count; j++) {
+			struct block *b = &m->files[i].blocks[j];
+
+			if (b->kind != BLOCK_IFACE || b->deleted ||
+					!get_word(b->head, 1, word, sizeof(word)) ||
+					strcmp(word, dev) ||
+					!get_word(b->head, 2, word, sizeof(word)) ||
+					strcmp(word, family))
+				continue;
+			if (get_word(b->head, 3, method, len))
+				return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* name is device or its alias dev:N */
+static int is_dev_name(const char *name, const char *dev)
+{
+	size_t len = strlen(dev);
+
+	if (strncmp(name, dev, len))
+		return 0;
+	if (name[len] == '\0')
+		return 1;
+	if (name[len] != ':' || !isdigit(name[len + 1]))
+		return 0;
+	for (name += len + 1; isdigit(*name); name++)
+		;
+
+	return *name == '\0';
+}
+
+/* remove device from auto or allow-* list, return 1 if list is changed */
+static int remove_from_list(struct block *b, const char *dev)
+{
+	char word[PATH_MAX], *head;
+	size_t len = 0;
+	int i, removed = 0, left = 0;
+
+	head = (char *)malloc(strlen(b->head) + 1);
+	if (head == NULL) {
+		error(errno, "Can't allocate memory");
+		return 0;
+	}
+
+	get_word(b->head, 0, head, strlen(b->head) + 1);
+	len = strlen(head);
+	for (i = 1; get_word(b->head, i, word, sizeof(word)); i++) {
+		if (is_dev_name(word, dev)) {
+			removed = 1;
+			continue;
+		}
+		len += sprintf(head + len, " %s", word);
+		left++;
+	}
+
+	if (!removed) {
+		free(head);
+		return 0;
+	}
+
+	free(b->head);
+	b->head = head;
+	if (left == 0)
+		b->deleted = 1;
+
+	return 1;
+}
+
+void ifupdown_remove(struct ifupdown *m, const char *dev)
+{
+	char word[NAME_LENGTH];
+	int i, j;
+
+	for (i = 0; i < m->count; i++) {
+		struct config_file *f = &m->files[i];
+
+		for (j = 0; j < f->count; j++) {
+			struct block *b = &f->blocks[j];
+
+			if (b->deleted)
+				continue;
+			if (b->kind == BLOCK_AUTO) {
+				if (remove_from_list(b, dev))
+					f->changed = 1;
+			} else if (b->kind == BLOCK_IFACE &&
+					get_word(b->head, 1, word, sizeof(word)) &&
+					is_dev_name(word, dev)) {
+				b->deleted = 1;
+				f->changed = 1;
+			}
+		}
+	}
+}
+
+int ifupdown_append(struct ifupdown *m, const char *text)
+{
+	struct config_file *f = &m->files[0];
+	const char *line, *end;
+	char *copy;
+	int rc = 0;
+
+	for (line = text; *line != '\0' && rc == 0; line = end + (*end != '\0')) {
+		end = line + strcspn(line, "\n");
+		copy = strndup(line, end - line);
+		if (copy == NULL) {
+			error(errno, "Can't allocate memory");
+			return -1;
+		}
+		rc = parse_line(f, copy);
+		free(copy);
+	}
+	f->changed = 1;
+
+	return rc;
+}
+
+static int save_file(struct config_file *f)
+{
+	char tmp[PATH_MAX];
+	const char *base;
+	FILE *fp;
+	int i, fd, rc = 0;
+
+	base = strrchr(f->path, '/');
+	base = base ? base + 1 : f->path;
+	snprintf(tmp, sizeof(tmp), "%.*s.%s.tmp", (int)(base - f->path),
+			f->path, base);
+
+	fd = open(tmp, O_WRONLY|O_CREAT|O_TRUNC,
+			f->st.st_ino ? (f->st.st_mode & 07777) : 0644);
+	if (fd == -1 || (fp = fdopen(fd, "w")) == NULL) {
+		error(errno, "Can't create %s", tmp);
+		if (fd != -1)
+			close(fd);
+		return -1;
+	}
+
+	for (i = 0; i < f->count; i++) {
+		struct block *b = &f->blocks[i];
+
+		if (b->deleted)
+			continue;
+		if (b->head != NULL)
+			fprintf(fp, "%s\n", b->head);
+		if (b->body != NULL)
+			fwrite(b->body, 1, b->body_len, fp);
+	}
+
+	if (fclose(fp))
+		rc = -1;
+	if (rc == 0 && rename(tmp, f->path))
+		rc = -1;
+	if (rc) {
+		error(errno, "Can't write %s", f->path);
+		unlink(tmp);
+		return -1;
+	}
+
+	//own changes do not make model stale
+	stat(f->path, &f->st);
+	f->changed = 0;
+
+	return 0;
+}
+
+int ifupdown_save(struct ifupdown *m)
+{
+	int i, rc = 0;
+
+	for (i = 0; i < m->count; i++)
+		if (m->files[i].changed && save_file(&m->files[i]))
+			rc = -1;
+
+	if (stat(IFUPDOWN_CONFIG_DIR, &m->dir_st))
+		memset(&m->dir_st, 0, sizeof(m->dir_st));
+
+	return rc;
+}
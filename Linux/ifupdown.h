@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2019 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * stanza level model of ifupdown configuration /etc/network/interfaces
+ */
+
+#ifndef __IFUPDOWN_H__
+#define __IFUPDOWN_H__
+
+#include <stddef.h>
+
+#ifndef IFUPDOWN_CONFIG
+#define IFUPDOWN_CONFIG		"/etc/network/interfaces"
+#define IFUPDOWN_CONFIG_DIR	"/etc/network/interfaces.d"
+#endif
+
+/* interfaces file and files it sources, split into stanzas */
+struct ifupdown;
+
+/* return model which is parsed once per run and parsed again only if
+   some of its files is changed by others, missing interfaces is empty
+return NULL on error */
+struct ifupdown *ifupdown_get(void);
+
+/* check if interfaces file exists */
+int ifupdown_exists(struct ifupdown *m);
+
+/* copy method of iface stanza of device for family inet or inet6
+   into method, return 1 if it is found and 0 if there is none */
+int ifupdown_method(struct ifupdown *m, const char *dev, const char *family,
+		char *method, size_t len);
+
+/* remove iface stanzas of device and its aliases dev:N
+   and their names from auto and allow-* lines in all files */
+void ifupdown_remove(struct ifupdown *m, const char *dev);
+
+/* append stanzas of text to interfaces file, return 0 on success */
+int ifupdown_append(struct ifupdown *m, const char *text);
+
+/* write changed files at once: each is renamed from temporary file
+   in the same directory, return 0 on success */
+int ifupdown_save(struct ifupdown *m);
+
+#endif
@@ -0,0 +1,429 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2020 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * ledger of last applied options: hash of options per MAC address
+ * and index and name of the device they were applied to
+ */
+
+#include "../common.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+
+#include <asm/types.h>
+#include <libnetlink.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include "../netinfo.h"
+#include "../namelist.h"
+#include "../options.h"
+#include "ledger.h"
+
+#define BOOT_ID_FILE	"/proc/sys/kernel/random/boot_id"
+#define BOOT_ID_LENGTH	36
+
+#define FNV_OFFSET	0xcbf29ce484222325ULL
+#define FNV_PRIME	0x100000001b3ULL
+
+/* key of search domains and hostname */
+#define GLOBAL_KEY	"-"
+
+extern struct nettool_options net_opts;
+
+struct ledger_rec
+{
+	char mac[MAC_LENGTH+1];
+	int ifindex;
+	char name[NAME_LENGTH];
+	unsigned long long hash;
+	struct ledger_rec *next;
+};
+
+static unsigned int all_flags[] = { NET_OPT_DHCP, NET_OPT_IP, NET_OPT_GATEWAY, NET_OPT_SEARCH,
+				NET_OPT_DNS, NET_OPT_ROUTE, NET_OPT_HOSTNAME, 0};
+
+static unsigned long long fnv1a(unsigned long long hash, const char *str)
+{
+	while (*str != '\0') {
+		hash ^= (unsigned char)*str++;
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+/* hash of options for mac, NULL mac - search domains and hostname
+   option which is applied is taken for each type, words of value
+   are hashed in order
+return 0 if there are no options */
+static unsigned long long hash_opts(const char *mac)
+{
+	unsigned long long hash = FNV_OFFSET;
+	int i, found = 0;
+	char buf[16];
+
+	for (i = 0; all_flags[i]; i++)
+	{
+		unsigned int opt = all_flags[i];
+		struct nettool_mac *mac_it;
+		struct namelist *words = NULL, *it;
+
+		if ((mac == NULL) != ((opt & NET_OPT_GETNOTMAC) != 0))
+			continue;
+
+		mac_it = get_opt_mac(mac, opt);
+		if (mac_it == NULL)
+			continue;
+
+		found = 1;
+		snprintf(buf, sizeof(buf), "%x:", opt);
+		hash = fnv1a(hash, buf);
+
+		namelist_split(&words, mac_it->value);
+		for (it = words; it != NULL; it = it->next) {
+			hash = fnv1a(hash, it->name);
+			hash = fnv1a(hash, " ");
+		}
+		namelist_clean(&words);
+	}
+
+	return found ? hash : 0;
+}
+
+static struct ledger_rec *rec_search(struct ledger_rec *recs, const char *mac)
+{
+	for ( ; recs != NULL; recs = recs->next)
+		if (!strcasecmp(recs->mac, mac))
+			return recs;
+
+	return NULL;
+}
+
+static struct ledger_rec *rec_add(struct ledger_rec **recs, const char *mac)
+{
+	struct ledger_rec *rec = rec_search(*recs, mac);
+
+	if (rec != NULL)
+		return rec;
+
+	rec = (struct ledger_rec *) malloc(sizeof(struct ledger_rec));
+	if (rec == NULL) {
+		error(errno, "Can't allocate memory for ledger record");
+		return NULL;
+	}
+
+	memset(rec, 0, sizeof(struct ledger_rec));
+	snprintf(rec->mac, sizeof(rec->mac), "%s", mac);
+	rec->next = *recs;
+	*recs = rec;
+
+	return rec;
+}
+
+static void rec_remove(struct ledger_rec **recs, const char *mac)
+{
+	struct ledger_rec **prev, *rec;
+
+	for (prev = recs; (rec = *prev) != NULL; prev = &rec->next) {
+		if (!strcasecmp(rec->mac, mac)) {
+			*prev = rec->next;
+			free(rec);
+			return;
+		}
+	}
+}
+
+static void rec_clean(struct ledger_rec **recs)
+{
+	struct ledger_rec *rec, *next;
+
+	for (rec = *recs; rec != NULL; rec = next) {
+		next = rec->next;
+		free(rec);
+	}
+	*recs = NULL;
+}
+
+static int read_boot_id(char *boot_id)
+{
+	FILE *fp;
+	int rc;
+
+	fp = fopen(BOOT_ID_FILE, "r");
+	if (fp == NULL)
+		return -1;
+
+	rc = (fscanf(fp, "%36s", boot_id) == 1) ? 0 : -1;
+	fclose(fp);
+
+	return rc;
+}
+
+/* file format:
+   boot_id <boot_id>
+   <MAC> <ifindex> <name> <hash> */
+static int ledger_load(char *boot_id, struct ledger_rec **recs)
+{
+	FILE *fp;
+	char line[512];
+	char mac[MAC_LENGTH+1], name[NAME_LENGTH];
+	int ifindex;
+	unsigned long long hash;
+
+	boot_id[0] = '\0';
+
+	fp = fopen(LEDGER_FILE, "r");
+	if (fp == NULL)
+		return -1;
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		struct ledger_rec *rec;
+
+		if (sscanf(line, "boot_id %36s", boot_id) == 1)
+			continue;
+
+		if (sscanf(line, "%17s %d %259s %llx", mac, &ifindex, name, &hash) != 4)
+			continue;
+
+		rec = rec_add(recs, mac);
+		if (rec == NULL)
+			break;
+		rec->ifindex = ifindex;
+		snprintf(rec->name, sizeof(rec->name), "%s", name);
+		rec->hash = hash;
+	}
+
+	fclose(fp);
+
+	return 0;
+}
+
+static int ledger_save(const char *boot_id, struct ledger_rec *recs)
+{
+	FILE *fp;
+	int rc = 0;
+
+	if (mkdir(LEDGER_DIR, 0700) && errno != EEXIST) {
+		debug("Can't create %s: %s", LEDGER_DIR, strerror(errno));
+		return -1;
+	}
+
+	fp = fopen(LEDGER_FILE ".tmp", "w");
+	if (fp == NULL) {
+		debug("Can't create %s.tmp: %s", LEDGER_FILE, strerror(errno));
+		return -1;
+	}
+
+	fprintf(fp, "boot_id %s\n", boot_id);
+	for ( ; recs != NULL; recs = recs->next)
+		fprintf(fp, "%s %d %s %llx\n", recs->mac, recs->ifindex, recs->name, recs->hash);
+
+	if (fclose(fp))
+		rc = -1;
+
+	if (rc == 0 && rename(LEDGER_FILE ".tmp", LEDGER_FILE))
+		rc = -1;
+
+	if (rc) {
+		debug("Can't save %s: %s", LEDGER_FILE, strerror(errno));
+		unlink(LEDGER_FILE ".tmp");
+	}
+
+	return rc;
+}
+
+static int store_link(struct nlmsghdr *n, void *arg)
+{
+	struct ledger_rec **links = (struct ledger_rec **)arg;
+	struct ifinfomsg *ifi = NLMSG_DATA(n);
+	struct rtattr * tb[IFLA_MAX+1];
+	struct ledger_rec *link;
+	char buf[20];
+	int len;
+
+	if (n->nlmsg_type != RTM_NEWLINK)
+		return 0;
+
+	len = n->nlmsg_len - NLMSG_LENGTH(sizeof(*ifi));
+	if (len < 0)
+		return 0;
+
+	parse_rtattr(tb, IFLA_MAX, IFLA_RTA(ifi), len);
+	if (!tb[IFLA_IFNAME] || !tb[IFLA_ADDRESS])
+		return 0;
+
+	//ethernet addresses only
+	if (RTA_PAYLOAD(tb[IFLA_ADDRESS]) != 6)
+		return 0;
+
+	if (mac_to_str(RTA_DATA(tb[IFLA_ADDRESS]), RTA_PAYLOAD(tb[IFLA_ADDRESS]),
+				buf, sizeof(buf)) == NULL)
+		return 0;
+
+	link = rec_add(links, buf);
+	if (link == NULL)
+		return -1;
+
+	link->ifindex = ifi->ifi_index;
+	snprintf(link->name, sizeof(link->name), "%s", (char *)RTA_DATA(tb[IFLA_IFNAME]));
+
+	return 0;
+}
+
+/* index and name of devices from one link dump */
+static int read_links(struct ledger_rec **links)
+{
+	struct rtnl_handle rth;
+	int ret = -1;
+
+	if (rtnl_open(&rth, 0) < 0)
+		return -1;
+
+	if (rtnl_linkdump_req(&rth, AF_UNSPEC) < 0) {
+		werror("Cannot send dump request");
+		goto out;
+	}
+
+	if (rtnl_dump_filter(&rth, store_link, links) < 0) {
+		werror("Dump terminated");
+		goto out;
+	}
+
+	ret = 0;
+out:
+	rtnl_close(&rth);
+	return ret;
+}
+
+int ledger_match(void)
+{
+	char boot_id[BOOT_ID_LENGTH+1], cur_boot_id[BOOT_ID_LENGTH+1];
+	struct ledger_rec *recs = NULL, *links = NULL, *rec, *link;
+	struct nettool_mac *mac_it;
+	unsigned long long hash;
+	int rc = 0;
+
+	if (read_boot_id(cur_boot_id) || ledger_load(boot_id, &recs) ||
+			strcmp(boot_id, cur_boot_id))
+		goto out;
+
+	hash = hash_opts(NULL);
+	if (hash != 0) {
+		rec = rec_search(recs, GLOBAL_KEY);
+		if (rec == NULL || rec->hash != hash)
+			goto out;
+	}
+
+	if (read_links(&links))
+		goto out;
+
+	for (mac_it = net_opts.macs; mac_it != NULL; mac_it = mac_it->next)
+	{
+		if (mac_it->mac == NULL || mac_it->type == 0)
+			continue;
+
+		rec = rec_search(recs, mac_it->mac);
+		link = rec_search(links, mac_it->mac);
+		if (rec == NULL || link == NULL ||
+		    rec->ifindex != link->ifindex || strcmp(rec->name, link->name) ||
+		    rec->hash != hash_opts(mac_it->mac))
+			goto out;
+	}
+
+	rc = 1;
+out:
+	debug("%s: %s", __FUNCTION__, rc ? "request was applied already" : "no match");
+	rec_clean(&recs);
+	rec_clean(&links);
+	return rc;
+}
+
+void ledger_update(struct netinfo *netinfo_head)
+{
+	char boot_id[BOOT_ID_LENGTH+1], cur_boot_id[BOOT_ID_LENGTH+1];
+	struct ledger_rec *recs = NULL, *rec;
+	struct nettool_mac *mac_it;
+	unsigned long long hash;
+
+	if (read_boot_id(cur_boot_id))
+		return;
+
+	if (ledger_load(boot_id, &recs) == 0 && strcmp(boot_id, cur_boot_id))
+		rec_clean(&recs);
+
+	/* DNS servers and default gateway are shared by devices,
+	   so options recorded for other devices may not hold anymore */
+	if (count_opt_mac(NET_OPT_DNS | NET_OPT_GATEWAY)) {
+		struct ledger_rec **prev = &recs;
+
+		while ((rec = *prev) != NULL) {
+			if (strcmp(rec->mac, GLOBAL_KEY) && !search_opt_mac(rec->mac, NET_OPT_GETBYMAC)) {
+				*prev = rec->next;
+				free(rec);
+			} else {
+				prev = &rec->next;
+			}
+		}
+	}
+
+	hash = hash_opts(NULL);
+	if (hash != 0 && (rec = rec_add(&recs, GLOBAL_KEY)) != NULL) {
+		snprintf(rec->name, sizeof(rec->name), "%s", GLOBAL_KEY);
+		rec->hash = hash;
+	}
+
+	for (mac_it = net_opts.macs; mac_it != NULL; mac_it = mac_it->next)
+	{
+		struct netinfo *if_it;
+
+		if (mac_it->mac == NULL || mac_it->type == 0)
+			continue;
+
+		if_it = netinfo_search_mac(&netinfo_head, mac_it->mac);
+		if (if_it == NULL || if_it->ifindex == 0) {
+			rec_remove(&recs, mac_it->mac);
+			continue;
+		}
+
+		rec = rec_add(&recs, mac_it->mac);
+		if (rec == NULL)
+			break;
+		rec->ifindex = if_it->ifindex;
+		snprintf(rec->name, sizeof(rec->name), "%s", if_it->name);
+		rec->hash = hash_opts(mac_it->mac);
+	}
+
+	ledger_save(cur_boot_id, recs);
+	rec_clean(&recs);
+}
+
+void ledger_forget(void)
+{
+	//failed request may change settings shared by devices
+	if (unlink(LEDGER_FILE) && errno != ENOENT)
+		debug("Can't remove %s: %s", LEDGER_FILE, strerror(errno));
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2020 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * ledger of last applied options
+ */
+
+#ifndef __LEDGER_H__
+#define __LEDGER_H__
+
+#include "../netinfo.h"
+
+#define LEDGER_DIR	"/run/prl_nettool"
+#define LEDGER_FILE	LEDGER_DIR "/ledger"
+
+/* check options of current request were applied already
+   and devices were not renamed or re-created since
+return 1 - request is applied
+       0 - request should be applied */
+int ledger_match(void);
+
+/* record options of current request as applied */
+void ledger_update(struct netinfo *netinfo_head);
+
+/* forget all records after failed request */
+void ledger_forget(void);
+
+#endif
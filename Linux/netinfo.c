@@ -43,9 +43,11 @@
 #include "../posix_dns.h"
 #include "../netinfo.h"
 #include "../namelist.h"
+#include "../options.h"
 #include "../common.h"
 #include "detection.h"
 #include "exec.h"
+#include "netns.h"
 
 #include <asm/types.h>
 #include <libnetlink.h>
@@ -56,6 +58,7 @@ struct namelist *bridge_names = NULL;
 
 int os_vendor;
 char *os_script_prefix = NULL;
+const struct net_backend *net_backend = NULL;
 
 static int store_nlmsg(struct nlmsghdr *n, void *arg)
 {
@@ -265,12 +268,23 @@ static struct netinfo *put_linkinfo(struct nlmsghdr *n,
 	if (namelist_search(dev_name, &bridge_names)) {
 		return NULL;
 	}
+	//sysfs lists bridges of namespace which mounted it only
+	if (tb[IFLA_LINKINFO]) {
+		struct rtattr *linkinfo[IFLA_INFO_MAX+1];
+
+		parse_rtattr(linkinfo, IFLA_INFO_MAX, RTA_DATA(tb[IFLA_LINKINFO]),
+				RTA_PAYLOAD(tb[IFLA_LINKINFO]));
+		if (linkinfo[IFLA_INFO_KIND] &&
+				!strcmp(RTA_DATA(linkinfo[IFLA_INFO_KIND]), "bridge"))
+			return NULL;
+	}
 
 	if_info = netinfo_new();
 	if (if_info == NULL)
 		return NULL;
 
 	strncpy(if_info->name, dev_name, NAME_LENGTH-1);
+	if_info->ifindex = ifi->ifi_index;
 
 	strncpy(if_info->mac, buf, MAC_LENGTH);
 	if_info->mac[MAC_LENGTH] = '\0';
@@ -318,6 +332,64 @@ static struct netinfo *put_linkinfo(struct nlmsghdr *n,
 	return if_info;
 }
 
+/* static routes of devices, format of --route option: <IP>/<prefix>[=<GW>][m<metric>] */
+static int put_route(struct nlmsghdr *n, struct netinfo **netinfo_head)
+{
+	struct rtmsg *r = NLMSG_DATA(n);
+	int len, oif;
+	struct rtattr * rta_tb[RTA_MAX+1];
+	char abuf[256], route[600];
+	struct netinfo *it;
+
+	if (n->nlmsg_type != RTM_NEWROUTE)
+		return 0;
+
+	if (r->rtm_type != RTN_UNICAST || r->rtm_table != RT_TABLE_MAIN)
+		return 0;
+
+	//skip routes of addresses, DHCP and routing daemons
+	if (r->rtm_protocol != RTPROT_BOOT && r->rtm_protocol != RTPROT_STATIC)
+		return 0;
+
+	len = n->nlmsg_len - NLMSG_LENGTH(sizeof(*r));
+	if (len < 0) {
+		werror("netlink message too short to be a routing message");
+		return 1;
+	}
+
+	parse_rtattr(rta_tb, RTA_MAX, RTM_RTA(r), len);
+
+	if (!rta_tb[RTA_DST] || !r->rtm_dst_len) //default is gateway
+		return 0;
+
+	if (!rta_tb[RTA_OIF])
+		return 0;
+
+	oif = *(int *)RTA_DATA(rta_tb[RTA_OIF]);
+
+	if (inet_ntop(r->rtm_family, RTA_DATA(rta_tb[RTA_DST]), abuf, sizeof(abuf)) == NULL)
+		return 0;
+	len = snprintf(route, sizeof(route), "%s/%d", abuf, r->rtm_dst_len);
+
+	if (rta_tb[RTA_GATEWAY] &&
+	    inet_ntop(r->rtm_family, RTA_DATA(rta_tb[RTA_GATEWAY]), abuf, sizeof(abuf)) != NULL)
+		len += snprintf(route + len, sizeof(route) - len, "=%s", abuf);
+
+	if (rta_tb[RTA_PRIORITY])
+		snprintf(route + len, sizeof(route) - len, "%sm%u",
+			rta_tb[RTA_GATEWAY] ? "" : "=",
+			*(unsigned int *)RTA_DATA(rta_tb[RTA_PRIORITY]));
+
+	for (it = *netinfo_head; it != NULL; it = it->next) {
+		if (it->ifindex != oif)
+			continue;
+		if (namelist_add(route, &it->route) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
 static int read_ifconfioctl(struct netinfo **netinfo_head)
 {
 	struct rtnl_handle rth;
@@ -327,6 +399,7 @@ static int read_ifconfioctl(struct netinfo **netinfo_head)
 	struct nlmsg_list *rinfo = NULL; //route
 	struct nlmsg_list *r6info = NULL; //IPv6 route
 	struct nlmsg_list *l, *n;
+	struct netinfo *if_it;
 	int ret;
 
 	if (rtnl_open(&rth, 0) < 0)
@@ -410,15 +483,20 @@ static int read_ifconfioctl(struct netinfo **netinfo_head)
 	for ( l = rinfo  ; l ;  l = n) {
 		n = l->next;
 		put_gateway(&l->h, netinfo_head, 0);
+		put_route(&l->h, netinfo_head);
 		free(l);
 	}
 
 	for ( l = r6info  ; l ;  l = n) {
 		n = l->next;
 		put_gateway(&l->h, netinfo_head, 1);
+		put_route(&l->h, netinfo_head);
 		free(l);
 	}
 
+	for (if_it = *netinfo_head; if_it != NULL; if_it = if_it->next)
+		if_it->route_scanned = 1;
+
 out:
 	rtnl_close(&rth);
 	return 0;
@@ -440,20 +518,17 @@ void read_dhcp(struct netinfo **netinfo_head)
 	info = netinfo_get_first(netinfo_head);
 	while(info && strlen(info->mac))
 	{
-		char cmd[PATH_MAX+1];
+		char path[PATH_MAX];
 		int rc;
 
-		if (os_script_prefix == NULL)
+		if (backend_script(net_backend, OP_GET_DHCP, path) == NULL)
 			return;
 
-		if (snprintf(cmd, PATH_MAX,
-				SCRIPT_DIR "/%s-get_dhcp.sh \"%s\" \"%s\" 4", os_script_prefix, info->mac, info->name) >= PATH_MAX)
-		{
-			werror("ERROR: Command line for execution %s-get_dhcp.sh is too long", os_script_prefix);
-			return;
-		}
-
-		rc = run_cmd(cmd);
+		const char *argv4[] = {path, info->mac, info->name, "4", NULL};
+		if (net_backend->get_dhcp != NULL)
+			rc = net_backend->get_dhcp(info, 4);
+		else
+			rc = run_cmdv(argv4);
 
 		if (rc == 0)
 			info->configured_with_dhcp = 1;
@@ -463,14 +538,11 @@ void read_dhcp(struct netinfo **netinfo_head)
 			werror("Failed to get DHCP configuration for mac '%s'. return %d", info->mac, rc);
 
 
-		if (snprintf(cmd, PATH_MAX,
-				SCRIPT_DIR "/%s-get_dhcp.sh \"%s\" \"%s\" 6", os_script_prefix, info->mac, info->name) >= PATH_MAX)
-		{
-			werror("ERROR: Command line for execution %s-get_dhcp.sh is too long", os_script_prefix);
-			return;
-		}
-
-		rc = run_cmd(cmd);
+		const char *argv6[] = {path, info->mac, info->name, "6", NULL};
+		if (net_backend->get_dhcp != NULL)
+			rc = net_backend->get_dhcp(info, 6);
+		else
+			rc = run_cmdv(argv6);
 
 		if (rc == 0)
 			info->configured_with_dhcpv6 = 1;
@@ -485,17 +557,75 @@ void read_dhcp(struct netinfo **netinfo_head)
 
 }
 
+static void read_hostname(struct netinfo **netinfo_head)
+{
+	char buf[NAME_LENGTH];
+	struct netinfo *it;
+
+	if (gethostname(buf, sizeof(buf)) != 0) {
+		werror("Failed to get hostname: %s", strerror(errno));
+		return;
+	}
+	buf[sizeof(buf) - 1] = '\0';
+
+	for (it = *netinfo_head; it != NULL; it = it->next)
+		snprintf(it->hostname, NAME_LENGTH, "%s", buf);
+}
+
 void detect_distribution()
 {
-	get_distribution(&os_vendor, &os_script_prefix);
+	//devices of other network namespaces have no configuration files,
+	//only their kernel state is read and changed
+	if (netns_current() != NULL) {
+		os_vendor = VENDOR_UNKNOWN;
+		os_script_prefix = NULL;
+		net_backend = get_netlink_backend();
+	} else {
+		get_distribution(&os_vendor, &os_script_prefix);
+		net_backend = get_backend();
+	}
+	exec_set_backend(backend_name(net_backend));
+	exec_set_nm_active(net_backend->nm_active);
 }
 
 int get_device_list(struct netinfo **netinfo_head) {
 
-	get_distribution(&os_vendor, &os_script_prefix);
+	detect_distribution();
+
+	namelist_clean(&bridge_names);
+	//sysfs and resolver of host do not describe devices of other namespace
+	if (netns_current() != NULL)
+		return read_ifconfioctl(netinfo_head);
 
 	read_bridge_info();
 	read_ifconfioctl(netinfo_head);
+	read_dns(netinfo_head);
+	read_dhcp(netinfo_head);
+	read_hostname(netinfo_head);
+
+	return 0;
+}
+
+int get_offline_device_list(struct netinfo **netinfo_head, struct nettool_mac *ifnames)
+{
+	struct nettool_mac *it;
+	struct netinfo *info;
+
+	detect_distribution();
+	if (os_script_prefix == NULL) {
+		error(0, "Distribution is not detected, nothing can be configured");
+		return -1;
+	}
+
+	for (it = ifnames; it != NULL; it = it->next) {
+		info = netinfo_new();
+		if (info == NULL)
+			return -1;
+		snprintf(info->mac, sizeof(info->mac), "%s", it->mac);
+		snprintf(info->name, sizeof(info->name), "%s", it->value);
+		netinfo_add(info, netinfo_head);
+	}
+
 	read_dns(netinfo_head);
 	read_dhcp(netinfo_head);
 
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2020 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * network namespaces: setns() of the whole process, commands and threads
+ * started inside inherit the namespace
+ */
+
+#define _GNU_SOURCE
+#include "../common.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "netns.h"
+
+/* namespace of process while other one is entered */
+static int host_fd = -1;
+static int depth;
+static const char *current;
+
+static int open_netns(const char *ns)
+{
+	char path[PATH_MAX];
+	int fd;
+
+	if (strchr(ns, '/') != NULL)
+		snprintf(path, sizeof(path), "%s", ns);
+	else
+		snprintf(path, sizeof(path), NETNS_RUN_DIR "/%s", ns);
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		error(errno, "Can't open network namespace %s", path);
+
+	return fd;
+}
+
+int netns_enter(const char *ns)
+{
+	int fd;
+
+	if (depth++ > 0)
+		return 0;
+
+	host_fd = open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+	if (host_fd < 0) {
+		error(errno, "Can't open network namespace of process");
+		goto err;
+	}
+
+	fd = open_netns(ns);
+	if (fd < 0)
+		goto err;
+	if (setns(fd, CLONE_NEWNET)) {
+		error(errno, "Can't enter network namespace %s", ns);
+		close(fd);
+		goto err;
+	}
+	close(fd);
+
+	current = ns;
+	debug("%s: %s", __FUNCTION__, ns);
+
+	return 0;
+err:
+	if (host_fd >= 0)
+		close(host_fd);
+	host_fd = -1;
+	depth = 0;
+	return -1;
+}
+
+void netns_leave(void)
+{
+	if (depth == 0 || --depth > 0)
+		return;
+
+	if (setns(host_fd, CLONE_NEWNET))
+		error(errno, "Can't return to network namespace of process");
+	close(host_fd);
+	host_fd = -1;
+	current = NULL;
+}
+
+const char *netns_current(void)
+{
+	return current;
+}
+
+static int is_netns(const struct dirent *entry)
+{
+	return entry->d_name[0] != '.';
+}
+
+int netns_list(struct namelist **list)
+{
+	struct dirent **names;
+	int i, num, rc = 0;
+
+	num = scandir(NETNS_RUN_DIR, &names, is_netns, alphasort);
+	if (num < 0) {
+		//no namespace was ever added
+		if (errno == ENOENT)
+			return 0;
+		error(errno, "Can't read %s", NETNS_RUN_DIR);
+		return -1;
+	}
+
+	for (i = 0; i < num; i++) {
+		if (rc == 0 && namelist_add(names[i]->d_name, list))
+			rc = -1;
+		free(names[i]);
+	}
+	free(names);
+
+	return rc;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2020 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * network namespaces: scan and configuration of devices of other
+ * namespaces by netlink from the same process
+ */
+
+#ifndef __NETNS_H__
+#define __NETNS_H__
+
+#include "../namelist.h"
+
+/* namespaces created by "ip netns add" */
+#define NETNS_RUN_DIR	"/run/netns"
+
+/* switch process to network namespace ns: name in NETNS_RUN_DIR or path
+   to namespace file, ns should live until netns_leave(), calls may be
+   nested with the same ns and only the outer one switches
+return 0 on success, -1 on error */
+int netns_enter(const char *ns);
+
+/* return to namespace of process after the outer netns_enter() */
+void netns_leave(void);
+
+/* namespace entered by netns_enter(), NULL if it is one of process */
+const char *netns_current(void);
+
+/* add names of namespaces in NETNS_RUN_DIR to list in sorted order
+return 0 on success, -1 on error */
+int netns_list(struct namelist **list);
+
+#endif
@@ -0,0 +1,1847 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2019 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * native editor of netplan configuration: subset of YAML used by netplan
+ * is parsed into a tree and written back the way netplan-cfg.py does
+ */
+
+#include "../common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <regex.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../namelist.h"
+#include "exec.h"
+#include "netplan.h"
+
+#define FNV_OFFSET	0xcbf29ce484222325ULL
+#define FNV_PRIME	0x100000001b3ULL
+
+#define NETPLAN_INFO_SIZE	8192
+#define HOST_ROUTED_GW		"169.254.0.1"
+
+enum { YAML_SCALAR = 0, YAML_MAP, YAML_SEQ };
+
+/* node of YAML document, items of mapping and sequence are children */
+struct ynode
+{
+	int type;
+	int quoted;	/* scalar is string whatever its text is */
+	char *key;	/* key of item of mapping, NULL for others */
+	char *value;	/* text of scalar */
+	struct ynode *child, *last;
+	struct ynode *next;
+};
+
+struct yline
+{
+	int indent;
+	int num;
+	char *text;
+	char *buf;
+};
+
+struct yparser
+{
+	const char *path;
+	struct yline *lines;
+	int count;
+	int pos;
+	int failed;
+};
+
+/* implicit types of plain scalars of YAML 1.1 as PyYAML resolves them */
+enum { YTAG_STR = 0, YTAG_BOOL, YTAG_FLOAT, YTAG_INT, YTAG_MERGE, YTAG_NULL,
+	YTAG_TIMESTAMP, YTAG_VALUE, YTAG_MAX };
+
+static const char *tag_patterns[YTAG_MAX] = {
+	NULL,
+	"^(yes|Yes|YES|no|No|NO|true|True|TRUE|false|False|FALSE|on|On|ON|off|Off|OFF)$",
+	"^([-+]?[0-9][0-9_]*\\.[0-9_]*([eE][-+][0-9]+)?|\\.[0-9_]+([eE][-+][0-9]+)?"
+		"|[-+]?[0-9][0-9_]*(:[0-5]?[0-9])+\\.[0-9_]*|[-+]?\\.(inf|Inf|INF)"
+		"|\\.(nan|NaN|NAN))$",
+	"^([-+]?0b[0-1_]+|[-+]?0[0-7_]+|[-+]?(0|[1-9][0-9_]*)|[-+]?0x[0-9a-fA-F_]+"
+		"|[-+]?[1-9][0-9_]*(:[0-5]?[0-9])+)$",
+	"^<<$",
+	"^(~|null|Null|NULL|)$",
+	"^([0-9][0-9][0-9][0-9]-[0-9][0-9]-[0-9][0-9]"
+		"|[0-9][0-9][0-9][0-9]-[0-9][0-9]?-[0-9][0-9]?([Tt]|[ \t]+)"
+		"[0-9][0-9]?:[0-9][0-9]:[0-9][0-9](\\.[0-9]*)?"
+		"([ \t]*(Z|[-+][0-9][0-9]?(:[0-9][0-9])?))?)$",
+	"^=$",
+};
+
+static regex_t tag_regex[YTAG_MAX];
+static int tag_regex_ok;
+static pthread_once_t tag_once = PTHREAD_ONCE_INIT;
+
+static int has_default_routes = -1;
+static pthread_once_t info_once = PTHREAD_ONCE_INIT;
+
+/* configuration changed by operations, it is written by netplan_commit() */
+struct staged_config
+{
+	char dev[NAME_LENGTH];
+	struct ynode *doc;
+	struct staged_config *next;
+};
+
+static struct staged_config *staged;
+static pthread_mutex_t staged_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void compile_tags(void)
+{
+	int i;
+
+	for (i = 1; i < YTAG_MAX; i++)
+		if (regcomp(&tag_regex[i], tag_patterns[i], REG_EXTENDED | REG_NOSUB)) {
+			error(0, "Can't compile pattern of YAML type %d", i);
+			return;
+		}
+	tag_regex_ok = 1;
+}
+
+/* type of plain scalar */
+static int resolve_tag(const char *value)
+{
+	int i;
+
+	pthread_once(&tag_once, compile_tags);
+	if (!tag_regex_ok)
+		return YTAG_STR;
+
+	for (i = 1; i < YTAG_MAX; i++)
+		if (!regexec(&tag_regex[i], value, 0, NULL, 0))
+			return i;
+
+	return YTAG_STR;
+}
+
+/* bool scalar is false, value is one of words of YTAG_BOOL */
+static int is_false(const char *value)
+{
+	return strchr("nNfF", value[0]) != NULL ||
+		(strchr("oO", value[0]) != NULL && strchr("fF", value[1]) != NULL);
+}
+
+static struct ynode *ynode_new(int type, const char *key)
+{
+	struct ynode *n = (struct ynode *)calloc(1, sizeof(*n));
+
+	if (n == NULL) {
+		error(errno, "Can't allocate memory");
+		return NULL;
+	}
+	n->type = type;
+	if (key != NULL && (n->key = strdup(key)) == NULL) {
+		error(errno, "Can't allocate memory");
+		free(n);
+		return NULL;
+	}
+
+	return n;
+}
+
+static struct ynode *yscalar_new(const char *key, const char *value, int quoted)
+{
+	struct ynode *n = ynode_new(YAML_SCALAR, key);
+
+	if (n == NULL)
+		return NULL;
+	n->quoted = quoted;
+	n->value = strdup(value);
+	if (n->value == NULL) {
+		error(errno, "Can't allocate memory");
+		free(n->key);
+		free(n);
+		return NULL;
+	}
+
+	return n;
+}
+
+static void ynode_free(struct ynode *n)
+{
+	struct ynode *next;
+
+	for ( ; n != NULL; n = next) {
+		next = n->next;
+		ynode_free(n->child);
+		free(n->key);
+		free(n->value);
+		free(n);
+	}
+}
+
+static void ynode_add(struct ynode *parent, struct ynode *n)
+{
+	if (parent->last != NULL)
+		parent->last->next = n;
+	else
+		parent->child = n;
+	parent->last = n;
+}
+
+static struct ynode *ymap_get(struct ynode *map, const char *key)
+{
+	struct ynode *n;
+
+	if (map == NULL || map->type != YAML_MAP)
+		return NULL;
+	for (n = map->child; n != NULL; n = n->next)
+		if (!strcmp(n->key, key))
+			return n;
+
+	return NULL;
+}
+
+static void ymap_del(struct ynode *map, const char *key)
+{
+	struct ynode *n, *prev = NULL, *next;
+
+	for (n = map->child; n != NULL; n = next) {
+		next = n->next;
+		if (strcmp(n->key, key)) {
+			prev = n;
+			continue;
+		}
+		if (prev != NULL)
+			prev->next = next;
+		else
+			map->child = next;
+		if (map->last == n)
+			map->last = prev;
+		n->next = NULL;
+		ynode_free(n);
+	}
+}
+
+/* replace value of key by n, n is freed on error */
+static int ymap_set(struct ynode *map, const char *key, struct ynode *n)
+{
+	if (n == NULL)
+		return -1;
+	if (n->key == NULL && (n->key = strdup(key)) == NULL) {
+		error(errno, "Can't allocate memory");
+		ynode_free(n);
+		return -1;
+	}
+
+	ymap_del(map, key);
+	ynode_add(map, n);
+
+	return 0;
+}
+
+static int ymap_set_scalar(struct ynode *map, const char *key, const char *value,
+		int quoted)
+{
+	return ymap_set(map, key, yscalar_new(NULL, value, quoted));
+}
+
+/* value of key of type, it is created if key is absent or has other type */
+static struct ynode *ymap_obtain(struct ynode *map, const char *key, int type)
+{
+	struct ynode *n = ymap_get(map, key);
+
+	if (n != NULL && n->type == type)
+		return n;
+
+	n = ynode_new(type, NULL);
+	if (ymap_set(map, key, n))
+		return NULL;
+
+	return n;
+}
+
+/* Python truth value of node as netplan-cfg.py loads it */
+static int ynode_true(const struct ynode *n)
+{
+	if (n->type != YAML_SCALAR)
+		return n->child != NULL;
+	if (n->quoted)
+		return n->value[0] != '\0';
+
+	switch (resolve_tag(n->value)) {
+	case YTAG_BOOL:
+		return !is_false(n->value);
+	case YTAG_NULL:
+		return 0;
+	case YTAG_INT:
+	case YTAG_FLOAT:
+		return strtod(n->value, NULL) != 0;
+	}
+
+	return 1;
+}
+
+/* text of node which is equal for equal values of Python */
+static void ynode_canon(const struct ynode *n, FILE *fp)
+{
+	const struct ynode *it;
+	int tag;
+
+	if (n->type != YAML_SCALAR) {
+		fputc(n->type == YAML_MAP ? '{' : '[', fp);
+		for (it = n->child; it != NULL; it = it->next) {
+			if (it->key != NULL)
+				fprintf(fp, "%zu:%s", strlen(it->key), it->key);
+			ynode_canon(it, fp);
+		}
+		fputc(n->type == YAML_MAP ? '}' : ']', fp);
+		return;
+	}
+
+	tag = n->quoted ? YTAG_STR : resolve_tag(n->value);
+	if (tag == YTAG_BOOL)
+		fprintf(fp, "b%d", !is_false(n->value));
+	else if (tag == YTAG_NULL)
+		fputc('n', fp);
+	else
+		fprintf(fp, "%d:%zu:%s", tag, strlen(n->value), n->value);
+}
+
+/* canonical text of mapping with sorted keys, to be freed by caller */
+static char *ymap_key(const struct ynode *map)
+{
+	const struct ynode *items[64], *it;
+	char *text = NULL;
+	size_t len = 0;
+	int i, j, count = 0;
+	FILE *fp;
+
+	fp = open_memstream(&text, &len);
+	if (fp == NULL) {
+		error(errno, "Can't allocate memory");
+		return NULL;
+	}
+
+	if (map->type != YAML_MAP) {
+		ynode_canon(map, fp);
+	} else {
+		//items of route are few, insertion sort
+		for (it = map->child; it != NULL && count < 64; it = it->next) {
+			for (i = count; i > 0 && strcmp(items[i - 1]->key, it->key) > 0; i--)
+				items[i] = items[i - 1];
+			items[i] = it;
+			count++;
+		}
+		fputc('{', fp);
+		for (j = 0; j < count; j++) {
+			fprintf(fp, "%zu:%s", strlen(items[j]->key), items[j]->key);
+			ynode_canon(items[j], fp);
+		}
+		fputc('}', fp);
+	}
+
+	if (fclose(fp)) {
+		error(errno, "Can't allocate memory");
+		free(text);
+		return NULL;
+	}
+
+	return text;
+}
+
+/* set of canonical texts of routes, duplicates are found in O(1) */
+struct keyset
+{
+	char **keys;
+	int count, size;
+};
+
+static unsigned int hash_key(const char *key)
+{
+	unsigned long long hash = FNV_OFFSET;
+
+	for ( ; *key; key++) {
+		hash ^= (unsigned char)*key;
+		hash *= FNV_PRIME;
+	}
+	return (unsigned int)hash;
+}
+
+static int keyset_slot(const struct keyset *set, const char *key)
+{
+	int mask = set->size - 1;
+	int slot = hash_key(key) & mask;
+
+	while (set->keys[slot] != NULL && strcmp(set->keys[slot], key))
+		slot = (slot + 1) & mask;
+
+	return slot;
+}
+
+static int keyset_has(const struct keyset *set, const char *key)
+{
+	return set->size != 0 && set->keys[keyset_slot(set, key)] != NULL;
+}
+
+/* key is owned by set */
+static int keyset_add(struct keyset *set, char *key)
+{
+	char **old = set->keys;
+	int i, old_size = set->size;
+
+	if (2 * (set->count + 1) > set->size) {
+		set->size = old_size ? old_size * 2 : 64;
+		set->keys = (char **)calloc(set->size, sizeof(char *));
+		if (set->keys == NULL) {
+			error(errno, "Can't allocate memory");
+			set->keys = old;
+			set->size = old_size;
+			free(key);
+			return -1;
+		}
+		for (i = 0; i < old_size; i++)
+			if (old[i] != NULL)
+				set->keys[keyset_slot(set, old[i])] = old[i];
+		free(old);
+	}
+
+	set->keys[keyset_slot(set, key)] = key;
+	set->count++;
+
+	return 0;
+}
+
+static void keyset_clean(struct keyset *set)
+{
+	int i;
+
+	for (i = 0; i < set->size; i++)
+		free(set->keys[i]);
+	free(set->keys);
+	memset(set, 0, sizeof(*set));
+}
+
+static struct ynode *yfail(struct yparser *p, int num)
+{
+	if (!p->failed)
+		error(0, "%s:%d: invalid or unsupported YAML", p->path, num);
+	p->failed = 1;
+
+	return NULL;
+}
+
+/* end of quoted scalar s, NULL if it is not closed on this line */
+static char *skip_quoted(char *s)
+{
+	char *p;
+
+	for (p = s + 1; *p; p++) {
+		if (*s == '"' && *p == '\\' && p[1] != '\0')
+			p++;
+		else if (*p == *s && *s == '\'' && p[1] == '\'')
+			p++;
+		else if (*p == *s)
+			return p + 1;
+	}
+
+	return NULL;
+}
+
+/* escapes of double quoted scalar which PyYAML accepts besides \x, \u and \U */
+static const char escape_chars[] = "0abt\tnvfre \"/\\N_LP";
+static const unsigned int escape_codes[] = {0, 0x07, 0x08, 0x09, 0x09, 0x0A, 0x0B,
+	0x0C, 0x0D, 0x1B, 0x20, 0x22, 0x2F, 0x5C, 0x85, 0xA0, 0x2028, 0x2029};
+
+/* code point of escape after backslash at p, p is moved to its last character
+return -1 if escape is unsupported */
+static long escape_code(const char **p)
+{
+	const char *s = *p, *chr;
+	char digits[9];
+	int i, len;
+
+	if (*s == 'x' || *s == 'u' || *s == 'U') {
+		len = (*s == 'x') ? 2 : (*s == 'u') ? 4 : 8;
+		for (i = 0; i < len; i++) {
+			if (!isxdigit((unsigned char)s[i + 1]))
+				return -1;
+			digits[i] = s[i + 1];
+		}
+		digits[len] = '\0';
+		*p = s + len;
+		return strtol(digits, NULL, 16);
+	}
+
+	chr = (*s != '\0') ? strchr(escape_chars, *s) : NULL;
+
+	return chr ? (long)escape_codes[chr - escape_chars] : -1;
+}
+
+/* code point c as UTF-8 to w, return its length */
+static int put_utf8(char *w, unsigned long c)
+{
+	if (c < 0x80) {
+		w[0] = c;
+		return 1;
+	}
+	if (c < 0x800) {
+		w[0] = 0xC0 | (c >> 6);
+		w[1] = 0x80 | (c & 0x3F);
+		return 2;
+	}
+	if (c < 0x10000) {
+		w[0] = 0xE0 | (c >> 12);
+		w[1] = 0x80 | ((c >> 6) & 0x3F);
+		w[2] = 0x80 | (c & 0x3F);
+		return 3;
+	}
+	w[0] = 0xF0 | (c >> 18);
+	w[1] = 0x80 | ((c >> 12) & 0x3F);
+	w[2] = 0x80 | ((c >> 6) & 0x3F);
+	w[3] = 0x80 | (c & 0x3F);
+	return 4;
+}
+
+/* text of quoted scalar s, to be freed by caller, end is set after its
+   closing quote, NUL can't be kept in text and is not accepted
+return NULL if scalar is not closed or has unsupported escape */
+static char *unquote(char *s, char **end)
+{
+	const char *p;
+	char *text, *w, quote = *s;
+	long c;
+
+	*end = skip_quoted(s);
+	if (*end == NULL)
+		return NULL;
+
+	//escape is at least as long as its UTF-8 text except \L and \P
+	text = (char *)malloc(2 * (*end - s));
+	if (text == NULL) {
+		error(errno, "Can't allocate memory");
+		return NULL;
+	}
+
+	for (p = s + 1, w = text; p < *end - 1; p++) {
+		if (quote == '\'' && *p == '\'') {
+			p++;
+		} else if (quote == '"' && *p == '\\') {
+			p++;
+			c = escape_code(&p);
+			if (c <= 0 || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) {
+				free(text);
+				return NULL;
+			}
+			w += put_utf8(w, c);
+			continue;
+		}
+		*w++ = *p;
+	}
+	*w = '\0';
+
+	return text;
+}
+
+/* cut comment and trailing spaces of line */
+static void strip_comment(char *s)
+{
+	char *p, *end;
+
+	for (p = s; *p; p++) {
+		if ((*p == '\'' || *p == '"') && (p == s || strchr(" \t[{,:", p[-1]))) {
+			end = skip_quoted(p);
+			if (end == NULL)
+				break;
+			p = end - 1;
+		} else if (*p == '#' && (p == s || p[-1] == ' ' || p[-1] == '\t')) {
+			*p = '\0';
+			break;
+		}
+	}
+
+	end = s + strlen(s);
+	while (end > s && strchr(" \t\r\n", end[-1]))
+		*--end = '\0';
+}
+
+static int is_dash(const char *text)
+{
+	return text[0] == '-' && (text[1] == ' ' || text[1] == '\0');
+}
+
+/* colon after key of mapping item, NULL if text is not such item */
+static char *find_colon(char *text)
+{
+	char *p = text;
+
+	if (*text == '[' || *text == '{')
+		return NULL;
+	if (*text == '\'' || *text == '"') {
+		p = skip_quoted(text);
+		if (p == NULL)
+			return NULL;
+		p += strspn(p, " \t");
+		return (*p == ':' && (p[1] == ' ' || p[1] == '\0')) ? p : NULL;
+	}
+
+	for ( ; (p = strchr(p, ':')) != NULL; p++)
+		if (p[1] == ' ' || p[1] == '\t' || p[1] == '\0')
+			return p;
+
+	return NULL;
+}
+
+/* scalar of flow collection, it ends with , ] } or : of key */
+static struct ynode *flow_scalar(struct yparser *p, char **sp, int num)
+{
+	char *s = *sp, *end, *text, c;
+	struct ynode *n;
+
+	if (*s == '\'' || *s == '"') {
+		text = unquote(s, &end);
+		if (text == NULL)
+			return yfail(p, num);
+		*sp = end;
+		n = yscalar_new(NULL, text, 1);
+		free(text);
+		return n;
+	}
+
+	for (end = s; *end && !strchr(",[]{}", *end) &&
+			!(*end == ':' && strchr(" ,]}", end[1])); end++)
+		;
+	*sp = end;
+	while (end > s && end[-1] == ' ')
+		end--;
+
+	c = *end;
+	*end = '\0';
+	n = yscalar_new(NULL, s, 0);
+	*end = c;
+
+	return n;
+}
+
+/* [a, b] or {a: b}, whole collection is on one line */
+static struct ynode *parse_flow(struct yparser *p, char **sp, int num)
+{
+	char *s = *sp + strspn(*sp, " \t"), close;
+	struct ynode *n, *item, *value;
+
+	if (*s != '[' && *s != '{') {
+		n = flow_scalar(p, &s, num);
+		*sp = s;
+		return n;
+	}
+
+	close = (*s == '[') ? ']' : '}';
+	n = ynode_new(*s == '[' ? YAML_SEQ : YAML_MAP, NULL);
+	if (n == NULL)
+		return NULL;
+
+	for (s++; ; s++) {
+		s += strspn(s, " \t");
+		if (*s == close)
+			break;
+
+		item = parse_flow(p, &s, num);
+		if (item == NULL)
+			goto err;
+		s += strspn(s, " \t");
+
+		if (n->type == YAML_SEQ) {
+			ynode_add(n, item);
+		} else {
+			if (item->type != YAML_SCALAR) {
+				ynode_free(item);
+				goto fail;
+			}
+			if (*s == ':') {
+				s++;
+				value = parse_flow(p, &s, num);
+				s += strspn(s, " \t");
+			} else {
+				value = yscalar_new(NULL, "", 0);
+			}
+			if (value == NULL || ymap_set(n, item->value, value)) {
+				ynode_free(item);
+				goto err;
+			}
+			ynode_free(item);
+		}
+
+		if (*s == close)
+			break;
+		if (*s != ',')
+			goto fail;
+	}
+
+	*sp = s + 1;
+	return n;
+fail:
+	yfail(p, num);
+err:
+	ynode_free(n);
+	return NULL;
+}
+
+/* value written after "key:" or "-" on the same line */
+static struct ynode *parse_value(struct yparser *p, char *s, int num)
+{
+	struct ynode *n;
+	char *end, *text;
+
+	if (*s == '[' || *s == '{') {
+		n = parse_flow(p, &s, num);
+		if (n != NULL && s[strspn(s, " \t")] != '\0') {
+			ynode_free(n);
+			return yfail(p, num);
+		}
+		return n;
+	}
+
+	if (*s == '\'' || *s == '"') {
+		text = unquote(s, &end);
+		if (text == NULL || end[strspn(end, " \t")] != '\0') {
+			free(text);
+			return yfail(p, num);
+		}
+		n = yscalar_new(NULL, text, 1);
+		free(text);
+		return n;
+	}
+
+	//block scalars, anchors, aliases and tags are not used by netplan
+	if (strchr("|>&*!", *s))
+		return yfail(p, num);
+
+	return yscalar_new(NULL, s, 0);
+}
+
+static struct ynode *parse_block(struct yparser *p, int indent);
+
+static struct ynode *parse_seq(struct yparser *p, int indent)
+{
+	struct ynode *seq, *item;
+	struct yline *line;
+	char *content;
+
+	seq = ynode_new(YAML_SEQ, NULL);
+	while (seq != NULL && p->pos < p->count) {
+		line = &p->lines[p->pos];
+		if (line->indent != indent || !is_dash(line->text))
+			break;
+
+		content = line->text + 1;
+		content += strspn(content, " ");
+		if (*content == '\0') {
+			p->pos++;
+			if (p->pos < p->count && p->lines[p->pos].indent > indent)
+				item = parse_block(p, p->lines[p->pos].indent);
+			else
+				item = yscalar_new(NULL, "", 0);
+		} else {
+			//item is parsed as block indented to its text
+			line->indent += content - line->text;
+			line->text = content;
+			item = parse_block(p, line->indent);
+		}
+		if (item == NULL) {
+			ynode_free(seq);
+			return NULL;
+		}
+		ynode_add(seq, item);
+
+		if (p->pos < p->count && p->lines[p->pos].indent > indent) {
+			ynode_free(seq);
+			return yfail(p, p->lines[p->pos].num);
+		}
+	}
+
+	return seq;
+}
+
+static struct ynode *parse_map(struct yparser *p, int indent)
+{
+	struct ynode *map, *value;
+	struct yline *line;
+	char *colon, *key, *quoted, *s, *end;
+	int rc;
+
+	map = ynode_new(YAML_MAP, NULL);
+	while (map != NULL && p->pos < p->count) {
+		line = &p->lines[p->pos];
+		if (line->indent != indent || is_dash(line->text))
+			break;
+
+		colon = find_colon(line->text);
+		if (colon == NULL)
+			goto fail;
+		*colon = '\0';
+		s = colon + 1;
+		s += strspn(s, " \t");
+
+		key = line->text;
+		quoted = NULL;
+		if (*key == '\'' || *key == '"') {
+			key = quoted = unquote(key, &end);
+			if (key == NULL)
+				goto fail;
+		} else {
+			end = colon;
+			while (end > key && (end[-1] == ' ' || end[-1] == '\t'))
+				*--end = '\0';
+		}
+
+		p->pos++;
+		if (*s != '\0')
+			value = parse_value(p, s, line->num);
+		else if (p->pos < p->count && p->lines[p->pos].indent > indent)
+			value = parse_block(p, p->lines[p->pos].indent);
+		else if (p->pos < p->count && p->lines[p->pos].indent == indent &&
+				is_dash(p->lines[p->pos].text))
+			//sequence is not indented under its key
+			value = parse_seq(p, indent);
+		else
+			value = yscalar_new(NULL, "", 0);
+		rc = (value == NULL || ymap_set(map, key, value));
+		free(quoted);
+		if (rc)
+			goto err;
+
+		if (p->pos < p->count && p->lines[p->pos].indent > indent) {
+			line = &p->lines[p->pos];
+			goto fail;
+		}
+	}
+
+	return map;
+fail:
+	yfail(p, line->num);
+err:
+	ynode_free(map);
+	return NULL;
+}
+
+static struct ynode *parse_block(struct yparser *p, int indent)
+{
+	struct yline *line = &p->lines[p->pos];
+
+	if (is_dash(line->text))
+		return parse_seq(p, indent);
+	if (find_colon(line->text) != NULL)
+		return parse_map(p, indent);
+
+	p->pos++;
+	return parse_value(p, line->text, line->num);
+}
+
+static void free_lines(struct yparser *p)
+{
+	int i;
+
+	for (i = 0; i < p->count; i++)
+		free(p->lines[i].buf);
+	free(p->lines);
+}
+
+/* significant lines of file without comments */
+static int read_lines(struct yparser *p, FILE *fp)
+{
+	struct yline *lines;
+	char *buf = NULL;
+	size_t size = 0;
+	int num = 0, alloc = 0;
+
+	while (getline(&buf, &size, fp) != -1) {
+		num++;
+		strip_comment(buf);
+		if (buf[strspn(buf, " ")] == '\0' || buf[0] == '%' ||
+				!strcmp(buf, "---"))
+			continue;
+		if (!strcmp(buf, "..."))
+			break;
+		if (buf[strspn(buf, " ")] == '\t') {
+			yfail(p, num);
+			break;
+		}
+
+		if (p->count == alloc) {
+			alloc = alloc ? alloc * 2 : 64;
+			lines = (struct yline *)realloc(p->lines, alloc * sizeof(*lines));
+			if (lines == NULL) {
+				error(errno, "Can't allocate memory");
+				p->failed = 1;
+				break;
+			}
+			p->lines = lines;
+		}
+
+		lines = &p->lines[p->count++];
+		lines->buf = buf;
+		lines->num = num;
+		lines->indent = strspn(buf, " ");
+		lines->text = buf + lines->indent;
+		buf = NULL;
+		size = 0;
+	}
+	free(buf);
+
+	return p->failed ? -1 : 0;
+}
+
+/* load document from path, *absent is set if there is no file */
+static struct ynode *yaml_load(const char *path, int *absent)
+{
+	struct yparser p;
+	struct ynode *doc = NULL;
+	FILE *fp;
+
+	*absent = 0;
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		if (errno == ENOENT) {
+			*absent = 1;
+			return NULL;
+		}
+		error(errno, "Can't open %s", path);
+		return NULL;
+	}
+
+	memset(&p, 0, sizeof(p));
+	p.path = path;
+	if (read_lines(&p, fp) == 0) {
+		if (p.count == 0)
+			*absent = 1;
+		else if (p.lines[0].indent != 0)
+			yfail(&p, p.lines[0].num);
+		else
+			doc = parse_block(&p, 0);
+	}
+	fclose(fp);
+
+	if (doc != NULL && p.pos < p.count) {
+		yfail(&p, p.lines[p.pos].num);
+		ynode_free(doc);
+		doc = NULL;
+	}
+	if (doc != NULL && doc->type != YAML_MAP) {
+		error(0, "%s: configuration is not a mapping", path);
+		ynode_free(doc);
+		doc = NULL;
+	}
+	free_lines(&p);
+
+	return doc;
+}
+
+/* character is not printable ASCII, PyYAML writes it escaped in double quotes */
+static int is_special(char c)
+{
+	return (unsigned char)c < ' ' || (unsigned char)c >= 0x7F;
+}
+
+/* string can't be written as plain scalar, checks of PyYAML emitter */
+static int needs_quotes(const char *s)
+{
+	size_t len = strlen(s);
+	const char *p;
+
+	if (len == 0 || resolve_tag(s) != YTAG_STR)
+		return 1;
+	if (s[0] == ' ' || s[len - 1] == ' ' || s[len - 1] == ':')
+		return 1;
+	if (strchr("#,[]{}&*!|>'\"%@`", s[0]))
+		return 1;
+	if (strchr("-?:", s[0]) && strchr(" \t", s[1]))
+		return 1;
+	if (!strncmp(s, "---", 3) || !strncmp(s, "...", 3))
+		return 1;
+	if (strstr(s, ": ") || strstr(s, ":\t") || strstr(s, " #"))
+		return 1;
+	for (p = s; *p; p++)
+		if (is_special(*p))
+			return 1;
+
+	return 0;
+}
+
+/* code point of UTF-8 sequence at s to c, return its length,
+   byte which does not start valid sequence is taken alone */
+static int get_utf8(const char *s, unsigned long *c)
+{
+	const unsigned char *u = (const unsigned char *)s;
+	int i, len;
+
+	if (u[0] >= 0xF0 && u[0] < 0xF8) {
+		len = 4;
+		*c = u[0] & 0x07;
+	} else if (u[0] >= 0xE0 && u[0] < 0xF0) {
+		len = 3;
+		*c = u[0] & 0x0F;
+	} else if (u[0] >= 0xC0 && u[0] < 0xE0) {
+		len = 2;
+		*c = u[0] & 0x1F;
+	} else {
+		*c = u[0];
+		return 1;
+	}
+
+	for (i = 1; i < len; i++) {
+		if ((u[i] & 0xC0) != 0x80) {
+			*c = u[0];
+			return 1;
+		}
+		*c = (*c << 6) | (u[i] & 0x3F);
+	}
+
+	return len;
+}
+
+/* special characters, quote and backslash are escaped in double quotes as
+   PyYAML escapes them, line breaks are escaped instead of being folded */
+static void emit_escaped(FILE *fp, const char *s)
+{
+	unsigned long c;
+	int i;
+
+	fputc('"', fp);
+	while (*s) {
+		if (!is_special(*s) && *s != '"' && *s != '\\') {
+			fputc(*s++, fp);
+			continue;
+		}
+
+		s += get_utf8(s, &c);
+		for (i = 0; escape_chars[i] != '\0' && escape_codes[i] != c; i++)
+			;
+		if (escape_chars[i] != '\0')
+			fprintf(fp, "\\%c", escape_chars[i]);
+		else if (c <= 0xFF)
+			fprintf(fp, "\\x%02lX", c);
+		else if (c <= 0xFFFF)
+			fprintf(fp, "\\u%04lX", c);
+		else
+			fprintf(fp, "\\U%08lX", c);
+	}
+	fputc('"', fp);
+}
+
+static void emit_string(FILE *fp, const char *s)
+{
+	const char *p;
+
+	if (!needs_quotes(s)) {
+		fputs(s, fp);
+		return;
+	}
+	for (p = s; *p; p++)
+		if (is_special(*p)) {
+			emit_escaped(fp, s);
+			return;
+		}
+
+	fputc('\'', fp);
+	for ( ; *s; s++) {
+		if (*s == '\'')
+			fputc('\'', fp);
+		fputc(*s, fp);
+	}
+	fputc('\'', fp);
+}
+
+/* integer in decimal form, sexagesimal one is written as is */
+static void emit_int(FILE *fp, const char *value)
+{
+	char digits[64], *w = digits, *end;
+	const char *p = value;
+	int base = 10, neg = 0;
+	long long v;
+
+	if (*p == '-' || *p == '+')
+		neg = (*p++ == '-');
+	if (strchr(p, ':') != NULL) {
+		fputs(value, fp);
+		return;
+	}
+	if (p[0] == '0' && (p[1] == 'x' || p[1] == 'b')) {
+		base = (p[1] == 'x') ? 16 : 2;
+		p += 2;
+	} else if (p[0] == '0' && p[1] != '\0') {
+		base = 8;
+	}
+
+	for ( ; *p && w < digits + sizeof(digits) - 1; p++)
+		if (*p != '_')
+			*w++ = *p;
+	*w = '\0';
+
+	errno = 0;
+	v = strtoll(digits, &end, base);
+	if (errno || *end != '\0')
+		fputs(value, fp);
+	else
+		fprintf(fp, "%lld", neg ? -v : v);
+}
+
+/* plain bool, null and integer are written as PyYAML dumps loaded values */
+static void emit_scalar(FILE *fp, const struct ynode *n)
+{
+	if (!n->quoted) {
+		switch (resolve_tag(n->value)) {
+		case YTAG_STR:
+			break;
+		case YTAG_BOOL:
+			fputs(is_false(n->value) ? "false" : "true", fp);
+			return;
+		case YTAG_NULL:
+			fputs("null", fp);
+			return;
+		case YTAG_INT:
+			emit_int(fp, n->value);
+			return;
+		default:
+			fputs(n->value, fp);
+			return;
+		}
+	}
+
+	emit_string(fp, n->value);
+}
+
+static int compare_keys(const void *a, const void *b)
+{
+	return strcmp((*(const struct ynode **)a)->key, (*(const struct ynode **)b)->key);
+}
+
+static int emit_map(FILE *fp, const struct ynode *map, int indent, int inline_first);
+
+static int emit_seq(FILE *fp, const struct ynode *seq, int indent, int inline_first);
+
+/* value after "key:" or "-" */
+static int emit_value(FILE *fp, const struct ynode *n, int indent, int in_seq)
+{
+	if (n->type == YAML_SCALAR) {
+		fputc(' ', fp);
+		emit_scalar(fp, n);
+		fputc('\n', fp);
+		return 0;
+	}
+	if (n->child == NULL) {
+		fputs(n->type == YAML_MAP ? " {}\n" : " []\n", fp);
+		return 0;
+	}
+
+	//collection in sequence starts on the line of its dash
+	if (in_seq) {
+		fputc(' ', fp);
+		return (n->type == YAML_MAP) ? emit_map(fp, n, indent + 2, 1) :
+			emit_seq(fp, n, indent + 2, 1);
+	}
+
+	//sequence is not indented under its key
+	fputc('\n', fp);
+	return (n->type == YAML_MAP) ? emit_map(fp, n, indent + 2, 0) :
+		emit_seq(fp, n, indent, 0);
+}
+
+/* block mapping with sorted keys */
+static int emit_map(FILE *fp, const struct ynode *map, int indent, int inline_first)
+{
+	const struct ynode **items, *it;
+	int i, count = 0, rc = 0;
+
+	for (it = map->child; it != NULL; it = it->next)
+		count++;
+	items = (const struct ynode **)malloc(count * sizeof(*items));
+	if (items == NULL) {
+		error(errno, "Can't allocate memory");
+		return -1;
+	}
+	for (it = map->child, i = 0; it != NULL; it = it->next)
+		items[i++] = it;
+	qsort(items, count, sizeof(*items), compare_keys);
+
+	for (i = 0; i < count && rc == 0; i++) {
+		if (i > 0 || !inline_first)
+			fprintf(fp, "%*s", indent, "");
+		emit_string(fp, items[i]->key);
+		fputc(':', fp);
+		rc = emit_value(fp, items[i], indent, 0);
+	}
+	free(items);
+
+	return rc;
+}
+
+static int emit_seq(FILE *fp, const struct ynode *seq, int indent, int inline_first)
+{
+	const struct ynode *it;
+	int rc = 0;
+
+	for (it = seq->child; it != NULL && rc == 0; it = it->next) {
+		if (it != seq->child || !inline_first)
+			fprintf(fp, "%*s", indent, "");
+		fputc('-', fp);
+		rc = emit_value(fp, it, indent, 1);
+	}
+
+	return rc;
+}
+
+/* write document to temporary file and rename it over path,
+   previous file is kept as .bkp */
+static int yaml_save(const char *path, const struct ynode *doc)
+{
+	char tmp[PATH_MAX + 8], bkp[PATH_MAX + 8];
+	struct stat st;
+	mode_t mode;
+	FILE *fp;
+	int fd, rc;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	snprintf(bkp, sizeof(bkp), "%s.bkp", path);
+
+	//netplan warns about configuration readable by others
+	mode = stat(path, &st) ? 0600 : (st.st_mode & 07777);
+	fd = open(tmp, O_WRONLY|O_CREAT|O_TRUNC, mode);
+	if (fd == -1 && errno == ENOENT && mkdir(NETPLAN_CFG_DIR, 0755) == 0)
+		fd = open(tmp, O_WRONLY|O_CREAT|O_TRUNC, mode);
+	if (fd == -1 || (fp = fdopen(fd, "w")) == NULL) {
+		error(errno, "Can't create %s", tmp);
+		if (fd != -1)
+			close(fd);
+		return -1;
+	}
+
+	if (doc->child == NULL)
+		rc = (fputs("{}\n", fp) == EOF) ? -1 : 0;
+	else
+		rc = emit_map(fp, doc, 0, 0);
+	if (fclose(fp))
+		rc = -1;
+
+	//target is replaced atomically, backup is its hard link
+	if (rc == 0 && !access(path, F_OK)) {
+		unlink(bkp);
+		if (link(path, bkp))
+			debug("Can't create %s: %s", bkp, strerror(errno));
+	}
+	if (rc == 0 && rename(tmp, path))
+		rc = -1;
+	if (rc) {
+		error(errno, "Can't write %s", path);
+		unlink(tmp);
+	}
+
+	return rc;
+}
+
+static void probe_info(void)
+{
+	const char *argv[] = {"netplan", "info", NULL};
+	char *out;
+
+	has_default_routes = 0;
+	out = (char *)malloc(NETPLAN_INFO_SIZE);
+	if (out == NULL)
+		return;
+
+	if (run_cmdv_output(argv, out, NETPLAN_INFO_SIZE) == 0 &&
+			strstr(out, "default-routes") != NULL)
+		has_default_routes = 1;
+	free(out);
+}
+
+/* netplan supports "to: default" routes, it is checked once per run */
+static int default_routes_supported(void)
+{
+	pthread_once(&info_once, probe_info);
+
+	return has_default_routes;
+}
+
+static void config_path(const char *dev, char *path, size_t size)
+{
+	snprintf(path, size, NETPLAN_CFG_DIR "/" NETPLAN_CFG_PREFIX "%s.yaml", dev);
+}
+
+/* settings of device in document, they are created if absent */
+static struct ynode *config_device(struct ynode *doc, const char *dev)
+{
+	struct ynode *n;
+
+	n = ymap_obtain(doc, "network", YAML_MAP);
+	if (n != NULL)
+		n = ymap_obtain(n, "ethernets", YAML_MAP);
+	if (n != NULL)
+		n = ymap_obtain(n, dev, YAML_MAP);
+
+	return n;
+}
+
+/* {network: {version: 2, ethernets: {dev: {}}}} */
+static struct ynode *config_skeleton(const char *dev)
+{
+	struct ynode *doc, *network;
+
+	doc = ynode_new(YAML_MAP, NULL);
+	if (doc == NULL)
+		return NULL;
+
+	network = ymap_obtain(doc, "network", YAML_MAP);
+	if (network == NULL || ymap_set_scalar(network, "version", "2", 0) ||
+			config_device(doc, dev) == NULL) {
+		ynode_free(doc);
+		return NULL;
+	}
+
+	return doc;
+}
+
+/* configuration of device, skeleton if there is none */
+static struct ynode *config_load(const char *dev)
+{
+	char path[PATH_MAX];
+	struct ynode *doc;
+	int absent;
+
+	config_path(dev, path, sizeof(path));
+	doc = yaml_load(path, &absent);
+	if (doc == NULL && absent)
+		doc = config_skeleton(dev);
+
+	return doc;
+}
+
+static struct staged_config *stage_find(const char *dev)
+{
+	struct staged_config *s;
+
+	for (s = staged; s != NULL; s = s->next)
+		if (!strcmp(s->dev, dev))
+			return s;
+
+	return NULL;
+}
+
+/* replace configuration of device by doc, doc is freed on error
+   staged_lock is held by caller */
+static int stage_put(const char *dev, struct ynode *doc)
+{
+	struct staged_config *s = stage_find(dev);
+
+	if (s == NULL) {
+		s = (struct staged_config *)calloc(1, sizeof(*s));
+		if (s == NULL) {
+			error(errno, "Can't allocate memory");
+			ynode_free(doc);
+			return -1;
+		}
+		snprintf(s->dev, sizeof(s->dev), "%s", dev);
+		s->next = staged;
+		staged = s;
+	}
+
+	ynode_free(s->doc);
+	s->doc = doc;
+
+	return 0;
+}
+
+/* configuration of device to be changed in place, it is loaded once
+   staged_lock is held by caller */
+static struct ynode *stage_get(const char *dev)
+{
+	struct staged_config *s = stage_find(dev);
+	struct ynode *doc;
+
+	if (s != NULL)
+		return s->doc;
+
+	doc = config_load(dev);
+	if (doc == NULL || stage_put(dev, doc))
+		return NULL;
+
+	return doc;
+}
+
+/* value removes addresses or routes of family */
+static int is_remove(const char *value)
+{
+	return !strcmp(value, "remove") || !strcmp(value, "remove6");
+}
+
+/* IP[/MASK] as netplan accepts it: with prefix length */
+static void format_address(const char *ip, char *buf, size_t size)
+{
+	const char *mask = strchr(ip, '/');
+	int v4 = (strchr(ip, '.') != NULL), bits = 0;
+	char *end;
+
+	if (mask == NULL) {
+		snprintf(buf, size, "%s/%s", ip, v4 ? "32" : "64");
+		return;
+	}
+	if (!v4 || strchr(mask, '.') == NULL) {
+		snprintf(buf, size, "%s", ip);
+		return;
+	}
+
+	for (mask++; *mask; mask = (*end == '.') ? end + 1 : end) {
+		bits += __builtin_popcountl(strtoul(mask, &end, 10));
+		if (end == mask)
+			break;
+	}
+	snprintf(buf, size, "%.*s/%d", (int)(strchr(ip, '/') - ip), ip, bits);
+}
+
+int netplan_set_ip(struct netinfo *if_it, const char *value, const char *opts, int live)
+{
+	struct namelist *ips = NULL, *words = NULL, *it;
+	struct ynode *doc, *dev, *addrs = NULL, *n;
+	char buf[NAME_LENGTH];
+	int rc = -1;
+
+	//configuration is generated by netplan_restart()
+	VARUNUSED(live);
+
+	//old configuration is flushed, value has all addresses
+	doc = config_skeleton(if_it->name);
+	if (doc == NULL)
+		return -1;
+	dev = config_device(doc, if_it->name);
+
+	namelist_split(&ips, value);
+	for (it = ips; it != NULL; it = it->next) {
+		if (is_remove(it->name))
+			continue;
+		if (addrs == NULL && (addrs = ymap_obtain(dev, "addresses", YAML_SEQ)) == NULL)
+			goto out;
+
+		format_address(it->name, buf, sizeof(buf));
+		n = yscalar_new(NULL, buf, 1);
+		if (n == NULL)
+			goto out;
+		ynode_add(addrs, n);
+	}
+
+	namelist_split(&words, opts);
+	if (ymap_set_scalar(dev, "dhcp4", namelist_search("dhcp", &words) ? "true" : "false", 0) ||
+			ymap_set_scalar(dev, "dhcp6",
+				namelist_search("dhcpv6", &words) ? "true" : "false", 0))
+		goto out;
+
+	pthread_mutex_lock(&staged_lock);
+	rc = stage_put(if_it->name, doc);
+	pthread_mutex_unlock(&staged_lock);
+	doc = NULL;
+out:
+	ynode_free(doc);
+	namelist_clean(&ips);
+	namelist_clean(&words);
+
+	return rc;
+}
+
+/* route {to, via[, metric][, scope][, on-link]}, NULL values are skipped */
+static struct ynode *route_new(const char *to, const char *via, const char *metric,
+		const char *scope, const char *on_link)
+{
+	struct ynode *route = ynode_new(YAML_MAP, NULL);
+
+	if (route == NULL)
+		return NULL;
+	if (ymap_set_scalar(route, "to", to, 1) || ymap_set_scalar(route, "via", via, 1) ||
+			(metric != NULL && ymap_set_scalar(route, "metric", metric, 0)) ||
+			(scope != NULL && ymap_set_scalar(route, "scope", scope, 1)) ||
+			(on_link != NULL && ymap_set_scalar(route, "on-link", on_link, 1))) {
+		ynode_free(route);
+		return NULL;
+	}
+
+	return route;
+}
+
+/* append route to sequence unless equal one is there already */
+static int add_route_once(struct ynode *routes, struct ynode *route)
+{
+	struct ynode *it;
+	char *key, *other;
+	int found = 0;
+
+	if (route == NULL)
+		return -1;
+	key = ymap_key(route);
+	if (key == NULL) {
+		ynode_free(route);
+		return -1;
+	}
+
+	for (it = routes->child; it != NULL && !found; it = it->next) {
+		other = ymap_key(it);
+		found = (other != NULL && !strcmp(key, other));
+		free(other);
+	}
+	free(key);
+
+	if (found)
+		ynode_free(route);
+	else
+		ynode_add(routes, route);
+
+	return 0;
+}
+
+int netplan_set_gateway(struct netinfo *if_it, const char *value, int live)
+{
+	struct namelist *gws = NULL, *it;
+	struct ynode *doc, *dev, *routes;
+	int rc = -1, default_routes = 0;
+
+	VARUNUSED(live);
+
+	namelist_split(&gws, value);
+	for (it = gws; it != NULL; it = it->next)
+		if (strstr(it->name, "remove") == NULL) {
+			default_routes = default_routes_supported();
+			break;
+		}
+
+	pthread_mutex_lock(&staged_lock);
+	doc = stage_get(if_it->name);
+	dev = doc ? config_device(doc, if_it->name) : NULL;
+	if (dev == NULL)
+		goto out;
+
+	//routes are removed only if there is gateway to set besides "remove*"
+	if (it != NULL)
+		ymap_del(dev, "routes");
+
+	for (it = gws; it != NULL; it = it->next) {
+		if (strstr(it->name, "remove") != NULL)
+			continue;
+
+		routes = ymap_obtain(dev, "routes", YAML_SEQ);
+		if (routes == NULL)
+			goto out;
+
+		if (default_routes) {
+			if (add_route_once(routes, route_new("default", it->name, NULL, NULL, "true")))
+				goto out;
+		} else if (ymap_set_scalar(dev, strchr(it->name, ':') ? "gateway6" : "gateway4",
+					it->name, 1)) {
+			goto out;
+		}
+
+		//on-link route to host-routed gateway
+		if (!strcmp(it->name, HOST_ROUTED_GW) && add_route_once(routes,
+					route_new(HOST_ROUTED_GW, "0.0.0.0", NULL, "link", NULL)))
+			goto out;
+	}
+	rc = 0;
+out:
+	pthread_mutex_unlock(&staged_lock);
+	namelist_clean(&gws);
+
+	return rc;
+}
+
+/* "to" of route belongs to family of remove or remove6 */
+static int route_of_family(const struct ynode *route, int family6)
+{
+	const struct ynode *to = ymap_get((struct ynode *)route, "to");
+
+	if (to == NULL || to->type != YAML_SCALAR)
+		return 0;
+
+	return strchr(to->value, family6 ? ':' : '.') != NULL;
+}
+
+static void remove_routes(struct ynode *routes, int family6)
+{
+	struct ynode *it, *prev = NULL, *next;
+
+	for (it = routes->child; it != NULL; it = next) {
+		next = it->next;
+		if (!route_of_family(it, family6)) {
+			prev = it;
+			continue;
+		}
+		if (prev != NULL)
+			prev->next = next;
+		else
+			routes->child = next;
+		if (routes->last == it)
+			routes->last = prev;
+		it->next = NULL;
+		ynode_free(it);
+	}
+}
+
+static int index_routes(struct keyset *set, const struct ynode *routes)
+{
+	const struct ynode *it;
+	char *key;
+
+	keyset_clean(set);
+	for (it = routes->child; it != NULL; it = it->next) {
+		key = ymap_key(it);
+		if (key == NULL || keyset_add(set, key))
+			return -1;
+	}
+
+	return 0;
+}
+
+/* metric of route of "X.X.X.X/Z=X.X.X.Ym100" format, 0 if it is not set */
+static int route_metric(const char *value, long *metric)
+{
+	const char *m = strchr(value, 'm');
+	char *end;
+
+	*metric = 0;
+	if (m == NULL || strchr(m + 1, 'm') != NULL)
+		return 0;
+
+	*metric = strtol(m + 1, &end, 10);
+	if (end == m + 1 || *end != '\0') {
+		error(0, "Invalid metric of route %s", value);
+		return -1;
+	}
+
+	return 0;
+}
+
+static struct ynode *route_from_value(const char *value)
+{
+	char buf[NAME_LENGTH], metric[32], *p, *via = "0.0.0.0";
+	const char *scope = NULL;
+	long m;
+
+	if (route_metric(value, &m))
+		return NULL;
+	snprintf(metric, sizeof(metric), "%ld", m);
+
+	snprintf(buf, sizeof(buf), "%s", value);
+	p = strchr(buf, 'm');
+	if (p != NULL)
+		*p = '\0';
+	p = strchr(buf, '=');
+	if (p != NULL) {
+		*p++ = '\0';
+		if (strchr(p, '=') == NULL)
+			via = p;
+	}
+
+	if (!strcmp(buf, HOST_ROUTED_GW))
+		scope = "link";
+
+	return route_new(buf, via, m ? metric : NULL, scope, NULL);
+}
+
+int netplan_set_route(struct netinfo *if_it, const char *value, int live)
+{
+	struct namelist *list = NULL, *it;
+	struct keyset seen = {NULL, 0, 0};
+	struct ynode *doc, *dev, *routes, *route;
+	char *key;
+	long metric;
+	int rc = -1;
+
+	VARUNUSED(live);
+
+	//staged configuration is not changed by invalid request
+	namelist_split(&list, value);
+	for (it = list; it != NULL; it = it->next)
+		if (!is_remove(it->name) && route_metric(it->name, &metric)) {
+			namelist_clean(&list);
+			return -1;
+		}
+
+	pthread_mutex_lock(&staged_lock);
+	doc = stage_get(if_it->name);
+	dev = doc ? config_device(doc, if_it->name) : NULL;
+	routes = dev ? ymap_obtain(dev, "routes", YAML_SEQ) : NULL;
+	if (routes == NULL || index_routes(&seen, routes))
+		goto out;
+
+	for (it = list; it != NULL; it = it->next) {
+		if (is_remove(it->name)) {
+			remove_routes(routes, !strcmp(it->name, "remove6"));
+			if (index_routes(&seen, routes))
+				goto out;
+			continue;
+		}
+
+		route = route_from_value(it->name);
+		key = route ? ymap_key(route) : NULL;
+		if (key == NULL) {
+			ynode_free(route);
+			goto out;
+		}
+		if (keyset_has(&seen, key)) {
+			free(key);
+			ynode_free(route);
+			continue;
+		}
+		if (keyset_add(&seen, key)) {
+			ynode_free(route);
+			goto out;
+		}
+		ynode_add(routes, route);
+	}
+	rc = 0;
+out:
+	pthread_mutex_unlock(&staged_lock);
+	keyset_clean(&seen);
+	namelist_clean(&list);
+
+	return rc;
+}
+
+int netplan_set_dhcp(struct netinfo *if_it, const char *proto)
+{
+	struct ynode *doc, *dev;
+	int rc;
+
+	//configuration is replaced by DHCP as debian-set_dhcp.sh did
+	doc = config_skeleton(if_it->name);
+	if (doc == NULL)
+		return -1;
+	dev = config_device(doc, if_it->name);
+
+	if ((strchr(proto, '4') && ymap_set_scalar(dev, "dhcp4", "yes", 1)) ||
+			(strchr(proto, '6') && ymap_set_scalar(dev, "dhcp6", "yes", 1))) {
+		ynode_free(doc);
+		return -1;
+	}
+
+	pthread_mutex_lock(&staged_lock);
+	rc = stage_put(if_it->name, doc);
+	pthread_mutex_unlock(&staged_lock);
+
+	return rc;
+}
+
+int netplan_get_dhcp(struct netinfo *if_it, int proto)
+{
+	struct staged_config *s;
+	struct ynode *doc, *n;
+	int rc = 2;
+
+	pthread_mutex_lock(&staged_lock);
+	s = stage_find(if_it->name);
+	doc = s ? s->doc : config_load(if_it->name);
+	if (doc != NULL) {
+		n = ymap_get(ymap_get(ymap_get(doc, "network"), "ethernets"), if_it->name);
+		n = ymap_get(n, proto == 6 ? "dhcp6" : "dhcp4");
+		if (n != NULL)
+			rc = ynode_true(n) ? 0 : 1;
+		if (s == NULL)
+			ynode_free(doc);
+	}
+	pthread_mutex_unlock(&staged_lock);
+
+	return rc;
+}
+
+int netplan_commit(void)
+{
+	struct staged_config *s;
+	char path[PATH_MAX];
+	int rc = 0;
+
+	pthread_mutex_lock(&staged_lock);
+	while ((s = staged) != NULL) {
+		staged = s->next;
+		config_path(s->dev, path, sizeof(path));
+		if (yaml_save(path, s->doc))
+			rc = -1;
+		ynode_free(s->doc);
+		free(s);
+	}
+	pthread_mutex_unlock(&staged_lock);
+
+	return rc;
+}
+
+/* device is rendered by systemd-networkd, it may be reconfigured alone */
+static int is_networkd(const char *dev)
+{
+	struct ynode *doc, *renderer;
+	int networkd;
+
+	doc = config_load(dev);
+	if (doc == NULL)
+		return 0;
+	renderer = ymap_get(ymap_get(doc, "network"), "renderer");
+	networkd = (renderer == NULL ||
+		(renderer->type == YAML_SCALAR && !strcmp(renderer->value, "networkd")));
+	ynode_free(doc);
+
+	return networkd;
+}
+
+/* apply configuration of devices with systemd-networkd,
+   other devices keep their traffic */
+static int reconfigure(const char *const devs[], int count)
+{
+	const char *generate[] = {"netplan", "generate", NULL};
+	const char **argv;
+	int i, rc;
+
+	argv = (const char **)malloc((count + 3) * sizeof(char *));
+	if (argv == NULL) {
+		error(errno, "Can't allocate memory for arguments");
+		return -1;
+	}
+	argv[0] = "networkctl";
+	argv[1] = "reconfigure";
+	for (i = 0; i < count; i++)
+		argv[i + 2] = devs[i];
+	argv[count + 2] = NULL;
+
+	rc = run_cmdv(generate);
+	if (rc == 0)
+		rc = run_cmdv(argv);
+	free(argv);
+
+	return rc ? -1 : 0;
+}
+
+int netplan_restart(const char *const devs[])
+{
+	const char *argv[] = {"netplan", "apply", NULL};
+	int count = 0;
+
+	while (devs != NULL && devs[count] != NULL && is_networkd(devs[count]))
+		count++;
+	if (count > 0 && devs[count] == NULL && reconfigure(devs, count) == 0)
+		return 0;
+
+	return run_cmdv(argv);
+}
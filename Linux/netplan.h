@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2019 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * native editor of netplan configuration of devices /etc/netplan/90-vz-<dev>.yaml
+ */
+
+#ifndef __NETPLAN_H__
+#define __NETPLAN_H__
+
+#include "../netinfo.h"
+
+#ifndef NETPLAN_CFG_DIR
+#define NETPLAN_CFG_DIR		"/etc/netplan"
+#endif
+#define NETPLAN_CFG_PREFIX	"90-vz-"
+
+/* actions of netplan-cfg.py, all actions of request change configuration
+   of device loaded once in memory, it is written by netplan_commit()
+   return 0 on success */
+int netplan_set_ip(struct netinfo *if_it, const char *value, const char *opts, int live);
+
+int netplan_set_gateway(struct netinfo *if_it, const char *value, int live);
+
+int netplan_set_route(struct netinfo *if_it, const char *value, int live);
+
+/* proto contains 4 and/or 6 */
+int netplan_set_dhcp(struct netinfo *if_it, const char *proto);
+
+/* return 0 - DHCP of proto 4 or 6 is enabled, 1 - disabled, 2 - not set */
+int netplan_get_dhcp(struct netinfo *if_it, int proto);
+
+/* write configuration changed by actions, each file once */
+int netplan_commit(void);
+
+/* generate configuration once and reconfigure devices of NULL-terminated
+   list with systemd-networkd if it renders all of them, otherwise apply
+   whole configuration once, devs is NULL for whole network */
+int netplan_restart(const char *const devs[]);
+
+#endif
@@ -0,0 +1,1201 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2019 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * native backend of NetworkManager: settings of profile prl_nettool-nm-<dev>
+ * are built in memory by operations of request and sent with one call,
+ * settings of active profile are reapplied without restart of device
+ */
+
+#include "../common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+#include "../namelist.h"
+#include "dbus.h"
+#include "exec.h"
+#include "nm.h"
+
+#define NM_SERVICE		"org.freedesktop.NetworkManager"
+#define NM_PATH			"/org/freedesktop/NetworkManager"
+#define NM_SETTINGS_PATH	NM_PATH "/Settings"
+#define NM_SETTINGS		NM_SERVICE ".Settings"
+#define NM_CONNECTION		NM_SETTINGS ".Connection"
+#define NM_DEVICE		NM_SERVICE ".Device"
+#define NM_ACTIVE		NM_SERVICE ".Connection.Active"
+#define DBUS_SERVICE		"org.freedesktop.DBus"
+#define DBUS_PROPERTIES		DBUS_SERVICE ".Properties"
+#define DBUS_UNKNOWN_METHOD	DBUS_SERVICE ".Error.UnknownMethod"
+
+/* flag of Update2 and AddConnection2 */
+#define NM_TO_DISK		0x1
+/* flag of Reload */
+#define NM_RELOAD_CONF		0x1
+
+/* states of active connection */
+#define NM_ACTIVATED		2
+#define NM_DEACTIVATING		3
+
+/* s to wait for NetworkManager on bus as nm-online -t 30 did */
+#define NM_START_WAIT		30
+/* s to wait for activation as nmcli c up does */
+#define NM_ACTIVATE_WAIT	90
+#define NM_POLL_US		100000
+
+#define UUID_FILE		"/proc/sys/kernel/random/uuid"
+
+/* change of key of group of settings, it is applied again to settings
+   read at commit, so changes done by other tools meanwhile are kept */
+struct nm_edit
+{
+	char group[32];
+	char key[32];
+	struct dbus_value *value;	/* NULL deletes key */
+	struct nm_edit *next;
+};
+
+/* profile of device changed by operations, it is sent by nm_commit() */
+struct nm_profile
+{
+	char dev[NAME_LENGTH];
+	char mac[MAC_LENGTH + 1];
+	struct dbus_value *settings;	/* a{sa{sv}} with edits applied */
+	struct nm_edit *edits;
+	int activate;	/* some operation was not done live */
+	char active[PATH_MAX];	/* active connection to wait for */
+	struct nm_profile *next;
+};
+
+static struct nm_profile *staged;
+
+/* connection to bus is opened once for all requests */
+static struct dbus_conn *bus;
+static pid_t bus_pid;
+static char nm_error[512];
+
+/* protects bus, staged profiles and nm_error */
+static pthread_mutex_t nm_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* return 1 if NetworkManager is on bus, 0 if it is not, -1 on error */
+static int has_owner(void)
+{
+	struct dbus_value *reply;
+	int rc;
+
+	rc = dbus_call(bus, DBUS_SERVICE, "/org/freedesktop/DBus", DBUS_SERVICE,
+			"NameHasOwner", dbus_new_string('s', NM_SERVICE), &reply);
+	if (rc)
+		return -1;
+	rc = (reply != NULL && *reply->sig == 'b' && reply->v.u);
+	dbus_free(reply);
+
+	return rc;
+}
+
+/* connection to bus, NetworkManager may be started yet
+   nm_lock is held by caller */
+static struct dbus_conn *get_bus(void)
+{
+	int i, rc;
+
+	//connection is not shared with process forked by --fast
+	if (bus != NULL && bus_pid != getpid()) {
+		dbus_disconnect(bus);
+		bus = NULL;
+	}
+	if (bus != NULL)
+		return bus;
+
+	bus = dbus_connect();
+	if (bus == NULL)
+		return NULL;
+	bus_pid = getpid();
+
+	for (i = 0; (rc = has_owner()) == 0; i++) {
+		if (i == NM_START_WAIT) {
+			error(0, "NetworkManager did not start in %d seconds", NM_START_WAIT);
+			break;
+		}
+		sleep(1);
+	}
+	if (rc < 0) {
+		dbus_disconnect(bus);
+		bus = NULL;
+	}
+
+	return bus;
+}
+
+/* call method of NetworkManager with argc arguments, they are freed,
+   NULL argument is failure of its allocation
+   nm_lock is held by caller
+return 0 on success, 1 - error reply in nm_error, -1 - failure */
+static int nm_call(const char *path, const char *iface, const char *member,
+		struct dbus_value **reply, int argc, ...)
+{
+	struct dbus_value *args = NULL, **tail = &args, *arg;
+	int i, failed = 0, rc;
+	va_list ap;
+
+	if (reply != NULL)
+		*reply = NULL;
+
+	va_start(ap, argc);
+	for (i = 0; i < argc; i++) {
+		arg = va_arg(ap, struct dbus_value *);
+		if (arg == NULL) {
+			failed = 1;
+			continue;
+		}
+		*tail = arg;
+		tail = &arg->next;
+	}
+	va_end(ap);
+
+	snprintf(nm_error, sizeof(nm_error), "no connection to D-Bus");
+	if (failed) {
+		snprintf(nm_error, sizeof(nm_error), "can't allocate memory");
+		dbus_free(args);
+		return -1;
+	}
+	if (get_bus() == NULL) {
+		dbus_free(args);
+		return -1;
+	}
+
+	rc = dbus_call(bus, NM_SERVICE, path, iface, member, args, reply);
+	if (rc > 0)
+		snprintf(nm_error, sizeof(nm_error), "%s", dbus_error(bus));
+	if (rc < 0) {
+		dbus_disconnect(bus);
+		bus = NULL;
+	}
+
+	return rc;
+}
+
+static int nm_failure(const char *what, const char *dev)
+{
+	error(0, "NetworkManager failed to %s %s: %s", what, dev, nm_error);
+	return -1;
+}
+
+static int is_unknown_method(void)
+{
+	return !strncmp(nm_error, DBUS_UNKNOWN_METHOD, strlen(DBUS_UNKNOWN_METHOD));
+}
+
+/* value of property of type of sig, reply is freed by caller */
+static int get_property(const char *path, const char *iface, const char *name,
+		char type, struct dbus_value **reply)
+{
+	int rc;
+
+	rc = nm_call(path, DBUS_PROPERTIES, "Get", reply, 2,
+			dbus_new_string('s', iface), dbus_new_string('s', name));
+	if (rc == 0 && (*reply == NULL || *(*reply)->sig != 'v' ||
+				*(*reply)->child->sig != type)) {
+		snprintf(nm_error, sizeof(nm_error), "invalid property %s", name);
+		dbus_free(*reply);
+		*reply = NULL;
+		rc = 1;
+	}
+
+	return rc;
+}
+
+static int get_path_property(const char *path, const char *iface, const char *name,
+		char *buf, size_t size)
+{
+	struct dbus_value *reply;
+	int rc;
+
+	rc = get_property(path, iface, name, 'o', &reply);
+	if (rc == 0)
+		snprintf(buf, size, "%s", reply->child->v.s);
+	dbus_free(reply);
+
+	return rc;
+}
+
+static int device_path(const char *dev, char *path, size_t size)
+{
+	struct dbus_value *reply;
+	int rc;
+
+	rc = nm_call(NM_PATH, NM_SERVICE, "GetDeviceByIpIface", &reply, 1,
+			dbus_new_string('s', dev));
+	if (rc == 0 && (reply == NULL || *reply->sig != 'o')) {
+		snprintf(nm_error, sizeof(nm_error), "invalid reply");
+		rc = 1;
+	}
+	if (rc == 0)
+		snprintf(path, size, "%s", reply->v.s);
+	dbus_free(reply);
+
+	return rc;
+}
+
+/* settings of group, it is created if create is set */
+static struct dbus_value *settings_group(struct dbus_value *settings, const char *name,
+		int create)
+{
+	struct dbus_value *group = dbus_dict_get(settings, name);
+
+	if (group != NULL || !create)
+		return group;
+	if (dbus_dict_set(settings, name, dbus_new("a{sv}")))
+		return NULL;
+
+	return dbus_dict_get(settings, name);
+}
+
+/* set key of group to value, NULL value deletes it */
+static int settings_set(struct dbus_value *settings, const char *group, const char *key,
+		struct dbus_value *value)
+{
+	struct dbus_value *g = settings_group(settings, group, value != NULL);
+
+	if (value == NULL) {
+		dbus_dict_del(g, key);
+		return 0;
+	}
+	if (g == NULL) {
+		dbus_free(value);
+		return -1;
+	}
+
+	return dbus_dict_set(g, key, value);
+}
+
+static const char *settings_string(struct dbus_value *settings, const char *group,
+		const char *key)
+{
+	const char *s = dbus_dict_string(settings_group(settings, group, 0), key);
+
+	return s ? s : "";
+}
+
+static int get_settings(const char *path, struct dbus_value **settings)
+{
+	int rc;
+
+	rc = nm_call(path, NM_CONNECTION, "GetSettings", settings, 0);
+	if (rc == 0 && (*settings == NULL || strcmp((*settings)->sig, "a{sa{sv}}"))) {
+		snprintf(nm_error, sizeof(nm_error), "invalid settings of %s", path);
+		dbus_free(*settings);
+		*settings = NULL;
+		rc = 1;
+	}
+
+	return rc;
+}
+
+/* profile of device by its id, its object path is copied to path
+return 0 - found, 1 - there is none, -1 - error */
+static int find_profile(const char *dev, char *path, size_t size,
+		struct dbus_value **settings)
+{
+	struct dbus_value *list, *it, *conf;
+	char id[NAME_LENGTH + sizeof(NM_PROFILE_PREFIX)];
+	int rc;
+
+	snprintf(id, sizeof(id), NM_PROFILE_PREFIX "%s", dev);
+	if (nm_call(NM_SETTINGS_PATH, NM_SETTINGS, "ListConnections", &list, 0))
+		return nm_failure("list profiles for", dev);
+
+	rc = 1;
+	for (it = (list && !strcmp(list->sig, "ao")) ? list->child : NULL;
+			it != NULL && rc == 1; it = it->next) {
+		//profile may be deleted meanwhile
+		switch (get_settings(it->v.s, &conf)) {
+		case 0:
+			break;
+		case 1:
+			continue;
+		default:
+			rc = nm_failure("read profiles for", dev);
+			continue;
+		}
+
+		if (!strcmp(settings_string(conf, "connection", "id"), id)) {
+			snprintf(path, size, "%s", it->v.s);
+			*settings = conf;
+			rc = 0;
+		} else {
+			dbus_free(conf);
+		}
+	}
+	dbus_free(list);
+
+	return rc;
+}
+
+/* profile is bound to MAC of device */
+static int same_mac(struct dbus_value *settings, const char *mac)
+{
+	struct dbus_value *addr, *b;
+	char buf[MAC_LENGTH + 1] = "";
+	size_t len = 0;
+
+	addr = dbus_dict_get(settings_group(settings, "802-3-ethernet", 0), "mac-address");
+	if (addr == NULL || strcmp(addr->sig, "ay"))
+		return 0;
+
+	for (b = addr->child; b != NULL && len + 3 <= sizeof(buf); b = b->next)
+		len += snprintf(buf + len, sizeof(buf) - len, "%s%02X",
+				len ? ":" : "", (unsigned int)b->v.u);
+
+	return !strcasecmp(buf, mac);
+}
+
+static struct dbus_value *mac_bytes(const char *mac)
+{
+	struct dbus_value *bytes = dbus_new("ay");
+	unsigned int b[6];
+	int i;
+
+	if (sscanf(mac, "%x:%x:%x:%x:%x:%x", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) != 6) {
+		dbus_free(bytes);
+		return NULL;
+	}
+	for (i = 0; i < 6; i++)
+		if (dbus_add(bytes, dbus_new_uint('y', b[i] & 0xff)))
+			return NULL;
+
+	return bytes;
+}
+
+static int new_uuid(char *uuid, size_t size)
+{
+	FILE *fp;
+	int rc = -1;
+
+	fp = fopen(UUID_FILE, "r");
+	if (fp == NULL) {
+		error(errno, "Can't open %s", UUID_FILE);
+		return -1;
+	}
+	if (fgets(uuid, size, fp) != NULL) {
+		uuid[strcspn(uuid, "\n")] = '\0';
+		rc = 0;
+	}
+	fclose(fp);
+
+	return rc;
+}
+
+/* settings of new profile as nm_check_and_create created it */
+static struct dbus_value *profile_new(const char *dev, const char *mac)
+{
+	struct dbus_value *settings;
+	char id[NAME_LENGTH + sizeof(NM_PROFILE_PREFIX)], uuid[64], client_id[MAC_LENGTH + 3];
+
+	if (new_uuid(uuid, sizeof(uuid)))
+		return NULL;
+	snprintf(id, sizeof(id), NM_PROFILE_PREFIX "%s", dev);
+	//same DHCP client id for different configurations of device
+	snprintf(client_id, sizeof(client_id), "1:%s", mac);
+
+	settings = dbus_new("a{sa{sv}}");
+	if (settings == NULL ||
+			settings_set(settings, "connection", "id", dbus_new_string('s', id)) ||
+			settings_set(settings, "connection", "uuid", dbus_new_string('s', uuid)) ||
+			settings_set(settings, "connection", "type",
+				dbus_new_string('s', "802-3-ethernet")) ||
+			settings_set(settings, "connection", "interface-name",
+				dbus_new_string('s', dev)) ||
+			settings_set(settings, "802-3-ethernet", "mac-address", mac_bytes(mac)) ||
+			settings_set(settings, "ipv4", "method", dbus_new_string('s', "auto")) ||
+			settings_set(settings, "ipv4", "dhcp-client-id",
+				dbus_new_string('s', client_id)) ||
+			settings_set(settings, "ipv4", "may-fail", dbus_new_uint('b', 0)) ||
+			settings_set(settings, "ipv6", "method", dbus_new_string('s', "auto"))) {
+		error(0, "Can't create settings of profile %s", id);
+		dbus_free(settings);
+		return NULL;
+	}
+
+	return settings;
+}
+
+static void profile_free(struct nm_profile *p)
+{
+	struct nm_edit *e;
+
+	while ((e = p->edits) != NULL) {
+		p->edits = e->next;
+		dbus_free(e->value);
+		free(e);
+	}
+	dbus_free(p->settings);
+	free(p);
+}
+
+static struct nm_profile *stage_find(const char *dev)
+{
+	struct nm_profile *p;
+
+	for (p = staged; p != NULL; p = p->next)
+		if (!strcmp(p->dev, dev))
+			return p;
+
+	return NULL;
+}
+
+/* profile of device to be changed, settings are read once,
+   profile of other MAC is replaced by new one
+   nm_lock is held by caller */
+static struct nm_profile *stage_get(struct netinfo *if_it)
+{
+	struct nm_profile *p = stage_find(if_it->name);
+	struct dbus_value *settings = NULL;
+	char path[PATH_MAX];
+	int rc;
+
+	if (p != NULL)
+		return p;
+
+	rc = find_profile(if_it->name, path, sizeof(path), &settings);
+	if (rc < 0)
+		return NULL;
+	if (rc == 0 && !same_mac(settings, if_it->mac)) {
+		dbus_free(settings);
+		rc = 1;
+	}
+	if (rc == 1 && (settings = profile_new(if_it->name, if_it->mac)) == NULL)
+		return NULL;
+
+	p = (struct nm_profile *)calloc(1, sizeof(*p));
+	if (p == NULL) {
+		error(errno, "Can't allocate memory");
+		dbus_free(settings);
+		return NULL;
+	}
+	snprintf(p->dev, sizeof(p->dev), "%s", if_it->name);
+	snprintf(p->mac, sizeof(p->mac), "%s", if_it->mac);
+	p->settings = settings;
+	p->next = staged;
+	staged = p;
+
+	return p;
+}
+
+static int apply_edit(struct dbus_value *settings, const struct nm_edit *e)
+{
+	struct dbus_value *value = NULL;
+
+	if (e->value != NULL && (value = dbus_copy(e->value)) == NULL)
+		return -1;
+
+	return settings_set(settings, e->group, e->key, value);
+}
+
+/* record change of key and apply it to staged settings,
+   value is freed, NULL value deletes key */
+static int stage_edit(struct nm_profile *p, const char *group, const char *key,
+		struct dbus_value *value)
+{
+	struct nm_edit *e, **tail;
+
+	for (tail = &p->edits; (e = *tail) != NULL; tail = &e->next)
+		if (!strcmp(e->group, group) && !strcmp(e->key, key))
+			break;
+
+	if (e == NULL) {
+		e = (struct nm_edit *)calloc(1, sizeof(*e));
+		if (e == NULL) {
+			dbus_free(value);
+			return -1;
+		}
+		snprintf(e->group, sizeof(e->group), "%s", group);
+		snprintf(e->key, sizeof(e->key), "%s", key);
+		*tail = e;
+	}
+	dbus_free(e->value);
+	e->value = value;
+
+	return apply_edit(p->settings, e);
+}
+
+static int stage_set(struct nm_profile *p, const char *group, const char *key,
+		struct dbus_value *value)
+{
+	if (value == NULL)
+		return -1;
+
+	return stage_edit(p, group, key, value);
+}
+
+static int stage_string(struct nm_profile *p, const char *group, const char *key,
+		const char *value)
+{
+	return stage_set(p, group, key, dbus_new_string('s', value));
+}
+
+static int stage_del(struct nm_profile *p, const char *group, const char *key)
+{
+	return stage_edit(p, group, key, NULL);
+}
+
+/* value removes addresses or routes of family */
+static int is_remove(const char *value)
+{
+	return !strcmp(value, "remove") || !strcmp(value, "remove6");
+}
+
+/* address of value IP[/MASK] is copied to ip,
+   return prefix length, default is of host, -1 if mask is not valid */
+static int ip_prefix(const char *value, char *ip, size_t size)
+{
+	const char *mask = strchr(value, '/');
+	int v6 = is_ipv6(value);
+	long prefix;
+	char *end;
+
+	snprintf(ip, size, "%.*s", mask ? (int)(mask - value) : (int)strlen(value), value);
+	if (mask == NULL)
+		return v6 ? 128 : 32;
+
+	mask++;
+	if (!v6 && strchr(mask, '.') != NULL)
+		return mask_to_prefix(mask);
+	prefix = strtol(mask, &end, 10);
+	if (end == mask || *end || prefix < 0 || prefix > (v6 ? 128 : 32))
+		return -1;
+
+	return prefix;
+}
+
+/* item {address|dest, prefix} of address-data or route-data */
+static struct dbus_value *ip_item(const char *key, const char *ip, int prefix)
+{
+	struct dbus_value *item = dbus_new("a{sv}");
+
+	if (item == NULL || dbus_dict_set(item, key, dbus_new_string('s', ip)) ||
+			dbus_dict_set(item, "prefix", dbus_new_uint('u', prefix))) {
+		dbus_free(item);
+		return NULL;
+	}
+
+	return item;
+}
+
+/* replace addresses of family, deprecated property is dropped */
+static int stage_addresses(struct nm_profile *p, const char *family, struct dbus_value *list)
+{
+	if (stage_set(p, family, "address-data", list))
+		return -1;
+
+	return stage_del(p, family, "addresses");
+}
+
+static int has_addresses(struct nm_profile *p, const char *family)
+{
+	struct dbus_value *group = settings_group(p->settings, family, 0), *addrs;
+
+	addrs = dbus_dict_get(group, "address-data");
+	if (addrs == NULL)
+		addrs = dbus_dict_get(group, "addresses");
+
+	return addrs != NULL && addrs->child != NULL;
+}
+
+int nm_set_ip(struct netinfo *if_it, const char *value, const char *opts, int live)
+{
+	struct namelist *ips = NULL, *words = NULL, *it;
+	struct dbus_value *addrs4, *addrs6, *list;
+	struct nm_profile *p;
+	char ip[NAME_LENGTH];
+	int count4 = 0, count6 = 0, dhcp4, dhcp6, prefix, rc = -1;
+
+	namelist_split(&words, opts);
+	dhcp4 = namelist_search("dhcp", &words);
+	dhcp6 = namelist_search("dhcpv6", &words);
+	namelist_clean(&words);
+
+	//addresses of family are set at once
+	addrs4 = dbus_new("aa{sv}");
+	addrs6 = dbus_new("aa{sv}");
+	namelist_split(&ips, value);
+	for (it = ips; it != NULL && addrs4 && addrs6; it = it->next) {
+		if (is_remove(it->name))
+			continue;
+		if (is_ipv6(it->name))
+			count6++;
+		else
+			count4++;
+
+		prefix = ip_prefix(it->name, ip, sizeof(ip));
+		if (prefix < 0) {
+			error(0, "Invalid mask of address %s of %s", it->name, if_it->name);
+			goto out;
+		}
+		list = is_ipv6(it->name) ? addrs6 : addrs4;
+		if (dbus_add(list, ip_item("address", ip, prefix)))
+			goto out;
+	}
+	if (addrs4 == NULL || addrs6 == NULL)
+		goto out;
+
+	pthread_mutex_lock(&nm_lock);
+	p = stage_get(if_it);
+	if (p == NULL ||
+			(dhcp4 && stage_string(p, "ipv4", "method", "auto")) ||
+			(dhcp6 && stage_string(p, "ipv6", "method", "auto")))
+		goto unlock;
+
+	if (addrs4->child != NULL) {
+		if (stage_addresses(p, "ipv4", dbus_copy(addrs4)) ||
+				(!dhcp4 && stage_string(p, "ipv4", "method", "manual")))
+			goto unlock;
+	}
+	if (addrs6->child != NULL) {
+		if (stage_addresses(p, "ipv6", dbus_copy(addrs6)) ||
+				(!dhcp6 && stage_string(p, "ipv6", "method", "manual")))
+			goto unlock;
+	}
+
+	if (count4 == 0) {
+		if (stage_addresses(p, "ipv4", dbus_new("aa{sv}")) ||
+				stage_del(p, "ipv4", "gateway") ||
+				(!dhcp4 && stage_string(p, "ipv4", "method", "link-local")))
+			goto unlock;
+	}
+	if (count6 == 0) {
+		if (stage_addresses(p, "ipv6", dbus_new("aa{sv}")) ||
+				stage_del(p, "ipv6", "gateway") ||
+				(!dhcp6 && stage_string(p, "ipv6", "method", "ignore")))
+			goto unlock;
+	}
+
+	if (!live)
+		p->activate = 1;
+	rc = 0;
+unlock:
+	pthread_mutex_unlock(&nm_lock);
+out:
+	if (rc)
+		error(0, "Can't set addresses of %s", if_it->name);
+	dbus_free(addrs4);
+	dbus_free(addrs6);
+	namelist_clean(&ips);
+
+	return rc;
+}
+
+int nm_set_gateway(struct netinfo *if_it, const char *value, int live)
+{
+	struct namelist *gws = NULL, *it;
+	struct nm_profile *p;
+	int rc = -1;
+
+	namelist_split(&gws, value);
+
+	pthread_mutex_lock(&nm_lock);
+	p = stage_get(if_it);
+	for (it = gws; p != NULL && it != NULL; it = it->next) {
+		if (!strcmp(it->name, "remove"))
+			rc = stage_del(p, "ipv4", "gateway");
+		else if (!strcmp(it->name, "removev6"))
+			rc = stage_del(p, "ipv6", "gateway");
+		else
+			rc = stage_string(p, is_ipv6(it->name) ? "ipv6" : "ipv4", "gateway",
+					it->name);
+		if (rc)
+			break;
+	}
+	if (p != NULL && it == NULL) {
+		if (!live)
+			p->activate = 1;
+		rc = 0;
+	}
+	pthread_mutex_unlock(&nm_lock);
+
+	if (rc)
+		error(0, "Can't set gateway of %s", if_it->name);
+	namelist_clean(&gws);
+
+	return rc;
+}
+
+/* route IP[/MASK][=GW][mMETRIC] is added to route-data list */
+static int add_route(struct dbus_value *list, const char *value)
+{
+	char buf[NAME_LENGTH], ip[NAME_LENGTH], *gw, *metric, *end;
+	struct dbus_value *item;
+	unsigned long num = 0;
+	int prefix;
+
+	snprintf(buf, sizeof(buf), "%s", value);
+	metric = strrchr(buf, 'm');
+	if (metric != NULL) {
+		*metric++ = '\0';
+		errno = 0;
+		num = strtoul(metric, &end, 10);
+		if (end == metric || *end || errno || num > UINT_MAX) {
+			error(0, "Invalid metric of route %s", value);
+			return -1;
+		}
+	}
+	gw = strrchr(buf, '=');
+	if (gw != NULL)
+		*gw++ = '\0';
+
+	prefix = ip_prefix(buf, ip, sizeof(ip));
+	if (prefix < 0) {
+		error(0, "Invalid destination of route %s", value);
+		return -1;
+	}
+
+	item = ip_item("dest", ip, prefix);
+	if (item == NULL ||
+			(gw && *gw && dbus_dict_set(item, "next-hop", dbus_new_string('s', gw))) ||
+			(metric && dbus_dict_set(item, "metric", dbus_new_uint('u', num)))) {
+		dbus_free(item);
+		return -1;
+	}
+
+	return dbus_add(list, item);
+}
+
+int nm_set_route(struct netinfo *if_it, const char *value, int live)
+{
+	struct namelist *routes = NULL, *it;
+	struct dbus_value *routes4, *routes6;
+	struct nm_profile *p;
+	int rc = -1;
+
+	//routes of family are set at once, "remove" deletes all of them
+	routes4 = dbus_new("aa{sv}");
+	routes6 = dbus_new("aa{sv}");
+	if (strcmp(value, "remove"))
+		namelist_split(&routes, value);
+	for (it = routes; it != NULL && routes4 && routes6; it = it->next) {
+		if (is_remove(it->name))
+			continue;
+		if (add_route(is_ipv6(it->name) ? routes6 : routes4, it->name))
+			goto out;
+	}
+	if (routes4 == NULL || routes6 == NULL)
+		goto out;
+
+	pthread_mutex_lock(&nm_lock);
+	p = stage_get(if_it);
+	if (p != NULL) {
+		//lists are taken by staged settings in any case
+		rc = (stage_set(p, "ipv4", "route-data", routes4) |
+			stage_del(p, "ipv4", "routes") |
+			stage_set(p, "ipv6", "route-data", routes6) |
+			stage_del(p, "ipv6", "routes")) ? -1 : 0;
+		routes4 = routes6 = NULL;
+		if (rc == 0 && !live)
+			p->activate = 1;
+	}
+	pthread_mutex_unlock(&nm_lock);
+out:
+	if (rc)
+		error(0, "Can't set routes of %s", if_it->name);
+	dbus_free(routes4);
+	dbus_free(routes6);
+	namelist_clean(&routes);
+
+	return rc;
+}
+
+/* set method of family, manual one needs addresses, link-local is used
+   instead, addresses and gateway are dropped for other methods,
+   NetworkManager rejects them for link-local and ignore */
+static int stage_method(struct nm_profile *p, const char *family, const char *method)
+{
+	if (!strcmp(method, "manual") && !has_addresses(p, family))
+		method = "link-local";
+	if (stage_string(p, family, "method", method))
+		return -1;
+	if (!strcmp(method, "manual"))
+		return 0;
+
+	if (stage_addresses(p, family, dbus_new("aa{sv}")))
+		return -1;
+	return stage_del(p, family, "gateway");
+}
+
+int nm_set_dhcp(struct netinfo *if_it, const char *proto)
+{
+	const char *proto4 = "manual", *proto6 = "manual";
+	struct nm_profile *p;
+	int rc = -1;
+
+	if (strchr(proto, '4'))
+		proto4 = "auto";
+	if (strchr(proto, '6'))
+		proto6 = "auto";
+	else if (strchr(proto, '4'))
+		proto6 = "ignore";
+
+	pthread_mutex_lock(&nm_lock);
+	p = stage_get(if_it);
+	if (p != NULL && !stage_method(p, "ipv4", proto4) && !stage_method(p, "ipv6", proto6)) {
+		p->activate = 1;
+		rc = 0;
+	}
+	pthread_mutex_unlock(&nm_lock);
+
+	if (rc)
+		error(0, "Can't set DHCP of %s", if_it->name);
+
+	return rc;
+}
+
+int nm_get_dhcp(struct netinfo *if_it, int proto)
+{
+	const char *family = (proto == 6) ? "ipv6" : "ipv4";
+	struct dbus_value *settings = NULL;
+	struct nm_profile *p;
+	char path[PATH_MAX];
+	int rc;
+
+	pthread_mutex_lock(&nm_lock);
+	p = stage_find(if_it->name);
+	if (p != NULL) {
+		rc = strcmp(settings_string(p->settings, family, "method"), "auto") ? 1 : 0;
+	} else {
+		rc = find_profile(if_it->name, path, sizeof(path), &settings);
+		//profile is not created yet or is replaced, new one uses DHCP
+		if (rc == 0 && same_mac(settings, if_it->mac))
+			rc = strcmp(settings_string(settings, family, "method"), "auto") ? 1 : 0;
+		else
+			rc = (rc < 0) ? 2 : 0;
+		dbus_free(settings);
+	}
+	pthread_mutex_unlock(&nm_lock);
+
+	return rc;
+}
+
+/* create configuration of NetworkManager for device as create_nm_if_config
+   did, it is reloaded instead of restart of NetworkManager */
+static void write_conf(const char *dev, const char *mac)
+{
+	char path[PATH_MAX], tmp[PATH_MAX + 8];
+	FILE *fp;
+	int rc = 0;
+
+	snprintf(path, sizeof(path), NM_CONF_DIR "/60-prl_nettool_%s.conf", dev);
+	if (access(path, F_OK) == 0)
+		return;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	fp = fopen(tmp, "w");
+	if (fp == NULL) {
+		debug("Can't create %s: %s", tmp, strerror(errno));
+		return;
+	}
+	fprintf(fp, "[main]\nno-auto-default+=%s\nplugins-=ifcfg-rh\n", mac);
+	if (fclose(fp) || rename(tmp, path))
+		rc = -1;
+	if (rc) {
+		debug("Can't save %s: %s", path, strerror(errno));
+		unlink(tmp);
+		return;
+	}
+
+	if (nm_call(NM_PATH, NM_SERVICE, "Reload", NULL, 1, dbus_new_uint('u', NM_RELOAD_CONF)))
+		debug("NetworkManager did not reload configuration: %s", nm_error);
+}
+
+/* start activation of profile at path on device, NULL path lets
+   NetworkManager choose profile, active connection to wait for is
+   copied to active, it is empty if settings were reapplied */
+static int profile_up(const char *dev, const char *path, char *active, size_t size)
+{
+	char dev_path[PATH_MAX], current[PATH_MAX], applied[PATH_MAX];
+	struct dbus_value *reply;
+	int rc;
+
+	active[0] = '\0';
+	if (device_path(dev, dev_path, sizeof(dev_path)))
+		return nm_failure("find device", dev);
+
+	if (path != NULL &&
+			!get_path_property(dev_path, NM_DEVICE, "ActiveConnection",
+				current, sizeof(current)) && strcmp(current, "/") &&
+			!get_path_property(current, NM_ACTIVE, "Connection",
+				applied, sizeof(applied)) && !strcmp(applied, path)) {
+		//device keeps its link, changed settings are applied to it
+		rc = nm_call(dev_path, NM_DEVICE, "Reapply", NULL, 3, dbus_new("a{sa{sv}}"),
+				dbus_new_uint('t', 0), dbus_new_uint('u', 0));
+		if (rc == 0)
+			return 0;
+		debug("NetworkManager can't reapply settings of %s: %s", dev, nm_error);
+	}
+
+	rc = nm_call(NM_PATH, NM_SERVICE, "ActivateConnection", &reply, 3,
+			dbus_new_string('o', path ? path : "/"), dbus_new_string('o', dev_path),
+			dbus_new_string('o', "/"));
+	if (rc)
+		return nm_failure("activate", dev);
+	if (reply != NULL && *reply->sig == 'o')
+		snprintf(active, size, "%s", reply->v.s);
+	dbus_free(reply);
+
+	return 0;
+}
+
+/* wait until device is activated as nmcli c up does, nm_lock is taken
+   for each poll only, so other devices are activated meanwhile */
+static int wait_active(const char *dev, const char *active)
+{
+	struct dbus_value *state;
+	int i, rc, done = 0;
+
+	if (*active == '\0')
+		return 0;
+
+	for (i = 0; i < NM_ACTIVATE_WAIT * 1000000 / NM_POLL_US; i++) {
+		pthread_mutex_lock(&nm_lock);
+		//active connection is removed when activation fails
+		rc = get_property(active, NM_ACTIVE, "State", 'u', &state);
+		if (rc == 0 && state->child->v.u >= NM_DEACTIVATING) {
+			snprintf(nm_error, sizeof(nm_error), "connection is deactivated");
+			rc = 1;
+		}
+		if (rc)
+			nm_failure("activate", dev);
+		else
+			done = (state->child->v.u == NM_ACTIVATED);
+		dbus_free(state);
+		pthread_mutex_unlock(&nm_lock);
+
+		if (rc)
+			return -1;
+		if (done)
+			return 0;
+		usleep(NM_POLL_US);
+	}
+
+	error(0, "Activation of %s did not complete in %d seconds", dev, NM_ACTIVATE_WAIT);
+	return -1;
+}
+
+/* Update2 of NetworkManager 1.12 and newer or Update */
+static int update_profile(const char *dev, const char *path, struct dbus_value *settings)
+{
+	int rc;
+
+	rc = nm_call(path, NM_CONNECTION, "Update2", NULL, 3, dbus_copy(settings),
+			dbus_new_uint('u', NM_TO_DISK), dbus_new("a{sv}"));
+	if (rc > 0 && is_unknown_method())
+		rc = nm_call(path, NM_CONNECTION, "Update", NULL, 1, dbus_copy(settings));
+
+	return rc ? nm_failure("update profile of", dev) : 0;
+}
+
+/* new profile is activated at once if up is set,
+   otherwise AddConnection2 of NetworkManager 1.20 and newer or AddConnection */
+static int add_profile(struct nm_profile *p, int up)
+{
+	struct dbus_value *reply = NULL;
+	char dev_path[PATH_MAX];
+	int rc;
+
+	if (up) {
+		if (device_path(p->dev, dev_path, sizeof(dev_path)))
+			return nm_failure("find device", p->dev);
+		rc = nm_call(NM_PATH, NM_SERVICE, "AddAndActivateConnection", &reply, 3,
+				dbus_copy(p->settings), dbus_new_string('o', dev_path),
+				dbus_new_string('o', "/"));
+		if (rc == 0 && reply != NULL && reply->next != NULL && *reply->next->sig == 'o')
+			snprintf(p->active, sizeof(p->active), "%s", reply->next->v.s);
+	} else {
+		rc = nm_call(NM_SETTINGS_PATH, NM_SETTINGS, "AddConnection2", &reply, 3,
+				dbus_copy(p->settings), dbus_new_uint('u', NM_TO_DISK),
+				dbus_new("a{sv}"));
+		if (rc > 0 && is_unknown_method())
+			rc = nm_call(NM_SETTINGS_PATH, NM_SETTINGS, "AddConnection", &reply, 1,
+					dbus_copy(p->settings));
+	}
+	dbus_free(reply);
+
+	return rc ? nm_failure("add profile of", p->dev) : 0;
+}
+
+/* edits are applied to settings read now, so that other changes of profile
+   done during request are kept, one call saves profile
+   nm_lock is held by caller */
+static int commit_profile(struct nm_profile *p)
+{
+	struct dbus_value *settings = NULL;
+	int rc, up = p->activate && !exec_is_deferred();
+	struct nm_edit *e;
+	char path[PATH_MAX];
+
+	write_conf(p->dev, p->mac);
+
+	rc = find_profile(p->dev, path, sizeof(path), &settings);
+	if (rc == 0 && !same_mac(settings, p->mac)) {
+		//profile of device with other MAC is replaced
+		dbus_free(settings);
+		if (nm_call(path, NM_CONNECTION, "Delete", NULL, 0))
+			return nm_failure("delete old profile of", p->dev);
+		rc = 1;
+	}
+	if (rc < 0)
+		return -1;
+	if (rc == 1)
+		return add_profile(p, up);
+
+	for (e = p->edits; e != NULL; e = e->next) {
+		if (apply_edit(settings, e)) {
+			error(0, "Can't change settings of %s", p->dev);
+			dbus_free(settings);
+			return -1;
+		}
+	}
+	rc = update_profile(p->dev, path, settings);
+	dbus_free(settings);
+	if (rc == 0 && up)
+		rc = profile_up(p->dev, path, p->active, sizeof(p->active));
+
+	return rc;
+}
+
+int nm_commit(void)
+{
+	struct nm_profile *p, *done;
+	int rc = 0;
+
+	pthread_mutex_lock(&nm_lock);
+	done = staged;
+	staged = NULL;
+	for (p = done; p != NULL; p = p->next)
+		if (commit_profile(p))
+			rc = -1;
+	pthread_mutex_unlock(&nm_lock);
+
+	//devices are activated at once, each one is waited for
+	while ((p = done) != NULL) {
+		done = p->next;
+		if (wait_active(p->dev, p->active))
+			rc = -1;
+		profile_free(p);
+	}
+
+	return rc;
+}
+
+/* find profile of device and start its activation */
+static int device_up(const char *dev, char *active, size_t size)
+{
+	struct dbus_value *settings = NULL;
+	char path[PATH_MAX];
+	int rc;
+
+	rc = find_profile(dev, path, sizeof(path), &settings);
+	dbus_free(settings);
+	if (rc < 0)
+		return -1;
+
+	//device without profile is connected as nmcli d connect does
+	return profile_up(dev, rc ? NULL : path, active, size);
+}
+
+int nm_activate(struct netinfo *if_it)
+{
+	char active[PATH_MAX];
+	int rc;
+
+	pthread_mutex_lock(&nm_lock);
+	rc = device_up(if_it->name, active, sizeof(active));
+	pthread_mutex_unlock(&nm_lock);
+
+	return rc ? rc : wait_active(if_it->name, active);
+}
+
+/* devices having profiles of prl_nettool */
+static int profile_devices(struct namelist **devs)
+{
+	struct dbus_value *list, *it, *conf;
+	const char *id;
+	int rc;
+
+	if (nm_call(NM_SETTINGS_PATH, NM_SETTINGS, "ListConnections", &list, 0))
+		return nm_failure("list profiles", "");
+
+	for (it = (list && !strcmp(list->sig, "ao")) ? list->child : NULL;
+			it != NULL; it = it->next) {
+		rc = get_settings(it->v.s, &conf);
+		if (rc < 0) {
+			dbus_free(list);
+			return nm_failure("read profiles", "");
+		}
+		if (rc > 0)
+			continue;
+
+		id = settings_string(conf, "connection", "id");
+		if (!strncmp(id, NM_PROFILE_PREFIX, strlen(NM_PROFILE_PREFIX)))
+			namelist_add(id + strlen(NM_PROFILE_PREFIX), devs);
+		dbus_free(conf);
+	}
+	dbus_free(list);
+
+	return 0;
+}
+
+int nm_restart(const char *const devs[])
+{
+	struct namelist *all = NULL, *names = NULL, **tail = &names, *it;
+	char active[PATH_MAX];
+	int rc = 0;
+
+	pthread_mutex_lock(&nm_lock);
+	if (devs == NULL && profile_devices(&all))
+		rc = -1;
+	pthread_mutex_unlock(&nm_lock);
+
+	for (; devs != NULL && *devs != NULL; devs++)
+		namelist_append(*devs, &tail);
+	if (devs == NULL)
+		names = all;
+
+	//devices are reconfigured one by one, other ones keep their traffic
+	for (it = names; it != NULL; it = it->next) {
+		active[0] = '\0';
+		pthread_mutex_lock(&nm_lock);
+		if (device_up(it->name, active, sizeof(active)))
+			rc = -1;
+		pthread_mutex_unlock(&nm_lock);
+
+		if (wait_active(it->name, active))
+			rc = -1;
+	}
+	namelist_clean(&names);
+
+	return rc;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2019 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * native backend of NetworkManager over D-Bus instead of nm-*.sh scripts
+ */
+
+#ifndef __NM_H__
+#define __NM_H__
+
+#include "../netinfo.h"
+
+/* profile of device is prl_nettool-nm-<dev> as nm-*.sh named it */
+#define NM_PROFILE_PREFIX	"prl_nettool-nm-"
+/* tests keep configuration in their own directory */
+#ifndef NM_CONF_DIR
+#define NM_CONF_DIR		"/etc/NetworkManager/conf.d"
+#endif
+
+/* actions of nm-*.sh scripts, all actions of request change settings
+   of profile kept in memory, they are sent by nm_commit()
+   return 0 on success */
+int nm_set_ip(struct netinfo *if_it, const char *value, const char *opts, int live);
+
+int nm_set_gateway(struct netinfo *if_it, const char *value, int live);
+
+int nm_set_route(struct netinfo *if_it, const char *value, int live);
+
+/* proto contains 4 and/or 6 */
+int nm_set_dhcp(struct netinfo *if_it, const char *proto);
+
+/* return 0 - DHCP of proto 4 or 6 is enabled, 1 - disabled, 2 - error */
+int nm_get_dhcp(struct netinfo *if_it, int proto);
+
+/* save settings changed by actions with one call for each profile,
+   changed devices are brought up unless it is deferred */
+int nm_commit(void);
+
+/* reapply settings of profile to device or activate it */
+int nm_activate(struct netinfo *if_it);
+
+/* nm_activate() of devices of NULL-terminated list,
+   devs is NULL for all devices having profiles of prl_nettool */
+int nm_restart(const char *const devs[]);
+
+#endif
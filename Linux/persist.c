@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2020 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * write-behind of configuration for --fast requests: kernel state is set
+ * by the caller, configuration is written by detached child which takes
+ * the lock after the caller and marks itself pending until it is done
+ */
+
+#include "../common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "persist.h"
+
+/* write single line to file atomically */
+static int write_file(const char *path, const char *line)
+{
+	char tmp[PATH_MAX];
+	FILE *fp;
+	int rc = 0;
+
+	if (mkdir(LEDGER_DIR, 0700) && errno != EEXIST) {
+		debug("Can't create %s: %s", LEDGER_DIR, strerror(errno));
+		return -1;
+	}
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	fp = fopen(tmp, "w");
+	if (fp == NULL) {
+		debug("Can't create %s: %s", tmp, strerror(errno));
+		return -1;
+	}
+
+	fprintf(fp, "%s\n", line);
+	if (fclose(fp))
+		rc = -1;
+
+	if (rc == 0 && rename(tmp, path))
+		rc = -1;
+
+	if (rc) {
+		debug("Can't save %s: %s", path, strerror(errno));
+		unlink(tmp);
+	}
+
+	return rc;
+}
+
+static void record_failure(const char *what, int rc)
+{
+	char line[128];
+	char stamp[32];
+	time_t now = time(NULL);
+
+	strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime(&now));
+	snprintf(line, sizeof(line), "%s %s %d", stamp, what, rc);
+	write_file(PERSIST_FAILED, line);
+
+	//applied options do not match configuration
+	ledger_forget();
+}
+
+pid_t persist_start(void)
+{
+	char line[32];
+	char ready = 0;
+	pid_t pid, child;
+	int fds[2];
+	int fd, status;
+
+	//child reports on pipe that it is recorded as pending
+	if (pipe2(fds, O_CLOEXEC)) {
+		error(errno, "Can't create pipe to write configuration");
+		return -1;
+	}
+
+	/* intermediate process lets the child be reparented to init,
+	   so it is not left as zombie of long running caller */
+	pid = fork();
+	if (pid < 0) {
+		error(errno, "Can't fork process to write configuration");
+		close(fds[0]);
+		close(fds[1]);
+		return -1;
+	}
+
+	if (pid == 0) {
+		close(fds[0]);
+		setsid();
+		child = fork();
+		if (child != 0)
+			_exit(child < 0 ? 1 : 0);
+
+		//child marks itself, so it never runs unrecorded
+		snprintf(line, sizeof(line), "%d", (int)getpid());
+		if (write_file(PERSIST_PENDING, line))
+			_exit(1);
+		ready = 1;
+		if (write(fds[1], &ready, 1) != 1)
+			_exit(1);
+		close(fds[1]);
+
+		//caller does not wait for output of the child
+		fd = open("/dev/null", O_RDWR);
+		if (fd != -1) {
+			dup2(fd, STDIN_FILENO);
+			dup2(fd, STDOUT_FILENO);
+			dup2(fd, STDERR_FILENO);
+			if (fd > STDERR_FILENO)
+				close(fd);
+		}
+		return 0;
+	}
+
+	close(fds[1]);
+	while (waitpid(pid, &status, 0) == -1 && errno == EINTR)
+		;
+	//pipe is closed without mark if the child exits before it is pending
+	while (read(fds[0], &ready, 1) == -1 && errno == EINTR)
+		;
+	close(fds[0]);
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || !ready) {
+		error(0, "Can't start process to write configuration");
+		return -1;
+	}
+
+	return pid;
+}
+
+void persist_done(int rc)
+{
+	if (rc)
+		record_failure("configuration failed", rc);
+
+	if (unlink(PERSIST_PENDING) && errno != ENOENT)
+		debug("Can't remove %s: %s", PERSIST_PENDING, strerror(errno));
+}
+
+int persist_pending(void)
+{
+	FILE *fp;
+	int pid = 0;
+
+	fp = fopen(PERSIST_PENDING, "r");
+	if (fp == NULL)
+		return 0;
+	if (fscanf(fp, "%d", &pid) != 1)
+		pid = 0;
+	fclose(fp);
+
+	if (pid == getpid())
+		return 0;
+	if (pid > 0 && (kill(pid, 0) == 0 || errno == EPERM))
+		return 1;
+
+	error(0, "WARNING: process %d writing configuration was interrupted", pid);
+	record_failure("configuration interrupted", -1);
+	unlink(PERSIST_PENDING);
+
+	return 0;
+}
+
+int persist_report(void)
+{
+	char line[128] = "";
+	FILE *fp;
+
+	fp = fopen(PERSIST_FAILED, "r");
+	if (fp == NULL)
+		return 0;
+	if (fgets(line, sizeof(line), fp) != NULL)
+		line[strcspn(line, "\n")] = '\0';
+	fclose(fp);
+
+	error(0, "WARNING: configuration of previous --fast request was not written: %s",
+			line);
+	if (unlink(PERSIST_FAILED))
+		debug("Can't remove %s: %s", PERSIST_FAILED, strerror(errno));
+
+	return 1;
+}
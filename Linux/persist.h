@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2020 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * write-behind of configuration for --fast requests
+ */
+
+#ifndef __PERSIST_H__
+#define __PERSIST_H__
+
+#include <sys/types.h>
+
+#include "ledger.h"
+
+/* pid of process writing configuration, exists while it runs */
+#define PERSIST_PENDING	LEDGER_DIR "/pending"
+/* failure of the last write-behind, reported by the next call */
+#define PERSIST_FAILED	LEDGER_DIR "/failed"
+
+/* start detached process which writes configuration in background,
+   caller keeps the lock until the process is recorded as pending
+return 0 in the child, positive value in the caller and -1 on error */
+pid_t persist_start(void);
+
+/* record result of write-behind and remove pending mark, called by child */
+void persist_done(int rc);
+
+/* check if write-behind of other process is pending, stale mark of
+   process which died is recorded as failure and removed
+return 1 - pending, 0 - not */
+int persist_pending(void);
+
+/* report recorded failure of previous write-behind and forget it
+return 1 - there was failure, 0 - not */
+int persist_report(void);
+
+#endif
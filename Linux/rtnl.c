@@ -0,0 +1,647 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2020 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * native rtnetlink configuration of routes and addresses
+ * changes are sent in batches of messages with ACK requested for each one,
+ * so that error of every change is known without a command per change
+ */
+
+#include "../common.h"
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <asm/types.h>
+#include <libnetlink.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include "../netinfo.h"
+#include "../namelist.h"
+#include "../options.h"
+#include "rtnl.h"
+
+#define BATCH_SIZE	16384
+#define BATCH_MSGS	64
+/* room for the longest message: header, rtmsg and 4 attributes */
+#define MSG_ROOM	256
+#define DESC_LENGTH	512
+/* keep secondary IPv4 addresses when primary one is deleted */
+#define PROMOTE_SECONDARIES	"/proc/sys/net/ipv4/conf/%s/promote_secondaries"
+
+struct rtnl_batch
+{
+	struct rtnl_handle rth;
+	char buf[BATCH_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+	size_t len;
+	int count;
+	__u32 seq;
+	char desc[BATCH_MSGS][DESC_LENGTH];
+	int ignore[BATCH_MSGS];
+	int rc;
+};
+
+struct ipv6_addr
+{
+	unsigned char addr[16];
+	unsigned char prefixlen;
+};
+
+struct addr
+{
+	int family;
+	unsigned char addr[16];
+	unsigned char prefixlen;
+	const char *value;
+};
+
+struct ipv6_list
+{
+	int ifindex;
+	int count;
+	struct ipv6_addr *addrs;
+};
+
+static int batch_open(struct rtnl_batch *b)
+{
+	memset(b, 0, sizeof(*b));
+	if (rtnl_open(&b->rth, 0) < 0) {
+		error(errno, "ERROR: can't open rtnetlink socket");
+		return -1;
+	}
+	b->seq = time(NULL);
+
+	return 0;
+}
+
+/* send queued messages at once and collect their ACKs */
+static int batch_flush(struct rtnl_batch *b)
+{
+	struct sockaddr_nl nladdr = { .nl_family = AF_NETLINK };
+	char buf[BATCH_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+	__u32 first = b->seq - b->count;
+	int acked = 0;
+
+	if (b->count == 0)
+		return 0;
+
+	if (sendto(b->rth.fd, b->buf, b->len, 0,
+			(struct sockaddr *)&nladdr, sizeof(nladdr)) < 0) {
+		error(errno, "ERROR: can't send rtnetlink batch");
+		b->rc = errno;
+		goto out;
+	}
+
+	while (acked < b->count) {
+		struct nlmsghdr *h;
+		ssize_t len = recv(b->rth.fd, buf, sizeof(buf), 0);
+
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			error(errno, "ERROR: can't receive rtnetlink reply");
+			b->rc = errno;
+			goto out;
+		}
+
+		for (h = (struct nlmsghdr *)buf; NLMSG_OK(h, (size_t)len);
+				h = NLMSG_NEXT(h, len)) {
+			struct nlmsgerr *e = NLMSG_DATA(h);
+			__u32 i = h->nlmsg_seq - first;
+			int err;
+
+			if (h->nlmsg_type != NLMSG_ERROR || i >= (__u32)b->count)
+				continue;
+			acked++;
+
+			err = -e->error;
+			if (err == 0 || err == b->ignore[i])
+				continue;
+			if (b->ignore[i] == ESRCH && err == ENOENT)
+				continue;
+
+			error(err, "ERROR: failed to %s", b->desc[i]);
+			b->rc = err;
+		}
+	}
+
+out:
+	b->len = 0;
+	b->count = 0;
+
+	return b->rc;
+}
+
+/* queue new message, error in ignore is not reported */
+static struct nlmsghdr *batch_msg(struct rtnl_batch *b, int type, int flags,
+		size_t size, int ignore, const char *fmt, ...)
+{
+	struct nlmsghdr *n;
+	va_list args;
+
+	if (b->count == BATCH_MSGS || b->len + MSG_ROOM > BATCH_SIZE)
+		batch_flush(b);
+
+	n = (struct nlmsghdr *)(b->buf + b->len);
+	memset(n, 0, MSG_ROOM);
+	n->nlmsg_len = NLMSG_LENGTH(size);
+	n->nlmsg_type = type;
+	n->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | flags;
+	n->nlmsg_seq = b->seq++;
+
+	va_start(args, fmt);
+	vsnprintf(b->desc[b->count], DESC_LENGTH, fmt, args);
+	va_end(args);
+	b->ignore[b->count] = ignore;
+	b->count++;
+
+	return n;
+}
+
+static void batch_done(struct rtnl_batch *b, struct nlmsghdr *n)
+{
+	b->len += NLMSG_ALIGN(n->nlmsg_len);
+}
+
+static int batch_close(struct rtnl_batch *b)
+{
+	batch_flush(b);
+	rtnl_close(&b->rth);
+
+	return b->rc;
+}
+
+static void add_attr(struct nlmsghdr *n, int type, const void *data, int len)
+{
+	struct rtattr *rta = (struct rtattr *)((char *)n + NLMSG_ALIGN(n->nlmsg_len));
+
+	rta->rta_type = type;
+	rta->rta_len = RTA_LENGTH(len);
+	memcpy(RTA_DATA(rta), data, len);
+	n->nlmsg_len = NLMSG_ALIGN(n->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+}
+
+static int addr_len(int family)
+{
+	return family == AF_INET6 ? 16 : 4;
+}
+
+/* parse <IP>[/<prefix>|/<mask>] of route, "default" is accepted too */
+static int parse_dst(const char *value, int family, unsigned char *addr,
+		unsigned char *prefixlen)
+{
+	char ip[INET6_ADDRSTRLEN];
+	const char *mask = strchr(value, '/');
+	int max = addr_len(family) * 8;
+	int prefix;
+
+	if (strcmp(value, "default") == 0) {
+		*prefixlen = 0;
+		return 0;
+	}
+
+	snprintf(ip, sizeof(ip), "%.*s",
+		mask ? (int)(mask - value) : (int)strlen(value), value);
+	if (inet_pton(family, ip, addr) != 1)
+		return -1;
+
+	if (mask == NULL)
+		prefix = max;
+	else if (strchr(mask + 1, '.') != NULL)
+		prefix = mask_to_prefix(mask + 1);
+	else
+		prefix = atoi(mask + 1);
+	if (prefix < 0 || prefix > max)
+		return -1;
+
+	*prefixlen = prefix;
+
+	return 0;
+}
+
+/* queue route of main table, dst of NULL is default route */
+static int queue_route(struct rtnl_batch *b, int type, int flags, int family,
+		int ifindex, const char *dst, const char *gw, const char *metric,
+		const char *desc)
+{
+	unsigned char addr[16], gwaddr[16];
+	unsigned char prefixlen = 0;
+	struct nlmsghdr *n;
+	struct rtmsg *r;
+
+	if (dst != NULL && parse_dst(dst, family, addr, &prefixlen) != 0) {
+		error(0, "ERROR: invalid destination of route %s", dst);
+		return -1;
+	}
+	if (gw != NULL && inet_pton(family, gw, gwaddr) != 1) {
+		error(0, "ERROR: invalid gateway %s", gw);
+		return -1;
+	}
+
+	n = batch_msg(b, type, flags, sizeof(struct rtmsg),
+			type == RTM_DELROUTE ? ESRCH : 0, "%s", desc);
+	r = NLMSG_DATA(n);
+	r->rtm_family = family;
+	r->rtm_dst_len = prefixlen;
+	r->rtm_table = RT_TABLE_MAIN;
+	r->rtm_type = RTN_UNICAST;
+	if (type == RTM_DELROUTE) {
+		r->rtm_scope = RT_SCOPE_NOWHERE;
+	} else {
+		r->rtm_protocol = RTPROT_BOOT;
+		r->rtm_scope = (gw != NULL) ? RT_SCOPE_UNIVERSE : RT_SCOPE_LINK;
+	}
+
+	if (prefixlen > 0)
+		add_attr(n, RTA_DST, addr, addr_len(family));
+	if (gw != NULL)
+		add_attr(n, RTA_GATEWAY, gwaddr, addr_len(family));
+	if (ifindex > 0)
+		add_attr(n, RTA_OIF, &ifindex, sizeof(ifindex));
+	if (metric != NULL && *metric != '\0') {
+		__u32 prio = strtoul(metric, NULL, 10);
+		add_attr(n, RTA_PRIORITY, &prio, sizeof(prio));
+	}
+	batch_done(b, n);
+
+	return 0;
+}
+
+/* queue replacement of each route of list, or only its deletion */
+static int queue_routes(struct rtnl_batch *b, struct netinfo *if_it,
+		struct namelist *routes, int delete_only)
+{
+	struct namelist *it;
+	char desc[DESC_LENGTH];
+	int rc = 0;
+
+	for (it = routes; it != NULL; it = it->next) {
+		struct route route = {NULL, NULL, NULL};
+		char *value = strdup(it->name);
+		const char *gw;
+		int family;
+
+		if (value == NULL) {
+			error(errno, "ERROR: failed to strdup");
+			rc = -1;
+			break;
+		}
+		parse_route(value, &route);
+		free(value);
+		if (route.ip == NULL) {
+			clear_route(&route);
+			continue;
+		}
+
+		family = is_ipv6(route.ip) ? AF_INET6 : AF_INET;
+		gw = (route.gw != NULL && *route.gw != '\0') ? route.gw : NULL;
+
+		/* old route to the same destination may have other metric */
+		snprintf(desc, sizeof(desc), "delete route %s dev %s",
+				route.ip, if_it->name);
+		if (queue_route(b, RTM_DELROUTE, 0, family, if_it->ifindex,
+				route.ip, gw, delete_only ? route.metric : NULL,
+				desc) != 0) {
+			rc = -1;
+		} else if (!delete_only) {
+			snprintf(desc, sizeof(desc), "replace route %s%s%s dev %s",
+					route.ip, gw ? " via " : "", gw ? gw : "", if_it->name);
+			if (queue_route(b, RTM_NEWROUTE, NLM_F_CREATE | NLM_F_REPLACE,
+					family, if_it->ifindex, route.ip, gw, route.metric,
+					desc) != 0)
+				rc = -1;
+		}
+
+		clear_route(&route);
+	}
+
+	return rc;
+}
+
+int rtnl_update_routes(struct netinfo *if_it, struct namelist *add,
+		struct namelist *del)
+{
+	struct rtnl_batch *b;
+	int rc;
+
+	b = malloc(sizeof(*b));
+	if (b == NULL) {
+		error(errno, "ERROR: can't allocate memory");
+		return -1;
+	}
+	if (batch_open(b) != 0) {
+		free(b);
+		return -1;
+	}
+
+	rc = queue_routes(b, if_it, del, 1);
+	if (queue_routes(b, if_it, add, 0) != 0)
+		rc = -1;
+
+	if (batch_close(b) != 0)
+		rc = b->rc;
+	free(b);
+
+	return rc;
+}
+
+int rtnl_replace_routes(struct netinfo *if_it, struct namelist *routes)
+{
+	return rtnl_update_routes(if_it, routes, NULL);
+}
+
+int rtnl_set_gateways(struct netinfo *if_it, struct namelist *gws)
+{
+	struct rtnl_batch *b;
+	struct namelist *it;
+	char desc[DESC_LENGTH];
+	int rc = 0;
+
+	b = malloc(sizeof(*b));
+	if (b == NULL) {
+		error(errno, "ERROR: can't allocate memory");
+		return -1;
+	}
+	if (batch_open(b) != 0) {
+		free(b);
+		return -1;
+	}
+
+	for (it = gws; it != NULL; it = it->next) {
+		int ipv6 = is_ipv6(it->name) || is_removev6(it->name);
+		int family = ipv6 ? AF_INET6 : AF_INET;
+
+		/* default route may be on other device, as "route del default" */
+		snprintf(desc, sizeof(desc), "delete default%s route",
+				ipv6 ? " IPv6" : "");
+		if (queue_route(b, RTM_DELROUTE, 0, family, 0, NULL, NULL, NULL,
+				desc) != 0)
+			rc = -1;
+
+		if (is_remove(it->name) || is_removev6(it->name))
+			continue;
+
+		snprintf(desc, sizeof(desc), "add default route via %s dev %s",
+				it->name, if_it->name);
+		if (queue_route(b, RTM_NEWROUTE, NLM_F_CREATE | NLM_F_REPLACE,
+				family, if_it->ifindex, NULL, it->name, NULL, desc) != 0)
+			rc = -1;
+	}
+
+	if (batch_close(b) != 0)
+		rc = b->rc;
+	free(b);
+
+	return rc;
+}
+
+static int store_ipv6(struct nlmsghdr *n, void *arg)
+{
+	struct ipv6_list *list = arg;
+	struct ifaddrmsg *ifa = NLMSG_DATA(n);
+	struct rtattr *tb[IFA_MAX+1];
+	struct rtattr *addr;
+	struct ipv6_addr *addrs;
+	int len = n->nlmsg_len - NLMSG_LENGTH(sizeof(*ifa));
+
+	if (n->nlmsg_type != RTM_NEWADDR || len < 0)
+		return 0;
+	if (ifa->ifa_family != AF_INET6 || (int)ifa->ifa_index != list->ifindex ||
+			ifa->ifa_scope != RT_SCOPE_UNIVERSE)
+		return 0;
+
+	parse_rtattr(tb, IFA_MAX, IFA_RTA(ifa), len);
+	addr = tb[IFA_LOCAL] ? tb[IFA_LOCAL] : tb[IFA_ADDRESS];
+	if (addr == NULL || RTA_PAYLOAD(addr) < 16)
+		return 0;
+
+	addrs = realloc(list->addrs, (list->count + 1) * sizeof(*addrs));
+	if (addrs == NULL)
+		return -1;
+	list->addrs = addrs;
+	memcpy(addrs[list->count].addr, RTA_DATA(addr), 16);
+	addrs[list->count].prefixlen = ifa->ifa_prefixlen;
+	list->count++;
+
+	return 0;
+}
+
+int rtnl_flush_ipv6(struct netinfo *if_it)
+{
+	struct ipv6_list list = {if_it->ifindex, 0, NULL};
+	struct rtnl_batch *b;
+	int i;
+	int rc;
+
+	b = malloc(sizeof(*b));
+	if (b == NULL) {
+		error(errno, "ERROR: can't allocate memory");
+		return -1;
+	}
+	if (batch_open(b) != 0) {
+		free(b);
+		return -1;
+	}
+
+	if (rtnl_addrdump_req(&b->rth, AF_INET6, NULL) < 0 ||
+			rtnl_dump_filter(&b->rth, store_ipv6, &list) < 0) {
+		error(0, "ERROR: can't dump IPv6 addresses of %s", if_it->name);
+		b->rc = -1;
+	} else {
+		for (i = 0; i < list.count; i++) {
+			char ip[INET6_ADDRSTRLEN] = "";
+			struct nlmsghdr *n;
+			struct ifaddrmsg *ifa;
+
+			inet_ntop(AF_INET6, list.addrs[i].addr, ip, sizeof(ip));
+			/* address may vanish on its own, e.g. on DAD failure */
+			n = batch_msg(b, RTM_DELADDR, 0, sizeof(struct ifaddrmsg),
+					EADDRNOTAVAIL, "delete address %s/%d dev %s",
+					ip, list.addrs[i].prefixlen, if_it->name);
+			ifa = NLMSG_DATA(n);
+			ifa->ifa_family = AF_INET6;
+			ifa->ifa_prefixlen = list.addrs[i].prefixlen;
+			ifa->ifa_scope = RT_SCOPE_UNIVERSE;
+			ifa->ifa_index = if_it->ifindex;
+			add_attr(n, IFA_LOCAL, list.addrs[i].addr, 16);
+			batch_done(b, n);
+		}
+	}
+
+	rc = batch_close(b);
+	free(list.addrs);
+	free(b);
+
+	return rc;
+}
+
+/* parse values of --ip, "remove" and invalid values are skipped */
+static struct addr *parse_addrs(struct namelist *list, int *count)
+{
+	struct namelist *it;
+	struct addr *addrs;
+	int n = 0;
+
+	for (it = list; it != NULL; it = it->next)
+		n++;
+	addrs = calloc(n + 1, sizeof(*addrs));
+	if (addrs == NULL) {
+		error(errno, "ERROR: can't allocate memory");
+		return NULL;
+	}
+
+	n = 0;
+	for (it = list; it != NULL; it = it->next) {
+		struct addr *a = &addrs[n];
+
+		if (it->name == NULL || is_remove(it->name) || is_removev6(it->name))
+			continue;
+		a->family = is_ipv6(it->name) ? AF_INET6 : AF_INET;
+		if (parse_dst(it->name, a->family, a->addr, &a->prefixlen) != 0 ||
+				strchr(it->name, '/') == NULL) {
+			error(0, "ERROR: invalid address %s", it->name);
+			continue;
+		}
+		a->value = it->name;
+		n++;
+	}
+	*count = n;
+
+	return addrs;
+}
+
+/* find address in list, prefix is compared if prefix is set */
+static struct addr *find_addr(struct addr *addrs, int count, struct addr *a,
+		int prefix)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		if (addrs[i].family == a->family &&
+				!memcmp(addrs[i].addr, a->addr, addr_len(a->family)) &&
+				(!prefix || addrs[i].prefixlen == a->prefixlen))
+			return &addrs[i];
+
+	return NULL;
+}
+
+static void queue_addr(struct rtnl_batch *b, int type, struct netinfo *if_it,
+		struct addr *a)
+{
+	struct nlmsghdr *n;
+	struct ifaddrmsg *ifa;
+
+	n = batch_msg(b, type, type == RTM_NEWADDR ? NLM_F_CREATE | NLM_F_EXCL : 0,
+			sizeof(struct ifaddrmsg), type == RTM_DELADDR ? EADDRNOTAVAIL : 0,
+			"%s address %s dev %s", type == RTM_NEWADDR ? "add" : "delete",
+			a->value, if_it->name);
+	ifa = NLMSG_DATA(n);
+	ifa->ifa_family = a->family;
+	ifa->ifa_prefixlen = a->prefixlen;
+	ifa->ifa_scope = RT_SCOPE_UNIVERSE;
+	ifa->ifa_index = if_it->ifindex;
+	add_attr(n, IFA_LOCAL, a->addr, addr_len(a->family));
+	if (a->family == AF_INET) {
+		add_attr(n, IFA_ADDRESS, a->addr, 4);
+		/* as "ip addr add ... brd +" */
+		if (type == RTM_NEWADDR && a->prefixlen < 31) {
+			__u32 brd;
+
+			memcpy(&brd, a->addr, 4);
+			brd |= htonl(0xFFFFFFFFU >> a->prefixlen);
+			add_attr(n, IFA_BROADCAST, &brd, 4);
+		}
+	}
+	batch_done(b, n);
+}
+
+static void promote_secondaries(struct netinfo *if_it)
+{
+	char path[PATH_MAX];
+	FILE *fp;
+
+	snprintf(path, sizeof(path), PROMOTE_SECONDARIES, if_it->name);
+	fp = fopen(path, "w");
+	if (fp == NULL) {
+		debug("Can't open %s: %s", path, strerror(errno));
+		return;
+	}
+	fputs("1", fp);
+	fclose(fp);
+}
+
+int rtnl_update_addrs(struct netinfo *if_it, struct namelist *want,
+		struct namelist *current)
+{
+	struct addr *wa, *ca;
+	int wn = 0, cn = 0, i, promote = 0;
+	struct rtnl_batch *b = NULL;
+	int rc = -1;
+
+	wa = parse_addrs(want, &wn);
+	ca = parse_addrs(current, &cn);
+	if (wa == NULL || ca == NULL)
+		goto out;
+
+	b = malloc(sizeof(*b));
+	if (b == NULL) {
+		error(errno, "ERROR: can't allocate memory");
+		goto out;
+	}
+	if (batch_open(b) != 0)
+		goto out;
+
+	for (i = 0; i < cn; i++)
+		if (ca[i].family == AF_INET && !find_addr(wa, wn, &ca[i], 1))
+			promote = 1;
+	if (promote)
+		promote_secondaries(if_it);
+
+	/* new addresses go first, so that device always has some address */
+	for (i = 0; i < wn; i++)
+		if (!find_addr(ca, cn, &wa[i], 0))
+			queue_addr(b, RTM_NEWADDR, if_it, &wa[i]);
+	for (i = 0; i < cn; i++)
+		if (!find_addr(wa, wn, &ca[i], 1))
+			queue_addr(b, RTM_DELADDR, if_it, &ca[i]);
+	/* addresses which only change prefix are added after their deletion */
+	for (i = 0; i < wn; i++)
+		if (find_addr(ca, cn, &wa[i], 0) && !find_addr(ca, cn, &wa[i], 1))
+			queue_addr(b, RTM_NEWADDR, if_it, &wa[i]);
+
+	rc = batch_close(b);
+
+out:
+	free(b);
+	free(wa);
+	free(ca);
+
+	return rc;
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2020 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * native rtnetlink configuration of routes and addresses
+ */
+
+#ifndef __RTNL_H__
+#define __RTNL_H__
+
+#include "../netinfo.h"
+#include "../namelist.h"
+
+/* all changes of one call are sent in few batches of netlink messages,
+   error of each message is reported with its value
+   return 0 or error of the last failed change */
+
+/* replace routes of device, values are in --route format */
+int rtnl_replace_routes(struct netinfo *if_it, struct namelist *routes);
+
+/* delete routes of del and replace routes of add, other routes of device
+   stay untouched, values are in --route format */
+int rtnl_update_routes(struct netinfo *if_it, struct namelist *add,
+		struct namelist *del);
+
+/* replace default route of family of each gateway by route via it,
+   "remove" and "removev6" only delete default route */
+int rtnl_set_gateways(struct netinfo *if_it, struct namelist *gws);
+
+/* delete IPv6 addresses of global scope from device */
+int rtnl_flush_ipv6(struct netinfo *if_it);
+
+/* add addresses of want absent in current and delete addresses of current
+   absent in want, others stay untouched; values are in --ip format */
+int rtnl_update_addrs(struct netinfo *if_it, struct namelist *want,
+		struct namelist *current);
+
+#endif
@@ -0,0 +1,39 @@
+#!/bin/bash
+# Copyright (c) 2017-2020 Virtuozzo International GmbH. All rights reserved.
+#
+# This script brings up device inside Debian like VM after its configuration
+# was written by set scripts with PRL_NETTOOL_DEFER=yes.
+#
+# Parameters: <dev> <mac>
+#   <dev>         - name of device. (example: eth2)
+#   <mac>         - hardware address of device
+#
+
+prog="$0"
+path="${prog%/*}"
+funcs="$path/functions"
+
+if [ -f "$funcs" ] ; then
+	. $funcs
+else
+	echo "Program $0"
+	echo "'$funcs' was not found"
+	exit 1
+fi
+
+ETH_DEV=$1
+ETH_MAC=$2
+
+unset PRL_NETTOOL_DEFER
+
+if is_netplan_controlled; then
+	# netplan configuration is applied by debian-netplan_restart.sh
+	exit 0
+elif [ -f $NWSYSTEMCONF -o -f $NMCONFFILE ]; then
+	call_nm_script $0 "$@"
+	exit $?
+fi
+
+$path/debian-restart.sh ${ETH_DEV}
+
+# end of script
@@ -3,6 +3,9 @@
 #
 # This script restart network inside Debian-based VM controlled by netplan.
 #
+# Parameters: [<dev> ...]
+#   <dev>         - apply configuration of these devices only
+#
 
 prog="$0"
 path="${prog%/*}"
@@ -17,8 +20,12 @@ else
 fi
 
 if is_netplan_controlled; then
-	$path/$NETPLAN_CFG -a "restart" -d "$1"
-	exit $?
+	[ $# -eq 0 ] && set -- ""
+	rc=0
+	for dev in "$@"; do
+		$path/$NETPLAN_CFG -a "restart" -d "$dev" || rc=$?
+	done
+	exit $rc
 else
 	exit 0
 fi
@@ -4,6 +4,9 @@
 #
 # This script restart network inside Debian like VM.
 #
+# Parameters: [<dev> <mac>]
+#   <dev>         - restart only this device
+#   <mac>         - hardware address of device
   
 
 prog="$0"
@@ -27,14 +30,26 @@ function restart_conf()
 function restart_iface()
 {
 	local iface=$1
+	local pids=""
+	local pid
+	local rc=0
 
 	restart_conf $iface || return $?
 	
 	conf_suffix=(`cat /etc/network/interfaces | grep "^\s*auto $iface:.*$" | sed "s@\s*auto $iface:\(\d*\)\s*@\1@"`)
+	# aliases are brought up at once
 	for suffix in ${conf_suffix[@]}
 	do
-		restart_conf "$iface:$suffix" || return $?
+		restart_conf "$iface:$suffix" &
+		pids="$pids $!"
 	done
+
+	for pid in $pids
+	do
+		wait $pid || rc=$?
+	done
+
+	return $rc
 }
 
 function restart()
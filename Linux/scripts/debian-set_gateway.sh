@@ -24,15 +24,15 @@ else
 fi
 
 ETH_DEV=$1
-ETH_GATEWAY=$2
+read_value ETH_GATEWAY "$2"
 ETH_MAC=$3
 ETH_MAC_NW=`echo $ETH_MAC | sed "s,00,0,g"`
 
 if is_netplan_controlled; then
-	$path/$NETPLAN_CFG -a "set_gateway" -d "$ETH_DEV" -i "$ETH_GATEWAY"
+	printf '%s' "$ETH_GATEWAY" | $path/$NETPLAN_CFG -a "set_gateway" -d "$ETH_DEV" -i -
 	exit $?
 elif [ -f $NWSYSTEMCONF -o -f $NMCONFFILE ]; then
-	call_nm_script $0 "$@"
+	printf '%s' "${ETH_GATEWAY}" | call_nm_script $0 "$@"
 	exit $?
 else
 	for gw in ${ETH_GATEWAY}; do
@@ -78,7 +78,7 @@ else
 
 fi
 
-$path/debian-restart.sh ${ETH_DEV}
+is_deferred || $path/debian-restart.sh ${ETH_DEV}
 
 exit 0
 # end of script
@@ -26,14 +26,15 @@ fi
 
 ETH_DEV=$1
 ETH_MAC=$2
-IP_MASKS=$3
+read_value IP_MASKS "$3"
 OPTIONS=$4
 ETH_MAC_NW=`echo $ETH_MAC | sed "s,00,0,g"`
 IFNUM=-1
 IFNUM6=-1
-IP4_MASKS=
-IP6_MASK=
+IP4_MASKS=()
+IP6_MASKS=()
 SET_AUTO[0]="no"
+IP6_ADDRS=()
 
 set_options "${OPTIONS}"
 
@@ -41,36 +42,53 @@ for ip_mask in ${IP_MASKS}; do
 	if [ "${ip_mask}" == "remove" ] ; then
 		continue
 	elif is_ipv6 ${ip_mask}; then
-		IP6_MASKS="${IP6_MASKS} ${ip_mask}"
+		IP6_MASKS+=("${ip_mask}")
 	else
-		IP4_MASKS="${IP4_MASKS} ${ip_mask}"
+		IP4_MASKS+=("${ip_mask}")
 	fi
 done
 
 
+# stanzas are printed to stdout, set_ip appends them to
+# $DEBIAN_CONFIGFILE at once
 function print_ipv6_header()
 {
 	local device=$1
 	local method=$2
 	if [ "${SET_AUTO[0]}" != "yes" ] ; then
 		SET_AUTO[0]="yes"
-		echo "auto ${device}" >> $DEBIAN_CONFIGFILE
+		echo "auto ${device}"
 	fi
 
-	echo "iface ${device} inet6 ${method}" >> $DEBIAN_CONFIGFILE
+	echo "iface ${device} inet6 ${method}"
 
 	# 2.6.35 kernel doesn't flush IPv6 addresses
-	echo "	pre-down ip -6 addr flush dev ${device} scope global || :" >> $DEBIAN_CONFIGFILE
+	echo "	pre-down ip -6 addr flush dev ${device} scope global || :"
+}
+
+function print_ip6()
+{
+	local device=$1
+	local ip_mask
+
+	[ ${#IP6_ADDRS[@]} -eq 0 ] && return 0
+
+	print_ipv6_header ${device} static
+
+	echo "	address ${IP6_ADDRS[0]%/*}"
+	echo "	netmask ${IP6_ADDRS[0]##*/}"
+	for ip_mask in "${IP6_ADDRS[@]:1}"; do
+		echo "	up ip addr add ${ip_mask} dev ${device}"
+	done
+
+	echo
+	echo
 }
 
 function add_ip6()
 {
 	local ip=$1
 	local mask=$2
-	local device=$3
-	local ifnum=${IFNUM6}
-	local ifnum_postfix=":${IFNUM6}"
-	local inet="inet6"
 
 	[ -z "${ip}" ] && \
 		error "Empty value of IP"
@@ -78,36 +96,8 @@ function add_ip6()
 	[ -z "${mask}" ] && \
 		error "Empty value of MASK"
 
-
-	if [ "x${IFNUM6}" == "x0" ] ; then
-		print_ipv6_header ${device} static
-
-		echo "	address ${ip}" >> $DEBIAN_CONFIGFILE
-		echo "	netmask ${mask}" >> $DEBIAN_CONFIGFILE
-	else
-		awk 'BEGIN {found = 0}
-		NF == 0 {next}
-		!found && $1 == "iface" && $2 ~/'${device}'$/ && $3 == "inet6" {
-			found = 1;
-			print;
-			next;
-		}
-		found == 1 && !/^\t/{
-			print "\tup ip addr add '${ip}'/'${mask}' dev '${device}'";
-			found++;
-		}
-		{print}
-		END {
-			if (found == 1) {
-				print "\tup ip addr add '${ip}'/'${mask}' dev '${device}'";
-			}
-		}
-		' < ${DEBIAN_CONFIGFILE} > ${DEBIAN_CONFIGFILE}.$$ && \
-			mv -f ${DEBIAN_CONFIGFILE}.$$ ${DEBIAN_CONFIGFILE}
-	fi
-	
-	echo >> $DEBIAN_CONFIGFILE
-	echo >> $DEBIAN_CONFIGFILE
+	# secondary addresses are added by "up" lines of one stanza
+	IP6_ADDRS+=("${ip}/${mask}")
 }
 
 function create_config()
@@ -129,67 +119,70 @@ function create_config()
 
 	if [ "${SET_AUTO[${ifnum}]}" != "yes" ] ; then
 		SET_AUTO[${ifnum}]="yes"
-		echo "auto ${device}${ifnum_postfix}" >> $DEBIAN_CONFIGFILE
+		echo "auto ${device}${ifnum_postfix}"
 	fi
 
 	if [ "${ip}" == "remove" ] ; then
-		echo "" >> $DEBIAN_CONFIGFILE
+		echo ""
 		return
 	fi
 
-	echo "iface ${device}${ifnum_postfix} ${inet} static" >> $DEBIAN_CONFIGFILE
-
-	echo "	address ${ip}
-	netmask ${mask}" >> $DEBIAN_CONFIGFILE
-	echo "	broadcast +
-" >> $DEBIAN_CONFIGFILE
+	echo "iface ${device}${ifnum_postfix} ${inet} static
+	address ${ip}
+	netmask ${mask}
+	broadcast +
+"
 }
 
-function set_ip()
+function print_config()
 {
 	local ip_mask ip mask
-	local new_ips
 
-	remove_debian_interfaces ${ETH_DEV}
-	remove_debian_interfaces "${ETH_DEV}:[0-9]+"
-
-	new_ips="${IP_MASKS}"
-	for ip_mask in ${new_ips}; do
+	for ip_mask in ${IP_MASKS}; do
+		if [ "${ip_mask}" != "${ip_mask#*/}" ] ; then
+			mask=${ip_mask##*/}
+		else
+			mask=
+		fi
+		ip=${ip_mask%%/*}
 		if is_ipv6 ${ip_mask} ; then
 			let IFNUM6=IFNUM6+1
-			if echo ${ip_mask} | grep -q '/' ; then
-				mask=${ip_mask##*/}
-			else
-				mask='64'
-			fi
-			ip=${ip_mask%%/*}
-			add_ip6 "${ip}" "${mask}" ${ETH_DEV}
+			add_ip6 "${ip}" "${mask:-64}"
 		else
 			let IFNUM=IFNUM+1
-			if echo ${ip_mask} | grep -q '/' ; then
-				mask=${ip_mask##*/}
-			else
-				mask='255.255.255.255'
-			fi
-			ip=${ip_mask%%/*}
-			create_config "${ip}" "${mask}" ${ETH_DEV}
+			create_config "${ip}" "${mask:-255.255.255.255}" ${ETH_DEV}
 		fi
 	done
 
-	#clean IPv4
-	ip -4 addr flush dev ${ETH_DEV}
-	if [ "x$IP4_MASKS" == "x" ] ; then
+	print_ip6 ${ETH_DEV}
+
+	if [ ${#IP4_MASKS[@]} -eq 0 ] ; then
 		if [ $USE_DHCPV4 -eq 1 ] ; then
 			echo "
 iface ${ETH_DEV} inet dhcp
-" >> $DEBIAN_CONFIGFILE
+"
 		fi
 	fi
 
 	# unset IPv6 addresses on interface down
-	[ "x$IP6_MASKS" == "x" ] && print_ipv6_header ${ETH_DEV} manual
+	[ ${#IP6_MASKS[@]} -eq 0 ] && print_ipv6_header ${ETH_DEV} manual
+	return 0
+}
+
+function set_ip()
+{
+	remove_debian_interfaces ${ETH_DEV}
+	remove_debian_interfaces "${ETH_DEV}:[0-9]+"
+
+	# thousands of addresses are written at once without
+	# rewriting the file for each one
+	print_config >> $DEBIAN_CONFIGFILE || \
+		error "Can't change file ${DEBIAN_CONFIGFILE}" $VZ_FS_NO_DISK_SPACE
+
+	#clean IPv4
+	is_live || ip -4 addr flush dev ${ETH_DEV}
 
-	if [ "x$IP6_MASKS" == "x" -a $USE_DHCPV6 -eq 1 ] ; then
+	if [ ${#IP6_MASKS[@]} -eq 0 -a $USE_DHCPV6 -eq 1 ] ; then
 		#don't support dhcpv6 by config
 		set_wide_dhcpv6 ${ETH_DEV}
 	else
@@ -198,16 +191,16 @@ iface ${ETH_DEV} inet dhcp
 }
 
 if is_netplan_controlled; then
-	$path/$NETPLAN_CFG -a "set_ip" -d "$ETH_DEV" -i "$IP_MASKS" -o "$OPTIONS"
+	printf '%s' "$IP_MASKS" | $path/$NETPLAN_CFG -a "set_ip" -d "$ETH_DEV" -i - -o "$OPTIONS"
 	exit $?
 elif [ -f $NWSYSTEMCONF -o -f $NMCONFFILE ]; then
-	call_nm_script $0 "$@"
+	printf '%s' "${IP_MASKS}" | call_nm_script $0 "$@"
 	exit $?
 else
 	set_ip
 fi
 
-$path/debian-restart.sh ${ETH_DEV}
+is_deferred || $path/debian-restart.sh ${ETH_DEV}
 
 exit 0
 # end of script
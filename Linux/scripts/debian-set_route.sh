@@ -24,71 +24,107 @@ else
 fi
 
 ETH_DEV=$1
-ETH_GATEWAY=$2
+read_value ETH_GATEWAY "$2"
 ETH_MAC=$3
 ETH_MAC_NW=`echo $ETH_MAC | sed "s,00,0,g"`
 
-if is_netplan_controlled; then
-	$path/$NETPLAN_CFG -a "set_route" -d "$ETH_DEV" -i "$ETH_GATEWAY"
-	exit $?
-elif [ -f $NWSYSTEMCONF -o -f $NMCONFFILE ]; then
-	call_nm_script $0 "$@"
-	exit $?
+if which route >/dev/null 2>&1
+then
+	route="route -A"
+	add="add"
+	via="gw"
 else
-	for gw in ${ETH_GATEWAY}; do
-		inet="inet"
+	route="ip -f"
+	add="route add"
+	via="via"
+fi
 
-		copy_fields=("address" "netmask" "broadcast")
-		if is_ipv6 ${gw} || [ "${gw}" = "removev6" ] ; then
-			inet="inet6"
-			copy_fields=("${copy_fields[@]}" "pre-down" "up ip")
-		else
-			copy_fields=("${copy_fields[@]}" "pre-up")
-		fi
+# Rewrite interfaces file once for all routes: "up" commands are added to
+# iface stanza of family after its address lines, "remove" and "removev6"
+# drop routes of family added before them and ones already in the file
+function set_routes()
+{
+	local gw inet remove4=0 remove6=0
+	local up4=() up6=()
 
-		cmd=
-		for f in "${copy_fields[@]}"; do
-			cmd="$cmd"'
-				/^\t'"$f"'/ {print; next; }'
-		done
+	for gw in ${ETH_GATEWAY}; do
+		if [ "${gw}" == "remove" ] ; then
+			remove4=1
+			up4=()
+			continue
+		elif [ "${gw}" == "removev6" ] ; then
+			remove6=1
+			up6=()
+			continue
+		fi
 
+		parse_route $gw
+		inet="inet"
+		is_ipv6 ${gw} && inet="inet6"
+		hop=
+		[ -n "$ROUTE_GW" ] && hop="$via $ROUTE_GW"
+		metric=
+		[ -n "$ROUTE_METRIC" ] && metric="metric $ROUTE_METRIC"
 
-		if which route >/dev/null 2>&1
-		then
-			route="route -A"
-			add="add"
-			via="gw"
+		if [ "$inet" == "inet6" ] ; then
+			up6+=("	up ${route} ${inet} ${add} ${ROUTE_IP} ${hop} dev ${ETH_DEV} ${metric}")
 		else
-			route="ip -f"
-			add="route add"
-			via="via"
+			up4+=("	up ${route} ${inet} ${add} ${ROUTE_IP} ${hop} dev ${ETH_DEV} ${metric}")
 		fi
+	done
 
-		if [ "${gw}" == "remove" -o "${gw}" == "removev6" ] ; then
-			cmd="$cmd"'
-				/^\tup '${route}' '${inet}' '${add}' .* dev '${ETH_DEV}'/ { next; }'
-		else
-			ip=$(route_ip $gw)
-			hop=$(route_gw $gw)
-			[ -n "$hop" ] && hop="$via $hop"
-			metric=$(route_metric $gw)
-			[ -n "$metric" ] && metric="metric $metric"
-			cmd="$cmd"'
-				$1 == "iface" && $2 ~/'${ETH_DEV}'$/ && $3 == "'${inet}'" { addgw=1; print; next; }
-				addgw {
-					print "\tup '${route}' '${inet}' '${add}' '${ip}' '"${hop}"' dev '${ETH_DEV}' '"${metric}"'";
-					addgw=0
-				}'
-		fi
-		cmd="$cmd"'
-			{ print }'
+	# new lines are read from stdin, they may not fit to awk arguments,
+	# it is never empty to tell it from interfaces file
+	{
+		echo "routes"
+		for gw in "${up4[@]}"; do echo "inet	$gw"; done
+		for gw in "${up6[@]}"; do echo "inet6	$gw"; done
+	} | awk -v dev="${ETH_DEV}" -v route="${route}" -v add="${add}" \
+		-v remove4=$remove4 -v remove6=$remove6 '
+		function flush() {
+			if (fam != "")
+				for (i = 0; i < count[fam]; i++)
+					print lines[fam, i]
+			fam = ""
+		}
+		NR == FNR {
+			if (FNR == 1)
+				next
+			f = substr($0, 1, index($0, "\t") - 1)
+			lines[f, count[f]++] = substr($0, length(f) + 2)
+			next
+		}
+		# routes of family are removed
+		remove4 && index($0, "\tup " route " inet " add " ") == 1 &&
+			$0 ~ (" dev " dev "( |$)") { next }
+		remove6 && index($0, "\tup " route " inet6 " add " ") == 1 &&
+			$0 ~ (" dev " dev "( |$)") { next }
+		$1 == "iface" && $2 ~ (dev "$") && ($3 == "inet" || $3 == "inet6") {
+			flush()
+			fam = $3
+			print
+			next
+		}
+		# keep address lines at the beginning of stanza
+		fam == "inet" && /^\t(address|netmask|broadcast|pre-up)/ { print; next }
+		fam == "inet6" && /^\t(address|netmask|broadcast|pre-down|up ip)/ { print; next }
+		{ flush(); print }
+		END { flush() }
+	' - ${DEBIAN_CONFIGFILE} > ${DEBIAN_CONFIGFILE}.$$ && \
+		mv -f ${DEBIAN_CONFIGFILE}.$$ ${DEBIAN_CONFIGFILE}
+}
 
-		awk "${cmd}" < ${DEBIAN_CONFIGFILE} > ${DEBIAN_CONFIGFILE}.$$ && \
-			mv -f ${DEBIAN_CONFIGFILE}.$$ ${DEBIAN_CONFIGFILE}
-	done
+if is_netplan_controlled; then
+	printf '%s' "$ETH_GATEWAY" | $path/$NETPLAN_CFG -a "set_route" -d "$ETH_DEV" -i -
+	exit $?
+elif [ -f $NWSYSTEMCONF -o -f $NMCONFFILE ]; then
+	printf '%s' "$ETH_GATEWAY" | call_nm_script $0 "$@"
+	exit $?
+else
+	set_routes
 fi
 
-$path/debian-restart.sh ${ETH_DEV}
+is_deferred || $path/debian-restart.sh ${ETH_DEV}
 
 exit 0
 # end of script
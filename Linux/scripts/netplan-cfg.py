@@ -159,17 +159,17 @@ class npConfig(object):
 		set_route action implementation for netplan config
 		"""
 		route_tree = self.__get_route_tree()
+		# keys of routes in the tree, duplicates are checked in O(1)
+		# for thousands of routes
+		route_key = lambda route: tuple(sorted(route.items()))
+		seen = set(route_key(route) for route in route_tree)
 
 		for ip in self._ip.split():
-			if ip == 'remove':
-				for route in route_tree:
-					if is_ip_proto(route["to"], 4):
-							route_tree.remove(route)
-
-			elif ip == 'remove6':
-				for route in route_tree:
-					if is_ip_proto(route["to"], 6):
-							route_tree.remove(route)
+			if ip == 'remove' or ip == 'remove6':
+				proto = 4 if ip == 'remove' else 6
+				route_tree[:] = [route for route in route_tree
+					if not is_ip_proto(route["to"], proto)]
+				seen = set(route_key(route) for route in route_tree)
 
 			else:
 				to, via, metric = split_route(ip)
@@ -180,7 +180,8 @@ class npConfig(object):
 					route["scope"] = "link"
 
 				# Check for duplicates before adding route
-				if route not in route_tree:
+				if route_key(route) not in seen:
+					seen.add(route_key(route))
 					route_tree.append(route)
 
 	def __set_ip(self):
@@ -194,7 +195,7 @@ class npConfig(object):
 		ifcfg = self.config["network"]["ethernets"][self._ifname]
 
 		for ip in self._ip.split():
-			if self._ip == 'remove' or self._ip == 'remove6':
+			if ip == 'remove' or ip == 'remove6':
 				continue
 
 			if "addresses" not in ifcfg:
@@ -220,8 +221,8 @@ class npConfig(object):
 		for opt in self._options.split():
 			if opt =="dhcp":
 				ifcfg["dhcp4"] = True
-			if opt =="dhcp6":
-				fcfg["dhcp6"] = True
+			if opt =="dhcpv6":
+				ifcfg["dhcp6"] = True
 
 	def __checkFeature(self, feature):
 		"""
@@ -239,10 +240,39 @@ class npConfig(object):
 			return True
 		return False
 
+	def __reconfigure(self):
+		"""
+		apply configuration of single device with systemd-networkd,
+		other devices keep their traffic
+		"""
+		if self.config["network"].get("renderer", "networkd") != "networkd":
+			return False
+
+		if self.__generate():
+			return False
+
+		try:
+			p = subprocess.Popen(["networkctl", "reconfigure", self._ifname],
+				stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+		except OSError:
+			# no systemd-networkd
+			return False
+		out = p.communicate()
+
+		if p.returncode:
+			print("networkctl reconfigure failed [%d].\nstdout:%s\nstderr:%s\n" %
+				(p.returncode, str(out[0]), str(out[1])))
+			return False
+
+		return True
+
 	def __restart(self):
 		"""
 		restart action implementation for netplan config
 		"""
+		if self._ifname and self.__reconfigure():
+			return 0
+
 		p = subprocess.Popen("netplan apply".split(), stdout=subprocess.PIPE, stderr=subprocess.PIPE)
 		out = p.communicate()
 
@@ -271,7 +301,7 @@ class npConfig(object):
 		"""
 		ifcfg = self.config["network"]["ethernets"][self._ifname]
 
-		if self._proto == 6:
+		if int(self._proto) == 6:
 			dhcpvp = "dhcp6"
 		else:
 			dhcpvp = "dhcp4"
@@ -324,7 +354,9 @@ class npConfig(object):
 			self.__set_gateway()
 
 		self.__save()
-		self.__generate()
+		# prl_nettool applies configuration at the end of transaction
+		if os.environ.get("PRL_NETTOOL_DEFER") not in ("yes", "live"):
+			self.__generate()
 		return 0
 
 
@@ -333,6 +365,9 @@ Main body starts here
 """
 if __name__ == '__main__':
 	args = getArgParser().parse_args()
+	# long lists of addresses and routes are passed on stdin
+	if args.ip == "-":
+		args.ip = sys.stdin.read()
 
 	npcfg = npConfig(action=args.action, device=args.device,
 		ip=args.ip, proto=args.proto, options=args.options)
@@ -0,0 +1,34 @@
+#!/bin/bash
+# Copyright (c) 2017-2020 Virtuozzo International GmbH. All rights reserved.
+#
+# This script brings up device inside VM controlled with NM after its configuration
+# was written by set scripts with PRL_NETTOOL_DEFER=yes.
+#
+# Parameters: <dev> <mac>
+#   <dev>         - name of device. (example: eth2)
+#   <mac>         - hardware address of device
+#
+
+prog="$0"
+path="${prog%/*}"
+funcs="$path/functions"
+
+if [ -f "$funcs" ] ; then
+	. $funcs
+else
+	echo "Program $0"
+	echo "'$funcs' was not found"
+	exit 1
+fi
+
+ETH_DEV=$1
+ETH_MAC=$2
+
+unset PRL_NETTOOL_DEFER
+
+uuid=`nm_get_if_field $ETH_DEV connection.uuid` ||
+	exit $?
+
+call_nmcli c up $uuid
+
+# end of script
@@ -4,6 +4,9 @@
 #
 # This script restart network inside RedHat like VM.
 #
+# Parameters: [<dev> <mac>]
+#   <dev>         - restart only this device
+#   <mac>         - hardware address of device
 
 prog="$0"
 path="${prog%/*}"
@@ -17,6 +20,16 @@ else
 	exit 1
 fi
   
+if [ -n "$1" ]; then
+	uuid=`nm_get_if_field $1 connection.uuid`
+	if [ -n "$uuid" ]; then
+		call_nmcli c up $uuid
+	else
+		call_nmcli d connect $1
+	fi
+	exit $?
+fi
+
 service_command NetworkManager stop &&
 service_command network restart &&
 service_command NetworkManager start
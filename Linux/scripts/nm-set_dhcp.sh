@@ -57,5 +57,5 @@ fi
 
 [ $PROTO6 == "auto" ] && nmcli_clean_ip_and_gw $uuid 6
 
-call_nmcli c up $uuid || exit $?
+is_deferred || call_nmcli c up $uuid || exit $?
 # end of script
@@ -24,7 +24,7 @@ fi
 
 
 ETH_DEV=$1
-ETH_GATEWAY=$2
+read_value ETH_GATEWAY "$2"
 ETH_MAC=$3
 
 uuid=`nm_check_and_create $ETH_DEV $ETH_MAC` ||
@@ -48,7 +48,7 @@ function set_gateway()
 		[ $? -ne 0 ] && errors=$((errors + 1))
 	done
 
-	call_nmcli c up $uuid || return $?
+	is_deferred || call_nmcli c up $uuid || return $?
 
 	return $errors
 }
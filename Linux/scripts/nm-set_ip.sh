@@ -27,7 +27,7 @@ fi
 
 ETH_DEV=$1
 ETH_MAC=$2
-IP_MASKS=$3
+read_value IP_MASKS "$3"
 OPTIONS=$4
 
 IP4_COUNT=0
@@ -90,10 +90,10 @@ function mask2cidr()
 function set_ip()
 {
 	local ip_mask ip mask
-	local new_ips
-	local plusv4=""
-	local plusv6=""
+	local new_ips=()
+	local addrs4=() addrs6=()
 	local errors=0
+	declare -A cidrs
 
 	for ip_mask in ${IP_MASKS}; do
 		[ "${ip_mask}" = "remove" ] && continue
@@ -102,7 +102,7 @@ function set_ip()
 		else
 			let IP4_COUNT=IP4_COUNT+1
 		fi
-		new_ips="${new_ips} ${ip_mask}"
+		new_ips+=("${ip_mask}")
 	done
 
 	if [ $USE_DHCPV4 -eq 1 ]; then
@@ -118,27 +118,34 @@ function set_ip()
 		IPV6_MANUAL="ipv6.method manual"
 	fi
 
-	for ip_mask in ${new_ips}; do
+	# addresses of family are set at once, not by nmcli call for each one
+	for ip_mask in "${new_ips[@]}"; do
 		if ! is_ipv6 ${ip_mask}; then
-			if echo ${ip_mask} | grep -q '/' ; then
-				mask=`mask2cidr ${ip_mask##*/}`
+			if [ "${ip_mask}" != "${ip_mask#*/}" ] ; then
+				mask=${ip_mask##*/}
+				# few masks are converted for thousands of addresses
+				[ -z "${cidrs[$mask]}" ] && cidrs[$mask]=`mask2cidr $mask`
+				mask=${cidrs[$mask]}
 			else
 				mask=32
 			fi
 			ip=${ip_mask%%/*}
 
-			if [ "$mask" -ge 0 ]; then
-				call_nmcli c modify $uuid ${plusv4}ipv4.address $ip/$mask $IPV4_MANUAL
-				[ $? -ne 0 ] && errors=$((errors + 1))
-				plusv4="+"
-			fi
+			[ "$mask" -ge 0 ] && addrs4+=("$ip/$mask")
 		else
-			call_nmcli c modify $uuid ${plusv6}ipv6.address $ip_mask $IPV6_MANUAL
-			[ $? -ne 0 ] && errors=$((errors + 1))
-			plusv6="+"
+			addrs6+=("$ip_mask")
 		fi
 	done
 
+	if [ ${#addrs4[@]} -ne 0 ]; then
+		nmcli_set_list $uuid ipv4.addresses "$(join_list , "${addrs4[@]}")" \
+			$IPV4_MANUAL || errors=$((errors + 1))
+	fi
+	if [ ${#addrs6[@]} -ne 0 ]; then
+		nmcli_set_list $uuid ipv6.addresses "$(join_list , "${addrs6[@]}")" \
+			$IPV6_MANUAL || errors=$((errors + 1))
+	fi
+
 	if [ $IP4_COUNT -eq 0 ]; then
 		METHOD=""
 		if [ $USE_DHCPV4 -eq 0 ]; then
@@ -157,7 +164,7 @@ function set_ip()
 			return $?
 	fi
 
-	call_nmcli c up $uuid || return $?
+	is_deferred || call_nmcli c up $uuid || return $?
 
 	return $errors
 }
@@ -23,7 +23,7 @@ fi
 
 
 ETH_DEV=$1
-ETH_GATEWAY=$2
+read_value ETH_GATEWAY "$2"
 ETH_MAC=$3
 
 uuid=`nm_check_and_create $ETH_DEV $ETH_MAC` ||
@@ -31,25 +31,26 @@ uuid=`nm_check_and_create $ETH_DEV $ETH_MAC` ||
 
 function set_routes()
 {
-	call_nmcli c modify $uuid ipv4.routes ""
-	call_nmcli c modify $uuid ipv6.routes ""
-
-	local errors=0 args
+	local errors=0 routes4=() routes6=()
 
+	# routes of family are set at once, not by nmcli call for each one
 	if [ "${ETH_GATEWAY}" != "remove" ] ; then
 		for gw in ${ETH_GATEWAY}; do
-			args=$(split_route $gw)
+			parse_route $gw
 			if is_ipv6 ${gw}; then
-				call_nmcli c modify $uuid +ipv6.routes "${args}"
+				routes6+=("$ROUTE_IP $ROUTE_GW $ROUTE_METRIC")
 			else
-				call_nmcli c modify $uuid +ipv4.routes "${args}"
+				routes4+=("$ROUTE_IP $ROUTE_GW $ROUTE_METRIC")
 			fi
-
-			[ $? -ne 0 ] && errors=$((errors + 1))
 		done
 	fi
 
-	call_nmcli c up $uuid || return $?
+	nmcli_set_list $uuid ipv4.routes "$(join_list , "${routes4[@]}")" ||
+		errors=$((errors + 1))
+	nmcli_set_list $uuid ipv6.routes "$(join_list , "${routes6[@]}")" ||
+		errors=$((errors + 1))
+
+	is_deferred || call_nmcli c up $uuid || return $?
 
 	return $errors
 }
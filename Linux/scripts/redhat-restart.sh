@@ -4,6 +4,9 @@
 #
 # This script restart network inside RedHat like VM.
 #
+# Parameters: [<dev> <mac>]
+#   <dev>         - restart only this device
+#   <mac>         - hardware address of device
 
 prog="$0"
 path="${prog%/*}"
@@ -17,5 +20,15 @@ else
 	exit 2
 fi
 
+if [ -n "$1" ]; then
+	is_nm_active
+	if [ $? -eq 0 ]; then
+		call_nm_script $0 "$@"
+		exit $?
+	fi
+	reload_device $1
+	exit $?
+fi
+
 call_nm_script $0 "$@" || /etc/init.d/network restart
 # end of script
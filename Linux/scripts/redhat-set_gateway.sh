@@ -24,7 +24,7 @@ fi
 
 
 ETH_DEV=$1
-ETH_GATEWAY=$2
+read_value ETH_GATEWAY "$2"
 ETH_MAC=$3
 ETH_DEV_CFG=ifcfg-$ETH_DEV
 
@@ -58,13 +58,12 @@ function set_gateway()
 		fi
 	done
 	
-	is_device_up ${ETH_DEV} && /sbin/ifdown ${ETH_DEV}
-	/sbin/ifup ${ETH_DEV}
+	reload_device ${ETH_DEV}
 }
 
 is_nm_active
 if [ $? -eq 0 ]; then
-	call_nm_script $0 "$@"
+	printf '%s' "${ETH_GATEWAY}" | call_nm_script $0 "$@"
 	exit $?
 fi
 
@@ -27,7 +27,7 @@ fi
 
 ETH_DEV=$1
 ETH_MAC=$2
-IP_MASKS=$3
+read_value IP_MASKS "$3"
 OPTIONS=$4
 ETH_DEV_CFG=ifcfg-$ETH_DEV
 IFNUM=-1
@@ -58,15 +58,42 @@ function setup_network()
 	fi
 }
 
+# parameters of ${IFCFG}, written at once by write_config
+# the first set gives position of parameter and the last one its value
+declare -A IFCFG_VALUES
+IFCFG_NAMES=()
+IP6_SECONDARIES=()
+declare -A IP6_SEEN
+
+function cfg_param()
+{
+	[ -z "${IFCFG_VALUES[$1]+set}" ] && IFCFG_NAMES+=("$1")
+	IFCFG_VALUES[$1]=$2
+}
+
+function write_config()
+{
+	local ifcfg=${IFCFG_DIR}/bak/${ETH_DEV_CFG}
+	local name
+
+	[ ${#IP6_SECONDARIES[@]} -ne 0 ] && \
+		cfg_param IPV6ADDR_SECONDARIES "$(join_list ' ' "${IP6_SECONDARIES[@]}")"
+
+	for name in "${IFCFG_NAMES[@]}"; do
+		echo "${name}=\"${IFCFG_VALUES[$name]}\""
+	done > ${ifcfg} || error "Can't change file ${ifcfg}" $VZ_FS_NO_DISK_SPACE
+
+	if [ $IP6_COUNT -ne 0 ]; then
+		put_param ${NETFILE} NETWORKING_IPV6 yes
+	fi
+}
+
 function create_config()
 {
 	local ip=$1
 	local mask=$2
 	local ifnum=$3
 	local ifnum_postfix=":${ifnum}"
-	# Use the new scheme only for Fedoras with systemd and Network Manager installed
-	is_nm_present
-	local is_nm_controlled=$?
 
 	[ -z "${ip}" ] && \
 		error "Empty value of IP"
@@ -78,80 +105,83 @@ function create_config()
 
 	[ "x${ifnum}" == "x0" ] && ifnum_postfix=""
 
-	[ ${is_nm_controlled} -eq 1 ] && ifnum_postfix=""
-
-	local ifcfg=${IFCFG_DIR}/bak/${ETH_DEV_CFG}${ifnum_postfix}
-	touch ${ifcfg}
+	[ ${IS_NM_CONTROLLED} -eq 1 ] && ifnum_postfix=""
+
+	if [ -n "${ifnum_postfix}" ]; then
+		# alias has its own file
+		echo "DEVICE=\"${ETH_DEV}${ifnum_postfix}\"
+ONBOOT=\"yes\"
+BOOTPROTO=\"none\"
+HWADDR=\"${ETH_MAC}\"
+NO_ALIASROUTING=\"yes\"
+IPADDR=\"${ip}\"
+NETMASK=\"${mask}\"" > ${IFCFG_DIR}/bak/${ETH_DEV_CFG}${ifnum_postfix} || \
+			error "Can't create file ${ETH_DEV_CFG}${ifnum_postfix}" $VZ_FS_NO_DISK_SPACE
+		return 0
+	fi
 
-	if [ "x${ifnum}" == "x0" -o ${is_nm_controlled} -eq 0 ]; then
-		put_param ${ifcfg} DEVICE "${ETH_DEV}${ifnum_postfix}"
-		put_param ${ifcfg} ONBOOT yes
-		put_param ${ifcfg} BOOTPROTO none
-		put_param ${ifcfg} HWADDR ${ETH_MAC}
-		if [ -n "${ifnum_postfix}" ]; then
-			put_param ${ifcfg} NO_ALIASROUTING yes
-		fi
+	if [ "x${ifnum}" == "x0" ]; then
+		cfg_param DEVICE "${ETH_DEV}"
+		cfg_param ONBOOT yes
+		cfg_param BOOTPROTO none
+		cfg_param HWADDR ${ETH_MAC}
 	fi
-	if [ ${is_nm_controlled} -eq 1 ]; then
-		put_param ${ifcfg} IPADDR${ifnum} "${ip}"
-		put_param ${ifcfg} NETMASK${ifnum} ${mask}
+	if [ ${IS_NM_CONTROLLED} -eq 1 ]; then
+		cfg_param IPADDR${ifnum} "${ip}"
+		cfg_param NETMASK${ifnum} ${mask}
 	else
-		put_param ${ifcfg} IPADDR "${ip}"
-		put_param ${ifcfg} NETMASK ${mask}
+		cfg_param IPADDR "${ip}"
+		cfg_param NETMASK ${mask}
 	fi
 	
 	if [ "x${ifnum}" == "x0" ] ; then
 		if [ $IP6_COUNT -eq 0 -a $USE_DHCPV6 -eq 1 ]; then
-			put_param ${ifcfg} DHCPV6C yes
-			put_param ${ifcfg} DHCPV6C_OPTIONS "-d"
+			cfg_param DHCPV6C yes
+			cfg_param DHCPV6C_OPTIONS "-d"
 		fi
 	fi
 }
 
 function add_ip6()
 {
-        local ifcfg="${IFCFG_DIR}/bak/${ETH_DEV_CFG}"
-        local ip=$1
-        local mask=$2
-        local ipm
+	local ip=$1
+	local mask=$2
 	local ifnum=$3
-
-	touch ${ifcfg}
+	local ipm
 
 	if [ $ifnum -eq 0 ] ; then
-		del_param "${ifcfg}" IPV6ADDR_SECONDARIES
-		del_param "${ifcfg}" IPV6ADDR
-		put_param ${ifcfg} DHCPV6C no
-		put_param ${ifcfg} IPV6_AUTOCONF no
+		cfg_param DHCPV6C no
+		cfg_param IPV6_AUTOCONF no
 		
 		if [ $IP4_COUNT -eq 0 ]; then
-			put_param ${ifcfg} DEVICE "${ETH_DEV}${ifnum_postfix}"
-			put_param ${ifcfg} ONBOOT yes
+			cfg_param DEVICE "${ETH_DEV}"
+			cfg_param ONBOOT yes
 			if [ $USE_DHCPV4 -eq 1 ]; then
-				put_param ${ifcfg} BOOTPROTO dhcp
+				cfg_param BOOTPROTO dhcp
 			else
-				put_param ${ifcfg} BOOTPROTO none
+				cfg_param BOOTPROTO none
 			fi
-			put_param ${ifcfg} HWADDR ${ETH_MAC}
+			cfg_param HWADDR ${ETH_MAC}
 		fi
 	fi
 
-        put_param ${NETFILE} NETWORKING_IPV6 yes
-        put_param ${ifcfg} DEVICE "${ETH_DEV}" 
-        put_param ${ifcfg} IPV6INIT yes
-        if ! grep -qw "${ip}" ${ifcfg} 2>/dev/null; then
-                if [ -n "${mask}" ]; then
-                        ipm="${ip}/${mask}"
-                else
-                        ipm="${ip}"
-                fi
-
-		if [ $ifnum -eq 0 ] ; then
-			put_param ${ifcfg} IPV6ADDR "${ipm}"
-		else
-			add_param ${ifcfg} IPV6ADDR_SECONDARIES "${ipm}"
-		fi
-        fi
+	cfg_param DEVICE "${ETH_DEV}"
+	cfg_param IPV6INIT yes
+
+	[ -n "${IP6_SEEN[$ip]}" ] && return 0
+	IP6_SEEN[$ip]=1
+
+	if [ -n "${mask}" ]; then
+		ipm="${ip}/${mask}"
+	else
+		ipm="${ip}"
+	fi
+
+	if [ $ifnum -eq 0 ] ; then
+		cfg_param IPV6ADDR "${ipm}"
+	else
+		IP6_SECONDARIES+=("${ipm}")
+	fi
 }
 
 function move_configs()
@@ -199,28 +229,29 @@ function set_ip()
 
 	setup_network
 
-	new_ips="${IP_MASKS}"
+	# Use the new scheme only for Fedoras with systemd and Network Manager installed
+	is_nm_present
+	IS_NM_CONTROLLED=$?
+
+	# configuration is collected in memory and written once,
+	# thousands of addresses do not rewrite file for each one
 	for ip_mask in ${new_ips}; do
+		if [ "${ip_mask}" != "${ip_mask#*/}" ] ; then
+			mask=${ip_mask##*/}
+		else
+			mask=
+		fi
+		ip=${ip_mask%%/*}
 		if ! is_ipv6 ${ip_mask}; then
 			let IFNUM=IFNUM+1
-			if echo ${ip_mask} | grep -q '/' ; then
-				mask=${ip_mask##*/}
-			else
-				mask='255.255.255.255'
-			fi
-			ip=${ip_mask%%/*}
-			create_config "${ip}" "${mask}" "${IFNUM}"
+			create_config "${ip}" "${mask:-255.255.255.255}" "${IFNUM}"
 		else
 			let IF6NUM=IF6NUM+1
-			if echo ${ip_mask} | grep -q '/' ; then
-				mask=${ip_mask##*/}
-			else
-				mask=
-			fi
-			ip=${ip_mask%%/*}
 			add_ip6 "${ip}" "${mask}" "${IF6NUM}"
 		fi
 	done
+
+	write_config
 }
 
 function apply()
@@ -228,7 +259,8 @@ function apply()
 	#stop adapter
 	if [ "x$RESTART_NETWORK" = "xyes" ]; then
 		/etc/init.d/network stop
-	else
+	elif ! is_deferred; then
+		# addresses are already changed live or device is restarted later
 		/sbin/ifdown ${ETH_DEV}
 	fi
 
@@ -237,14 +269,14 @@ function apply()
 	#start adapter
 	if [ "x$RESTART_NETWORK" = "xyes"  ]; then
 		/etc/init.d/network start
-	else
+	elif ! is_deferred; then
 		/sbin/ifup ${ETH_DEV}
 	fi
 }
 
 is_nm_active
 if [ $? -eq 0 ]; then
-	call_nm_script $0 "$@"
+	printf '%s' "${IP_MASKS}" | call_nm_script $0 "$@"
 	exit $?
 fi
 
@@ -23,7 +23,7 @@ fi
 
 
 ETH_DEV=$1
-ETH_GATEWAY=$2
+read_value ETH_GATEWAY "$2"
 ETH_MAC=$3
 
 ETH_DEV_CFG=route-$ETH_DEV
@@ -41,26 +41,27 @@ function set_routes()
 		is_changed="yes"
 	fi
 
-	if [ "${ETH_GATEWAY}" != "remove" ] ; then
+	if [ "${ETH_GATEWAY}" != "remove" -a -n "${ETH_GATEWAY// }" ] ; then
+		# whole file is written at once
 		for gw in ${ETH_GATEWAY}; do
-			hop=$(route_gw $gw)
-			[ -n "$hop" ] && hop="via $hop"
-			metric=$(route_metric $gw)
-			[ -n "$metric" ] && metric="metric $metric"
-			echo "$(route_ip $gw) $hop dev ${ETH_DEV} $metric scope link" >> $IFCFG
-			is_changed="yes"
-		done
+			parse_route $gw
+			hop=
+			[ -n "$ROUTE_GW" ] && hop="via $ROUTE_GW"
+			metric=
+			[ -n "$ROUTE_METRIC" ] && metric="metric $ROUTE_METRIC"
+			echo "$ROUTE_IP $hop dev ${ETH_DEV} $metric scope link"
+		done > $IFCFG
+		is_changed="yes"
 	fi
 	
 	if [ "$is_changed" == "yes" ] ; then
-		is_device_up ${ETH_DEV} && /sbin/ifdown ${ETH_DEV}
-		/sbin/ifup ${ETH_DEV}
+		reload_device ${ETH_DEV}
 	fi
 }
 
 is_nm_active
 if [ $? -eq 0 ]; then
-	call_nm_script $0 "$@"
+	printf '%s' "${ETH_GATEWAY}" | call_nm_script $0 "$@"
 	exit $?
 fi
 
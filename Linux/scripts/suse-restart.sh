@@ -4,6 +4,27 @@
 #
 # This script restart network inside SuSE like VM.
 #
+# Parameters: [<dev> <mac>]
+#   <dev>         - restart only this device
+#   <mac>         - hardware address of device
+#
+
+if [ -n "$1" ]; then
+	prog="$0"
+	path="${prog%/*}"
+	funcs="$path/functions"
+
+	if [ -f "$funcs" ] ; then
+		. $funcs
+	else
+		echo "Program $0"
+		echo "'$funcs' was not found"
+		exit 1
+	fi
+
+	reload_device $1
+	exit $?
+fi
 
 /etc/init.d/network restart
   
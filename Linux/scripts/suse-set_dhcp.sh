@@ -85,9 +85,7 @@ function set_dhcp()
 	create_config
 	move_configs
 
-	is_device_up ${ETH_DEV} && /sbin/ifdown ${ETH_DEV}
-
-	/sbin/ifup ${ETH_DEV}
+	reload_device ${ETH_DEV}
 }
 
 get_suse_config_name $ETH_DEV $ETH_MAC
@@ -23,7 +23,7 @@ fi
 
 
 ETH_DEV=$1
-ETH_GATEWAY=$2
+read_value ETH_GATEWAY "$2"
 
 IFCFG_DIR=/etc/sysconfig/network/
 IFCFG=${IFCFG_DIR}/routes
@@ -42,9 +42,7 @@ function set_gateway()
 		fi
 	done
 	
-	is_device_up ${ETH_DEV} && /sbin/ifdown ${ETH_DEV}
-
-	/sbin/ifup ${ETH_DEV}
+	reload_device ${ETH_DEV}
 }
 
 set_gateway
@@ -27,7 +27,7 @@ fi
 
 ETH_DEV=$1
 ETH_MAC=$2
-IP_MASKS=$3
+read_value IP_MASKS "$3"
 OPTIONS=$4
 ETH_DEV_CFG=ifcfg-$ETH_DEV
 IFNUM=-1
@@ -37,12 +37,12 @@ IFCFG=${IFCFG_DIR}/${ETH_DEV_CFG}
 
 set_options "${OPTIONS}"
 
+# configuration is printed to stdout, set_ip writes it at once
 function create_config()
 {
 	local ip=$1
 	local mask=$2
 	local ifnum=$3
-	local ifcfg=$4
 
 	[ -z "${ip}" ] && \
 		error "Empty value of IP"
@@ -66,15 +66,13 @@ function create_config()
 	echo "BOOTPROTO='${dhcp_type}'
 STARTMODE='auto'
 USERCONTROL='no'
-IPADDR=${ip}" > ${ifcfg} || \
-	error "Unable to create interface config file" ${VZ_FS_NO_DISK_SPACE}
+IPADDR=${ip}"
 
 	if ! is_ipv6 "${ip}" ; then
-		echo "NETMASK=${mask}" >> ${ifcfg}
+		echo "NETMASK=${mask}"
 	else
-		echo "PREFIXLEN=${mask}" >> ${ifcfg}
+		echo "PREFIXLEN=${mask}"
 	fi
-
 }
 
 function add_alias()
@@ -82,13 +80,8 @@ function add_alias()
 	local ip=$1
 	local mask=$2
 	local ifnum=$3
-	local ifcfg=$4
 	local cfg
 
-	if [ ! -f ${ifcfg} ]; then
-		create_config "$ip" "$mask" "0" "$ifcfg"
-		return
-	fi
 	cfg="IPADDR_${ifnum}=${ip}
 LABEL_${ifnum}=${ifnum}"
 
@@ -100,7 +93,7 @@ NETMASK_${ifnum}=${mask}"
 PREFIXLEN_${ifnum}=${mask}"
 	fi
 
-	echo "${cfg}" >> ${ifcfg} || error "Unable to create interface config file ${ifcfg}" ${VZ_FS_NO_DISK_SPACE}
+	echo "${cfg}"
 }
 
 function move_configs()
@@ -123,7 +116,7 @@ function set_ip()
 	new_ips="${IP_MASKS}"
 	for ip_mask in ${new_ips}; do
 		let IFNUM=IFNUM+1
-		if echo ${ip_mask} | grep -q '/' ; then
+		if [ "${ip_mask}" != "${ip_mask#*/}" ] ; then
 			mask=${ip_mask##*/}
 		else
 			if is_ipv6 ${ip_mask} ; then
@@ -134,17 +127,20 @@ function set_ip()
 		fi
 		ip=${ip_mask%%/*}
 		if [ ${IFNUM} -eq 0 ] ; then
-			create_config "${ip}" "${mask}" "${IFNUM}" "${ifcfg}"
+			create_config "${ip}" "${mask}" "${IFNUM}"
 		else
-			add_alias "${ip}" "${mask}" "${IFNUM}" "${ifcfg}"
+			add_alias "${ip}" "${mask}" "${IFNUM}"
 		fi
-	done
+	done > ${ifcfg} || \
+		error "Unable to create interface config file ${ifcfg}" ${VZ_FS_NO_DISK_SPACE}
 
-	/sbin/ifdown ${ETH_DEV}
+	# addresses are already changed live or device is restarted later
+	is_deferred || /sbin/ifdown ${ETH_DEV}
 
 	move_configs
 
-	/sbin/ifup ${ETH_DEV}
+	# device is brought up at the end of transaction
+	is_deferred || /sbin/ifup ${ETH_DEV}
 }
 
 get_suse_config_name $ETH_DEV $ETH_MAC
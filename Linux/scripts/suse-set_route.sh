@@ -23,7 +23,7 @@ fi
 
 
 ETH_DEV=$1
-ETH_GATEWAY=$2
+read_value ETH_GATEWAY "$2"
 
 IFCFG_DIR=/etc/sysconfig/network/
 IFCFG=${IFCFG_DIR}/routes
@@ -34,21 +34,19 @@ function set_routes()
 
 	[ -f ${IFCFG} ] && \
 		/bin/rm -f ${IFCFG} > /dev/null 2>&1
-	touch ${IFCFG}
 
+	# whole file is written at once
 	for gw in ${ETH_GATEWAY}; do
 		if [ "${gw}" != "remove" -a "${gw}" != "removev6" ] ; then
-			hop=$(route_gw $gw)
-			[ -z "$hop" ] && hop="-"
-			metric=$(route_metric $gw)
-			[ -n "$metric" ] && metric="metric $metric"
-			echo "$(route_ip $gw) $hop - ${ETH_DEV} $metric" >> ${IFCFG}
+			parse_route $gw
+			hop=${ROUTE_GW:--}
+			metric=
+			[ -n "$ROUTE_METRIC" ] && metric="metric $ROUTE_METRIC"
+			echo "$ROUTE_IP $hop - ${ETH_DEV} $metric"
 		fi
-	done
+	done > ${IFCFG}
 	
-	is_device_up ${ETH_DEV} && /sbin/ifdown ${ETH_DEV}
-
-	/sbin/ifup ${ETH_DEV}
+	reload_device ${ETH_DEV}
 }
 
 set_routes
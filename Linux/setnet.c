@@ -30,37 +30,169 @@
 #include <string.h>
 #include <unistd.h>
 #include <dirent.h>
+#include <sys/stat.h>
 
 #include "../netinfo.h"
 #include "../namelist.h"
 #include "../options.h"
+#include "../resolvconf.h"
 #include "exec.h"
 #include "detection.h"
+#include "ifcfg.h"
+#include "rtnl.h"
+#include "netns.h"
 
 extern int os_vendor;
 extern char * os_script_prefix;
+extern const struct net_backend *net_backend;
+extern struct nettool_options net_opts;
+
+/* options stored in netplan configuration */
+#define NETPLAN_OPS	(NET_OPT_DHCP | NET_OPT_IP | NET_OPT_GATEWAY | NET_OPT_ROUTE)
+
+/* value of set scripts which is read from stdin, it may be longer
+   than command line allows for thousands of addresses and routes */
+#define STDIN_VALUE	"-"
+
+#define OS_RELEASE	"/etc/os-release"
+
+/* path of script of operation of detected backend */
+static const char *script_path(char *path, enum BACKEND_OP op)
+{
+	if (net_backend == NULL)
+		detect_distribution();
+	return backend_script(net_backend, op, path);
+}
 
 int remove_ipv6(struct netinfo *if_it)
 {
-	char cmd[PATH_MAX+1];
+	rtnl_flush_ipv6(if_it);
 
-	if (snprintf(cmd, PATH_MAX,
-				"ip -6 addr flush dev %s scope global ", if_it->name) >= PATH_MAX)
-	{
-		werror("ERROR: Command line for execution 'ip -6 addr' is too long");
-		return -1;
+	return 0;
+}
+
+/* device has static addresses only and request does not switch it to DHCP */
+static int is_static(struct netinfo *if_it)
+{
+	return !if_it->configured_with_dhcp && !if_it->configured_with_dhcpv6 &&
+		get_opt_mac(if_it->mac, NET_OPT_DHCP) == NULL;
+}
+
+int is_ip_delta(struct netinfo *if_it)
+{
+	if (if_it->live & NET_OPT_IP)
+		return 1;
+	//device of other network namespace has kernel state only
+	if (netns_current() != NULL)
+		return 1;
+
+	return net_opts.delta && is_static(if_it);
+}
+
+/* add and delete scanned addresses of device to match value */
+static int update_addrs(struct netinfo *if_it, const char *value)
+{
+	struct namelist *want = NULL, *current = NULL, *it;
+	int rc;
+
+	namelist_split(&want, value);
+	for (it = if_it->ip; it != NULL; it = it->next)
+		if (it->name != NULL && !namelist_search(it->name, &if_it->ip_link))
+			namelist_add(it->name, &current);
+
+	rc = rtnl_update_addrs(if_it, want, current);
+
+	namelist_clean(&want);
+	namelist_clean(&current);
+
+	return rc;
+}
+
+int set_live(struct netinfo *if_it, struct nettool_mac *params)
+{
+	struct namelist *values = NULL;
+	int rc;
+
+	if (params->type == NET_OPT_IP) {
+		if (!is_static(if_it))
+			return 1;
+		rc = update_addrs(if_it, params->value);
+	} else if (params->type == NET_OPT_GATEWAY || params->type == NET_OPT_ROUTE) {
+		//set_* functions leave such device untouched
+		if (if_it->configured_with_dhcp && if_it->configured_with_dhcpv6)
+			return 1;
+		namelist_split(&values, params->value);
+		if (params->type == NET_OPT_GATEWAY)
+			rc = rtnl_set_gateways(if_it, values);
+		else
+			rc = rtnl_replace_routes(if_it, values);
+		namelist_clean(&values);
+	} else {
+		return 1;
 	}
 
-	run_cmd(cmd);
+	if (rc == 0)
+		if_it->live |= params->type;
 
-	return 0;
+	return rc;
+}
+
+int set_delta(struct netinfo *if_it, unsigned int type, struct namelist *add,
+		struct namelist *del)
+{
+	int rc;
+
+	if (type == NET_OPT_IP) {
+		if (!is_static(if_it))
+			return 1;
+		rc = rtnl_update_addrs(if_it, add, del);
+	} else if (type == NET_OPT_ROUTE) {
+		//set_route() leaves such device untouched
+		if (if_it->configured_with_dhcp && if_it->configured_with_dhcpv6)
+			return 1;
+		rc = rtnl_update_routes(if_it, add, del);
+	} else {
+		return 1;
+	}
+
+	if (rc == 0)
+		if_it->live |= type;
+
+	return rc;
+}
+
+/* change only differing addresses live, configuration is rewritten
+   by script without restart of device */
+static int set_ip_delta(struct netinfo *if_it, struct nettool_mac *params)
+{
+	char path[PATH_MAX];
+	int rc = 0;
+
+	//addresses were set already by set_live()
+	if (!(if_it->live & NET_OPT_IP))
+		rc = update_addrs(if_it, params->value);
+
+	if (rc == 0 && os_script_prefix != NULL) {
+		const char *argv[] = {script_path(path, OP_SET_IP), if_it->name,
+					if_it->mac, STDIN_VALUE, "", NULL};
+
+		if (net_backend->set_ip != NULL)
+			rc = net_backend->set_ip(if_it, params->value, "", 1);
+		else
+			rc = run_cmdv_live(argv, params->value);
+	}
+
+	return rc;
 }
 
 int set_ip(struct netinfo *if_it, struct nettool_mac *params){
-	char cmd[PATH_MAX+1];
+	char path[PATH_MAX];
 	int rc;
 	char opts[100] = {'\0'};
 
+	if (is_ip_delta(if_it))
+		return set_ip_delta(if_it, params);
+
 	if (!os_script_prefix) {
 		werror("Current distribution is not supported");
 		return 0; //TODO: need to support other distribs
@@ -82,21 +214,153 @@ int set_ip(struct netinfo *if_it, struct nettool_mac *params){
 			strcat(opts, "nodhcp");
 	}
 
-	if (snprintf(cmd, PATH_MAX, SCRIPT_DIR "/%s-set_ip.sh \"%s\" \"%s\" \"%s\" \"%s\"",
-			os_script_prefix,
-			if_it->name, if_it->mac, params->value, opts) >= PATH_MAX)
-	{
-		werror("ERROR: Command line for execution %s-set_ip.sh is too long", os_script_prefix);
-		return -1;
-	}
+	const char *argv[] = {script_path(path, OP_SET_IP), if_it->name, if_it->mac,
+				STDIN_VALUE, opts, NULL};
 
 	if_it->configured_with_dhcp = 0;
 
-	rc = run_cmd(cmd);
+	if (net_backend->set_ip != NULL)
+		rc = net_backend->set_ip(if_it, params->value, opts, 0);
+	else
+		rc = run_cmdv_input(argv, params->value);
 
 	return rc;
 }
 
+/* dhclient.conf of distribution, the one set_dns.sh used */
+static const char *dhclient_conf(void)
+{
+	struct ifcfg *release;
+	const char *id;
+	int ubuntu = 0;
+
+	if (os_script_prefix != NULL && !strcmp(os_script_prefix, "debian")) {
+		release = ifcfg_open(OS_RELEASE, 1, '"');
+		if (release != NULL) {
+			id = ifcfg_get(release, "ID");
+			ubuntu = id != NULL && !strcmp(id, "ubuntu");
+			ifcfg_free(release);
+		}
+		//only old ubuntu has dhcp3-client
+		if (ubuntu && access("/etc/dhcp3", F_OK) == 0)
+			return "/etc/dhcp3/dhclient.conf";
+		return "/etc/dhcp/dhclient.conf";
+	}
+	if (os_script_prefix != NULL && !strcmp(os_script_prefix, "redhat"))
+		return "/etc/dhcp/dhclient.conf";
+	if (os_script_prefix != NULL && !strcmp(os_script_prefix, "suse"))
+		return "/etc/dhclient.conf";
+	if (access("/etc/dhcp", F_OK) == 0)
+		return "/etc/dhcp/dhclient.conf";
+	return "/etc/dhclient.conf";
+}
+
+/* load file, missing one is empty */
+static int load_resolver_file(struct resolvconf_line *head, const char *path)
+{
+	int rc;
+
+	rc = resolvconf_load__(head, path);
+	if (rc == -ENOENT) {
+		resolvconf_init(head);
+		rc = 0;
+	}
+	if (rc)
+		error(-rc, "Can't read %s", path);
+
+	return rc;
+}
+
+static int save_resolver_file(struct resolvconf_line *head, const char *path)
+{
+	int rc;
+
+	rc = resolvconf_save__(head, path);
+	if (rc)
+		error(-rc, "Can't change file %s", path);
+
+	return rc;
+}
+
+/* set nameservers and search domains in resolv.conf, or in static part
+   of it if it is generated by resolvconf, and dhclient prepend directives,
+   NULL or empty value is left as it is, "#" removes it,
+   each file is edited in memory and written at once */
+static int set_resolver_files(const char *servers, const char *search)
+{
+	struct resolvconf_line resolv, dhclient;
+	const char *resolv_path = resolvconf_base();
+	const char *dhclient_path = dhclient_conf();
+	char dir[PATH_MAX], *p;
+	int rc;
+
+	//empty value is not set, as set_dns.sh did
+	if (search != NULL && *search == '\0')
+		search = NULL;
+	if (servers != NULL && *servers == '\0')
+		servers = NULL;
+	if (search == NULL && servers == NULL)
+		return 0;
+
+	//value for empty search list
+	if (search != NULL && (!strcmp(search, "remove") || !strcmp(search, "#")))
+		search = "";
+	if (servers != NULL && !strcmp(servers, "#"))
+		servers = "";
+
+	snprintf(dir, sizeof(dir), "%s", dhclient_path);
+	p = strrchr(dir, '/');
+	if (p != NULL && p != dir) {
+		*p = '\0';
+		if (mkdir(dir, 0755) && errno != EEXIST) {
+			error(errno, "Can't create %s", dir);
+			return -1;
+		}
+	}
+
+	if (load_resolver_file(&resolv, resolv_path))
+		return -1;
+	if (load_resolver_file(&dhclient, dhclient_path)) {
+		resolvconf_free(&resolv);
+		return -1;
+	}
+
+	rc = 0;
+	if (search != NULL) {
+		if (*search == '\0')
+			rc = resolvconf_del_search_list(&resolv);
+		else
+			rc = resolvconf_set_search_list(&resolv, search);
+		if (rc == 0)
+			rc = resolvconf_set_prepend(&dhclient, "domain-search", search, 1);
+	}
+	if (rc == 0 && servers != NULL) {
+		rc = resolvconf_set_nameservers(&resolv, servers);
+		if (rc == 0)
+			rc = resolvconf_set_prepend(&dhclient, "domain-name-servers",
+					servers, 0);
+	}
+
+	if (rc)
+		error(-rc, "Can't set resolver configuration");
+	else if (save_resolver_file(&resolv, resolv_path) ||
+			save_resolver_file(&dhclient, dhclient_path))
+		rc = -1;
+
+	resolvconf_free(&resolv);
+	resolvconf_free(&dhclient);
+
+	return rc ? -1 : 0;
+}
+
+int is_resolver_global(void)
+{
+	if (net_backend == NULL)
+		detect_distribution();
+	//NetworkManager keeps servers in profiles of devices
+	return !net_backend->nm_active;
+}
+
 /*
 set_dns options:
 
@@ -107,75 +371,77 @@ set_dns options:
 	HOSTNAME="$5"
 	DISTR="$6"
 */
-int set_dns(struct netinfo *if_it, struct nettool_mac *params){
-	char cmd[PATH_MAX+1];
+int set_resolver(struct netinfo *if_it, const char *dns, const char *search,
+		const char *hostname)
+{
+	char path[PATH_MAX], *name = NULL;
+	size_t len;
 	int rc;
 
-	(void)if_it; /* to make compiler happy */
-
-	if (params->value == NULL)
-		return 0;
+	if (hostname != NULL) {
+		/* strip trailing dots */
+		len = strlen(hostname);
+		while (len > 0 && hostname[len-1] == '.')
+			len--;
+		name = strndup(hostname, len);
+		if (name == NULL) {
+			error(errno, "Can't allocate memory for hostname");
+			return -1;
+		}
+	}
 
 	/* We had better use dhclient-$IF.conf here,
 	 * but it brings a lot of problems when e.g. iface is bridged
 	 * so just leave the old (global, not per-interface) behaviour.
 	 * */
-	if (snprintf(cmd, PATH_MAX, SCRIPT_DIR "/set_dns.sh \"%s\" \"%s\" \"%s\" \"\" \"\" \"%s\"",
-			if_it->name, if_it->mac,
-			params->value, (os_script_prefix != NULL) ?  os_script_prefix : "") >= PATH_MAX)
-	{
-		werror("ERROR: Command line for execution set_dns.sh is too long");
-		return -1;
+	const char *argv[] = {script_path(path, OP_SET_DNS),
+				(if_it != NULL) ? if_it->name : "",
+				(if_it != NULL) ? if_it->mac : "",
+				"", "", (name != NULL) ? name : "",
+				(os_script_prefix != NULL) ?  os_script_prefix : "", NULL};
+
+	if (!is_resolver_global()) {
+		//one run of nm script sets all values
+		argv[3] = (dns != NULL) ? dns : "";
+		argv[4] = (search != NULL) ? search : "";
+		rc = run_cmdv(argv);
+	} else {
+		rc = set_resolver_files(dns, search);
+		//hostname is left to the script
+		if (rc == 0 && name != NULL && *name != '\0')
+			rc = run_cmdv(argv);
 	}
-	rc = run_cmd(cmd);
+
+	free(name);
 
 	return rc;
 }
 
-int set_search_domain(struct nettool_mac *params) {
-	char cmd[PATH_MAX+1];
-	int rc;
-
+int set_dns(struct netinfo *if_it, struct nettool_mac *params){
 	if (params->value == NULL)
 		return 0;
 
-	if (snprintf(cmd, PATH_MAX, SCRIPT_DIR "/set_dns.sh \"\" \"\" \"\" \"%s\" \"\" \"%s\"",
-			params->value, (os_script_prefix != NULL) ?  os_script_prefix : "") >= PATH_MAX)
-	{
-		werror("ERROR: Command line for execution set_dns.sh is too long");
-		return -1;
-	}
-	rc = run_cmd(cmd);
+	return set_resolver(if_it, params->value, NULL, NULL);
+}
 
-	return rc;
+int set_search_domain(struct nettool_mac *params) {
+	if (params->value == NULL)
+		return 0;
+
+	return set_resolver(NULL, NULL, params->value, NULL);
 }
 
 int set_hostname(struct nettool_mac *params)
 {
-	char cmd[PATH_MAX+1];
-	size_t len;
-
 	if (params->value == NULL)
 		return 0;
 
-	/* strip trailing dots */
-	len = strlen(params->value);
-	while (len > 0 && params->value[len-1] == '.')
-		params->value[--len] = 0;
-
-	if (snprintf(cmd, PATH_MAX, SCRIPT_DIR "/set_dns.sh \"\" \"\" \"\" \"\" \"%s\" \"%s\"",
-		params->value, (os_script_prefix != NULL) ?  os_script_prefix : "")
-				>= PATH_MAX) {
-		werror("ERROR: Command line for execution set_dns.sh is too long");
-		return -1;
-	}
-
-	return run_cmd(cmd);
+	return set_resolver(NULL, NULL, NULL, params->value);
 }
 
 int set_gateway(struct netinfo *if_it, struct nettool_mac *params) {
 
-	char cmd[PATH_MAX+1];
+	char path[PATH_MAX];
 	int rc = 0;
 
 	if (if_it->configured_with_dhcp && if_it->configured_with_dhcpv6)
@@ -185,43 +451,20 @@ int set_gateway(struct netinfo *if_it, struct nettool_mac *params) {
 	}
 
 	if (os_script_prefix != NULL) { //TODO: need to support other distribs
-		if (snprintf(cmd, PATH_MAX, SCRIPT_DIR "/%s-set_gateway.sh \"%s\" \"%s\" \"%s\"",
-			os_script_prefix, if_it->name, params->value, if_it->mac) >= PATH_MAX)
-		{
-			werror("ERROR: Command line for execution %s-set_gateway.sh is too long", os_script_prefix);
-			return -1;
-		}
-
-		rc = run_cmd(cmd);
-	}else{
-		struct namelist *gws = NULL, *gw;
+		const char *argv[] = {script_path(path, OP_SET_GATEWAY), if_it->name,
+					STDIN_VALUE, if_it->mac, NULL};
+
+		if (net_backend->set_gateway != NULL)
+			rc = net_backend->set_gateway(if_it, params->value,
+					if_it->live & NET_OPT_GATEWAY);
+		else if (if_it->live & NET_OPT_GATEWAY)
+			rc = run_cmdv_live(argv, params->value);
+		else
+			rc = run_cmdv_input(argv, params->value);
+	}else if (!(if_it->live & NET_OPT_GATEWAY)){
+		struct namelist *gws = NULL;
 		namelist_split(&gws, params->value);
-		gw = gws;
-		while(gw)
-		{
-			if (is_ipv6(gw->name) || is_removev6(gw->name))
-			{
-				//ipv6
-				snprintf(cmd, PATH_MAX, "route -A inet6 del default; ");
-
-				if (!is_removev6(gw->name))
-					snprintf(cmd, PATH_MAX, "%s route -A inet6 add default gw %s %s",
-						cmd, gw->name, if_it->name);
-			}
-			else
-			{
-				//ipv4
-				//use generic route command
-				snprintf(cmd, PATH_MAX, "route del default; ");
-
-				if (!is_remove(gw->name))
-					snprintf(cmd, PATH_MAX, "%s route add default gw %s %s",
-						cmd, gw->name, if_it->name);
-			}
-			rc = run_cmd(cmd);
-
-			gw = gw->next;
-		}
+		rc = rtnl_set_gateways(if_it, gws);
 		namelist_clean(&gws);
 	}
 
@@ -231,8 +474,7 @@ int set_gateway(struct netinfo *if_it, struct nettool_mac *params) {
 int set_route(struct netinfo *if_it, struct nettool_mac *params)
 {
 
-	char cmd[PATH_MAX+1];
-	char ip_cmd[50];
+	char path[PATH_MAX];
 	int rc = 0;
 
 	if (if_it->configured_with_dhcp && if_it->configured_with_dhcpv6)
@@ -242,40 +484,21 @@ int set_route(struct netinfo *if_it, struct nettool_mac *params)
 	}
 
 	if (os_script_prefix != NULL) {
-		if (snprintf(cmd, PATH_MAX, SCRIPT_DIR "/%s-set_route.sh \"%s\" \"%s\" \"%s\"",
-			os_script_prefix, if_it->name, params->value,
-			if_it->mac) >= PATH_MAX)
-		{
-			werror("ERROR: Command line for execution %s-set_route.sh is too long", os_script_prefix);
-			return -1;
-		}
-
-		rc = run_cmd(cmd);
-	}else{
-		struct namelist *gws = NULL, *gw;
-		namelist_split(&gws, params->value);
-		gw = gws;
-		while(gw)
-		{
-			if (is_ipv6(gw->name))
-				snprintf(ip_cmd, sizeof(ip_cmd), "ip -6");
-			else
-				snprintf(ip_cmd, sizeof(ip_cmd), "ip");
-
-			struct route route = {NULL, NULL, NULL};
-			parse_route(gw->name, &route);
-
-			snprintf(cmd, PATH_MAX, " %s route del %s %s %s dev %s;"
-					" %s route add %s %s %s dev %s %s %s",
-					ip_cmd, route.ip, route.gw ? "via" : "", route.gw, if_it->name,
-					ip_cmd, route.ip, route.gw ? "via" : "", route.gw, if_it->name,
-					route.metric ? "metric" : "", route.metric);
-			rc = run_cmd(cmd);
-
-			clear_route(&route);
-			gw = gw->next;
-		}
-		namelist_clean(&gws);
+		const char *argv[] = {script_path(path, OP_SET_ROUTE), if_it->name,
+					STDIN_VALUE, if_it->mac, NULL};
+
+		if (net_backend->set_route != NULL)
+			rc = net_backend->set_route(if_it, params->value,
+					if_it->live & NET_OPT_ROUTE);
+		else if (if_it->live & NET_OPT_ROUTE)
+			rc = run_cmdv_live(argv, params->value);
+		else
+			rc = run_cmdv_input(argv, params->value);
+	}else if (!(if_it->live & NET_OPT_ROUTE)){
+		struct namelist *routes = NULL;
+		namelist_split(&routes, params->value);
+		rc = rtnl_replace_routes(if_it, routes);
+		namelist_clean(&routes);
 	}
 
 	return rc;
@@ -283,6 +506,7 @@ int set_route(struct netinfo *if_it, struct nettool_mac *params)
 
 int set_dhcp(struct netinfo *if_it, struct nettool_mac *params) {
 	int rc = 0;
+	char path[PATH_MAX];
 
 	if (!os_script_prefix)
 	{
@@ -291,8 +515,6 @@ int set_dhcp(struct netinfo *if_it, struct nettool_mac *params) {
 	}
 
 	//switch to dynamic
-	char cmd[PATH_MAX+1];
-
 	struct nettool_mac *mac_it = get_opt_mac(if_it->mac, NET_OPT_IP);
 	if (strchr(params->value, '6') == NULL && mac_it == NULL)
 	{
@@ -300,22 +522,19 @@ int set_dhcp(struct netinfo *if_it, struct nettool_mac *params) {
 		remove_ipv6(if_it);
 	}
 
-	if (snprintf(cmd, PATH_MAX, SCRIPT_DIR "/%s-set_dhcp.sh \"%s\" \"%s\" \"%s\" ",
-			os_script_prefix, if_it->name, if_it->mac, params->value ) >= PATH_MAX)
-	{
-		werror("ERROR: Command line for execution %s-set_dhcp.sh is too long", os_script_prefix);
-		return -1;
-	}
-	rc = run_cmd(cmd);
+	const char *argv[] = {script_path(path, OP_SET_DHCP), if_it->name, if_it->mac,
+				params->value, NULL};
+
+	if (net_backend->set_dhcp != NULL)
+		rc = net_backend->set_dhcp(if_it, params->value);
+	else
+		rc = run_cmdv(argv);
 
 	if (strchr(params->value, '4'))
 		if_it->configured_with_dhcp = 1;
 	if (strchr(params->value, '6'))
 		if_it->configured_with_dhcpv6 = 1;
 
-
-	VARUNUSED(params);
-
 	return rc;
 }
 
@@ -334,7 +553,7 @@ int enable_adapter(struct netinfo *if_it, int enable)
 
 int restart_guest_network()
 {
-	char cmd[PATH_MAX+1];
+	char path[PATH_MAX];
 
 	if (!os_script_prefix)
 	{
@@ -342,16 +561,89 @@ int restart_guest_network()
 		return -1;
 	}
 
-	if (snprintf(cmd, PATH_MAX, SCRIPT_DIR "/%s-restart.sh",
-			os_script_prefix) >= PATH_MAX)
+	const char *argv[] = {script_path(path, OP_RESTART), NULL};
+
+	if (net_backend->restart != NULL)
+		return net_backend->restart(NULL);
+
+	return run_cmdv(argv);
+}
+
+int restart_device(struct netinfo *if_it)
+{
+	char path[PATH_MAX];
+
+	if (!os_script_prefix)
 	{
-		werror("ERROR: Command line for execution %s-restart.sh is too long", os_script_prefix);
+		werror("Distribution not supported");
 		return -1;
 	}
-	return run_cmd(cmd);
+
+	const char *argv[] = {script_path(path, OP_RESTART), if_it->name, if_it->mac, NULL};
+	const char *devs[] = {if_it->name, NULL};
+
+	if (net_backend->restart != NULL)
+		return net_backend->restart(devs);
+
+	return run_cmdv(argv);
+}
+
+int activate_device(struct netinfo *if_it)
+{
+	char path[PATH_MAX];
+
+	//ip commands change running configuration only
+	if (!os_script_prefix)
+		return 0;
+
+	const char *argv[] = {script_path(path, OP_ACTIVATE), if_it->name, if_it->mac, NULL};
+
+	if (net_backend->activate != NULL)
+		return net_backend->activate(if_it);
+
+	return run_cmdv(argv);
+}
+
+int commit_config(void)
+{
+	if (net_backend == NULL || net_backend->commit == NULL)
+		return 0;
+
+	return net_backend->commit();
 }
 
-int restart_debian_netplan_network()
+int restart_debian_netplan_network(struct netinfo *netinfo_head)
 {
-	return run_cmd(SCRIPT_DIR "/debian-netplan_restart.sh");
+	const char **argv;
+	struct netinfo *if_it;
+	int n = 1, rc;
+
+	for (if_it = netinfo_head; if_it != NULL; if_it = if_it->next)
+		if (if_it->changed & NETPLAN_OPS)
+			n++;
+	if (n == 1)
+		return 0; //netplan configuration was not changed
+
+	argv = (const char **) malloc((n + 1) * sizeof(char *));
+	if (argv == NULL) {
+		error(errno, "Can't allocate memory for arguments");
+		return -1;
+	}
+
+	n = 0;
+	argv[n++] = SCRIPT_DIR "/debian-netplan_restart.sh";
+	for (if_it = netinfo_head; if_it != NULL; if_it = if_it->next)
+		if (if_it->changed & NETPLAN_OPS)
+			argv[n++] = if_it->name;
+	argv[n] = NULL;
+
+	//all devices are applied at once, devices of NetworkManager are
+	//brought up by commit_config()
+	if (net_backend != NULL && net_backend->controller == CONTROLLER_NETPLAN)
+		rc = net_backend->restart(argv + 1);
+	else
+		rc = run_cmdv(argv);
+	free(argv);
+
+	return rc;
 }
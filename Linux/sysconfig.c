@@ -0,0 +1,545 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2019 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * native writers of sysconfig ifcfg files of RedHat and SUSE: all
+ * variables of device are set in memory and each file is written once
+ */
+
+#include "../common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "exec.h"
+#include "ifcfg.h"
+#include "sysconfig.h"
+#include "sysroot.h"
+
+#ifndef RH_IFCFG_DIR
+#define RH_IFCFG_DIR	"/etc/sysconfig/network-scripts"
+#define RH_NETFILE	"/etc/sysconfig/network"
+#endif
+#define RH_NETWORK_INIT	"/etc/init.d/network"
+#ifndef SUSE_IFCFG_DIR
+#define SUSE_IFCFG_DIR	"/etc/sysconfig/network"
+#define SUSE_RELEASE	"/etc/SuSE-release"
+#define OS_RELEASE	"/etc/os-release"
+#endif
+
+#define DEFAULT_MASK	"255.255.255.255"
+#define DEFAULT_PREFIX6	"64"
+
+/* addresses of set_ip value, IP/MASK each */
+struct addr_list
+{
+	char *buf;
+	char **items;
+	int count;
+};
+
+static void free_addrs(struct addr_list *list)
+{
+	free(list->items);
+	free(list->buf);
+}
+
+static int split_addrs(const char *value, struct addr_list *list)
+{
+	char *tok, *save, **items;
+	int size = 0;
+
+	list->items = NULL;
+	list->count = 0;
+	list->buf = strdup(value);
+	if (list->buf == NULL)
+		goto nomem;
+
+	for (tok = strtok_r(list->buf, " \t\n", &save); tok != NULL;
+			tok = strtok_r(NULL, " \t\n", &save)) {
+		if (list->count == size) {
+			size = size ? size * 2 : 16;
+			items = (char **)realloc(list->items, size * sizeof(char *));
+			if (items == NULL)
+				goto nomem;
+			list->items = items;
+		}
+		list->items[list->count++] = tok;
+	}
+
+	return 0;
+nomem:
+	error(errno, "Can't allocate memory");
+	free_addrs(list);
+	return -1;
+}
+
+/* split IP/MASK in place, mask is NULL if it is not given */
+static char *split_mask(char *ip_mask)
+{
+	char *mask = strrchr(ip_mask, '/');
+
+	if (mask == NULL)
+		return NULL;
+
+	mask = (mask[1] != '\0') ? mask + 1 : NULL;
+	*strchr(ip_mask, '/') = '\0';
+
+	return mask;
+}
+
+/* word of set_ip options, as set_options in functions checks it */
+static int has_opt(const char *opts, const char *name)
+{
+	size_t len = strlen(name);
+	const char *p;
+
+	for (p = opts; (p = strstr(p, name)) != NULL; p += len)
+		if ((p == opts || p[-1] == ' ') && (p[len] == '\0' || p[len] == ' '))
+			return 1;
+
+	return 0;
+}
+
+static int run_ifcmd(const char *cmd, const char *arg)
+{
+	const char *argv[] = {cmd, arg, NULL};
+
+	return run_cmdv(argv);
+}
+
+int redhat_disables_nm(void)
+{
+	static const struct {
+		const char *id;
+		int version;
+	} old[] = {
+		{"fedora", 21}, {"centos", 7}, {"redos", 7},
+		{"virtuozzo", 7}, {"cloudlinux", 7}, {"rhel", 7},
+	};
+	struct ifcfg *release;
+	const char *id, *version;
+	unsigned int i;
+	int rc = 0;
+
+	release = ifcfg_open(OS_RELEASE, 1, '"');
+	if (release == NULL)
+		return 0;
+
+	id = ifcfg_get(release, "ID");
+	version = ifcfg_get(release, "VERSION_ID");
+	if (id != NULL && version != NULL && isdigit(*version))
+		for (i = 0; i < sizeof(old) / sizeof(old[0]); i++)
+			if (!strcmp(id, old[i].id) && atoi(version) < old[i].version)
+				rc = 1;
+	ifcfg_free(release);
+
+	return rc;
+}
+
+/* remove alias files ifcfg-<dev>:<n> of device except n = 1..keep */
+static void remove_aliases(const char *dev, int keep)
+{
+	char prefix[NAME_LENGTH + 8], path[PATH_MAX];
+	struct dirent *ent;
+	size_t len;
+	char *end;
+	long n;
+	DIR *dir;
+
+	dir = opendir(RH_IFCFG_DIR);
+	if (dir == NULL)
+		return;
+
+	len = snprintf(prefix, sizeof(prefix), "ifcfg-%s:", dev);
+	while ((ent = readdir(dir)) != NULL) {
+		if (strncmp(ent->d_name, prefix, len))
+			continue;
+		n = strtol(ent->d_name + len, &end, 10);
+		if (end != ent->d_name + len && *end == '\0' && n >= 1 && n <= keep)
+			continue;
+		snprintf(path, sizeof(path), RH_IFCFG_DIR "/%s", ent->d_name);
+		if (unlink(path))
+			debug("Can't remove %s: %s", path, strerror(errno));
+	}
+	closedir(dir);
+}
+
+/* replace files of device, it is down while they are changed
+   unless its addresses are deferred or already set live,
+   net is saved if it is not NULL */
+static int redhat_apply(struct netinfo *if_it, struct ifcfg *cfg,
+		struct ifcfg **aliases, int count, struct ifcfg *net,
+		int restart, int deferred)
+{
+	int i, rc = 0;
+
+	//network of stopped guest is started by its boot
+	if (sysroot_offline()) {
+		restart = 0;
+		deferred = 1;
+	}
+
+	if (restart)
+		run_ifcmd(RH_NETWORK_INIT, "stop");
+	else if (!deferred)
+		run_ifcmd("/sbin/ifdown", if_it->name);
+
+	if (net != NULL && ifcfg_save(net))
+		rc = -1;
+	if (cfg != NULL && ifcfg_save(cfg))
+		rc = -1;
+	for (i = 0; i < count; i++)
+		if (ifcfg_save(aliases[i]))
+			rc = -1;
+	remove_aliases(if_it->name, count);
+
+	//device is brought up even if some file failed
+	if (restart)
+		i = run_ifcmd(RH_NETWORK_INIT, "start");
+	else if (!deferred)
+		i = run_ifcmd("/sbin/ifup", if_it->name);
+	else
+		i = 0;
+
+	return rc ? rc : i;
+}
+
+/* "remove" keeps ifcfg of device without addresses */
+static int redhat_remove_ips(struct netinfo *if_it, const char *path, int deferred)
+{
+	struct ifcfg *cfg = NULL;
+	int rc;
+
+	if (access(path, F_OK) == 0) {
+		cfg = ifcfg_open(path, 1, '"');
+		if (cfg == NULL)
+			return -1;
+		ifcfg_del(cfg, "IPV6ADDR_SECONDARIES", 0);
+		ifcfg_del(cfg, "IPV6ADDR", 0);
+		ifcfg_del(cfg, "IPADDR", 1);
+		ifcfg_del(cfg, "NETMASK", 1);
+	}
+
+	rc = redhat_apply(if_it, cfg, NULL, 0, NULL, 0, deferred);
+	ifcfg_free(cfg);
+
+	return rc;
+}
+
+/* alias of device has its own file */
+static struct ifcfg *redhat_alias(struct netinfo *if_it, int ifnum,
+		const char *ip, const char *mask)
+{
+	char path[PATH_MAX], dev[NAME_LENGTH + 16];
+	struct ifcfg *cfg;
+	int rc = 0;
+
+	snprintf(dev, sizeof(dev), "%s:%d", if_it->name, ifnum);
+	snprintf(path, sizeof(path), RH_IFCFG_DIR "/ifcfg-%s", dev);
+	cfg = ifcfg_open(path, 0, '"');
+	if (cfg == NULL)
+		return NULL;
+
+	rc |= ifcfg_set(cfg, "DEVICE", dev);
+	rc |= ifcfg_set(cfg, "ONBOOT", "yes");
+	rc |= ifcfg_set(cfg, "BOOTPROTO", "none");
+	rc |= ifcfg_set(cfg, "HWADDR", if_it->mac);
+	rc |= ifcfg_set(cfg, "NO_ALIASROUTING", "yes");
+	rc |= ifcfg_set(cfg, "IPADDR", ip);
+	rc |= ifcfg_set(cfg, "NETMASK", mask);
+	if (rc) {
+		ifcfg_free(cfg);
+		return NULL;
+	}
+
+	return cfg;
+}
+
+int redhat_set_ip(struct netinfo *if_it, const char *value, const char *opts, int live)
+{
+	int deferred = live || exec_is_deferred();
+	int dhcp4 = has_opt(opts, "dhcp"), dhcp6 = has_opt(opts, "dhcpv6");
+	int ip4_count = 0, ip6_count = 0, ifnum = -1, if6num = -1, secondaries = 0;
+	int i, restart = 0, rc = -1;
+	struct ifcfg *cfg = NULL, *net = NULL, *seen = NULL, **aliases = NULL;
+	struct addr_list addrs;
+	const char *networking;
+	char path[PATH_MAX];
+	char *ip, *mask, *secondaries_buf = NULL;
+	size_t secondaries_len = 0;
+	FILE *secondaries_fp = NULL;
+
+	if (split_addrs(value, &addrs))
+		return -1;
+
+	snprintf(path, sizeof(path), RH_IFCFG_DIR "/ifcfg-%s", if_it->name);
+	for (i = 0; i < addrs.count; i++) {
+		if (!strcmp(addrs.items[i], "remove")) {
+			rc = redhat_remove_ips(if_it, path, deferred);
+			goto out;
+		}
+		if (is_ipv6(addrs.items[i]))
+			ip6_count++;
+		else
+			ip4_count++;
+	}
+
+	if (mkdir(RH_IFCFG_DIR, 0755) && errno != EEXIST) {
+		error(errno, "Can't create %s", RH_IFCFG_DIR);
+		goto out;
+	}
+
+	net = ifcfg_open(RH_NETFILE, 1, '"');
+	cfg = ifcfg_open(path, 0, '"');
+	//set of IPv6 addresses already added, it is never saved
+	seen = ifcfg_open("", 0, '"');
+	aliases = (struct ifcfg **)calloc(ip4_count + 1, sizeof(struct ifcfg *));
+	secondaries_fp = open_memstream(&secondaries_buf, &secondaries_len);
+	if (net == NULL || cfg == NULL || seen == NULL || aliases == NULL ||
+			secondaries_fp == NULL) {
+		if (aliases == NULL || secondaries_fp == NULL)
+			error(errno, "Can't allocate memory");
+		goto out;
+	}
+
+	networking = ifcfg_get(net, "NETWORKING");
+	if (networking == NULL || strncasecmp(networking, "yes", 3)) {
+		if (ifcfg_set(net, "NETWORKING", "yes"))
+			goto out;
+		restart = 1;
+	}
+
+	rc = 0;
+	for (i = 0; i < addrs.count && rc == 0; i++) {
+		ip = addrs.items[i];
+		mask = split_mask(ip);
+
+		if (!is_ipv6(ip)) {
+			ifnum++;
+			if (mask == NULL)
+				mask = DEFAULT_MASK;
+			if (ifnum > 0) {
+				aliases[ifnum - 1] = redhat_alias(if_it, ifnum, ip, mask);
+				if (aliases[ifnum - 1] == NULL)
+					rc = -1;
+				continue;
+			}
+			rc |= ifcfg_set(cfg, "DEVICE", if_it->name);
+			rc |= ifcfg_set(cfg, "ONBOOT", "yes");
+			rc |= ifcfg_set(cfg, "BOOTPROTO", "none");
+			rc |= ifcfg_set(cfg, "HWADDR", if_it->mac);
+			rc |= ifcfg_set(cfg, "IPADDR", ip);
+			rc |= ifcfg_set(cfg, "NETMASK", mask);
+			if (ip6_count == 0 && dhcp6) {
+				rc |= ifcfg_set(cfg, "DHCPV6C", "yes");
+				rc |= ifcfg_set(cfg, "DHCPV6C_OPTIONS", "-d");
+			}
+			continue;
+		}
+
+		if6num++;
+		if (if6num == 0) {
+			rc |= ifcfg_set(cfg, "DHCPV6C", "no");
+			rc |= ifcfg_set(cfg, "IPV6_AUTOCONF", "no");
+			if (ip4_count == 0) {
+				rc |= ifcfg_set(cfg, "DEVICE", if_it->name);
+				rc |= ifcfg_set(cfg, "ONBOOT", "yes");
+				rc |= ifcfg_set(cfg, "BOOTPROTO", dhcp4 ? "dhcp" : "none");
+				rc |= ifcfg_set(cfg, "HWADDR", if_it->mac);
+			}
+		}
+		rc |= ifcfg_set(cfg, "DEVICE", if_it->name);
+		rc |= ifcfg_set(cfg, "IPV6INIT", "yes");
+
+		if (ifcfg_get(seen, ip) != NULL)
+			continue;
+		rc |= ifcfg_set(seen, ip, "");
+
+		if (mask != NULL)
+			mask[-1] = '/';
+		if (if6num == 0)
+			rc |= ifcfg_set(cfg, "IPV6ADDR", ip);
+		else
+			fprintf(secondaries_fp, "%s%s", secondaries++ ? " " : "", ip);
+	}
+
+	if (fclose(secondaries_fp)) {
+		error(errno, "Can't allocate memory");
+		rc = -1;
+	}
+	secondaries_fp = NULL;
+	if (secondaries)
+		rc |= ifcfg_set(cfg, "IPV6ADDR_SECONDARIES", secondaries_buf);
+	if (ip6_count)
+		rc |= ifcfg_set(net, "NETWORKING_IPV6", "yes");
+	if (rc)
+		goto out;
+
+	rc = redhat_apply(if_it, cfg, aliases, ifnum > 0 ? ifnum : 0,
+			(restart || ip6_count) ? net : NULL, restart, deferred);
+out:
+	if (secondaries_fp != NULL)
+		fclose(secondaries_fp);
+	free(secondaries_buf);
+	if (aliases != NULL)
+		for (i = 0; i < ip4_count; i++)
+			ifcfg_free(aliases[i]);
+	free(aliases);
+	ifcfg_free(seen);
+	ifcfg_free(cfg);
+	ifcfg_free(net);
+	free_addrs(&addrs);
+
+	return rc;
+}
+
+/* line of release file matches ^[[:space:]]*VERSION.*1[digits],
+   ignoring case as grep -i in suse scripts */
+static int release_matches(const char *file, const char *digits)
+{
+	char buf[256];
+	const char *p;
+	int found = 0;
+	FILE *fp;
+
+	fp = fopen(file, "r");
+	if (fp == NULL)
+		return 0;
+
+	while (!found && fgets(buf, sizeof(buf), fp) != NULL) {
+		p = buf + strspn(buf, " \t");
+		if (strncasecmp(p, "VERSION", 7))
+			continue;
+		for (p += 7; *p != '\0' && !found; p++)
+			found = (p[0] == '1' && p[1] != '\0' && strchr(digits, p[1]));
+	}
+	fclose(fp);
+
+	return found;
+}
+
+/* config of device is named by MAC address on SUSE 10,
+   as get_suse_config_name in functions chooses it */
+static void suse_config_path(struct netinfo *if_it, char *path)
+{
+	snprintf(path, PATH_MAX, SUSE_IFCFG_DIR "/ifcfg-%s", if_it->name);
+	if (access(path, F_OK) == 0)
+		return;
+
+	snprintf(path, PATH_MAX, SUSE_IFCFG_DIR "/ifcfg-eth-id-%s", if_it->mac);
+	if (access(path, F_OK) == 0)
+		return;
+
+	if (release_matches(access(OS_RELEASE, F_OK) == 0 ?
+				OS_RELEASE : SUSE_RELEASE, "0"))
+		return;
+
+	snprintf(path, PATH_MAX, SUSE_IFCFG_DIR "/ifcfg-%s", if_it->name);
+}
+
+int suse_set_ip(struct netinfo *if_it, const char *value, const char *opts, int live)
+{
+	int deferred = live || exec_is_deferred();
+	int dhcp4 = has_opt(opts, "dhcp"), dhcp6 = has_opt(opts, "dhcpv6");
+	const char *dhcp_type = "static";
+	char path[PATH_MAX], name[32], label[16];
+	struct addr_list addrs;
+	struct ifcfg *cfg;
+	char *ip, *mask;
+	int i, rc = 0;
+
+	if (dhcp4 && dhcp6) {
+		dhcp_type = "dhcp";
+	} else if (release_matches(SUSE_RELEASE, "123456789")) {
+		//only SUSE 11 and up supports explicit dhcp4 / dhcp6
+		if (dhcp4)
+			dhcp_type = "dhcp4";
+		if (dhcp6)
+			dhcp_type = "dhcp6";
+	} else if (dhcp4) {
+		dhcp_type = "dhcp";
+	}
+
+	if (mkdir(SUSE_IFCFG_DIR, 0755) && errno != EEXIST) {
+		error(errno, "Can't create %s", SUSE_IFCFG_DIR);
+		return -1;
+	}
+
+	suse_config_path(if_it, path);
+	if (split_addrs(value, &addrs))
+		return -1;
+	cfg = ifcfg_open(path, 0, '\'');
+	if (cfg == NULL) {
+		free_addrs(&addrs);
+		return -1;
+	}
+
+	for (i = 0; i < addrs.count && rc == 0; i++) {
+		ip = addrs.items[i];
+		mask = split_mask(ip);
+		if (mask == NULL)
+			mask = is_ipv6(ip) ? DEFAULT_PREFIX6 : DEFAULT_MASK;
+
+		if (i == 0) {
+			if (!strcmp(ip, "remove"))
+				ip = "";
+			rc |= ifcfg_set(cfg, "BOOTPROTO", dhcp_type);
+			rc |= ifcfg_set(cfg, "STARTMODE", "auto");
+			rc |= ifcfg_set(cfg, "USERCONTROL", "no");
+			rc |= ifcfg_set(cfg, "IPADDR", ip);
+			rc |= ifcfg_set(cfg, is_ipv6(ip) ? "PREFIXLEN" : "NETMASK", mask);
+			continue;
+		}
+
+		snprintf(label, sizeof(label), "%d", i);
+		snprintf(name, sizeof(name), "IPADDR_%d", i);
+		rc |= ifcfg_set(cfg, name, ip);
+		snprintf(name, sizeof(name), "LABEL_%d", i);
+		rc |= ifcfg_set(cfg, name, label);
+		snprintf(name, sizeof(name), "%s_%d",
+				is_ipv6(ip) ? "PREFIXLEN" : "NETMASK", i);
+		rc |= ifcfg_set(cfg, name, mask);
+	}
+
+	if (rc == 0) {
+		//addresses are already changed live or device is restarted later
+		if (!deferred)
+			run_ifcmd("/sbin/ifdown", if_it->name);
+		rc = ifcfg_save(cfg);
+		if (!deferred)
+			run_ifcmd("/sbin/ifup", if_it->name);
+	}
+
+	ifcfg_free(cfg);
+	free_addrs(&addrs);
+
+	return rc;
+}
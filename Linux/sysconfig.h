@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2019 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * native writers of sysconfig ifcfg files of RedHat and SUSE
+ */
+
+#ifndef __SYSCONFIG_H__
+#define __SYSCONFIG_H__
+
+#include "../netinfo.h"
+
+/* write addresses of value into network-scripts ifcfg files of device
+   as redhat-set_ip.sh does and restart device unless it is deferred,
+   opts are options of set_ip script (dhcp, dhcpv6), live is set if
+   addresses are already changed in kernel
+return 0 on success */
+int redhat_set_ip(struct netinfo *if_it, const char *value, const char *opts, int live);
+
+/* the same for /etc/sysconfig/network of SUSE as suse-set_ip.sh does */
+int suse_set_ip(struct netinfo *if_it, const char *value, const char *opts, int live);
+
+/* old RedHat releases where redhat-set_ip.sh disables NetworkManager
+   and keeps addresses in single file, they are left to the script */
+int redhat_disables_nm(void);
+
+#endif
@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2020 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * offline configuration of stopped guest: guest filesystem is entered with
+ * chroot in private user, mount, network and UTS namespaces, distribution
+ * and backend are detected from its files and scripts of host are run inside
+ * of it without capabilities which let its binaries leave it
+ */
+
+#define _GNU_SOURCE
+#include "../common.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <unistd.h>
+#include <linux/capability.h>
+#include <sys/mount.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "sysroot.h"
+
+/* runtime state of guest which is not valid while it is stopped,
+   /run also hides active units and pid files from detection */
+static const char *tmpfs_dirs[] = { "/run", "/dev", "/tmp", NULL };
+
+/* capabilities which let commands of guest create devices, mount,
+   leave root or reach kernel and processes of host */
+static const int dropped_caps[] = { CAP_SYS_ADMIN, CAP_MKNOD, CAP_SYS_CHROOT,
+	CAP_SYS_MODULE, CAP_SYS_RAWIO, CAP_SYS_PTRACE, CAP_SYS_BOOT, CAP_SYS_TIME,
+	CAP_MAC_ADMIN, CAP_MAC_OVERRIDE, -1 };
+
+static const char *id_maps[] = { "uid_map", "gid_map", NULL };
+
+static int offline;
+
+static int make_dir(const char *path, mode_t mode)
+{
+	if (mkdir(path, mode) && errno != EEXIST) {
+		error(errno, "Can't create %s", path);
+		return -1;
+	}
+	return 0;
+}
+
+/* same ids in new user namespace as in current one, so files of guest
+   keep their owners, map is copied from current one */
+static int read_id_map(const char *path, char *buf, size_t size)
+{
+	unsigned long first, lower, count;
+	size_t len = 0;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		error(errno, "Can't open %s", path);
+		return -1;
+	}
+	while (fscanf(fp, "%lu %lu %lu", &first, &lower, &count) == 3 && len < size)
+		len += snprintf(buf + len, size - len, "%lu %lu %lu\n", first, first, count);
+	fclose(fp);
+
+	if (len == 0 || len >= size) {
+		error(0, "Can't read %s", path);
+		return -1;
+	}
+	return 0;
+}
+
+/* capabilities of host are not valid for mounts and devices created by
+   namespaces of guest, maps of ids can be written only by process which
+   stays in current namespace, so helper process writes them
+return 0 on success, 1 if user namespaces are not supported, -1 on error */
+static int enter_userns(void)
+{
+	char maps[2][1024], path[64], c = 0;
+	pid_t pid = getpid(), helper;
+	int fds[2], fd, i, status, rc = 0;
+
+	for (i = 0; id_maps[i] != NULL; i++) {
+		snprintf(path, sizeof(path), "/proc/self/%s", id_maps[i]);
+		if (read_id_map(path, maps[i], sizeof(maps[i])))
+			return -1;
+	}
+
+	if (pipe2(fds, O_CLOEXEC)) {
+		error(errno, "Can't create pipe");
+		return -1;
+	}
+	helper = fork();
+	if (helper < 0) {
+		error(errno, "Can't fork process to map ids");
+		close(fds[0]);
+		close(fds[1]);
+		return -1;
+	}
+
+	if (helper == 0) {
+		close(fds[1]);
+		//pipe is closed without byte if namespace is not created
+		if (read(fds[0], &c, 1) != 1)
+			_exit(0);
+		for (i = 0; id_maps[i] != NULL; i++) {
+			snprintf(path, sizeof(path), "/proc/%d/%s", (int)pid, id_maps[i]);
+			fd = open(path, O_WRONLY | O_CLOEXEC);
+			if (fd < 0 || write(fd, maps[i], strlen(maps[i])) < 0) {
+				error(errno, "Can't write %s", path);
+				_exit(1);
+			}
+			close(fd);
+		}
+		_exit(0);
+	}
+
+	close(fds[0]);
+	if (unshare(CLONE_NEWUSER)) {
+		if (errno != EINVAL && errno != EPERM && errno != ENOSPC && errno != EUSERS) {
+			error(errno, "Can't create user namespace");
+			rc = -1;
+		} else {
+			debug("%s: user namespace is not available: %s",
+					__FUNCTION__, strerror(errno));
+			rc = 1;
+		}
+	} else if (write(fds[1], &c, 1) != 1) {
+		error(errno, "Can't start mapping of ids");
+		rc = -1;
+	}
+	close(fds[1]);
+
+	while (waitpid(helper, &status, 0) == -1 && errno == EINTR)
+		;
+	if (rc == 0 && (!WIFEXITED(status) || WEXITSTATUS(status) != 0)) {
+		error(0, "Can't map ids of user namespace");
+		rc = -1;
+	}
+
+	return rc;
+}
+
+/* capabilities are dropped from bounding set too, so commands
+   of guest do not get them back on exec */
+static int drop_caps(void)
+{
+	struct __user_cap_header_struct hdr = { _LINUX_CAPABILITY_VERSION_3, 0 };
+	struct __user_cap_data_struct data[_LINUX_CAPABILITY_U32S_3];
+	unsigned int bit;
+	int i;
+
+	if (syscall(SYS_capget, &hdr, data)) {
+		error(errno, "Can't get capabilities");
+		return -1;
+	}
+
+	for (i = 0; dropped_caps[i] >= 0; i++) {
+		if (prctl(PR_CAPBSET_DROP, dropped_caps[i], 0, 0, 0) && errno != EINVAL) {
+			error(errno, "Can't drop capability %d", dropped_caps[i]);
+			return -1;
+		}
+		bit = 1U << (dropped_caps[i] & 31);
+		data[dropped_caps[i] >> 5].effective &= ~bit;
+		data[dropped_caps[i] >> 5].permitted &= ~bit;
+		data[dropped_caps[i] >> 5].inheritable &= ~bit;
+	}
+
+	if (syscall(SYS_capset, &hdr, data)) {
+		error(errno, "Can't drop capabilities");
+		return -1;
+	}
+	//setuid files of guest do not give more either
+	if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0)) {
+		error(errno, "Can't forbid new privileges");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* bind src of host over path inside of root, regular file is created
+   as mount point of file */
+static int bind_path(const char *src, const char *path, int is_dir)
+{
+	int fd;
+
+	if (is_dir) {
+		if (make_dir(path, 0755))
+			return -1;
+	} else {
+		fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+		if (fd < 0) {
+			error(errno, "Can't create %s", path);
+			return -1;
+		}
+		close(fd);
+	}
+
+	if (mount(src, path, NULL, MS_BIND, NULL)) {
+		error(errno, "Can't bind %s to %s", src, path);
+		return -1;
+	}
+	return 0;
+}
+
+int sysroot_enter(const char *root)
+{
+	char path[PATH_MAX];
+	struct stat st;
+	int i;
+
+	if (stat(root, &st)) {
+		error(errno, "Can't access root %s", root);
+		return -1;
+	}
+	if (!S_ISDIR(st.st_mode)) {
+		error(0, "Root %s is not a directory", root);
+		return -1;
+	}
+
+	//runtime directories of guest are replaced, not created in it
+	for (i = 0; tmpfs_dirs[i] != NULL; i++) {
+		snprintf(path, sizeof(path), "%s%s", root, tmpfs_dirs[i]);
+		if (stat(path, &st) || !S_ISDIR(st.st_mode)) {
+			error(0, "Root %s has no directory %s", root, tmpfs_dirs[i]);
+			return -1;
+		}
+	}
+
+	//without it capabilities below protect host
+	if (enter_userns() < 0)
+		return -1;
+
+	if (unshare(CLONE_NEWNS | CLONE_NEWNET | CLONE_NEWUTS)) {
+		error(errno, "Can't create namespaces for %s", root);
+		return -1;
+	}
+	//mounts below should not propagate back to host
+	if (mount(NULL, "/", NULL, MS_REC | MS_PRIVATE, NULL)) {
+		error(errno, "Can't make mounts private");
+		return -1;
+	}
+
+	for (i = 0; tmpfs_dirs[i] != NULL; i++) {
+		snprintf(path, sizeof(path), "%s%s", root, tmpfs_dirs[i]);
+		if (mount("tmpfs", path, "tmpfs", MS_NOSUID | MS_NODEV | MS_NOEXEC,
+					"mode=0755")) {
+			error(errno, "Can't mount tmpfs on %s", path);
+			return -1;
+		}
+	}
+
+	//exec.c redirects stdin of commands from it
+	snprintf(path, sizeof(path), "%s/dev/null", root);
+	if (bind_path("/dev/null", path, 0))
+		return -1;
+
+	snprintf(path, sizeof(path), "%s" LEDGER_DIR, root);
+	if (make_dir(path, 0700))
+		return -1;
+	snprintf(path, sizeof(path), "%s" SYSROOT_SCRIPT_DIR, root);
+	if (bind_path(SCRIPT_DIR, path, 1))
+		return -1;
+
+	if (chroot(root) || chdir("/")) {
+		error(errno, "Can't change root to %s", root);
+		return -1;
+	}
+	if (drop_caps())
+		return -1;
+
+	debug("%s: root is %s", __FUNCTION__, root);
+	offline = 1;
+
+	return 0;
+}
+
+int sysroot_offline(void)
+{
+	return offline;
+}
+
+const char *sysroot_script_dir(void)
+{
+	return offline ? SYSROOT_SCRIPT_DIR : SCRIPT_DIR;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2020 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * offline configuration of stopped guest: request is applied inside of
+ * guest filesystem mounted at some directory instead of running guest
+ */
+
+#ifndef __SYSROOT_H__
+#define __SYSROOT_H__
+
+#include "ledger.h"
+
+/* scripts of host are bound here inside of entered root */
+#define SYSROOT_SCRIPT_DIR	LEDGER_DIR "/scripts"
+
+/* enter filesystem of guest at root in private user, mount, network and
+   UTS namespaces: runtime directories of guest are replaced by empty ones
+   without devices, setuid and executable files, scripts of host are bound
+   into it and capabilities to create devices, mount, leave root or reach
+   kernel of host are dropped, called by child process which exits after
+   the request
+return 0 on success, -1 on error */
+int sysroot_enter(const char *root);
+
+/* only configuration files of guest are written, devices and services
+   are not touched
+return 1 - root is entered, 0 - not */
+int sysroot_offline(void);
+
+/* directory of scripts of operations */
+const char *sysroot_script_dir(void);
+
+#endif
@@ -0,0 +1,769 @@
+#include "../../netinfo.h"
+#include "../../namelist.h"
+#include "../debian.h"
+#include "../ifcfg.h"
+#include "../ifupdown.h"
+#include "../netplan.h"
+#include "../sysconfig.h"
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define CHEAT_NO_MATH
+#include "cheat.h"
+#include "cheats.h"
+
+
+CHEAT_DECLARE(
+	#define TMP_PATH        "tmp"
+	#define NETPLAN_PATH    NETPLAN_CFG_DIR "/" NETPLAN_CFG_PREFIX "eth0.yaml"
+
+	/* devices are given by tests */
+	int get_device_list(struct netinfo **netinfo_head)
+	{
+		(void)netinfo_head;
+		return -1;
+	}
+
+	/* names of list joined with space, list is freed */
+	static char *joined(struct namelist **list)
+	{
+		static char buf[1024];
+		char *s = namelist_join(list, " ");
+
+		snprintf(buf, sizeof(buf), "%s", s ? s : "");
+		free(s);
+		namelist_clean(list);
+		return buf;
+	}
+
+	static void write_file(const char *path, const char *text)
+	{
+		FILE *fp = fopen(path, "w");
+
+		if (fp != NULL) {
+			fputs(text, fp);
+			fclose(fp);
+		}
+	}
+
+	/* content of file, empty if there is none */
+	static char *read_file(const char *path)
+	{
+		static char buf[8192];
+		size_t len = 0;
+		FILE *fp = fopen(path, "r");
+
+		if (fp != NULL) {
+			len = fread(buf, 1, sizeof(buf) - 1, fp);
+			fclose(fp);
+		}
+		buf[len] = '\0';
+		return buf;
+	}
+
+	static void init_dev(struct netinfo *if_it, const char *name, const char *mac)
+	{
+		memset(if_it, 0, sizeof(*if_it));
+		snprintf(if_it->name, sizeof(if_it->name), "%s", name);
+		snprintf(if_it->mac, sizeof(if_it->mac), "%s", mac);
+	}
+
+	/* configuration of eth0 is written again without changes */
+	static char *netplan_rewrite(const char *text)
+	{
+		struct netinfo dev;
+
+		init_dev(&dev, "eth0", "00:1c:42:aa:bb:01");
+		write_file(NETPLAN_PATH, text);
+		if (netplan_set_gateway(&dev, "remove", 0) || netplan_commit())
+			return NULL;
+		return read_file(NETPLAN_PATH);
+	}
+)
+
+CHEAT_SET_UP(
+	mkdir(TMP_PATH, 0777);
+	mkdir(TMP_PATH "/bin", 0777);
+	mkdir(NETPLAN_CFG_DIR, 0777);
+	mkdir(IFUPDOWN_CONFIG_DIR, 0777);
+	mkdir(TMP_PATH "/extra", 0777);
+	mkdir(RH_IFCFG_DIR, 0777);
+	mkdir(SUSE_IFCFG_DIR, 0777);
+	unlink(NETPLAN_PATH);
+	unlink(NETPLAN_PATH ".bkp");
+
+	//netplan of command path supports "to: default" routes
+	write_file(TMP_PATH "/bin/netplan",
+		"#!/bin/sh\n[ \"$1\" = info ] && echo 'features: [default-routes]'\nexit 0\n");
+	chmod(TMP_PATH "/bin/netplan", 0755);
+)
+
+CHEAT_TEST(route_diff,
+	struct namelist *scanned = NULL, *add = NULL, *del = NULL;
+	struct namelist **tail1 = &add, **tail2 = &scanned;
+	char *value, route[32];
+	size_t len;
+	int i, res;
+
+	(void)(cheat_check); // suppress compiler "unused" error
+
+	namelist_split(&scanned, "10.0.0.0/255.0.0.0=1.1.1.1m5 10.1.0.0/16=1.1.1.1 "
+			"192.168.0.1=2.2.2.2m0 FD01::/64=FE80::1 10.2.0.0/16=1.1.1.1m3");
+
+	//mask, prefix of host route and case are normalized
+	res = route_diff(&scanned, "10.0.0.0/8=1.1.1.1 10.1.0.0/16=1.1.1.1m0 "
+			"192.168.0.1/32=2.2.2.2 fd01::/64=fe80::1 10.2.0.0/16=1.1.1.1m03", &add, &del);
+	cheat_assert_int(res, 1);
+	cheat_assert_pointer(add, NULL);
+	cheat_assert_pointer(del, NULL);
+
+	//metric is compared only if it is given, remove is skipped
+	res = route_diff(&scanned, "10.0.0.0/8=1.1.1.1m6 10.1.0.0/16=1.1.1.1 "
+			"192.168.0.1=2.2.2.2 10.3.0.0/16 remove", &add, &del);
+	cheat_assert_int(res, 0);
+	cheat_assert_string(joined(&add), "10.0.0.0/8=1.1.1.1m6 10.3.0.0/16");
+	cheat_assert_string(joined(&del), "10.0.0.0/255.0.0.0=1.1.1.1m5 "
+			"FD01::/64=FE80::1 10.2.0.0/16=1.1.1.1m3");
+
+	res = route_match("10.0.0.0/8=1.1.1.1m5", "10.0.0.0/255.0.0.0=1.1.1.1m5");
+	cheat_assert_int(res, 1);
+	res = route_match("10.0.0.0/8=1.1.1.1m5", "10.0.0.0/8=1.1.1.1");
+	cheat_assert_int(res, 0);
+	res = route_match("10.0.0.0/8=1.1.1.1", "10.0.0.0/8=1.1.1.2");
+	cheat_assert_int(res, 0);
+	namelist_clean(&scanned);
+
+	//many routes, scanned ones in other order without metric
+	value = (char *)malloc(20000 * sizeof(route));
+	cheat_assert_not_pointer(value, NULL);
+	for (i = 0, len = 0; i < 20000; i++) {
+		snprintf(route, sizeof(route), "10.%d.%d.0/24=10.0.0.1m%d", i / 256, i % 256, i % 7);
+		namelist_append(route, &tail1);
+		len += sprintf(value + len, "%s%s", len ? " " : "", route);
+	}
+	for (i = 19999; i >= 0; i--) {
+		snprintf(route, sizeof(route), "10.%d.%d.0/24=10.0.0.1", i / 256, i % 256);
+		namelist_append(route, &tail2);
+	}
+	res = route_diff(&add, value, NULL, NULL);
+	cheat_assert_int(res, 1);
+	res = route_diff(&scanned, value, NULL, &del);
+	cheat_assert_int(res, 0);
+	//scanned route without metric has metric 0
+	for (i = 0, tail1 = &del; *tail1 != NULL; tail1 = &(*tail1)->next)
+		i++;
+	cheat_assert_int(i, 20000 - 20000 / 7 - 1);
+	namelist_clean(&del);
+	free(value);
+	namelist_clean(&add);
+	namelist_clean(&scanned);
+)
+
+CHEAT_TEST(netplan_layouts,
+	const char *text;
+
+	//file written by hand is loaded as PyYAML loads it
+	text = netplan_rewrite(
+		"# written by hand\n"
+		"network:\n"
+		"    version: 2\n"
+		"    renderer: networkd\n"
+		"    ethernets:\n"
+		"        \"eth0\":\n"
+		"            dhcp4: no   # static\n"
+		"            addresses: [10.0.0.2/24, \"fd00::2/64\"]\n"
+		"            nameservers: {addresses: [8.8.8.8, '1.1.1.1'], search: []}\n"
+		"            routes:\n"
+		"                -   to: default\n"
+		"                    via: 10.0.0.1\n"
+		"                    on-link: true\n"
+		"                - {to: \"10.1.0.0/16\", via: 10.0.0.254, metric: 0x64}\n"
+		"            'match':\n"
+		"                macaddress: \"00:1c:42:aa:bb:01\"\n"
+		"            set-name: 'it''s #1'\n"
+		"            optional: ~\n"
+		"            mtu: 1_500\n"
+		"            wakeonlan: \"a\\x41b\\u00e9\\t\\\"\\\\\\/\"\n");
+	cheat_assert_string(text,
+		"network:\n"
+		"  ethernets:\n"
+		"    eth0:\n"
+		"      addresses:\n"
+		"      - 10.0.0.2/24\n"
+		"      - fd00::2/64\n"
+		"      dhcp4: false\n"
+		"      match:\n"
+		"        macaddress: 00:1c:42:aa:bb:01\n"
+		"      mtu: 1500\n"
+		"      nameservers:\n"
+		"        addresses:\n"
+		"        - 8.8.8.8\n"
+		"        - 1.1.1.1\n"
+		"        search: []\n"
+		"      optional: null\n"
+		"      routes:\n"
+		"      - on-link: true\n"
+		"        to: default\n"
+		"        via: 10.0.0.1\n"
+		"      - metric: 100\n"
+		"        to: 10.1.0.0/16\n"
+		"        via: 10.0.0.254\n"
+		"      set-name: 'it''s #1'\n"
+		"      wakeonlan: \"aAb\\xE9\\t\\\"\\\\/\"\n"
+		"  renderer: networkd\n"
+		"  version: 2\n");
+
+	//file written by netplan-cfg.py is kept as it is, previous one is backup
+	text = netplan_rewrite(
+		"network:\n"
+		"  ethernets:\n"
+		"    eth0:\n"
+		"      addresses:\n"
+		"      - 10.0.0.2/24\n"
+		"      dhcp4: 'yes'\n"
+		"      gateway4: 10.0.0.1\n"
+		"      routes:\n"
+		"      - on-link: 'true'\n"
+		"        to: default\n"
+		"        via: 10.0.0.1\n"
+		"  version: 2\n");
+	cheat_assert_string(text,
+		"network:\n"
+		"  ethernets:\n"
+		"    eth0:\n"
+		"      addresses:\n"
+		"      - 10.0.0.2/24\n"
+		"      dhcp4: 'yes'\n"
+		"      gateway4: 10.0.0.1\n"
+		"      routes:\n"
+		"      - on-link: 'true'\n"
+		"        to: default\n"
+		"        via: 10.0.0.1\n"
+		"  version: 2\n");
+	cheat_assert_string(read_file(NETPLAN_PATH ".bkp"), text);
+)
+
+CHEAT_TEST(netplan_edit,
+	struct netinfo dev;
+	const char *ips =
+		"network:\n"
+		"  ethernets:\n"
+		"    eth0:\n"
+		"      addresses:\n"
+		"      - 10.0.0.2/24\n"
+		"      - fd00::2/64\n"
+		"      dhcp4: false\n"
+		"      dhcp6: false\n";
+	const char *gateways =
+		"      routes:\n"
+		"      - on-link: 'true'\n"
+		"        to: default\n"
+		"        via: 10.0.0.1\n"
+		"      - on-link: 'true'\n"
+		"        to: default\n"
+		"        via: fd00::1\n";
+	char expected[2048];
+	int res;
+
+	init_dev(&dev, "eth0", "00:1c:42:aa:bb:01");
+
+	//outputs of netplan-cfg.py for the same actions
+	res = netplan_set_ip(&dev, "10.0.0.2/255.255.255.0 fd00::2", "", 0);
+	cheat_assert_int(res, 0);
+	res = netplan_commit();
+	cheat_assert_int(res, 0);
+	snprintf(expected, sizeof(expected), "%s  version: 2\n", ips);
+	cheat_assert_string(read_file(NETPLAN_PATH), expected);
+
+	res = netplan_set_gateway(&dev, "10.0.0.1 fd00::1", 0);
+	cheat_assert_int(res, 0);
+	res = netplan_commit();
+	cheat_assert_int(res, 0);
+	snprintf(expected, sizeof(expected), "%s%s  version: 2\n", ips, gateways);
+	cheat_assert_string(read_file(NETPLAN_PATH), expected);
+
+	res = netplan_set_route(&dev, "10.1.0.0/16=10.0.0.254m100 169.254.0.1 "
+			"fd01::/64=fd00::1 10.1.0.0/16=10.0.0.254m100", 0);
+	cheat_assert_int(res, 0);
+	res = netplan_commit();
+	cheat_assert_int(res, 0);
+	snprintf(expected, sizeof(expected), "%s%s"
+		"      - metric: 100\n"
+		"        to: 10.1.0.0/16\n"
+		"        via: 10.0.0.254\n"
+		"      - scope: link\n"
+		"        to: 169.254.0.1\n"
+		"        via: 0.0.0.0\n"
+		"      - to: fd01::/64\n"
+		"        via: fd00::1\n"
+		"  version: 2\n", ips, gateways);
+	cheat_assert_string(read_file(NETPLAN_PATH), expected);
+
+	//remove drops all IPv4 routes except default ones
+	res = netplan_set_route(&dev, "remove 10.2.0.0/16=10.0.0.254", 0);
+	cheat_assert_int(res, 0);
+	res = netplan_commit();
+	cheat_assert_int(res, 0);
+	snprintf(expected, sizeof(expected), "%s%s"
+		"      - to: fd01::/64\n"
+		"        via: fd00::1\n"
+		"      - to: 10.2.0.0/16\n"
+		"        via: 10.0.0.254\n"
+		"  version: 2\n", ips, gateways);
+	cheat_assert_string(read_file(NETPLAN_PATH), expected);
+
+	res = netplan_get_dhcp(&dev, 4);
+	cheat_assert_int(res, 1);
+
+	//changes of one request are written once
+	res = netplan_set_dhcp(&dev, "4");
+	cheat_assert_int(res, 0);
+	res = netplan_set_route(&dev, "10.3.0.0/16=10.0.0.254", 0);
+	cheat_assert_int(res, 0);
+	res = netplan_commit();
+	cheat_assert_int(res, 0);
+	cheat_assert_string(read_file(NETPLAN_PATH ".bkp"), expected);
+	cheat_assert_string(read_file(NETPLAN_PATH),
+		"network:\n"
+		"  ethernets:\n"
+		"    eth0:\n"
+		"      dhcp4: 'yes'\n"
+		"      routes:\n"
+		"      - to: 10.3.0.0/16\n"
+		"        via: 10.0.0.254\n"
+		"  version: 2\n");
+	res = netplan_get_dhcp(&dev, 4);
+	cheat_assert_int(res, 0);
+	res = netplan_get_dhcp(&dev, 6);
+	cheat_assert_int(res, 2);
+
+	res = netplan_set_route(&dev, "10.4.0.0/16=10.0.0.254mx", 0);
+	cheat_assert_int(res, -1);
+)
+
+CHEAT_TEST(netplan_rejected,
+	const char *texts[] = {
+		//anchors and aliases
+		"network:\n  ethernets: &e\n    eth0: {}\n  bridges: *e\n",
+		//block scalars
+		"network:\n  ethernets:\n    eth0:\n      set-name: |\n        eth1\n",
+		//tabs
+		"network:\n\tethernets: {}\n",
+		//escapes of NUL and unknown ones
+		"network:\n  ethernets:\n    eth0:\n      set-name: \"p\\0q\"\n",
+		"network:\n  ethernets:\n    eth0:\n      set-name: \"p\\x00q\"\n",
+		"network:\n  ethernets:\n    eth0:\n      set-name: \"p\\qq\"\n",
+		"network:\n  ethernets:\n    eth0:\n      set-name: \"p\\u12\"\n",
+		"network:\n  \"ethernets\\c\": {}\n",
+		//unclosed quotes
+		"network:\n  ethernets:\n    eth0:\n      set-name: 'p\n",
+		NULL
+	};
+	struct netinfo dev;
+	int i, res;
+
+	init_dev(&dev, "eth0", "00:1c:42:aa:bb:01");
+
+	//nothing is written for file which can't be loaded
+	for (i = 0; texts[i] != NULL; i++) {
+		write_file(NETPLAN_PATH, texts[i]);
+		res = netplan_set_gateway(&dev, "remove", 0);
+		cheat_assert_int(res, -1);
+		res = netplan_commit();
+		cheat_assert_int(res, 0);
+		cheat_assert_string(read_file(NETPLAN_PATH), texts[i]);
+		cheat_assert_int(access(NETPLAN_PATH ".bkp", F_OK), -1);
+	}
+)
+
+CHEAT_TEST(ifupdown_set_ip,
+	struct netinfo eth1, veth1, eth2, eth3;
+	int res;
+
+	init_dev(&eth1, "eth1", "00:1c:42:aa:bb:01");
+	init_dev(&veth1, "veth1", "00:1c:42:aa:bb:02");
+	init_dev(&eth2, "eth2", "00:1c:42:aa:bb:03");
+	init_dev(&eth3, "eth3", "00:1c:42:aa:bb:04");
+
+	write_file(IFUPDOWN_CONFIG,
+		"# main\n"
+		"auto lo eth1 veth1\n"
+		"allow-hotplug eth1 eth1:1 eth10\n"
+		"iface lo inet loopback\n"
+		"\n"
+		"iface eth1 inet static\n"
+		"\taddress 10.0.0.2\n"
+		"\tnetmask 255.255.255.0\n"
+		"\n"
+		"iface eth1:1 inet static\n"
+		"\taddress 10.0.0.3\n"
+		"\n"
+		"iface eth1 inet6 static\n"
+		"\taddress fd00::2\n"
+		"\tnetmask 64\n"
+		"\n"
+		"iface veth1 inet dhcp\n"
+		"\n"
+		"iface eth10 inet dhcp\n"
+		"\n"
+		"source interfaces.d/*.cfg\n"
+		"source-directory extra\n");
+	//sourced relative to directory of file with source directive
+	write_file(IFUPDOWN_CONFIG_DIR "/a.cfg",
+		"auto eth1 eth2\n"
+		"iface eth1 inet dhcp\n"
+		"\n"
+		"iface eth2 inet dhcp\n");
+	//not sourced, files of interfaces.d are edited anyway
+	write_file(IFUPDOWN_CONFIG_DIR "/other",
+		"iface eth1:2 inet static\n"
+		"\taddress 10.0.0.4\n"
+		"iface eth1:x inet manual\n");
+	//source-directory takes names of run-parts only
+	write_file(TMP_PATH "/extra/eth",
+		"iface eth1 inet6 auto\n");
+	write_file(TMP_PATH "/extra/skip.cfg",
+		"iface eth1 inet dhcp\n"
+		"iface eth3 inet dhcp\n");
+	write_file(WIDE_DHCPV6_CONFIG,
+		"# devices\n"
+		"  INTERFACES=\"eth1\"\n");
+
+	//devices are matched by exact name
+	res = debian_get_dhcp(&eth1, 4);
+	cheat_assert_int(res, 1);
+	res = debian_get_dhcp(&veth1, 4);
+	cheat_assert_int(res, 0);
+	res = debian_get_dhcp(&eth2, 4);
+	cheat_assert_int(res, 0);
+	res = debian_get_dhcp(&eth3, 4);
+	cheat_assert_int(res, 1);
+	res = debian_get_dhcp(&eth1, 6);
+	cheat_assert_int(res, 0);
+	res = debian_get_dhcp(&eth2, 6);
+	cheat_assert_int(res, 1);
+
+	//stanzas of device and its aliases are replaced, other devices are kept
+	res = debian_set_ip(&eth1, "10.1.0.2/255.255.0.0 10.1.0.3 fd01::2/64 fd01::3", "", 1);
+	cheat_assert_int(res, 0);
+	cheat_assert_string(read_file(IFUPDOWN_CONFIG),
+		"# main\n"
+		"auto lo veth1\n"
+		"allow-hotplug eth10\n"
+		"iface lo inet loopback\n"
+		"\n"
+		"iface veth1 inet dhcp\n"
+		"\n"
+		"iface eth10 inet dhcp\n"
+		"\n"
+		"source interfaces.d/*.cfg\n"
+		"source-directory extra\n"
+		"auto eth1\n"
+		"iface eth1 inet static\n"
+		"\taddress 10.1.0.2\n"
+		"\tnetmask 255.255.0.0\n"
+		"\tbroadcast +\n"
+		"\n"
+		"auto eth1:1\n"
+		"iface eth1:1 inet static\n"
+		"\taddress 10.1.0.3\n"
+		"\tnetmask 255.255.255.255\n"
+		"\tbroadcast +\n"
+		"\n"
+		"iface eth1 inet6 static\n"
+		"\tpre-down ip -6 addr flush dev eth1 scope global || :\n"
+		"\taddress fd01::2\n"
+		"\tnetmask 64\n"
+		"\tup ip addr add fd01::3/64 dev eth1\n"
+		"\n"
+		"\n");
+	cheat_assert_string(read_file(IFUPDOWN_CONFIG_DIR "/a.cfg"),
+		"auto eth2\n"
+		"iface eth2 inet dhcp\n");
+	cheat_assert_string(read_file(IFUPDOWN_CONFIG_DIR "/other"),
+		"iface eth1:x inet manual\n");
+	cheat_assert_string(read_file(TMP_PATH "/extra/eth"), "");
+	cheat_assert_string(read_file(TMP_PATH "/extra/skip.cfg"),
+		"iface eth1 inet dhcp\n"
+		"iface eth3 inet dhcp\n");
+
+	res = debian_get_dhcp(&eth1, 4);
+	cheat_assert_int(res, 1);
+	res = debian_get_dhcp(&veth1, 4);
+	cheat_assert_int(res, 0);
+
+	//DHCP without addresses, IPv6 addresses are unset on down
+	res = debian_set_ip(&eth1, "", "dhcp", 1);
+	cheat_assert_int(res, 0);
+	cheat_assert_not_pointer(strstr(read_file(IFUPDOWN_CONFIG),
+		"source-directory extra\n"
+		"\n"
+		"iface eth1 inet dhcp\n"
+		"\n"
+		"auto eth1\n"
+		"iface eth1 inet6 manual\n"
+		"\tpre-down ip -6 addr flush dev eth1 scope global || :\n"), NULL);
+	cheat_assert_pointer(strstr(read_file(IFUPDOWN_CONFIG), "10.1.0."), NULL);
+	res = debian_get_dhcp(&eth1, 4);
+	cheat_assert_int(res, 0);
+)
+
+CHEAT_TEST(ifupdown_missing,
+	struct netinfo eth1;
+	int res;
+
+	init_dev(&eth1, "eth1", "00:1c:42:aa:bb:01");
+	unlink(IFUPDOWN_CONFIG);
+	unlink(WIDE_DHCPV6_CONFIG);
+
+	res = debian_get_dhcp(&eth1, 4);
+	cheat_assert_int(res, 2);
+	res = debian_get_dhcp(&eth1, 6);
+	cheat_assert_int(res, 1);
+
+	//interfaces file is created
+	res = debian_set_ip(&eth1, "10.1.0.2/24", "", 1);
+	cheat_assert_int(res, 0);
+	cheat_assert_string(read_file(IFUPDOWN_CONFIG),
+		"auto eth1\n"
+		"iface eth1 inet static\n"
+		"\taddress 10.1.0.2\n"
+		"\tnetmask 24\n"
+		"\tbroadcast +\n"
+		"\n"
+		"iface eth1 inet6 manual\n"
+		"\tpre-down ip -6 addr flush dev eth1 scope global || :\n");
+	res = debian_get_dhcp(&eth1, 4);
+	cheat_assert_int(res, 1);
+)
+
+CHEAT_TEST(ifcfg_edit,
+	struct ifcfg *cfg;
+	int res;
+
+	write_file(TMP_PATH "/ifcfg",
+		"# comment\n"
+		"  \n"
+		"DEVICE=eth0\n"
+		"NAME=\"System eth0\"  # name\n"
+		"MTU='1500'\n"
+		"IPADDR0=10.0.0.1\n"
+		"IPADDR1=\"10.0.0.2\"\n"
+		"IPADDR_START=10.0.0.3\n"
+		"export ZONE=public\n");
+
+	cfg = ifcfg_open(TMP_PATH "/ifcfg", 1, '"');
+	cheat_assert_not_pointer(cfg, NULL);
+	cheat_assert_string(ifcfg_get(cfg, "NAME"), "System eth0");
+	cheat_assert_string(ifcfg_get(cfg, "MTU"), "1500");
+	cheat_assert_string(ifcfg_get(cfg, "IPADDR1"), "10.0.0.2");
+	cheat_assert_pointer(ifcfg_get(cfg, "ZONE"), NULL);
+
+	//unchanged variables keep their quoting, deleted one is added at the end
+	res = ifcfg_set(cfg, "DEVICE", "eth0");
+	cheat_assert_int(res, 0);
+	res = ifcfg_set(cfg, "MTU", "9000");
+	cheat_assert_int(res, 0);
+	res = ifcfg_set(cfg, "NOTE", "a\"b$c`d\\e");
+	cheat_assert_int(res, 0);
+	ifcfg_del(cfg, "IPADDR", 1);
+	cheat_assert_pointer(ifcfg_get(cfg, "IPADDR0"), NULL);
+	res = ifcfg_set(cfg, "IPADDR1", "10.0.0.4");
+	cheat_assert_int(res, 0);
+	res = ifcfg_save(cfg);
+	cheat_assert_int(res, 0);
+	ifcfg_free(cfg);
+	cheat_assert_string(read_file(TMP_PATH "/ifcfg"),
+		"# comment\n"
+		"  \n"
+		"DEVICE=eth0\n"
+		"NAME=\"System eth0\"  # name\n"
+		"MTU=\"9000\"\n"
+		"IPADDR_START=10.0.0.3\n"
+		"export ZONE=public\n"
+		"NOTE=\"a\\\"b\\$c\\`d\\\\e\"\n"
+		"IPADDR1=\"10.0.0.4\"\n");
+
+	cfg = ifcfg_open(TMP_PATH "/ifcfg", 1, '\'');
+	cheat_assert_not_pointer(cfg, NULL);
+	cheat_assert_string(ifcfg_get(cfg, "NOTE"), "a\"b$c`d\\e");
+	res = ifcfg_set(cfg, "NAME", "it's");
+	cheat_assert_int(res, 0);
+	res = ifcfg_save(cfg);
+	cheat_assert_int(res, 0);
+	ifcfg_free(cfg);
+	cheat_assert_not_pointer(strstr(read_file(TMP_PATH "/ifcfg"),
+		"DEVICE=eth0\nNAME='it'\\''s'\nMTU=\"9000\"\n"), NULL);
+)
+
+CHEAT_TEST(redhat_set_ip,
+	struct netinfo eth0;
+	int res;
+
+	init_dev(&eth0, "eth0", "00:1c:42:aa:bb:01");
+	write_file(RH_NETFILE, "# network\nNETWORKING=yes\nHOSTNAME='host'\n");
+	write_file(RH_IFCFG_DIR "/ifcfg-eth0", "# old\nDEVICE=eth0\nMTU=9000\n");
+	write_file(RH_IFCFG_DIR "/ifcfg-eth0:1", "DEVICE=eth0:1\n");
+	write_file(RH_IFCFG_DIR "/ifcfg-eth0:5", "DEVICE=eth0:5\n");
+	write_file(RH_IFCFG_DIR "/ifcfg-eth01:1", "DEVICE=eth01:1\n");
+
+	//first IPv4 address is in file of device, others in files of aliases
+	res = redhat_set_ip(&eth0, "10.0.0.2/255.255.255.0 10.0.0.3 10.0.0.4/24 "
+			"fd01::2/64 fd01::3 fd01::2/64 fd01::4/48", "", 1);
+	cheat_assert_int(res, 0);
+	cheat_assert_string(read_file(RH_IFCFG_DIR "/ifcfg-eth0"),
+		"DEVICE=\"eth0\"\n"
+		"ONBOOT=\"yes\"\n"
+		"BOOTPROTO=\"none\"\n"
+		"HWADDR=\"00:1c:42:aa:bb:01\"\n"
+		"IPADDR=\"10.0.0.2\"\n"
+		"NETMASK=\"255.255.255.0\"\n"
+		"DHCPV6C=\"no\"\n"
+		"IPV6_AUTOCONF=\"no\"\n"
+		"IPV6INIT=\"yes\"\n"
+		"IPV6ADDR=\"fd01::2/64\"\n"
+		"IPV6ADDR_SECONDARIES=\"fd01::3 fd01::4/48\"\n");
+	cheat_assert_string(read_file(RH_IFCFG_DIR "/ifcfg-eth0:1"),
+		"DEVICE=\"eth0:1\"\n"
+		"ONBOOT=\"yes\"\n"
+		"BOOTPROTO=\"none\"\n"
+		"HWADDR=\"00:1c:42:aa:bb:01\"\n"
+		"NO_ALIASROUTING=\"yes\"\n"
+		"IPADDR=\"10.0.0.3\"\n"
+		"NETMASK=\"255.255.255.255\"\n");
+	cheat_assert_not_pointer(strstr(read_file(RH_IFCFG_DIR "/ifcfg-eth0:2"),
+		"IPADDR=\"10.0.0.4\"\nNETMASK=\"24\"\n"), NULL);
+	//stale alias is removed, aliases of other devices are kept
+	res = access(RH_IFCFG_DIR "/ifcfg-eth0:5", F_OK);
+	cheat_assert_int(res, -1);
+	res = access(RH_IFCFG_DIR "/ifcfg-eth01:1", F_OK);
+	cheat_assert_int(res, 0);
+	cheat_assert_string(read_file(RH_NETFILE),
+		"# network\nNETWORKING=yes\nHOSTNAME='host'\nNETWORKING_IPV6=\"yes\"\n");
+
+	//DHCPv6 is enabled only without static IPv6 addresses
+	res = redhat_set_ip(&eth0, "10.0.0.2/24", "dhcpv6", 1);
+	cheat_assert_int(res, 0);
+	cheat_assert_string(read_file(RH_IFCFG_DIR "/ifcfg-eth0"),
+		"DEVICE=\"eth0\"\n"
+		"ONBOOT=\"yes\"\n"
+		"BOOTPROTO=\"none\"\n"
+		"HWADDR=\"00:1c:42:aa:bb:01\"\n"
+		"IPADDR=\"10.0.0.2\"\n"
+		"NETMASK=\"24\"\n"
+		"DHCPV6C=\"yes\"\n"
+		"DHCPV6C_OPTIONS=\"-d\"\n");
+	res = access(RH_IFCFG_DIR "/ifcfg-eth0:1", F_OK);
+	cheat_assert_int(res, -1);
+
+	res = redhat_set_ip(&eth0, "fd01::2", "dhcp", 1);
+	cheat_assert_int(res, 0);
+	cheat_assert_string(read_file(RH_IFCFG_DIR "/ifcfg-eth0"),
+		"DHCPV6C=\"no\"\n"
+		"IPV6_AUTOCONF=\"no\"\n"
+		"DEVICE=\"eth0\"\n"
+		"ONBOOT=\"yes\"\n"
+		"BOOTPROTO=\"dhcp\"\n"
+		"HWADDR=\"00:1c:42:aa:bb:01\"\n"
+		"IPV6INIT=\"yes\"\n"
+		"IPV6ADDR=\"fd01::2\"\n");
+)
+
+CHEAT_TEST(redhat_remove_ips,
+	struct netinfo eth0;
+	int res;
+
+	init_dev(&eth0, "eth0", "00:1c:42:aa:bb:01");
+	write_file(RH_NETFILE, "NETWORKING=yes\n");
+	write_file(RH_IFCFG_DIR "/ifcfg-eth0",
+		"# eth0\n"
+		"DEVICE=eth0\n"
+		"IPADDR=10.0.0.2\n"
+		"NETMASK=255.255.255.0\n"
+		"IPADDR1=10.0.0.3\n"
+		"NETMASK1=255.255.255.255\n"
+		"IPADDR_START=10.0.0.9\n"
+		"IPV6ADDR=fd01::2/64\n"
+		"IPV6ADDR_SECONDARIES=\"fd01::3 fd01::4\"\n"
+		"IPV6INIT='yes'\n");
+	write_file(RH_IFCFG_DIR "/ifcfg-eth0:1", "DEVICE=eth0:1\n");
+
+	//addresses and aliases are removed, other lines are kept as they are
+	res = redhat_set_ip(&eth0, "remove", "", 1);
+	cheat_assert_int(res, 0);
+	cheat_assert_string(read_file(RH_IFCFG_DIR "/ifcfg-eth0"),
+		"# eth0\n"
+		"DEVICE=eth0\n"
+		"IPADDR_START=10.0.0.9\n"
+		"IPV6INIT='yes'\n");
+	res = access(RH_IFCFG_DIR "/ifcfg-eth0:1", F_OK);
+	cheat_assert_int(res, -1);
+	cheat_assert_string(read_file(RH_NETFILE), "NETWORKING=yes\n");
+)
+
+CHEAT_TEST(suse_set_ip,
+	struct netinfo eth0, eth1, eth2;
+	int res;
+
+	init_dev(&eth0, "eth0", "00:1c:42:aa:bb:01");
+	init_dev(&eth1, "eth1", "00:1c:42:aa:bb:02");
+	init_dev(&eth2, "eth2", "00:1c:42:aa:bb:03");
+	unlink(SUSE_RELEASE);
+	unlink(OS_RELEASE);
+	unlink(SUSE_IFCFG_DIR "/ifcfg-eth0");
+
+	//additional addresses are numbered variables of the same file
+	res = suse_set_ip(&eth0, "10.0.0.2/24 10.0.0.3 fd01::2 fd01::3/48", "", 1);
+	cheat_assert_int(res, 0);
+	cheat_assert_string(read_file(SUSE_IFCFG_DIR "/ifcfg-eth0"),
+		"BOOTPROTO='static'\n"
+		"STARTMODE='auto'\n"
+		"USERCONTROL='no'\n"
+		"IPADDR='10.0.0.2'\n"
+		"NETMASK='24'\n"
+		"IPADDR_1='10.0.0.3'\n"
+		"LABEL_1='1'\n"
+		"NETMASK_1='255.255.255.255'\n"
+		"IPADDR_2='fd01::2'\n"
+		"LABEL_2='2'\n"
+		"PREFIXLEN_2='64'\n"
+		"IPADDR_3='fd01::3'\n"
+		"LABEL_3='3'\n"
+		"PREFIXLEN_3='48'\n");
+
+	//only SUSE 11 and up has dhcp6 type, existing file of device is kept
+	write_file(SUSE_RELEASE, "SUSE Linux Enterprise Server 11 (x86_64)\nVERSION = 11\n");
+	res = suse_set_ip(&eth0, "remove", "dhcpv6", 1);
+	cheat_assert_int(res, 0);
+	cheat_assert_string(read_file(SUSE_IFCFG_DIR "/ifcfg-eth0"),
+		"BOOTPROTO='dhcp6'\n"
+		"STARTMODE='auto'\n"
+		"USERCONTROL='no'\n"
+		"IPADDR=''\n"
+		"NETMASK='255.255.255.255'\n");
+
+	//SUSE 10 names new file by MAC address
+	write_file(SUSE_RELEASE, "SUSE Linux Enterprise Server 10 (x86_64)\nVERSION = 10\n");
+	res = suse_set_ip(&eth1, "10.0.0.5", "dhcp", 1);
+	cheat_assert_int(res, 0);
+	cheat_assert_string(read_file(SUSE_IFCFG_DIR "/ifcfg-eth-id-00:1c:42:aa:bb:02"),
+		"BOOTPROTO='dhcp'\n"
+		"STARTMODE='auto'\n"
+		"USERCONTROL='no'\n"
+		"IPADDR='10.0.0.5'\n"
+		"NETMASK='255.255.255.255'\n");
+	res = access(SUSE_IFCFG_DIR "/ifcfg-eth1", F_OK);
+	cheat_assert_int(res, -1);
+
+	//file named by MAC address is used if it exists on other releases
+	unlink(SUSE_RELEASE);
+	write_file(SUSE_IFCFG_DIR "/ifcfg-eth-id-00:1c:42:aa:bb:03", "IPADDR=10.0.0.7\n");
+	res = suse_set_ip(&eth2, "10.0.0.6/16", "", 1);
+	cheat_assert_int(res, 0);
+	cheat_assert_not_pointer(strstr(read_file(SUSE_IFCFG_DIR "/ifcfg-eth-id-00:1c:42:aa:bb:03"),
+		"IPADDR='10.0.0.6'\nNETMASK='16'\n"), NULL);
+	res = access(SUSE_IFCFG_DIR "/ifcfg-eth2", F_OK);
+	cheat_assert_int(res, -1);
+)
@@ -0,0 +1,363 @@
+/* NetworkManager on private bus for tests of nm.c: it keeps profiles in
+   memory, logs called methods and answers the calls nm.c makes,
+   it is built with libdbus, so values are checked by other implementation */
+#include <dbus/dbus.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NM_SERVICE	"org.freedesktop.NetworkManager"
+#define NM_PATH		"/org/freedesktop/NetworkManager"
+#define NM_SETTINGS	NM_SERVICE ".Settings"
+#define NM_CONNECTION	NM_SETTINGS ".Connection"
+#define NM_DEVICE	NM_SERVICE ".Device"
+#define NM_ACTIVE	NM_SERVICE ".Connection.Active"
+#define PROPERTIES	"org.freedesktop.DBus.Properties"
+#define UNKNOWN_METHOD	"org.freedesktop.DBus.Error.UnknownMethod"
+/* methods used by tests to control mock */
+#define MOCK		"org.example.MockNM"
+
+#define DEVICE_IFACE	"eth0"
+#define DEVICE_PATH	NM_PATH "/Devices/1"
+#define ACTIVE_PATH	NM_PATH "/ActiveConnection/1"
+#define PROFILE_PATH	NM_PATH "/Settings/%d"
+#define MAX_PROFILES	16
+#define LOG_SIZE	4096
+
+struct profile
+{
+	char path[64];
+	DBusMessage *settings;	/* call which set settings, they are its first arg */
+};
+
+static struct profile profiles[MAX_PROFILES];
+static int nprofiles;
+static char active[64] = "";	/* profile active on device */
+static int fail_reapply;
+static int old_api;	/* NetworkManager before Update2 and AddConnection2 */
+static char calls[LOG_SIZE];
+
+static void copy_value(DBusMessageIter *from, DBusMessageIter *to);
+
+static void copy_args(DBusMessageIter *from, DBusMessageIter *to)
+{
+	for (; dbus_message_iter_get_arg_type(from) != DBUS_TYPE_INVALID;
+			dbus_message_iter_next(from))
+		copy_value(from, to);
+}
+
+static void copy_value(DBusMessageIter *from, DBusMessageIter *to)
+{
+	DBusMessageIter fsub, tsub;
+	DBusBasicValue v;
+	char *sig = NULL;
+	int type = dbus_message_iter_get_arg_type(from);
+
+	if (dbus_type_is_basic(type)) {
+		dbus_message_iter_get_basic(from, &v);
+		dbus_message_iter_append_basic(to, type, &v);
+		return;
+	}
+
+	dbus_message_iter_recurse(from, &fsub);
+	if (type == DBUS_TYPE_ARRAY || type == DBUS_TYPE_VARIANT)
+		sig = dbus_message_iter_get_signature(&fsub);
+	dbus_message_iter_open_container(to, type, sig, &tsub);
+	copy_args(&fsub, &tsub);
+	dbus_message_iter_close_container(to, &tsub);
+	dbus_free(sig);
+}
+
+static struct profile *find_profile(const char *path)
+{
+	int i;
+
+	for (i = 0; i < nprofiles; i++)
+		if (strcmp(profiles[i].path, path) == 0)
+			return &profiles[i];
+
+	return NULL;
+}
+
+static struct profile *add_profile(DBusMessage *msg)
+{
+	struct profile *p;
+
+	if (nprofiles == MAX_PROFILES)
+		return NULL;
+
+	p = &profiles[nprofiles];
+	snprintf(p->path, sizeof(p->path), PROFILE_PATH, nprofiles + 1);
+	p->settings = dbus_message_ref(msg);
+	nprofiles++;
+
+	return p;
+}
+
+static void del_profile(struct profile *p)
+{
+	dbus_message_unref(p->settings);
+	if (strcmp(active, p->path) == 0)
+		active[0] = '\0';
+	memmove(p, p + 1, (char *)&profiles[--nprofiles] - (char *)p);
+}
+
+static DBusMessage *reply_settings(DBusMessage *msg, struct profile *p)
+{
+	DBusMessage *reply = dbus_message_new_method_return(msg);
+	DBusMessageIter from, to;
+
+	//settings are the first arg of call which set them
+	dbus_message_iter_init(p->settings, &from);
+	dbus_message_iter_init_append(reply, &to);
+	copy_value(&from, &to);
+
+	return reply;
+}
+
+static void log_call(const char *member)
+{
+	size_t len = strlen(calls);
+
+	snprintf(calls + len, sizeof(calls) - len, "%s%s", len ? " " : "", member);
+}
+
+static DBusMessage *reply_paths(DBusMessage *msg, const char *first, const char *second)
+{
+	DBusMessage *reply = dbus_message_new_method_return(msg);
+
+	if (second == NULL)
+		dbus_message_append_args(reply, DBUS_TYPE_OBJECT_PATH, &first,
+				DBUS_TYPE_INVALID);
+	else
+		dbus_message_append_args(reply, DBUS_TYPE_OBJECT_PATH, &first,
+				DBUS_TYPE_OBJECT_PATH, &second, DBUS_TYPE_INVALID);
+
+	return reply;
+}
+
+/* empty a{sv} after args already appended */
+static DBusMessage *append_empty_dict(DBusMessage *reply)
+{
+	DBusMessageIter it, sub;
+
+	dbus_message_iter_init_append(reply, &it);
+	dbus_message_iter_open_container(&it, DBUS_TYPE_ARRAY, "{sv}", &sub);
+	dbus_message_iter_close_container(&it, &sub);
+
+	return reply;
+}
+
+static DBusMessage *reply_variant(DBusMessage *msg, int type, const void *value)
+{
+	DBusMessage *reply = dbus_message_new_method_return(msg);
+	DBusMessageIter it, sub;
+	char sig[2] = {(char)type, '\0'};
+
+	dbus_message_iter_init_append(reply, &it);
+	dbus_message_iter_open_container(&it, DBUS_TYPE_VARIANT, sig, &sub);
+	dbus_message_iter_append_basic(&sub, type, value);
+	dbus_message_iter_close_container(&it, &sub);
+
+	return reply;
+}
+
+static DBusMessage *get_property(DBusMessage *msg, const char *path)
+{
+	const char *iface, *name, *value;
+	dbus_uint32_t state = 2;
+
+	if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_STRING, &iface,
+				DBUS_TYPE_STRING, &name, DBUS_TYPE_INVALID))
+		return NULL;
+
+	if (strcmp(path, DEVICE_PATH) == 0 && strcmp(name, "ActiveConnection") == 0) {
+		value = *active ? ACTIVE_PATH : "/";
+		return reply_variant(msg, DBUS_TYPE_OBJECT_PATH, &value);
+	}
+	if (strcmp(path, ACTIVE_PATH) == 0 && *active && strcmp(name, "Connection") == 0) {
+		value = active;
+		return reply_variant(msg, DBUS_TYPE_OBJECT_PATH, &value);
+	}
+	if (strcmp(path, ACTIVE_PATH) == 0 && *active && strcmp(name, "State") == 0)
+		return reply_variant(msg, DBUS_TYPE_UINT32, &state);
+
+	return dbus_message_new_error(msg, "org.freedesktop.DBus.Error.UnknownProperty", name);
+}
+
+static DBusMessage *handle(DBusMessage *msg)
+{
+	const char *path = dbus_message_get_path(msg);
+	const char *iface = dbus_message_get_interface(msg);
+	const char *member = dbus_message_get_member(msg);
+	DBusMessage *reply;
+	DBusMessageIter from, to;
+	struct profile *p;
+	const char *s, *paths[MAX_PROFILES], **list;
+	dbus_bool_t b;
+	int i;
+
+	if (path == NULL || iface == NULL || member == NULL)
+		return NULL;
+
+	if (strcmp(iface, MOCK) == 0) {
+		if (strcmp(member, "Echo") == 0) {
+			reply = dbus_message_new_method_return(msg);
+			dbus_message_iter_init(msg, &from);
+			dbus_message_iter_init_append(reply, &to);
+			copy_args(&from, &to);
+			return reply;
+		}
+		if (strcmp(member, "Calls") == 0) {
+			reply = dbus_message_new_method_return(msg);
+			s = calls;
+			dbus_message_append_args(reply, DBUS_TYPE_STRING, &s, DBUS_TYPE_INVALID);
+			calls[0] = '\0';
+			return reply;
+		}
+		if (strcmp(member, "FailReapply") == 0 &&
+				dbus_message_get_args(msg, NULL, DBUS_TYPE_BOOLEAN, &b,
+					DBUS_TYPE_INVALID)) {
+			fail_reapply = b;
+			return dbus_message_new_method_return(msg);
+		}
+		return NULL;
+	}
+
+	log_call(member);
+
+	if (strcmp(iface, PROPERTIES) == 0 && strcmp(member, "Get") == 0)
+		return get_property(msg, path);
+
+	if (strcmp(path, NM_PATH) == 0 && strcmp(iface, NM_SERVICE) == 0) {
+		if (strcmp(member, "GetDeviceByIpIface") == 0) {
+			if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_STRING, &s,
+						DBUS_TYPE_INVALID))
+				return NULL;
+			if (strcmp(s, DEVICE_IFACE) != 0)
+				return dbus_message_new_error(msg,
+						NM_SERVICE ".UnknownDevice", s);
+			return reply_paths(msg, DEVICE_PATH, NULL);
+		}
+		if (strcmp(member, "ActivateConnection") == 0) {
+			if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_OBJECT_PATH, &s,
+						DBUS_TYPE_INVALID) || find_profile(s) == NULL)
+				return dbus_message_new_error(msg,
+						NM_SERVICE ".UnknownConnection", "no profile");
+			snprintf(active, sizeof(active), "%s", s);
+			return reply_paths(msg, ACTIVE_PATH, NULL);
+		}
+		if (strcmp(member, "AddAndActivateConnection") == 0) {
+			p = add_profile(msg);
+			if (p == NULL)
+				return NULL;
+			snprintf(active, sizeof(active), "%s", p->path);
+			return reply_paths(msg, p->path, ACTIVE_PATH);
+		}
+		if (strcmp(member, "Reload") == 0)
+			return dbus_message_new_method_return(msg);
+		return NULL;
+	}
+
+	if (strcmp(path, NM_PATH "/Settings") == 0 && strcmp(iface, NM_SETTINGS) == 0) {
+		if (strcmp(member, "ListConnections") == 0) {
+			for (i = 0; i < nprofiles; i++)
+				paths[i] = profiles[i].path;
+			list = paths;
+			reply = dbus_message_new_method_return(msg);
+			dbus_message_append_args(reply, DBUS_TYPE_ARRAY, DBUS_TYPE_OBJECT_PATH,
+					&list, nprofiles, DBUS_TYPE_INVALID);
+			return reply;
+		}
+		if (old_api && strcmp(member, "AddConnection2") == 0)
+			return dbus_message_new_error(msg, UNKNOWN_METHOD, member);
+		if (strcmp(member, "AddConnection2") == 0 ||
+				strcmp(member, "AddConnection") == 0) {
+			p = add_profile(msg);
+			if (p == NULL)
+				return NULL;
+			reply = reply_paths(msg, p->path, NULL);
+			if (strcmp(member, "AddConnection2") == 0)
+				append_empty_dict(reply);
+			return reply;
+		}
+		return NULL;
+	}
+
+	if (strcmp(iface, NM_CONNECTION) == 0 && (p = find_profile(path)) != NULL) {
+		if (strcmp(member, "GetSettings") == 0)
+			return reply_settings(msg, p);
+		if (old_api && strcmp(member, "Update2") == 0)
+			return dbus_message_new_error(msg, UNKNOWN_METHOD, member);
+		if (strcmp(member, "Update2") == 0 || strcmp(member, "Update") == 0) {
+			dbus_message_unref(p->settings);
+			p->settings = dbus_message_ref(msg);
+			reply = dbus_message_new_method_return(msg);
+			if (strcmp(member, "Update2") == 0)
+				append_empty_dict(reply);
+			return reply;
+		}
+		if (strcmp(member, "Delete") == 0) {
+			del_profile(p);
+			return dbus_message_new_method_return(msg);
+		}
+		return NULL;
+	}
+
+	if (strcmp(path, DEVICE_PATH) == 0 && strcmp(iface, NM_DEVICE) == 0 &&
+			strcmp(member, "Reapply") == 0) {
+		if (fail_reapply || *active == '\0')
+			return dbus_message_new_error(msg,
+					NM_DEVICE ".IncompatibleConnection", "can't reapply");
+		return dbus_message_new_method_return(msg);
+	}
+
+	return NULL;
+}
+
+static DBusHandlerResult filter(DBusConnection *conn, DBusMessage *msg, void *data)
+{
+	DBusMessage *reply;
+
+	(void)data;
+	if (dbus_message_get_type(msg) != DBUS_MESSAGE_TYPE_METHOD_CALL)
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+	reply = handle(msg);
+	if (reply == NULL)
+		reply = dbus_message_new_error(msg, UNKNOWN_METHOD,
+				dbus_message_get_member(msg));
+	dbus_connection_send(conn, reply, NULL);
+	dbus_message_unref(reply);
+
+	return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+/* usage: mock_nm <address> [old], "ready" is printed once name is owned */
+int main(int argc, char *argv[])
+{
+	DBusConnection *conn;
+	DBusError err;
+
+	if (argc < 2)
+		return 2;
+	old_api = (argc > 2 && strcmp(argv[2], "old") == 0);
+
+	dbus_error_init(&err);
+	conn = dbus_connection_open_private(argv[1], &err);
+	if (conn == NULL || !dbus_bus_register(conn, &err) ||
+			dbus_bus_request_name(conn, NM_SERVICE, DBUS_NAME_FLAG_DO_NOT_QUEUE, &err) !=
+				DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER) {
+		fprintf(stderr, "mock_nm: %s\n", err.message ? err.message : "can't own name");
+		return 1;
+	}
+	dbus_connection_add_filter(conn, filter, NULL, NULL);
+
+	printf("ready\n");
+	fflush(stdout);
+
+	while (dbus_connection_read_write_dispatch(conn, -1))
+		;
+
+	return 0;
+}
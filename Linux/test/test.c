@@ -0,0 +1,472 @@
+#include "../dbus.h"
+#include "../exec.h"
+#include "../nm.h"
+#include "../../netinfo.h"
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define CHEAT_NO_MATH
+#include "cheat.h"
+#include "cheats.h"
+
+
+CHEAT_DECLARE(
+	#define TMP_PATH        "tmp"
+	#define NM_SERVICE      "org.freedesktop.NetworkManager"
+	#define NM_PATH         "/org/freedesktop/NetworkManager"
+	#define MOCK            "org.example.MockNM"
+	#define DEV_NAME        "eth0"
+	#define DEV_MAC         "00:1C:42:AA:BB:01"
+
+	static pid_t bus_pid, mock_pid;
+	static struct dbus_conn *conn;
+
+	/* devices are given by tests */
+	int get_device_list(struct netinfo **netinfo_head)
+	{
+		(void)netinfo_head;
+		return -1;
+	}
+
+	/* start program, first line of its output is copied to line */
+	static pid_t start(char *const argv[], char *line, size_t size)
+	{
+		int fds[2];
+		pid_t pid;
+		FILE *fp;
+
+		if (pipe(fds))
+			return -1;
+		pid = fork();
+		if (pid == 0) {
+			dup2(fds[1], STDOUT_FILENO);
+			close(fds[0]);
+			close(fds[1]);
+			execvp(argv[0], argv);
+			_exit(127);
+		}
+		close(fds[1]);
+
+		fp = fdopen(fds[0], "r");
+		if (fp == NULL || fgets(line, size, fp) == NULL)
+			line[0] = '\0';
+		line[strcspn(line, "\n")] = '\0';
+		if (fp != NULL)
+			fclose(fp);
+
+		return pid;
+	}
+
+	static void stop(pid_t *pid)
+	{
+		if (*pid > 0) {
+			kill(*pid, SIGTERM);
+			waitpid(*pid, NULL, 0);
+		}
+		*pid = 0;
+	}
+
+	/* NetworkManager of old API is started if old is set */
+	static int start_mock(int old)
+	{
+		char *argv[] = {MOCK_NM, getenv(DBUS_BUS_ENV), old ? "old" : NULL, NULL};
+		char line[64];
+
+		mock_pid = start(argv, line, sizeof(line));
+		if (strcmp(line, "ready"))
+			return -1;
+
+		conn = dbus_connect();
+		return conn ? 0 : -1;
+	}
+
+	static int mock_call(const char *member, struct dbus_value *args,
+			struct dbus_value **reply)
+	{
+		return dbus_call(conn, NM_SERVICE, NM_PATH, MOCK, member, args, reply);
+	}
+
+	/* methods called since the last check, separated by space */
+	static int mock_calls(char *buf, size_t size)
+	{
+		struct dbus_value *reply;
+
+		if (mock_call("Calls", NULL, &reply) || reply == NULL || *reply->sig != 's')
+			return -1;
+		snprintf(buf, size, "%s", reply->v.s);
+		dbus_free(reply);
+
+		return 0;
+	}
+
+	/* settings of the only profile */
+	static struct dbus_value *mock_settings(void)
+	{
+		struct dbus_value *list, *settings = NULL;
+
+		if (dbus_call(conn, NM_SERVICE, NM_PATH "/Settings",
+					NM_SERVICE ".Settings", "ListConnections", NULL, &list))
+			return NULL;
+		if (list != NULL && list->child != NULL && list->child->next == NULL)
+			dbus_call(conn, NM_SERVICE, list->child->v.s,
+					NM_SERVICE ".Settings.Connection", "GetSettings", NULL, &settings);
+		dbus_free(list);
+
+		return settings;
+	}
+
+	static int same_value(const struct dbus_value *a, const struct dbus_value *b)
+	{
+		for (; a != NULL && b != NULL; a = a->next, b = b->next) {
+			if (strcmp(a->sig, b->sig))
+				return 0;
+			if (strchr("sog", *a->sig) && strcmp(a->v.s, b->v.s))
+				return 0;
+			if (*a->sig == 'd' && a->v.d != b->v.d)
+				return 0;
+			if (strchr("ybnqiuxt", *a->sig) && a->v.u != b->v.u)
+				return 0;
+			if (!same_value(a->child, b->child))
+				return 0;
+		}
+
+		return a == NULL && b == NULL;
+	}
+
+	/* value of key of item of list of key of group of settings */
+	static struct dbus_value *item_get(struct dbus_value *settings, const char *group,
+			const char *list, int idx, const char *key)
+	{
+		struct dbus_value *it = dbus_dict_get(dbus_dict_get(settings, group), list);
+
+		for (it = it ? it->child : NULL; it != NULL && idx > 0; idx--)
+			it = it->next;
+
+		return it ? dbus_dict_get(it, key) : NULL;
+	}
+
+	static void init_dev(struct netinfo *if_it)
+	{
+		memset(if_it, 0, sizeof(*if_it));
+		snprintf(if_it->name, sizeof(if_it->name), DEV_NAME);
+		snprintf(if_it->mac, sizeof(if_it->mac), DEV_MAC);
+	}
+)
+
+CHEAT_SET_UP(
+	char *argv[] = {"dbus-daemon", "--session", "--nofork", "--nopidfile",
+		"--address=unix:tmpdir=/tmp", "--print-address=1", NULL};
+	char address[256];
+
+	mkdir(TMP_PATH, 0777);
+	mkdir(TMP_PATH "/conf.d", 0777);
+	unlink(TMP_PATH "/conf.d/60-prl_nettool_" DEV_NAME ".conf");
+
+	//private bus replaces system bus of NetworkManager
+	bus_pid = start(argv, address, sizeof(address));
+	setenv(DBUS_BUS_ENV, address, 1);
+)
+
+CHEAT_TEAR_DOWN(
+	dbus_disconnect(conn);
+	conn = NULL;
+	stop(&mock_pid);
+	stop(&bus_pid);
+)
+
+CHEAT_TEST(dbus_roundtrip,
+	struct dbus_value *args = NULL, *copy, **tail = &args;
+	struct dbus_value *reply = NULL, *v;
+	int res;
+
+	(void)(cheat_check); // suppress compiler "unused" error
+
+	res = start_mock(0);
+	cheat_assert_int(res, 0);
+
+	//values of each alignment follow ones of other alignment
+	*tail = dbus_new_uint('y', 0xfe);
+	tail = &(*tail)->next;
+	*tail = dbus_new_uint('n', (unsigned long long)-2);
+	tail = &(*tail)->next;
+	*tail = dbus_new_uint('x', (unsigned long long)-3);
+	tail = &(*tail)->next;
+	*tail = dbus_new_uint('b', 1);
+	tail = &(*tail)->next;
+	*tail = dbus_new_uint('q', 0xfffe);
+	tail = &(*tail)->next;
+	*tail = dbus_new_uint('i', (unsigned long long)-4);
+	tail = &(*tail)->next;
+	*tail = dbus_new_uint('t', 0xfffffffffffffffeULL);
+	tail = &(*tail)->next;
+	*tail = dbus_new_uint('u', 0xfffffffe);
+	tail = &(*tail)->next;
+	*tail = dbus_new("d");
+	(*tail)->v.d = -1.5;
+	tail = &(*tail)->next;
+	*tail = dbus_new_string('s', "string");
+	tail = &(*tail)->next;
+	*tail = dbus_new_string('o', "/object/path");
+	tail = &(*tail)->next;
+	*tail = dbus_new_string('g', "a{sv}");
+	tail = &(*tail)->next;
+
+	v = dbus_new("(ysv)");
+	dbus_add(v, dbus_new_uint('y', 7));
+	dbus_add(v, dbus_new_string('s', "field"));
+	dbus_add(v, dbus_new_variant(dbus_new_uint('t', 0x1122334455667788ULL)));
+	*tail = v;
+	tail = &v->next;
+
+	v = dbus_new("a{sv}");
+	dbus_dict_set(v, "address", dbus_new_string('s', "10.0.0.1"));
+	dbus_dict_set(v, "prefix", dbus_new_uint('u', 24));
+	dbus_dict_set(v, "flag", dbus_new_uint('b', 0));
+	*tail = v;
+	tail = &v->next;
+
+	*tail = dbus_new("aa{sv}");
+	tail = &(*tail)->next;
+
+	v = dbus_new("ay");
+	dbus_add(v, dbus_new_uint('y', 1));
+	dbus_add(v, dbus_new_uint('y', 2));
+	dbus_add(v, dbus_new_uint('y', 3));
+	*tail = dbus_new_variant(v);
+	tail = &(*tail)->next;
+
+	v = dbus_new("at");
+	dbus_add(v, dbus_new_uint('t', 1));
+	*tail = v;
+
+	//args are freed by call
+	copy = NULL;
+	for (tail = &copy, v = args; v != NULL; v = v->next) {
+		*tail = dbus_copy(v);
+		cheat_assert_not_pointer(*tail, NULL);
+		tail = &(*tail)->next;
+	}
+
+	res = mock_call("Echo", args, &reply);
+	cheat_assert_int(res, 0);
+	cheat_assert_int(same_value(copy, reply), 1);
+	dbus_free(reply);
+
+	//same values in other order
+	v = copy;
+	copy = copy->next;
+	v->next = NULL;
+	for (tail = &copy; *tail != NULL; tail = &(*tail)->next)
+		;
+	*tail = v;
+	args = NULL;
+	for (tail = &args, v = copy; v != NULL; v = v->next) {
+		*tail = dbus_copy(v);
+		tail = &(*tail)->next;
+	}
+	res = mock_call("Echo", args, &reply);
+	cheat_assert_int(res, 0);
+	cheat_assert_int(same_value(copy, reply), 1);
+	dbus_free(reply);
+	dbus_free(copy);
+
+	res = mock_call("Unknown", NULL, &reply);
+	cheat_assert_int(res, 1);
+	cheat_assert_int(strncmp(dbus_error(conn), "org.freedesktop.DBus.Error.UnknownMethod",
+				strlen("org.freedesktop.DBus.Error.UnknownMethod")), 0);
+)
+
+CHEAT_TEST(nm_new_profile,
+	struct netinfo dev;
+	struct dbus_value *settings, *v;
+	char calls[1024];
+	int res;
+
+	res = start_mock(0);
+	cheat_assert_int(res, 0);
+	init_dev(&dev);
+
+	res = nm_set_ip(&dev, "10.1.0.2/24 fd00::2/64", "", 0);
+	cheat_assert_int(res, 0);
+	res = nm_set_gateway(&dev, "10.1.0.1", 0);
+	cheat_assert_int(res, 0);
+	res = nm_set_route(&dev, "10.2.0.0/16=10.1.0.1m5 fd01::/64", 0);
+	cheat_assert_int(res, 0);
+	res = nm_get_dhcp(&dev, 4);
+	cheat_assert_int(res, 1);
+
+	res = nm_commit();
+	cheat_assert_int(res, 0);
+	res = mock_calls(calls, sizeof(calls));
+	cheat_assert_int(res, 0);
+	cheat_assert_string(calls, "ListConnections Reload ListConnections "
+			"GetDeviceByIpIface AddAndActivateConnection Get");
+	res = access(TMP_PATH "/conf.d/60-prl_nettool_" DEV_NAME ".conf", F_OK);
+	cheat_assert_int(res, 0);
+
+	settings = mock_settings();
+	cheat_assert_not_pointer(settings, NULL);
+	cheat_assert_string(settings->sig, "a{sa{sv}}");
+	cheat_assert_string(dbus_dict_string(dbus_dict_get(settings, "connection"), "id"),
+			NM_PROFILE_PREFIX DEV_NAME);
+	cheat_assert_string(dbus_dict_string(dbus_dict_get(settings, "ipv4"), "method"),
+			"manual");
+	cheat_assert_string(dbus_dict_string(dbus_dict_get(settings, "ipv4"), "gateway"),
+			"10.1.0.1");
+	cheat_assert_pointer(dbus_dict_get(dbus_dict_get(settings, "ipv4"), "addresses"), NULL);
+
+	v = item_get(settings, "ipv4", "address-data", 0, "address");
+	cheat_assert_not_pointer(v, NULL);
+	cheat_assert_string(v->v.s, "10.1.0.2");
+	v = item_get(settings, "ipv4", "address-data", 0, "prefix");
+	cheat_assert_not_pointer(v, NULL);
+	cheat_assert_int((int)v->v.u, 24);
+	v = item_get(settings, "ipv6", "address-data", 0, "address");
+	cheat_assert_not_pointer(v, NULL);
+	cheat_assert_string(v->v.s, "fd00::2");
+
+	v = item_get(settings, "ipv4", "route-data", 0, "dest");
+	cheat_assert_not_pointer(v, NULL);
+	cheat_assert_string(v->v.s, "10.2.0.0");
+	v = item_get(settings, "ipv4", "route-data", 0, "next-hop");
+	cheat_assert_not_pointer(v, NULL);
+	cheat_assert_string(v->v.s, "10.1.0.1");
+	v = item_get(settings, "ipv4", "route-data", 0, "metric");
+	cheat_assert_not_pointer(v, NULL);
+	cheat_assert_int((int)v->v.u, 5);
+	v = item_get(settings, "ipv6", "route-data", 0, "prefix");
+	cheat_assert_not_pointer(v, NULL);
+	cheat_assert_int((int)v->v.u, 64);
+
+	v = dbus_dict_get(dbus_dict_get(settings, "802-3-ethernet"), "mac-address");
+	cheat_assert_not_pointer(v, NULL);
+	cheat_assert_string(v->sig, "ay");
+	cheat_assert_int((int)v->child->next->v.u, 0x1c);
+	dbus_free(settings);
+)
+
+CHEAT_TEST(nm_reapply,
+	struct netinfo dev;
+	struct dbus_value *settings, *v;
+	char calls[1024];
+	int res;
+
+	res = start_mock(0);
+	cheat_assert_int(res, 0);
+	init_dev(&dev);
+
+	res = nm_set_ip(&dev, "10.1.0.2/24", "", 0);
+	cheat_assert_int(res, 0);
+	res = nm_commit();
+	cheat_assert_int(res, 0);
+	mock_calls(calls, sizeof(calls));
+
+	//settings of active profile are reapplied without its activation
+	res = nm_set_ip(&dev, "10.1.0.3/24", "", 0);
+	cheat_assert_int(res, 0);
+	res = nm_commit();
+	cheat_assert_int(res, 0);
+	res = mock_calls(calls, sizeof(calls));
+	cheat_assert_int(res, 0);
+	cheat_assert_string(calls, "ListConnections GetSettings ListConnections GetSettings "
+			"Update2 GetDeviceByIpIface Get Get Reapply");
+
+	settings = mock_settings();
+	v = item_get(settings, "ipv4", "address-data", 0, "address");
+	cheat_assert_not_pointer(v, NULL);
+	cheat_assert_string(v->v.s, "10.1.0.3");
+	dbus_free(settings);
+
+	//addresses with invalid mask fail the request and leave profile as it is
+	res = nm_set_ip(&dev, "10.1.0.4/33", "", 0);
+	cheat_assert_int(res, -1);
+	res = nm_set_ip(&dev, "10.1.0.4/24 10.1.0.5/255.0.255.0", "", 0);
+	cheat_assert_int(res, -1);
+	res = nm_commit();
+	cheat_assert_int(res, 0);
+	mock_calls(calls, sizeof(calls));
+	settings = mock_settings();
+	v = item_get(settings, "ipv4", "address-data", 0, "address");
+	cheat_assert_not_pointer(v, NULL);
+	cheat_assert_string(v->v.s, "10.1.0.3");
+	v = item_get(settings, "ipv4", "address-data", 1, "address");
+	cheat_assert_pointer(v, NULL);
+	dbus_free(settings);
+
+	//profile is activated again if its settings can't be reapplied
+	res = mock_call("FailReapply", dbus_new_uint('b', 1), NULL);
+	cheat_assert_int(res, 0);
+	res = nm_set_gateway(&dev, "10.1.0.1", 0);
+	cheat_assert_int(res, 0);
+	res = nm_commit();
+	cheat_assert_int(res, 0);
+	res = mock_calls(calls, sizeof(calls));
+	cheat_assert_int(res, 0);
+	cheat_assert_not_pointer(strstr(calls, "Update2 GetDeviceByIpIface Get Get Reapply "
+				"ActivateConnection Get"), NULL);
+
+	settings = mock_settings();
+	cheat_assert_string(dbus_dict_string(dbus_dict_get(settings, "ipv4"), "gateway"),
+			"10.1.0.1");
+	v = item_get(settings, "ipv4", "address-data", 0, "address");
+	cheat_assert_not_pointer(v, NULL);
+	cheat_assert_string(v->v.s, "10.1.0.3");
+	dbus_free(settings);
+
+	//nothing is activated for live changes
+	res = nm_set_route(&dev, "10.3.0.0/16", 1);
+	cheat_assert_int(res, 0);
+	res = nm_commit();
+	cheat_assert_int(res, 0);
+	res = mock_calls(calls, sizeof(calls));
+	cheat_assert_int(res, 0);
+	cheat_assert_pointer(strstr(calls, "Activate"), NULL);
+	cheat_assert_pointer(strstr(calls, "Reapply"), NULL);
+)
+
+CHEAT_TEST(nm_old_api,
+	struct netinfo dev;
+	struct dbus_value *settings;
+	char calls[1024];
+	int res;
+
+	res = start_mock(1);
+	cheat_assert_int(res, 0);
+	init_dev(&dev);
+	//profile is only saved, devices are activated later
+	exec_set_defer(1);
+
+	res = nm_set_dhcp(&dev, "4");
+	cheat_assert_int(res, 0);
+	res = nm_commit();
+	cheat_assert_int(res, 0);
+	res = mock_calls(calls, sizeof(calls));
+	cheat_assert_int(res, 0);
+	cheat_assert_not_pointer(strstr(calls, "AddConnection2 AddConnection"), NULL);
+	cheat_assert_pointer(strstr(calls, "Activate"), NULL);
+
+	res = nm_get_dhcp(&dev, 4);
+	cheat_assert_int(res, 0);
+	res = nm_get_dhcp(&dev, 6);
+	cheat_assert_int(res, 1);
+
+	res = nm_set_ip(&dev, "10.1.0.2/24", "dhcp", 0);
+	cheat_assert_int(res, 0);
+	res = nm_commit();
+	cheat_assert_int(res, 0);
+	res = mock_calls(calls, sizeof(calls));
+	cheat_assert_int(res, 0);
+	cheat_assert_not_pointer(strstr(calls, "Update2 Update"), NULL);
+
+	settings = mock_settings();
+	cheat_assert_string(dbus_dict_string(dbus_dict_get(settings, "ipv4"), "method"),
+			"auto");
+	cheat_assert_string(dbus_dict_string(dbus_dict_get(settings, "ipv6"), "method"),
+			"ignore");
+	dbus_free(settings);
+)
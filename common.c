@@ -139,6 +139,8 @@ void error(int err, const char *fmt, ...)
 		log_msg[0] = '\0';
 	}
 
+	//keep lines of devices configured in parallel
+	flockfile(stderr);
 	fprintf(stderr, "%s: %s", PROG_NAME, log_msg);
 
 	if (err != 0)
@@ -150,6 +152,7 @@ void error(int err, const char *fmt, ...)
 
 	fprintf(stderr, "\n");
 	fflush(stderr);
+	funlockfile(stderr);
 }
 
 int is_ipv6_supported()
@@ -163,8 +166,15 @@ int is_ipv6_supported()
 void debug(const char *fmt, ...)
 {
 	time_t t = time(NULL);
+#ifdef _WIN_
 	struct tm * tm = localtime(&t);
 	char * strtime = asctime(tm);
+#else
+	struct tm tm_buf;
+	char strtime[32];
+
+	asctime_r(localtime_r(&t, &tm_buf), strtime);
+#endif
 	char msg[1024];
 	size_t len = 0;
 	int pid = (int)getpid();
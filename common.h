@@ -70,6 +70,10 @@
 #define strcasecmp _stricmp
 #endif
 
+#ifndef strncasecmp
+#define strncasecmp _strnicmp
+#endif
+
 #ifndef strcasestr
 #define strcasestr StrStrIA
 #endif
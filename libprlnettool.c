@@ -0,0 +1,1588 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2020 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * scan, compare and apply entry points of the library
+ */
+
+/* #define DEBUG_OPT_COMPARE 1 */
+
+#ifdef _WIN_
+#include <sdkddkver.h>
+#include <windows.h>
+#else
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+#include "common.h"
+#include "options.h"
+#include "netinfo.h"
+#include "setnet.h"
+#include "namelist.h"
+#include "plan.h"
+#include "libprlnettool.h"
+#ifdef _LIN_
+#include "Linux/ledger.h"
+#include "Linux/persist.h"
+#include "Linux/exec.h"
+#include "Linux/sysroot.h"
+#include "Linux/netns.h"
+#include <sys/wait.h>
+#endif
+
+extern struct nettool_options net_opts;
+#ifdef _LIN_
+extern char * os_script_prefix;
+#endif
+
+struct nettool_ctx
+{
+	struct nettool_options opts;
+	struct netinfo *netinfo;
+	int scanned;
+	int timed_out;
+#ifdef _LIN_
+	char *netns; //network namespace of calls, NULL - one of process
+#endif
+};
+
+int is_equal_dhcp(struct netinfo *if_it, struct nettool_mac *mac_it)
+{
+	int dhcpv4 = (strchr(mac_it->value, '4') != NULL);
+	int dhcpv6 = (strchr(mac_it->value, '6') != NULL);
+
+#ifdef DEBUG_OPT_COMPARE
+	debug("DHCP;%s;%s\n", if_it->mac, mac_it->value);
+	debug("configured_with_dhcp=%d configured_with_dhcpv6=%d\n",
+	      if_it->configured_with_dhcp, if_it->configured_with_dhcpv6);
+#endif
+
+	if (!net_opts.compare)
+	{
+		if_it->dhcp4_changed = 1;
+		if_it->dhcp6_changed = 1;
+		return 0;
+	}
+
+	if_it->dhcp4_changed = dhcpv4 != if_it->configured_with_dhcp;
+	if_it->dhcp6_changed = dhcpv6 != if_it->configured_with_dhcpv6;
+
+	debug("DHCP;dhcp4_changed = %d; dhcp6_changed = %d" ,
+	       if_it->dhcp4_changed, if_it->dhcp6_changed);
+
+	return !if_it->dhcp4_changed && !if_it->dhcp6_changed;
+}
+
+static int is_equal_ip_skip_local(struct netinfo *if_it, const char *str, const char *delim)
+{
+	struct namelist *values = NULL, *it;
+	struct nameset have, want;
+	int skip4 = if_it->configured_with_dhcp && is_dhcp_opt_set(if_it->mac, '4');
+	int skip6 = if_it->configured_with_dhcpv6 && is_dhcp_opt_set(if_it->mac, '6');
+	int rc = 0;
+
+	if (if_it->ip == NULL || str == NULL)
+		return (if_it->ip == NULL && str == NULL);
+
+	//thousands of addresses are compared, so search in sorted sets
+	namelist_split_delim(&values, str, delim);
+	if (nameset_init(&have, &if_it->ip) != 0)
+		goto clean;
+	if (nameset_init(&want, &values) != 0)
+		goto clean_have;
+
+	for (it = values; it != NULL; it = it->next) {
+		if (strcasestr(it->name, "remove") != NULL)
+			continue;
+		if (nameset_find(&have, it->name) < 0)
+			goto out;
+	}
+
+	for (it = if_it->ip; it != NULL; it = it->next) {
+		if (!it->name)
+			continue;
+		if (namelist_search(it->name, &if_it->ip_link))
+			//skip link-local and site-local
+			continue;
+		if (is_ipv6(it->name) ? skip6 : skip4)
+			//leased by DHCP
+			continue;
+		if (nameset_find(&want, it->name) < 0)
+			goto out;
+	}
+
+	rc = 1;
+out:
+	nameset_clean(&want);
+clean_have:
+	nameset_clean(&have);
+clean:
+	namelist_clean(&values);
+
+	return rc;
+}
+
+int is_equal_ip(struct netinfo *if_it, struct nettool_mac *mac_it)
+{
+#ifdef DEBUG_OPT_COMPARE
+	char str[1024];
+	debug("IP_OPT;%s;%s\n", if_it->mac, mac_it->value);
+	print_namelist_to_str(&if_it->ip, str, sizeof(str));
+	debug("IP;%s", str);
+	print_namelist_to_str(&if_it->ip_link, str, sizeof(str));
+	debug("IP_LINK;%s", str);
+#endif
+
+	if (!net_opts.compare)
+		return 0;
+
+	return is_equal_ip_skip_local(if_it, mac_it->value, " ");
+}
+
+int is_equal_dns(struct netinfo *if_it, struct nettool_mac *mac_it)
+{
+#ifdef DEBUG_OPT_COMPARE
+	char str[1024];
+	debug("DNS_OPT;%s;%s\n", if_it->mac, mac_it->value);
+	print_namelist_to_str(&if_it->dns, str, sizeof(str));
+	debug("DNS;%s", str);
+#endif
+	if (!net_opts.compare)
+		return 0;
+
+	return namelist_compare(&if_it->dns, mac_it->value, " ");
+}
+
+int is_equal_gateway(struct netinfo *if_it, struct nettool_mac *mac_it)
+{
+#ifdef DEBUG_OPT_COMPARE
+	char str[1024];
+	debug("GW_OPT;%s;%s\n", if_it->mac, mac_it->value);
+	print_namelist_to_str(&if_it->gateway, str, sizeof(str));
+	debug("GW;%s", str);
+#endif
+	if (!net_opts.compare)
+		return 0;
+
+	return namelist_compare(&if_it->gateway, mac_it->value, " ");
+}
+
+int is_equal_route(struct netinfo *if_it, struct nettool_mac *mac_it)
+{
+#ifdef DEBUG_OPT_COMPARE
+	char str[1024];
+	debug("ROUTE_OPT;%s;%s\n", if_it->mac, mac_it->value);
+	print_namelist_to_str(&if_it->route, str, sizeof(str));
+	debug("ROUTE;%s", str);
+#endif
+	if (!net_opts.compare || !if_it->route_scanned)
+		return 0;
+
+	return route_diff(&if_it->route, mac_it->value, NULL, NULL);
+}
+
+/* search domains and hostname are the same for all devices */
+int is_equal_search(struct netinfo *netinfo_head, struct nettool_mac *mac_it)
+{
+	if (!net_opts.compare || netinfo_head == NULL)
+		return 0;
+
+	return namelist_compare(&netinfo_head->search, mac_it->value, " ");
+}
+
+int is_equal_hostname(struct netinfo *netinfo_head, struct nettool_mac *mac_it)
+{
+	if (!net_opts.compare || netinfo_head == NULL || netinfo_head->hostname[0] == '\0')
+		return 0;
+
+	return hostname_match(netinfo_head->hostname, mac_it->value);
+}
+
+#if defined(_WIN_)
+static void do_disable_adapter(struct netinfo* adapter_)
+{
+	if (adapter_->disabled)
+		return;
+
+	enable_adapter(adapter_, 0);
+	adapter_->disabled = 1;
+}
+
+static void disable_adapter_if_needed(struct netinfo *if_it)
+{
+#if (NTDDI_VERSION < NTDDI_LONGHORN)
+	//windows 2k3 don't like if we set IP/mask/gateway
+	//from differend ranges
+	//workaround: disable adapter, update setting, enable adapter
+	if (get_opt_mac(if_it->mac, NET_OPT_GATEWAY) == NULL &&
+	    get_opt_mac(if_it->mac, NET_OPT_ROUTE) == NULL)
+		return;
+
+	//disable
+	do_disable_adapter(if_it);
+#endif // NTDDI_VERSION < NTDDI_LONGHORN
+}
+
+void enable_adapter_if_needed(struct netinfo *if_it)
+{
+	if (!if_it->disabled)
+		return;
+
+	// enable
+	enable_adapter(if_it, 1);
+	if_it->disabled = 0;
+}
+
+static void enable_adapters(struct netinfo *netinfo_head)
+{
+	struct netinfo *if_it;
+
+	//over all scanned devices
+	for (if_it = netinfo_head; if_it != NULL; if_it = if_it->next)
+	{
+#if (NTDDI_VERSION >= NTDDI_LONGHORN)
+		/*
+		 * the adapter restart is required to apply dhcp
+		 * settings on longhorn windows and newer. see
+		 * #PSBM-18905.
+		 * */
+
+		if ((if_it->dhcp4_changed || if_it->dhcp6_changed) &&
+		    (NULL != get_opt_mac(if_it->mac, NET_OPT_DHCP)))
+				do_disable_adapter(if_it);
+#endif // NTDDI_VERSION >= NTDDI_LONGHORN
+		enable_adapter_if_needed(if_it);
+	}
+}
+#endif // _WIN_
+
+struct nettool_mac *get_opt_val_substr(struct nettool_mac *mac_it, unsigned int opts, const char *value)
+{
+	while(mac_it != NULL)
+	{
+		if ((mac_it->type & opts) && mac_it->value != NULL && strstr(value, mac_it->value) != NULL)
+			return mac_it;
+
+		mac_it = mac_it->next;
+	}
+	return NULL;
+}
+
+struct nettool_mac *get_opt_val_no_substr(struct nettool_mac *mac_it, unsigned int opts, const char *value)
+{
+	while(mac_it != NULL)
+	{
+		if ((mac_it->type & opts) && mac_it->value != NULL && strstr(value, mac_it->value) == NULL)
+			return mac_it;
+
+		mac_it = mac_it->next;
+	}
+	return NULL;
+}
+
+static unsigned int all_flags[] = { NET_OPT_DHCP, NET_OPT_IP, NET_OPT_GATEWAY, NET_OPT_SEARCH,
+				NET_OPT_DNS, NET_OPT_ROUTE, NET_OPT_HOSTNAME, 0};
+
+/* exclude options for MACs which are absent in system */
+static void check_opt_macs(struct netinfo **netinfo_head)
+{
+	struct nettool_mac *mac_it;
+	int enable_count = 0;
+
+#if defined(_WIN_) && (NTDDI_VERSION >= NTDDI_LONGHORN)
+	//try to enable #PSBM-9809
+	//on win2k3 we can't detect MAC address of disabled adapter
+	//enable only on w2k8 and above
+	{
+		struct namelist *wait_adapters = NULL;
+
+		mac_it = net_opts.macs;
+		while(mac_it != NULL)
+		{
+			if (mac_it->mac != NULL &&
+				netinfo_search_mac(netinfo_head, mac_it->mac) == NULL)
+			{
+				error(0, "Info: Enabling '%s' ...", mac_it->mac);
+				if (enable_disabled_adapter(mac_it->mac) > 0)
+					namelist_add(mac_it->mac, &wait_adapters);
+
+			}
+			mac_it = mac_it->next;
+		}
+
+		if (wait_adapters != NULL)
+		{
+			wait_for_start(wait_adapters);
+			namelist_clean(&wait_adapters);
+		}
+	}
+#else
+	VARUNUSED(enable_count);
+#endif
+
+	//check MACs from options
+	mac_it = net_opts.macs;
+	while(mac_it != NULL)
+	{
+		if (mac_it->mac != NULL &&
+			netinfo_search_mac(netinfo_head, mac_it->mac) == NULL)
+		{
+			error(0, "WARNING: MAC address '%s' was not found in system", mac_it->mac);
+			//exclude from options - just clean option type
+			mac_it->type = 0;
+		}
+		mac_it = mac_it->next;
+	}
+}
+
+/* mark fields of devices which configuration differs from options,
+   differing search domains and hostname are marked in global_changed
+   return number of changed devices, global settings count as one device */
+static int mark_changed(struct netinfo *netinfo_head, unsigned int *global_changed)
+{
+	struct netinfo *if_it;
+	int i, count = 0;
+
+	*global_changed = 0;
+
+	for (i = 0; all_flags[i]; i++)
+	{
+		unsigned int opt = all_flags[i];
+
+		if (count_opt_mac(opt) == 0)
+			continue;
+
+		if (opt & NET_OPT_GETNOTMAC)
+		{
+			struct nettool_mac *mac_it = get_opt_mac(NULL, opt);
+			if (mac_it == NULL)
+				continue;
+
+			if ((opt == NET_OPT_SEARCH && !is_equal_search(netinfo_head, mac_it)) ||
+			    (opt == NET_OPT_HOSTNAME && !is_equal_hostname(netinfo_head, mac_it)))
+				*global_changed |= opt;
+			continue;
+		}
+
+		for (if_it = netinfo_head; if_it != NULL; if_it = if_it->next) //over all scanned devices
+		{
+			struct nettool_mac *mac_it = get_opt_mac(if_it->mac, opt);
+			if (mac_it == NULL)
+			{//not found
+				continue;
+			}
+#ifdef DEBUG_OPT_COMPARE
+			if (opt == NET_OPT_DHCP)
+				debug("is_equal_dhcp(if_it, mac_it)=%d\n", is_equal_dhcp(if_it, mac_it));
+			if (opt == NET_OPT_IP)
+				debug("is_equal_ip(if_it, mac_it)=%d\n", is_equal_ip(if_it, mac_it));
+			if (opt == NET_OPT_GATEWAY)
+				debug("is_equal_gw(if_it, mac_it)=%d\n", is_equal_gateway(if_it, mac_it));
+			if (opt == NET_OPT_DNS)
+				debug("is_equal_dns(if_it, mac_it)=%d\n", is_equal_dns(if_it, mac_it));
+			if (opt == NET_OPT_ROUTE)
+				debug("is_equal_route(if_it, mac_it)=%d\n", is_equal_route(if_it, mac_it));
+#endif
+			if (!net_opts.compare ||
+			    (opt == NET_OPT_DHCP && !is_equal_dhcp(if_it, mac_it)) ||
+			    (opt == NET_OPT_IP && !is_equal_ip(if_it, mac_it)) ||
+			    (opt == NET_OPT_GATEWAY && !is_equal_gateway(if_it, mac_it)) ||
+			    (opt == NET_OPT_DNS && !is_equal_dns(if_it, mac_it)) ||
+			    (opt == NET_OPT_ROUTE && !is_equal_route(if_it, mac_it)))
+			{
+				if_it->changed |= opt;
+			}
+		}
+	}
+
+	for (if_it = netinfo_head; if_it != NULL; if_it = if_it->next)
+	{
+		/* set_dhcp() rewrites configuration of the device,
+		   so static settings are set again if IPv4 stays static */
+		if ((if_it->changed & NET_OPT_DHCP) && !is_dhcp_opt_set(if_it->mac, '4'))
+			if_it->changed |= NET_OPT_IP | NET_OPT_GATEWAY | NET_OPT_ROUTE;
+
+		if (if_it->changed)
+			count++;
+	}
+
+	if (*global_changed)
+		count++;
+
+	return count;
+}
+
+/* operations of backend which change only files and state of own device,
+   they may run for several devices at once */
+static unsigned int local_ops(void)
+{
+#ifdef _LIN_
+	//ip commands
+	if (os_script_prefix == NULL)
+		return NET_OPT_IP | NET_OPT_ROUTE;
+	//per device ifcfg files, but routes are kept in one file
+	if (strcmp(os_script_prefix, "suse") == 0)
+		return NET_OPT_IP;
+	//set_ip also edits /etc/sysconfig/network
+	if (strcmp(os_script_prefix, "redhat") == 0)
+		return NET_OPT_ROUTE;
+	//debian keeps all devices in one config
+#endif
+	return 0;
+}
+
+#ifdef _LIN_
+/* set values of operations merged by plan_merge_resolver() at once */
+static int run_resolver(struct plan_op *op)
+{
+	struct plan_op *dns = plan_merged(op, NET_OPT_DNS);
+	struct plan_op *search = plan_merged(op, NET_OPT_SEARCH);
+	struct plan_op *hostname = plan_merged(op, NET_OPT_HOSTNAME);
+
+	return set_resolver((dns != NULL) ? dns->if_it : NULL,
+			(dns != NULL) ? dns->value : NULL,
+			(search != NULL) ? search->value : NULL,
+			(hostname != NULL) ? hostname->value : NULL);
+}
+#endif
+
+static int run_op(struct plan_op *op)
+{
+	struct nettool_mac params;
+	int rc = 0;
+
+	params.type = op->type;
+	params.mac = (op->if_it != NULL) ? op->if_it->mac : NULL;
+	params.value = op->value;
+	params.next = NULL;
+
+#if defined(_WIN_)
+	if (op->if_it != NULL)
+		disable_adapter_if_needed(op->if_it);
+#endif // _WIN_
+#ifdef _LIN_
+	//only differing addresses and routes of the plan are changed in kernel,
+	//set_* functions then rewrite configuration without restart
+	if ((op->type == NET_OPT_IP || op->type == NET_OPT_ROUTE) &&
+			(op->add != NULL || op->del != NULL) &&
+			!(op->if_it->live & op->type)) {
+		rc = set_delta(op->if_it, op->type, op->add, op->del);
+		if (rc < 0)
+			error(0, "Failed to change %s of %s live, configuration is set as whole",
+				(op->type == NET_OPT_IP) ? "addresses" : "routes",
+				op->if_it->name);
+		rc = 0;
+	}
+#endif
+	if (op->type == NET_OPT_DHCP)
+		rc = set_dhcp(op->if_it, &params);
+	else if (op->type == NET_OPT_IP)
+		rc = set_ip(op->if_it, &params);
+	else if (op->type == NET_OPT_GATEWAY)
+		rc = set_gateway(op->if_it, &params);
+	else if (op->type == NET_OPT_DNS)
+		rc = set_dns(op->if_it, &params);
+	else if (op->type == NET_OPT_ROUTE)
+		rc = set_route(op->if_it, &params);
+	else if (op->type == NET_OPT_SEARCH)
+		rc = set_search_domain(&params);
+	else if (op->type == NET_OPT_HOSTNAME)
+		rc = set_hostname(&params);
+#ifdef _LIN_
+	else if (op->type == PLAN_OP_RESOLVER)
+		rc = run_resolver(op);
+#endif
+
+	return rc;
+}
+
+#ifdef _LIN_
+/* operations which need restart of device */
+#define ACTIVATE_OPS	(NET_OPT_DHCP | NET_OPT_IP | NET_OPT_GATEWAY | NET_OPT_ROUTE)
+
+/* activation mostly waits for link, DHCP and DAD,
+   so up to this number of devices are brought up at once */
+#define ACTIVATE_JOBS	32
+
+static void report_device(struct netinfo *if_it, const char *what, int rc)
+{
+	if (rc)
+		error(0, "Failed to %s %s (%s): %d", what, if_it->name, if_it->mac, rc);
+	else
+		debug("%s %s (%s) done", what, if_it->name, if_it->mac);
+}
+
+static int run_activate(struct plan_op *op)
+{
+	int rc = activate_device(op->if_it);
+
+	report_device(op->if_it, "activate", rc);
+	return rc;
+}
+
+static int run_restart(struct plan_op *op)
+{
+	int rc = restart_device(op->if_it);
+
+	report_device(op->if_it, "restart", rc);
+	return rc;
+}
+
+/* add device to the list of devices to be restarted once */
+static int add_device(struct netinfo *if_it, struct plan_op **devices)
+{
+	struct plan_op *op;
+
+	for (op = *devices; op != NULL; op = op->next)
+		if (op->if_it == if_it)
+			return 0;
+
+	op = plan_add(0, if_it, "", devices);
+	if (op == NULL)
+		return -1;
+	op->local = 1;
+
+	return 0;
+}
+
+/* bring up once each device changed by the plan, all devices at once */
+static int activate_devices(struct plan_op *plan)
+{
+	struct plan_op *op, *devices = NULL;
+	int rc;
+
+	for (op = plan; op != NULL; op = op->next)
+	{
+		if (op->if_it == NULL || !(op->type & ACTIVATE_OPS))
+			continue;
+		if (op->type == NET_OPT_IP && is_ip_delta(op->if_it))
+			continue;
+		//set in kernel by --fast, only configuration is written
+		if (op->if_it->live & op->type)
+			continue;
+
+		if (add_device(op->if_it, &devices)) {
+			plan_clean(&devices);
+			return -1;
+		}
+	}
+
+	rc = plan_execute(devices, ACTIVATE_JOBS, run_activate);
+	plan_clean(&devices);
+
+	return rc;
+}
+#endif
+
+/* execute operations of the plan, devices are configured in parallel
+   if backend allows it */
+static int apply_plan(struct netinfo **netinfo_head, struct plan_op **plan)
+{
+	int rc;
+	struct plan_op *op;
+	unsigned int local = local_ops();
+#ifdef _LIN_
+	int rc2, defer = (net_opts.transaction && os_script_prefix != NULL);
+#endif
+
+#ifdef _MAC_
+	OpenEdit();
+#endif
+
+	for (op = *plan; op != NULL; op = op->next)
+	{
+		op->local = (op->if_it != NULL && (op->type & local));
+		if (op->if_it != NULL)
+			op->if_it->changed |= op->type;
+	}
+
+#ifdef _LIN_
+	//resolver files are written once for all of its options
+	if (plan_merge_resolver(plan, is_resolver_global()) < 0)
+		return -1;
+
+	exec_set_defer(defer);
+#endif
+	rc = plan_execute(*plan, net_opts.jobs, run_op);
+#ifdef _LIN_
+	rc2 = commit_config();
+	if (rc2)
+		rc = rc2;
+	if (defer) {
+		exec_set_defer(0);
+		//devices of stopped guest are brought up by its boot
+		rc2 = sysroot_offline() ? 0 : activate_devices(*plan);
+		if (rc2)
+			rc = rc2;
+	}
+#endif
+
+#ifdef _MAC_
+	SavePrefs();
+#endif
+
+#if defined(_WIN_)
+	enable_adapters(*netinfo_head);
+#else
+	VARUNUSED(netinfo_head);
+#endif // _WIN_
+	return rc;
+}
+
+/* operations of request in order they should be applied */
+static int build_request_plan(struct netinfo **netinfo_head, unsigned int global_changed,
+		struct plan_op **plan)
+{
+	int i;
+	struct netinfo *if_it = NULL;
+
+	for (i = 0; all_flags[i]; i++)
+	{
+		unsigned int opt = all_flags[i];
+		struct nettool_mac *mac_it;
+
+		if (count_opt_mac(opt) == 0)
+			continue;
+
+		if (opt & NET_OPT_GETNOTMAC)
+		{
+			mac_it = get_opt_mac(NULL, opt);
+			if (mac_it == NULL || !(global_changed & opt))
+				continue;
+			if (plan_add(opt, NULL, mac_it->value, plan) == NULL)
+				return -1;
+			continue;
+		}
+
+		if (opt == NET_OPT_GATEWAY)
+		{
+			// remove gateway first
+			mac_it = get_opt_val_substr(net_opts.macs, NET_OPT_GATEWAY, "remove");
+			while (mac_it != NULL) {
+				if_it = netinfo_search_mac(netinfo_head, mac_it->mac);
+				if (if_it && (if_it->changed & NET_OPT_GATEWAY) &&
+						plan_add(opt, if_it, mac_it->value, plan) == NULL)
+					return -1;
+				mac_it = get_opt_val_substr(mac_it->next, NET_OPT_GATEWAY, "remove");
+			}
+
+			// then set
+			mac_it = get_opt_val_no_substr(net_opts.macs, NET_OPT_GATEWAY, "remove");
+			while (mac_it != NULL) {
+				if_it = netinfo_search_mac(netinfo_head, mac_it->mac);
+				if (if_it && (if_it->changed & NET_OPT_GATEWAY) &&
+						plan_add(opt, if_it, mac_it->value, plan) == NULL)
+					return -1;
+				mac_it = get_opt_val_no_substr(mac_it->next, NET_OPT_GATEWAY, "remove");
+			}
+			continue;
+		}
+
+		for (if_it = *netinfo_head; if_it != NULL; if_it = if_it->next) //over all scanned devices
+		{
+			mac_it = get_opt_mac(if_it->mac, opt);
+			if (mac_it == NULL || !(if_it->changed & opt))
+				continue;
+
+			if (plan_add(opt, if_it, mac_it->value, plan) == NULL)
+				return -1;
+		} //over network interfaces
+	}
+
+	return 0;
+}
+
+/* operations of request which differ from scanned state */
+static int request_plan(struct netinfo **netinfo_head, struct plan_op **plan)
+{
+	unsigned int global_changed;
+
+	if (count_opt_mac(NET_OPT_GETBYMAC) == 0 && count_opt_mac(NET_OPT_GETNOTMAC) == 0)
+		return 0;//nothing to do
+
+	check_opt_macs(netinfo_head);
+
+	mark_changed(*netinfo_head, &global_changed);
+
+	if (build_request_plan(netinfo_head, global_changed, plan)) {
+		plan_clean(plan);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int apply_parameters(struct netinfo **netinfo_head)
+{
+	int rc;
+	struct plan_op *plan = NULL;
+
+	if (request_plan(netinfo_head, &plan))
+		return -1;
+
+	rc = apply_plan(netinfo_head, &plan);
+	plan_clean(&plan);
+
+	return rc;
+}
+
+#ifdef _LIN_
+/* set addresses, gateways and routes of the plan in kernel
+return 0 if all of them were set, error of the first failed one otherwise */
+static int apply_live(struct plan_op *plan)
+{
+	struct nettool_mac params;
+	struct plan_op *op;
+	int rc;
+
+	for (op = plan; op != NULL; op = op->next)
+	{
+		if (op->if_it == NULL)
+			continue;
+
+		params.type = op->type;
+		params.mac = op->if_it->mac;
+		params.value = op->value;
+		params.next = NULL;
+
+		rc = set_live(op->if_it, &params);
+		if (rc < 0) {
+			error(0, "Failed to set %s of %s live, configure it as usual",
+					op->value, op->if_it->name);
+			return rc;
+		}
+	}
+
+	return 0;
+}
+#endif
+
+static int clean_parameters(struct netinfo *netinfo_head)
+{
+
+	struct netinfo *if_it;
+
+#ifdef _MAC_
+	OpenEdit();
+#endif
+
+
+		for (if_it = netinfo_head; if_it != NULL; if_it = if_it->next) //over all scanned devices
+		{
+			int rc = 0;
+
+
+			if (!if_it->configured_with_dhcp)
+				continue;
+
+
+			rc = clean(if_it);
+
+
+			if (rc)
+			{
+				goto exit;
+			}
+
+		} //over network interfaces
+
+
+exit:
+#ifdef _MAC_
+	SavePrefs();
+#endif
+	return 0;
+}
+
+/* restart devices from request or whole network if there are none */
+static int restart_network(struct netinfo **netinfo_head)
+{
+#ifdef _LIN_
+	struct nettool_mac *mac_it;
+	struct netinfo *if_it;
+	struct plan_op *devices = NULL;
+	int rc;
+
+	detect_distribution();
+
+	if (count_opt_mac(NET_OPT_GETBYMAC) == 0)
+		return restart_guest_network();
+
+	for (mac_it = net_opts.macs; mac_it != NULL; mac_it = mac_it->next)
+	{
+		if (mac_it->mac == NULL)
+			continue;
+
+		if_it = netinfo_search_mac(netinfo_head, mac_it->mac);
+		if (if_it == NULL) {
+			error(0, "WARNING: MAC address '%s' was not found in system", mac_it->mac);
+			continue;
+		}
+
+		if (add_device(if_it, &devices)) {
+			plan_clean(&devices);
+			return -1;
+		}
+	}
+
+	rc = plan_execute(devices, ACTIVATE_JOBS, run_restart);
+	plan_clean(&devices);
+
+	return rc;
+#else
+	VARUNUSED(netinfo_head);
+
+	return restart_guest_network();
+#endif
+}
+
+
+#define MUTEX_TIMEOUT	240
+#ifdef _WIN_
+#define MUTEX_NAME	"Global\\prl_nettool_mutex"
+static HANDLE hMutex;
+#else
+#define MUTEX_NAME "/tmp/prl_nettool.lock"
+static int fdlock = -1;
+#endif
+
+#ifndef _WIN_
+static void lock_file(void)
+{
+	struct flock fl;
+
+	fl.l_type = F_WRLCK;
+	fl.l_whence = SEEK_SET;
+	fl.l_start = 0;
+	fl.l_len = 1;
+
+	if ((fdlock = open(MUTEX_NAME, O_WRONLY|O_CREAT, 0600)) == -1) {
+		fprintf(stderr, "WARNING: open(\"%s\") = %d\n", MUTEX_NAME, errno);
+	} else {
+		int count = MUTEX_TIMEOUT;
+		while (fcntl(fdlock, F_SETLK, &fl) == -1) {
+			if (errno == EAGAIN || errno == EACCES) {
+				if (--count == 0) {
+					fprintf(stderr, "ERROR: timeout waiting for pending operation to finish\n");
+					exit(2);
+				}
+				sleep(1);
+			} else {
+				fprintf(stderr, "WARNING: fcntl(\"%s\", F_SETLK) = %d\n", MUTEX_NAME, errno);
+				break;
+			}
+		}
+	}
+}
+#endif
+
+void nettool_lock(void)
+{
+#ifdef _WIN_
+	hMutex = CreateMutexA(NULL, FALSE, MUTEX_NAME);
+	if (hMutex == NULL && GetLastError() == ERROR_ALREADY_EXISTS) {
+		hMutex = OpenMutexA(SYNCHRONIZE, FALSE, MUTEX_NAME);
+	}
+	if (hMutex == NULL) {
+		fprintf(stderr, "WARNING: OpenMutex(\"%s\") = %u\n", MUTEX_NAME, (int)GetLastError());
+	} else {
+		switch (WaitForSingleObject(hMutex, MUTEX_TIMEOUT*1000))
+		{
+		case WAIT_FAILED:
+		case WAIT_ABANDONED:
+			fprintf(stderr, "ERROR: WaitForSingleObject(\"%s\") = %u\n", MUTEX_NAME, (int)GetLastError());
+			exit(2);
+			break;
+		case WAIT_TIMEOUT:
+			fprintf(stderr, "ERROR: timeout waiting for pending operation to finish\n");
+			exit(2);
+			break;
+		}
+	}
+#else
+	lock_file();
+#ifdef _LIN_
+	{
+		int count = MUTEX_TIMEOUT;
+
+		//configuration of previous --fast request is still written
+		while (persist_pending()) {
+			nettool_unlock();
+			if (--count == 0) {
+				fprintf(stderr, "ERROR: timeout waiting for pending operation to finish\n");
+				exit(2);
+			}
+			sleep(1);
+			lock_file();
+		}
+	}
+#endif
+#endif
+}
+
+void nettool_unlock(void)
+{
+#ifdef _WIN_
+	if (hMutex)
+		ReleaseMutex(hMutex);
+#else
+	if (fdlock != -1) {
+		close(fdlock);
+		fdlock = -1;
+	}
+#endif
+}
+
+/* option helpers work with global net_opts,
+   so request of the context is made current for the duration of the call */
+static struct nettool_options saved_opts;
+
+static void ctx_enter(struct nettool_ctx *ctx)
+{
+	saved_opts = net_opts;
+	net_opts = ctx->opts;
+}
+
+static void ctx_leave(struct nettool_ctx *ctx)
+{
+	ctx->opts = net_opts;
+	net_opts = saved_opts;
+}
+
+struct nettool_ctx *nettool_ctx_new(void)
+{
+	struct nettool_ctx *ctx = (struct nettool_ctx *) malloc(sizeof(struct nettool_ctx));
+	if (ctx == NULL) {
+		error(errno, "Can't allocate memory for nettool_ctx");
+		return NULL;
+	}
+
+	memset(ctx, 0, sizeof(struct nettool_ctx));
+	ctx->opts.action = SET;
+	ctx->opts.timeout = NET_DEFAULT_TIMEOUT;
+	ctx->opts.jobs = NET_DEFAULT_JOBS;
+
+	return ctx;
+}
+
+struct nettool_ctx *nettool_ctx_from_options(void)
+{
+	struct nettool_ctx *ctx = nettool_ctx_new();
+	if (ctx == NULL)
+		return NULL;
+
+	ctx->opts = net_opts;
+	set_empty_options();
+
+	return ctx;
+}
+
+void nettool_ctx_free(struct nettool_ctx *ctx)
+{
+	if (ctx == NULL)
+		return;
+
+	nettool_request_clear(ctx);
+	netinfo_clean(&ctx->netinfo);
+#ifdef _LIN_
+	free(ctx->netns);
+#endif
+	free(ctx);
+}
+
+void nettool_set_compare(struct nettool_ctx *ctx, int compare)
+{
+	ctx->opts.compare = compare;
+}
+
+void nettool_set_timeout(struct nettool_ctx *ctx, unsigned int timeout,
+		unsigned int budget)
+{
+	ctx->opts.timeout = timeout;
+	ctx->opts.budget = budget;
+}
+
+void nettool_set_jobs(struct nettool_ctx *ctx, unsigned int jobs)
+{
+	ctx->opts.jobs = jobs;
+}
+
+void nettool_set_transaction(struct nettool_ctx *ctx, int transaction)
+{
+	ctx->opts.transaction = transaction;
+}
+
+void nettool_set_delta(struct nettool_ctx *ctx, int delta)
+{
+	ctx->opts.delta = delta;
+}
+
+void nettool_set_fast(struct nettool_ctx *ctx, int fast)
+{
+	ctx->opts.fast = fast;
+}
+
+int nettool_timed_out(struct nettool_ctx *ctx)
+{
+	return ctx->timed_out;
+}
+
+#ifdef _LIN_
+/* options which are set by netlink in other network namespace */
+#define NETNS_OPS	(NET_OPT_IP | NET_OPT_GATEWAY | NET_OPT_ROUTE)
+
+static int check_netns_opts(struct nettool_ctx *ctx)
+{
+	struct nettool_mac *mac_it;
+
+	if (ctx->opts.action != SET && ctx->opts.action != APPLY)
+		return 0;
+
+	for (mac_it = ctx->opts.macs; mac_it != NULL; mac_it = mac_it->next)
+	{
+		if (mac_it->type & ~NETNS_OPS) {
+			error(0, "Only addresses, gateways and routes can be set "
+				"in network namespace %s", ctx->netns);
+			return -1;
+		}
+	}
+	return 0;
+}
+#endif
+
+/* begin request which may run external commands: start its time budget */
+static int request_start(struct nettool_ctx *ctx)
+{
+	ctx->timed_out = 0;
+#ifdef _LIN_
+	if (ctx->netns != NULL &&
+			(check_netns_opts(ctx) || netns_enter(ctx->netns)))
+		return -1;
+	persist_report();
+	exec_set_limits(ctx->opts.timeout, ctx->opts.budget);
+#endif
+	return 0;
+}
+
+static void request_done(struct nettool_ctx *ctx)
+{
+#ifdef _LIN_
+	ctx->timed_out = (exec_timed_out() != 0);
+	exec_set_limits(0, 0);
+	if (ctx->netns != NULL)
+		netns_leave();
+#endif
+}
+
+int nettool_request_add(struct nettool_ctx *ctx, unsigned int opt,
+		const char *mac, const char *value)
+{
+	int rc;
+
+	ctx_enter(ctx);
+	rc = add_request_opt(opt, mac, value);
+	ctx_leave(ctx);
+
+	return rc;
+}
+
+int nettool_set_ifname(struct nettool_ctx *ctx, const char *mac, const char *name)
+{
+	int rc;
+
+	ctx_enter(ctx);
+	rc = add_ifname(mac, name);
+	ctx_leave(ctx);
+
+	return rc;
+}
+
+int nettool_set_netns(struct nettool_ctx *ctx, const char *ns)
+{
+#ifdef _LIN_
+	char *copy = NULL;
+
+	if (ns != NULL && (copy = strdup(ns)) == NULL) {
+		error(errno, "Can't allocate memory for namespace");
+		return -1;
+	}
+	free(ctx->netns);
+	ctx->netns = copy;
+	//scanned devices belong to previous namespace
+	netinfo_clean(&ctx->netinfo);
+	ctx->scanned = 0;
+
+	return 0;
+#else
+	if (ns == NULL)
+		return 0;
+	error(0, "Network namespace %s is not supported", ns);
+	return -1;
+#endif
+}
+
+int nettool_list_netns(struct namelist **list)
+{
+#ifdef _LIN_
+	return netns_list(list);
+#else
+	VARUNUSED(list);
+	return 0;
+#endif
+}
+
+void nettool_request_clear(struct nettool_ctx *ctx)
+{
+	struct nettool_options opts = ctx->opts;
+
+	ctx_enter(ctx);
+	free_options();
+	net_opts.compare = opts.compare;
+	net_opts.action = opts.action;
+	net_opts.timeout = opts.timeout;
+	net_opts.budget = opts.budget;
+	net_opts.jobs = opts.jobs;
+	net_opts.transaction = opts.transaction;
+	net_opts.delta = opts.delta;
+	net_opts.fast = opts.fast;
+	ctx_leave(ctx);
+}
+
+int nettool_scan(struct nettool_ctx *ctx)
+{
+	int rc;
+
+	netinfo_clean(&ctx->netinfo);
+
+#ifdef _LIN_
+	if (ctx->netns != NULL && netns_enter(ctx->netns))
+		return -1;
+#endif
+
+	//get ALL information in system
+#ifdef _LIN_
+	if (sysroot_offline())
+		rc = get_offline_device_list(&ctx->netinfo, ctx->opts.ifnames);
+	else
+#endif
+	rc = get_device_list(&ctx->netinfo);
+	ctx->scanned = (rc == 0);
+
+#ifdef _LIN_
+	if (ctx->netns != NULL)
+		netns_leave();
+#endif
+
+	return rc;
+}
+
+struct netinfo *nettool_query(struct nettool_ctx *ctx, const char *mac)
+{
+	if (!ctx->scanned && nettool_scan(ctx))
+		return NULL;
+
+	if (mac == NULL)
+		return ctx->netinfo;
+
+	return netinfo_search_mac(&ctx->netinfo, mac);
+}
+
+int nettool_compare(struct nettool_ctx *ctx)
+{
+	struct netinfo *if_it;
+	int count, compare = ctx->opts.compare;
+	unsigned int global_changed;
+
+	if (!ctx->scanned && nettool_scan(ctx))
+		return -1;
+
+	for (if_it = ctx->netinfo; if_it != NULL; if_it = if_it->next)
+		if_it->changed = 0;
+
+	ctx_enter(ctx);
+	net_opts.compare = 1;
+	count = mark_changed(ctx->netinfo, &global_changed);
+	ctx_leave(ctx);
+	ctx->opts.compare = compare;
+
+	return count;
+}
+
+#ifdef _LIN_
+/* apply changed netplan configuration and record result of request */
+static int request_finish(struct nettool_ctx *ctx, int rc)
+{
+	//ledger and netplan describe devices of process namespace only
+	if (sysroot_offline() || ctx->netns != NULL)
+		return rc;
+
+	if (rc == 0 && os_script_prefix != NULL && strcmp("debian", os_script_prefix) == 0)
+		rc = restart_debian_netplan_network(ctx->netinfo);
+
+	ctx_enter(ctx);
+	if (rc == 0)
+		ledger_update(ctx->netinfo);
+	else
+		ledger_forget();
+	ctx_leave(ctx);
+
+	return rc;
+}
+
+/* write configuration of the plan and finish request */
+static int persist_plan(struct nettool_ctx *ctx, struct plan_op **plan)
+{
+	int rc;
+
+	ctx_enter(ctx);
+	rc = apply_plan(&ctx->netinfo, plan);
+	ctx_leave(ctx);
+
+	return request_finish(ctx, rc);
+}
+
+/* set kernel state and return, configuration is written in background */
+static int apply_request_fast(struct nettool_ctx *ctx)
+{
+	struct plan_op *plan = NULL;
+	struct netinfo *if_it;
+	pid_t pid;
+	int rc;
+
+	if (nettool_scan(ctx))
+		return -1;
+
+	ctx_enter(ctx);
+	rc = request_plan(&ctx->netinfo, &plan);
+	ctx_leave(ctx);
+	if (rc)
+		return rc;
+
+	if (plan == NULL)
+		return 0;
+
+	ctx_enter(ctx);
+	rc = apply_live(plan);
+	ctx_leave(ctx);
+
+	if (rc == 0) {
+		pid = persist_start();
+		if (pid == 0) {
+			//child: inherited lock is not held, wait for the caller
+			nettool_unlock();
+			nettool_lock();
+			rc = persist_plan(ctx, &plan);
+			persist_done(rc);
+			nettool_unlock();
+			_exit(rc ? 1 : 0);
+		}
+		if (pid > 0) {
+			debug("%s: configuration is written in background", __FUNCTION__);
+			//previous ledger does not match anymore, the child
+			//records the request once configuration is written
+			ctx_enter(ctx);
+			ledger_forget();
+			ctx_leave(ctx);
+			plan_clean(&plan);
+			return 0;
+		}
+		//write configuration now, kernel state is set already
+	} else {
+		//fall back to usual configuration of the whole plan
+		for (if_it = ctx->netinfo; if_it != NULL; if_it = if_it->next)
+			if_it->live = 0;
+	}
+
+	rc = persist_plan(ctx, &plan);
+	plan_clean(&plan);
+
+	return rc;
+}
+#endif
+
+static int apply_request(struct nettool_ctx *ctx)
+{
+	int rc;
+
+#ifdef _LIN_
+	/* same request is re-sent often, skip scan if it was applied already */
+	if (ctx->opts.compare && ctx->netns == NULL) {
+		ctx_enter(ctx);
+		rc = ledger_match();
+		ctx_leave(ctx);
+		if (rc)
+			return 0;
+	}
+
+	//devices of other namespace are set live anyway
+	if (ctx->opts.fast && ctx->netns == NULL) {
+		rc = apply_request_fast(ctx);
+		ctx->scanned = 0;
+		return rc;
+	}
+#endif
+
+	if (nettool_scan(ctx))
+		return -1;
+
+	ctx_enter(ctx);
+	rc = apply_parameters(&ctx->netinfo);
+	ctx_leave(ctx);
+
+#ifdef _LIN_
+	rc = request_finish(ctx, rc);
+#endif
+
+	/* configuration was changed, scan again on next query */
+	ctx->scanned = 0;
+
+	return rc;
+}
+
+int nettool_apply(struct nettool_ctx *ctx)
+{
+	int rc;
+
+	if (request_start(ctx))
+		return -1;
+	rc = apply_request(ctx);
+	request_done(ctx);
+
+	return rc;
+}
+
+#ifdef _LIN_
+/* child process: apply request inside of root and exit */
+static void apply_root_request(struct nettool_ctx *ctx, const char *root)
+{
+	int rc = -1;
+
+	if (sysroot_enter(root) == 0) {
+		//configuration is only written, nothing is compared or set live
+		ctx->opts.compare = 0;
+		ctx->opts.transaction = 1;
+		ctx->opts.delta = 0;
+		ctx->opts.fast = 0;
+		ctx->scanned = 0;
+		if (request_start(ctx) == 0) {
+			rc = apply_request(ctx);
+			request_done(ctx);
+		}
+	}
+
+	if (rc && ctx->timed_out)
+		_exit(NET_EXIT_TIMEOUT);
+	_exit(rc ? 1 : 0);
+}
+#endif
+
+int nettool_apply_root(struct nettool_ctx *ctx, const char *root)
+{
+#ifdef _LIN_
+	struct nettool_mac *mac_it, *name_it;
+	pid_t pid;
+	int status;
+
+	if (ctx->netns != NULL) {
+		error(0, "Stopped guest at %s has no network namespaces", root);
+		return -1;
+	}
+
+	//devices of stopped guest can't be scanned, all of them are named
+	for (mac_it = ctx->opts.macs; mac_it != NULL; mac_it = mac_it->next)
+	{
+		if (mac_it->mac == NULL)
+			continue;
+		for (name_it = ctx->opts.ifnames; name_it != NULL; name_it = name_it->next)
+			if (!strcmp(name_it->mac, mac_it->mac))
+				break;
+		if (name_it == NULL) {
+			error(0, "Name of device %s should be set by --ifname", mac_it->mac);
+			return -1;
+		}
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+	pid = fork();
+	if (pid < 0) {
+		error(errno, "Can't fork");
+		return -1;
+	}
+	if (pid == 0)
+		apply_root_request(ctx, root);
+
+	while (waitpid(pid, &status, 0) < 0) {
+		if (errno != EINTR) {
+			error(errno, "Can't wait for configuration of %s", root);
+			return -1;
+		}
+	}
+
+	ctx->timed_out = (WIFEXITED(status) && WEXITSTATUS(status) == NET_EXIT_TIMEOUT);
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		error(0, "Failed to configure %s", root);
+		return -1;
+	}
+	debug("%s: %s is configured", __FUNCTION__, root);
+
+	return 0;
+#else
+	error(0, "Configuration of stopped guest at %s is not supported", root);
+	return -1;
+#endif
+}
+
+static int plan_request(struct nettool_ctx *ctx, int print)
+{
+	struct plan_op *plan = NULL;
+	int count;
+
+	if (nettool_scan(ctx))
+		return -1;
+
+	ctx_enter(ctx);
+	check_opt_macs(&ctx->netinfo);
+	count = plan_build(ctx->netinfo, &plan);
+	ctx_leave(ctx);
+
+	if (print)
+		plan_print(plan);
+	plan_clean(&plan);
+
+	return count;
+}
+
+int nettool_plan(struct nettool_ctx *ctx, int print)
+{
+	int rc;
+
+	if (request_start(ctx))
+		return -1;
+	rc = plan_request(ctx, print);
+	request_done(ctx);
+
+	return rc;
+}
+
+static int converge_request(struct nettool_ctx *ctx)
+{
+	struct plan_op *plan = NULL;
+	int rc = 0, count;
+
+	if (nettool_scan(ctx))
+		return -1;
+
+	ctx_enter(ctx);
+	check_opt_macs(&ctx->netinfo);
+	count = plan_build(ctx->netinfo, &plan);
+	if (count > 0)
+		rc = apply_plan(&ctx->netinfo, &plan);
+	ctx_leave(ctx);
+	plan_clean(&plan);
+
+	debug("%s: %d operations, rc = %d", __FUNCTION__, count, rc);
+	if (count < 0)
+		return -1;
+	if (count == 0)
+		return 0;
+
+#ifdef _LIN_
+	rc = request_finish(ctx, rc);
+#endif
+
+	ctx->scanned = 0;
+
+	return rc;
+}
+
+int nettool_converge(struct nettool_ctx *ctx)
+{
+	int rc;
+
+	if (request_start(ctx))
+		return -1;
+	rc = converge_request(ctx);
+	request_done(ctx);
+
+	return rc;
+}
+
+static int clean_request(struct nettool_ctx *ctx)
+{
+	int rc;
+
+	if (nettool_scan(ctx))
+		return -1;
+
+	ctx_enter(ctx);
+	rc = clean_parameters(ctx->netinfo);
+	ctx_leave(ctx);
+
+	ctx->scanned = 0;
+
+	return rc;
+}
+
+int nettool_clean(struct nettool_ctx *ctx)
+{
+	int rc;
+
+	if (request_start(ctx))
+		return -1;
+	rc = clean_request(ctx);
+	request_done(ctx);
+
+	return rc;
+}
+
+static int restart_request(struct nettool_ctx *ctx)
+{
+	int rc;
+
+	if (ctx->opts.macs != NULL && nettool_scan(ctx))
+		return -1;
+
+	ctx_enter(ctx);
+	rc = restart_network(&ctx->netinfo);
+	ctx_leave(ctx);
+
+	ctx->scanned = 0;
+
+	return rc;
+}
+
+int nettool_restart(struct nettool_ctx *ctx)
+{
+	int rc;
+
+	if (request_start(ctx))
+		return -1;
+	rc = restart_request(ctx);
+	request_done(ctx);
+
+	return rc;
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2020 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * C API of prl_nettool for in-process use by the guest tools agent
+ */
+
+#ifndef __LIBPRLNETTOOL_H__
+#define __LIBPRLNETTOOL_H__
+
+#include "netinfo.h"
+#include "options.h"
+
+#define NETTOOL_API_VERSION	1
+
+/*
+ * Opaque handle holding one request (list of options) and the
+ * scanned state of the guest network.
+ * The library is not thread-safe: use one context at a time.
+ */
+struct nettool_ctx;
+
+struct nettool_ctx *nettool_ctx_new(void);
+
+void nettool_ctx_free(struct nettool_ctx *ctx);
+
+/* create context with the request parsed by parse_options() */
+struct nettool_ctx *nettool_ctx_from_options(void);
+
+/* same meaning as --compare: skip options that already match */
+void nettool_set_compare(struct nettool_ctx *ctx, int compare);
+
+/* limit time of external commands run by apply, converge, clean and restart:
+   deadline of each command and budget of whole call, s, 0 - unlimited
+   default is NET_DEFAULT_TIMEOUT for command and no budget */
+void nettool_set_timeout(struct nettool_ctx *ctx, unsigned int timeout,
+		unsigned int budget);
+
+/* configure up to jobs devices at once, default is NET_DEFAULT_JOBS */
+void nettool_set_jobs(struct nettool_ctx *ctx, unsigned int jobs);
+
+/* write configuration of all operations first and then bring up
+   each changed device once, Linux only */
+void nettool_set_transaction(struct nettool_ctx *ctx, int transaction);
+
+/* change addresses of devices without DHCP live, adding and deleting
+   only the difference, configuration is written without restart, Linux only */
+void nettool_set_delta(struct nettool_ctx *ctx, int delta);
+
+/* set apply sets addresses, gateways and routes of static devices live
+   and returns, configuration is written by forked process which holds
+   the lock until it is done, its failure is reported by the next call,
+   Linux only */
+void nettool_set_fast(struct nettool_ctx *ctx, int fast);
+
+/* check if some command of the last call was killed on timeout */
+int nettool_timed_out(struct nettool_ctx *ctx);
+
+/* run following calls in network namespace ns: name of "ip netns" or path
+   to namespace file, NULL - namespace of process, scanned state is dropped,
+   only addresses, gateways and routes are set there, live and without
+   configuration files, Linux only */
+int nettool_set_netns(struct nettool_ctx *ctx, const char *ns);
+
+/* add names of namespaces of "ip netns" to list, return 0 on success */
+int nettool_list_netns(struct namelist **list);
+
+/* add option of NET_OPT_* type to the request
+   mac is NULL for NET_OPT_SEARCH and NET_OPT_HOSTNAME,
+   value is the same string that is accepted on command line */
+int nettool_request_add(struct nettool_ctx *ctx, unsigned int opt,
+		const char *mac, const char *value);
+
+void nettool_request_clear(struct nettool_ctx *ctx);
+
+/* (re)scan network devices of the guest, return 0 on success */
+int nettool_scan(struct nettool_ctx *ctx);
+
+/* search scanned device by MAC address, NULL mac returns head of list */
+struct netinfo *nettool_query(struct nettool_ctx *ctx, const char *mac);
+
+/* return number of devices which should be changed by the request,
+   changed search domains or hostname count as one more device,
+   0 - current configuration already matches */
+int nettool_compare(struct nettool_ctx *ctx);
+
+/* apply the request, return 0 on success */
+int nettool_apply(struct nettool_ctx *ctx);
+
+/* name device with MAC in stopped guest for nettool_apply_root() */
+int nettool_set_ifname(struct nettool_ctx *ctx, const char *mac, const char *name);
+
+/* apply the request to stopped guest whose filesystem is mounted at root:
+   distribution and backend are detected from its files, only configuration
+   is written and devices, kernel and services of host are not touched,
+   all devices of the request should be named by nettool_set_ifname(),
+   Linux only, return 0 on success */
+int nettool_apply_root(struct nettool_ctx *ctx, const char *root);
+
+/* request is treated as desired state: compute operations which make
+   scanned configuration match it, print them if print is set
+   return number of operations or -1 on error */
+int nettool_plan(struct nettool_ctx *ctx, int print);
+
+/* execute only operations computed by nettool_plan(), return 0 on success */
+int nettool_converge(struct nettool_ctx *ctx);
+
+int nettool_clean(struct nettool_ctx *ctx);
+
+/* restart devices which have options in the request,
+   whole network of the guest if there are none */
+int nettool_restart(struct nettool_ctx *ctx);
+
+/* global lock shared with prl_nettool binary */
+void nettool_lock(void);
+
+void nettool_unlock(void);
+
+#endif // __LIBPRLNETTOOL_H__
@@ -27,9 +27,9 @@
 #include "common.h"
 #include "namelist.h"
 
-int  namelist_add(const char * name, struct namelist **info)
+static struct namelist *namelist_new(const char *name)
 {
-	struct namelist *it, *new_it ;
+	struct namelist *new_it;
 
 	new_it =(struct namelist *) malloc ( sizeof(struct namelist) ) ;
 	if (new_it == NULL)
@@ -37,11 +37,24 @@ int  namelist_add(const char * name, struct namelist **info)
 	(new_it)->name = strdup (  name ) ;
 	if ((new_it)->name == NULL) {
 		free(new_it);
-		new_it = NULL;
 		goto no_memory;
 	}
 	(new_it)->next = NULL ;
 
+	return new_it;
+no_memory:
+	error(errno, "Can't allocate memory");
+	return NULL;
+}
+
+int  namelist_add(const char * name, struct namelist **info)
+{
+	struct namelist *it, *new_it ;
+
+	new_it = namelist_new(name);
+	if (new_it == NULL)
+		return -1;
+
 	//add to list
 	if ((*info) == NULL)
 		*info = new_it;
@@ -54,9 +67,23 @@ int  namelist_add(const char * name, struct namelist **info)
 		it->next = new_it;
 	}
 	return 0;
-no_memory:
-	error(errno, "Can't allocate memory");
-	return -1;
+}
+
+int namelist_append(const char *name, struct namelist ***tail)
+{
+	struct namelist *new_it;
+
+	while (**tail != NULL)
+		*tail = &(**tail)->next;
+
+	new_it = namelist_new(name);
+	if (new_it == NULL)
+		return -1;
+
+	**tail = new_it;
+	*tail = &new_it->next;
+
+	return 0;
 }
 
 /*search string in info with same name*/
@@ -159,37 +186,126 @@ void print_namelist_to_str_delim(struct namelist **info, char *str, size_t size,
 
 int namelist_compare(struct namelist **info, const char *str, const char *delim)
 {
-	struct namelist *it = NULL;
-	char * tmp, *s;
+	struct namelist *values = NULL, *it;
+	struct nameset have, want;
+	int rc = 0;
 
 	if (info == NULL || str == NULL)
 		return (info == NULL && str == NULL);
 
-	tmp = strdup(str);
-	if (tmp == NULL) {
-		error(0, "ERROR: failed to strdup");
+	namelist_split_delim(&values, str, delim);
+	if (nameset_init(&have, info) != 0)
+		goto clean;
+	if (nameset_init(&want, &values) != 0)
+		goto clean_have;
+
+	for (it = values; it != NULL; it = it->next) {
+		if (strcasestr(it->name, "remove") != NULL)
+			continue;
+		if (nameset_find(&have, it->name) < 0)
+			goto out;
+	}
+
+	for (it = *info; it != NULL; it = it->next) {
+		if (it->name && nameset_find(&want, it->name) < 0)
+			goto out;
+	}
+
+	rc = 1;
+out:
+	nameset_clean(&want);
+clean_have:
+	nameset_clean(&have);
+clean:
+	namelist_clean(&values);
+
+	return rc;
+}
+
+static int compare_names(const void *a, const void *b)
+{
+	return strcasecmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+int nameset_init(struct nameset *set, struct namelist **info)
+{
+	struct namelist *it;
+	int n = 0;
+
+	set->count = 0;
+	set->names = NULL;
+
+	for (it = *info; it != NULL; it = it->next)
+		if (it->name != NULL)
+			n++;
+	if (n == 0)
 		return 0;
+
+	set->names = (const char **) malloc(n * sizeof(char *));
+	if (set->names == NULL) {
+		error(errno, "Can't allocate memory");
+		return -1;
 	}
 
-	for (s = strtok(tmp, delim); s != NULL; s = strtok(NULL, delim)) {
-		if (strcasestr(s, "remove") != NULL)
-			continue;
-		if (!namelist_search(s, info)) {
-			free(tmp);
-			return 0;
-		}
+	for (it = *info; it != NULL; it = it->next)
+		if (it->name != NULL)
+			set->names[set->count++] = it->name;
+	qsort(set->names, set->count, sizeof(char *), compare_names);
+
+	return 0;
+}
+
+int nameset_find(const struct nameset *set, const char *name)
+{
+	int lo = 0, hi = set->count;
+
+	//first of equal names
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (strcasecmp(set->names[mid], name) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
 
-	free(tmp);
+	if (lo < set->count && !strcasecmp(set->names[lo], name))
+		return lo;
 
-	it = *info;
-	while (it != NULL) {
-		if (it->name && strcasestr(str, it->name) == NULL)
-			return 0;
-		it = it->next;
+	return -1;
+}
+
+void nameset_clean(struct nameset *set)
+{
+	free(set->names);
+	set->names = NULL;
+	set->count = 0;
+}
+
+char *namelist_join(struct namelist **info, const char *delim)
+{
+	struct namelist *it;
+	size_t len = 1, pos = 0;
+	char *str;
+
+	for (it = *info; it != NULL; it = it->next)
+		if (it->name)
+			len += strlen(it->name) + strlen(delim);
+
+	str = (char *) malloc(len);
+	if (str == NULL) {
+		error(errno, "Can't allocate memory");
+		return NULL;
 	}
 
-	return 1;
+	str[0] = '\0';
+	for (it = *info; it != NULL; it = it->next) {
+		if (it->name == NULL)
+			continue;
+		pos += snprintf(str + pos, len - pos, "%s%s", pos ? delim : "", it->name);
+	}
+
+	return str;
 }
 
 void print_namelist_to_str(struct namelist **info, char *str, size_t size)
@@ -199,15 +315,19 @@ void print_namelist_to_str(struct namelist **info, char *str, size_t size)
 
 void print_namelist(struct namelist **info)
 {
-	char str[1024];
-	print_namelist_to_str(info, str, sizeof(str));
-	printf("%s", str);
+	struct namelist *it;
+
+	//no limit of length, devices may have thousands of addresses
+	for (it = *info; it != NULL; it = it->next)
+		if (it->name)
+			printf("%s ", it->name);
 }
 
 void namelist_split_delim(struct namelist **list, const char *str, const char *delim)
 {
 	char * tmp;
 	char * parser;
+	struct namelist **tail = list;
 
 	if (list == NULL)
 		return;
@@ -224,7 +344,7 @@ void namelist_split_delim(struct namelist **list, const char *str, const char *d
 	parser=strtok(tmp, delim);
 
 	while(parser) {
-		namelist_add(parser, list);
+		namelist_append(parser, &tail);
 		parser=strtok(NULL, delim);
 	}
 
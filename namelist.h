@@ -36,6 +36,10 @@ struct namelist
 
 int  namelist_add(const char * name, struct namelist **info) ;
 
+/* add to the end of list without its walk for each value:
+   tail points to list or next field of last added element */
+int namelist_append(const char *name, struct namelist ***tail);
+
 /*search string in info with same name*/
 /* return 1 - found */
 int  namelist_search(const char *name, struct namelist **info);
@@ -58,4 +62,23 @@ void namelist_split(struct namelist **list, const char *str);
 
 int namelist_compare(struct namelist **info, const char *str, const char *delim);
 
+/* values joined with delim, to be freed by caller */
+char *namelist_join(struct namelist **info, const char *delim);
+
+/* sorted names of namelist for search of many values,
+   names are not copied, the list should live longer than the set */
+struct nameset
+{
+	const char **names;
+	int count;
+};
+
+int nameset_init(struct nameset *set, struct namelist **info);
+
+/* return index of the first name equal to name ignoring case, -1 if none,
+   equal names follow it */
+int nameset_find(const struct nameset *set, const char *name);
+
+void nameset_clean(struct nameset *set);
+
 #endif
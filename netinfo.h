@@ -43,13 +43,18 @@ struct netinfo
 	char mac[MAC_LENGTH+1];
 	char name[NAME_LENGTH];
 	int idx; // windows adapter idx to be used with netsh
+	int ifindex; // linux interface index
 	struct namelist *ip, *search, *dns;
 	struct namelist *ip_link; //link-local, site-local
 	struct namelist *gateway;
+	struct namelist *route; //static routes except default, same format as --route
+	int route_scanned; // 1 - route list is valid
+	char hostname[NAME_LENGTH]; // empty if not scanned
 	int configured_with_dhcp; // 1 - true. 0 - false
 	int configured_with_dhcpv6;
 	int disabled;
-	int changed;
+	unsigned int changed; // NET_OPT_* of fields which differ from options
+	unsigned int live; // NET_OPT_* already set in kernel, only configuration is written
 	int dhcp4_changed;
 	int dhcp6_changed;
 	struct netinfo *next;
@@ -57,6 +62,12 @@ struct netinfo
 };
 
 int get_device_list(struct netinfo **netinfo);
+#ifdef _LIN_
+struct nettool_mac;
+/* devices of stopped guest with names given by value of ifnames,
+   only their configuration is read */
+int get_offline_device_list(struct netinfo **netinfo_head, struct nettool_mac *ifnames);
+#endif
 struct netinfo *netinfo_search_mac(struct netinfo **netinfo_head, const char *mac);
 
 void  netinfo_add(struct netinfo *if_info, struct netinfo **netinfo_head);
@@ -69,6 +80,12 @@ struct netinfo *netinfo_search_idx(struct netinfo **netinfo_head, int idx);
 void netinfo_clean(struct netinfo **netinfo_head);
 const char *mac_to_str(unsigned char *addr, size_t alen, char *buf, size_t blen);
 int split_ip_mask(const char *ip_mask, char* ip, char *mask);
+/* convert dotted IPv4 mask to prefix length, -1 if it is not a mask */
+int mask_to_prefix(const char *mask);
+int route_match(const char *route, const char *scanned);
+int route_diff(struct namelist **scanned, const char *value,
+		struct namelist **add, struct namelist **del);
+int hostname_match(const char *hostname, const char *value);
 void wait_for_start(const struct namelist *adapters);
 
 #ifdef _WIN_
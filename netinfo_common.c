@@ -27,6 +27,7 @@
 #include "common.h"
 #include "netinfo.h"
 #include "namelist.h"
+#include "options.h"
 
 #include <unistd.h>
 
@@ -114,6 +115,7 @@ void netinfo_free(struct netinfo *it)
 	namelist_clean(&it->dns);
 	namelist_clean(&it->ip_link);
 	namelist_clean(&it->gateway);
+	namelist_clean(&it->route);
 	free(it);
 }
 
@@ -200,6 +202,193 @@ void clear_route(struct route *route)
 }
 
 
+/* convert dotted IPv4 mask to prefix length
+return -1 if it is not a mask */
+int mask_to_prefix(const char *mask)
+{
+	unsigned int b[4], m;
+	int prefix = 0;
+
+	if (sscanf(mask, "%u.%u.%u.%u", &b[0], &b[1], &b[2], &b[3]) != 4)
+		return -1;
+
+	m = (b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+	while (m & 0x80000000) {
+		prefix++;
+		m <<= 1;
+	}
+
+	return m ? -1 : prefix;
+}
+
+#define ROUTE_KEY_LEN	256
+
+/* destination of route in <IP>/<prefix> form */
+static void route_dst(const char *ip, char *buf, size_t size)
+{
+	const char *mask = strchr(ip, '/');
+	int prefix;
+
+	if (mask == NULL)
+		snprintf(buf, size, "%s/%d", ip, is_ipv6(ip) ? 128 : 32);
+	else if (strchr(mask + 1, '.') != NULL && (prefix = mask_to_prefix(mask + 1)) >= 0)
+		snprintf(buf, size, "%.*s/%d", (int)(mask - ip), ip, prefix);
+	else
+		snprintf(buf, size, "%s", ip);
+}
+
+/* keys of route for comparison: key is destination in <IP>/<prefix> form
+   with gateway, key_metric is key with metric, 0 if it is not given
+return 1 - metric is given
+       0 - no metric
+      -1 - route can't be parsed */
+static int route_key(const char *route, char *key, char *key_metric, size_t size)
+{
+	struct route r = {NULL, NULL, NULL};
+	char dst[128];
+	char *s;
+	int rc = -1;
+
+	s = strdup(route);
+	if (s == NULL) {
+		error(0, "ERROR: failed to strdup");
+		return -1;
+	}
+
+	parse_route(s, &r);
+	if (r.ip == NULL)
+		goto out;
+
+	route_dst(r.ip, dst, sizeof(dst));
+	snprintf(key, size, "%s=%s", dst, r.gw ? r.gw : "");
+	rc = (r.metric != NULL && *r.metric != '\0');
+	snprintf(key_metric, size, "%s m%d", key, rc ? atoi(r.metric) : 0);
+out:
+	clear_route(&r);
+	free(s);
+	return rc;
+}
+
+/* compare route of --route option with scanned one
+   metric is compared only if it is specified in option
+return 1 - same route
+       0 - different */
+int route_match(const char *route, const char *scanned)
+{
+	char key1[ROUTE_KEY_LEN], key1_metric[ROUTE_KEY_LEN];
+	char key2[ROUTE_KEY_LEN], key2_metric[ROUTE_KEY_LEN];
+	int metric;
+
+	metric = route_key(route, key1, key1_metric, ROUTE_KEY_LEN);
+	if (metric < 0 || route_key(scanned, key2, key2_metric, ROUTE_KEY_LEN) < 0)
+		return 0;
+
+	return metric ? !strcasecmp(key1_metric, key2_metric) : !strcasecmp(key1, key2);
+}
+
+/* routes of value absent in scanned go to add, scanned routes absent
+   in value go to del, add and del can be NULL,
+   each route is parsed once to keys searched in sorted sets
+return 1 - same routes
+       0 - different */
+int route_diff(struct namelist **scanned, const char *value,
+		struct namelist **add, struct namelist **del)
+{
+	struct namelist *want = NULL, *it;
+	//keys of scanned routes, keys of wanted routes without and with metric
+	struct namelist *have = NULL, *have_metric = NULL, *any = NULL, *exact = NULL;
+	struct namelist **have_tail = &have, **have_metric_tail = &have_metric;
+	struct namelist **any_tail = &any, **exact_tail = &exact;
+	struct namelist **add_tail = add, **del_tail = del;
+	struct nameset have_set, have_metric_set, any_set, exact_set;
+	char key[ROUTE_KEY_LEN], key_metric[ROUTE_KEY_LEN];
+	int same = 0, found, metric;
+
+	namelist_split(&want, value);
+
+	for (it = *scanned; it != NULL; it = it->next) {
+		if (route_key(it->name, key, key_metric, ROUTE_KEY_LEN) < 0)
+			continue;
+		if (namelist_append(key, &have_tail) ||
+				namelist_append(key_metric, &have_metric_tail))
+			goto clean;
+	}
+	for (it = want; it != NULL; it = it->next) {
+		if (is_remove(it->name))
+			continue;
+		metric = route_key(it->name, key, key_metric, ROUTE_KEY_LEN);
+		if (metric < 0)
+			continue;
+		if (metric ? namelist_append(key_metric, &exact_tail) :
+				namelist_append(key, &any_tail))
+			goto clean;
+	}
+
+	if (nameset_init(&have_set, &have) != 0)
+		goto clean;
+	if (nameset_init(&have_metric_set, &have_metric) != 0)
+		goto clean_have;
+	if (nameset_init(&any_set, &any) != 0)
+		goto clean_have_metric;
+	if (nameset_init(&exact_set, &exact) != 0)
+		goto clean_any;
+
+	same = 1;
+	for (it = want; it != NULL; it = it->next) {
+		if (is_remove(it->name))
+			continue;
+		metric = route_key(it->name, key, key_metric, ROUTE_KEY_LEN);
+		if (metric > 0)
+			found = nameset_find(&have_metric_set, key_metric) >= 0;
+		else
+			found = metric == 0 && nameset_find(&have_set, key) >= 0;
+		if (found)
+			continue;
+		same = 0;
+		if (add != NULL)
+			namelist_append(it->name, &add_tail);
+	}
+
+	for (it = *scanned; it != NULL; it = it->next) {
+		found = route_key(it->name, key, key_metric, ROUTE_KEY_LEN) >= 0 &&
+			(nameset_find(&any_set, key) >= 0 ||
+			 nameset_find(&exact_set, key_metric) >= 0);
+		if (found)
+			continue;
+		same = 0;
+		if (del != NULL)
+			namelist_append(it->name, &del_tail);
+	}
+
+	nameset_clean(&exact_set);
+clean_any:
+	nameset_clean(&any_set);
+clean_have_metric:
+	nameset_clean(&have_metric_set);
+clean_have:
+	nameset_clean(&have_set);
+clean:
+	namelist_clean(&exact);
+	namelist_clean(&any);
+	namelist_clean(&have_metric);
+	namelist_clean(&have);
+	namelist_clean(&want);
+
+	return same;
+}
+
+/* compare scanned hostname with --hostname value, trailing dots are ignored
+return 1 - same hostname */
+int hostname_match(const char *hostname, const char *value)
+{
+	size_t len = strlen(value);
+
+	while (len > 0 && value[len-1] == '.')
+		len--;
+
+	return (strlen(hostname) == len && strncasecmp(hostname, value, len) == 0);
+}
+
 int split_ip_mask(const char *ip_mask, char* ip, char *mask)
 {
 	char tmp[100];
@@ -48,14 +48,14 @@
 #include "netinfo.h"
 #include "setnet.h"
 #include "namelist.h"
+#include "libprlnettool.h"
 
 /* 2 mins to wait for PnP and SCM start completed */
 #define SCM_TIMEOUT (120*1000)
 
 extern struct nettool_options net_opts;
-extern char * os_script_prefix;
 
-int print_parameters()
+int print_parameters(struct nettool_ctx *ctx)
 {
 	unsigned int all_flags[] = {NET_OPT_GATEWAY, NET_OPT_DNS,  NET_OPT_IP,
 					NET_OPT_DHCP, NET_OPT_SEARCH, 0};
@@ -67,10 +67,8 @@ int print_parameters()
 		&& count_opt_mac(NET_OPT_GETBYMAC) == 0)
 		return 0;//nothing to do
 
-	netinfo_head = NULL;
-
 	//get ALL information in system
-	get_device_list(&netinfo_head);
+	netinfo_head = nettool_query(ctx, NULL);
 
 	for (i = 0; all_flags[i]; i++)
 	{
@@ -146,521 +144,47 @@ int print_parameters()
 	return 0;
 }
 
-int is_equal_dhcp(struct netinfo *if_it, struct nettool_mac *mac_it)
-{
-	int dhcpv4 = (strchr(mac_it->value, '4') != NULL);
-	int dhcpv6 = (strchr(mac_it->value, '6') != NULL);
-
-#ifdef DEBUG_OPT_COMPARE
-	debug("DHCP;%s;%s\n", if_it->mac, mac_it->value);
-	debug("configured_with_dhcp=%d configured_with_dhcpv6=%d\n",
-	      if_it->configured_with_dhcp, if_it->configured_with_dhcpv6);
-#endif
-
-	if (!net_opts.compare)
-	{
-		if_it->dhcp4_changed = 1;
-		if_it->dhcp6_changed = 1;
-		return 0;
-	}
-
-	if_it->dhcp4_changed = dhcpv4 != if_it->configured_with_dhcp;
-	if_it->dhcp6_changed = dhcpv6 != if_it->configured_with_dhcpv6;
-
-	debug("DHCP;dhcp4_changed = %d; dhcp6_changed = %d" ,
-	       if_it->dhcp4_changed, if_it->dhcp6_changed);
-
-	return !if_it->dhcp4_changed && !if_it->dhcp6_changed;
-}
-
-static int is_equal_ip_skip_local(struct netinfo *if_it, const char *str, const char *delim)
-{
-	struct namelist *it = NULL;
-	char * tmp, *s;
-
-	if (if_it->ip == NULL || str == NULL)
-		return (if_it->ip == NULL && str == NULL);
-
-	tmp = strdup(str);
-	if (tmp == NULL) {
-		error(0, "ERROR: failed to strdup");
-		return 0;
-	}
-
-	for (s = strtok(tmp, delim); s != NULL; s = strtok(NULL, delim)) {
-		if (strcasestr(s, "remove") != NULL)
-			continue;
-		if (!namelist_search(s, &if_it->ip)) {
-			free(tmp);
-			return 0;
-		}
-	}
-
-	free(tmp);
-
-	for (it = if_it->ip; it != NULL; it = it->next) {
-		if (!it->name)
-			continue;
-		if (namelist_search(it->name, &if_it->ip_link))
-			//skip link-local and site-local
-			continue;
-		if (strcasestr(str, it->name) == NULL)
-			return 0;
-	}
-
-	return 1;
-}
-
-int is_equal_ip(struct netinfo *if_it, struct nettool_mac *mac_it)
-{
-#ifdef DEBUG_OPT_COMPARE
-	char str[1024];
-	debug("IP_OPT;%s;%s\n", if_it->mac, mac_it->value);
-	print_namelist_to_str(&if_it->ip, str, sizeof(str));
-	debug("IP;%s", str);
-	print_namelist_to_str(&if_it->ip_link, str, sizeof(str));
-	debug("IP_LINK;%s", str);
-#endif
-
-	if (!net_opts.compare)
-		return 0;
-
-	return is_equal_ip_skip_local(if_it, mac_it->value, " ");
-}
-
-int is_equal_dns(struct netinfo *if_it, struct nettool_mac *mac_it)
-{
-#ifdef DEBUG_OPT_COMPARE
-	char str[1024];
-	debug("DNS_OPT;%s;%s\n", if_it->mac, mac_it->value);
-	print_namelist_to_str(&if_it->dns, str, sizeof(str));
-	debug("DNS;%s", str);
-#endif
-	if (!net_opts.compare)
-		return 0;
-
-	return namelist_compare(&if_it->dns, mac_it->value, " ");
-}
-
-int is_equal_gateway(struct netinfo *if_it, struct nettool_mac *mac_it)
-{
-#ifdef DEBUG_OPT_COMPARE
-	char str[1024];
-	debug("GW_OPT;%s;%s\n", if_it->mac, mac_it->value);
-	print_namelist_to_str(&if_it->gateway, str, sizeof(str));
-	debug("GW;%s", str);
-#endif
-	if (!net_opts.compare)
-		return 0;
-
-	return namelist_compare(&if_it->gateway, mac_it->value, " ");
-}
-
-#if defined(_WIN_)
-static void do_disable_adapter(struct netinfo* adapter_)
-{
-	if (adapter_->disabled)
-		return;
-
-	enable_adapter(adapter_, 0);
-	adapter_->disabled = 1;
-}
-
-static void disable_adapter_if_needed(struct netinfo *if_it)
-{
-#if (NTDDI_VERSION < NTDDI_LONGHORN)
-	//windows 2k3 don't like if we set IP/mask/gateway
-	//from differend ranges
-	//workaround: disable adapter, update setting, enable adapter
-	if (get_opt_mac(if_it->mac, NET_OPT_GATEWAY) == NULL &&
-	    get_opt_mac(if_it->mac, NET_OPT_ROUTE) == NULL)
-		return;
-
-	//disable
-	do_disable_adapter(if_it);
-#endif // NTDDI_VERSION < NTDDI_LONGHORN
-}
-
-void enable_adapter_if_needed(struct netinfo *if_it)
-{
-	if (!if_it->disabled)
-		return;
 
-	// enable
-	enable_adapter(if_it, 1);
-	if_it->disabled = 0;
-}
-#endif // _WIN_
+/* some command was killed on timeout */
+static int timed_out;
 
-struct nettool_mac *get_opt_val_substr(struct nettool_mac *mac_it, unsigned int opts, const char *value)
+static int run_action(struct nettool_ctx *ctx, enum ACTION action, int plan)
 {
-	while(mac_it != NULL)
-	{
-		if ((mac_it->type & opts) && mac_it->value != NULL && strstr(value, mac_it->value) != NULL)
-			return mac_it;
-
-		mac_it = mac_it->next;
-	}
-	return NULL;
-}
-
-struct nettool_mac *get_opt_val_no_substr(struct nettool_mac *mac_it, unsigned int opts, const char *value)
-{
-	while(mac_it != NULL)
-	{
-		if ((mac_it->type & opts) && mac_it->value != NULL && strstr(value, mac_it->value) == NULL)
-			return mac_it;
-
-		mac_it = mac_it->next;
-	}
-	return NULL;
-}
-
-int apply_parameters()
-{
-	unsigned int all_flags[] = { NET_OPT_DHCP, NET_OPT_IP, NET_OPT_GATEWAY, NET_OPT_SEARCH,
-					NET_OPT_DNS, NET_OPT_ROUTE, NET_OPT_HOSTNAME, 0};
-	struct netinfo *netinfo_head;
-	struct nettool_mac *mac_it;
-	int rc = 0, rc2 = 0;
-	int i;
-	int enable_count = 0;
-	struct netinfo *if_it = NULL;
-
-	if (count_opt_mac(NET_OPT_GETBYMAC) == 0 && count_opt_mac(NET_OPT_GETNOTMAC) == 0)
-		return 0;//nothing to do
-
-	netinfo_head = NULL;
-
-	//get ALL information in system
-	get_device_list(&netinfo_head);
-
-
-#if defined(_WIN_) && (NTDDI_VERSION >= NTDDI_LONGHORN)
-	//try to enable #PSBM-9809
-	//on win2k3 we can't detect MAC address of disabled adapter
-	//enable only on w2k8 and above
-	{
-		struct namelist *wait_adapters = NULL;
-
-		mac_it = net_opts.macs;
-		while(mac_it != NULL)
-		{
-			if (mac_it->mac != NULL &&
-				netinfo_search_mac(&netinfo_head, mac_it->mac) == NULL)
-			{
-				error(0, "Info: Enabling '%s' ...", mac_it->mac);
-				if (enable_disabled_adapter(mac_it->mac) > 0)
-					namelist_add(mac_it->mac, &wait_adapters);
-
-			}
-			mac_it = mac_it->next;
-		}
-
-		if (wait_adapters != NULL)
-		{
-			wait_for_start(wait_adapters);
-			namelist_clean(&wait_adapters);
-		}
-	}
-#else
-	VARUNUSED(enable_count);
-#endif
-
-	//check MACs from options
-	mac_it = net_opts.macs;
-	while(mac_it != NULL)
-	{
-		if (mac_it->mac != NULL &&
-			netinfo_search_mac(&netinfo_head, mac_it->mac) == NULL)
-		{
-			error(0, "WARNING: MAC address '%s' was not found in system", mac_it->mac);
-			//exclude from options - just clean option type
-			mac_it->type = 0;
-		}
-		mac_it = mac_it->next;
-	}
-
-#ifdef _MAC_
-	OpenEdit();
-#endif
-
-	for (i = 0; all_flags[i]; i++)
-	{
-		struct netinfo *if_it = NULL;
-		unsigned int opt = all_flags[i];
-
-		if (count_opt_mac(opt) == 0)
-			continue;
-
-		for (if_it = netinfo_head; if_it != NULL; if_it = if_it->next) //over all scanned devices
-		{
-			struct nettool_mac *mac_it = get_opt_mac(if_it->mac, opt);
-			if (mac_it == NULL)
-			{//not found
-				continue;
-			}
-#ifdef DEBUG_OPT_COMPARE
-			if (opt == NET_OPT_DHCP)
-				debug("is_equal_dhcp(if_it, mac_it)=%d\n", is_equal_dhcp(if_it, mac_it));
-			if (opt == NET_OPT_IP)
-				debug("is_equal_ip(if_it, mac_it)=%d\n", is_equal_ip(if_it, mac_it));
-			if (opt == NET_OPT_GATEWAY)
-				debug("is_equal_gw(if_it, mac_it)=%d\n", is_equal_gateway(if_it, mac_it));
-			if (opt == NET_OPT_DNS)
-				debug("is_equal_dns(if_it, mac_it)=%d\n", is_equal_dns(if_it, mac_it));
-#endif
-			if (!net_opts.compare ||
-			    (opt == NET_OPT_DHCP && !is_equal_dhcp(if_it, mac_it)) ||
-			    (opt == NET_OPT_IP && !is_equal_ip(if_it, mac_it)) ||
-			    (opt == NET_OPT_GATEWAY && !is_equal_gateway(if_it, mac_it)) ||
-			    (opt == NET_OPT_DNS && !is_equal_dns(if_it, mac_it)))
-				if_it->changed = 1;
-		}
-	}
-
-	for (i = 0; all_flags[i]; i++)
-	{
-		unsigned int opt = all_flags[i];
-
-		if (count_opt_mac(opt) == 0)
-			continue;
-
-		for (if_it = netinfo_head; if_it != NULL; if_it = if_it->next) //over all scanned devices
-		{
-			struct nettool_mac *mac_it = get_opt_mac(if_it->mac, opt);
-			if (mac_it == NULL)
-			{//not found
-				continue;
-			}
-
-			if (!if_it->changed)
-				continue;
-#if defined(_WIN_)
-			disable_adapter_if_needed(if_it);
-#endif // _WIN_
-			if (opt == NET_OPT_DHCP)
-				rc = set_dhcp(if_it, mac_it);
-			else if (opt == NET_OPT_ROUTE)
-				rc = set_route(if_it, mac_it);
-			else if (opt == NET_OPT_DNS)
-				rc = set_dns(if_it, mac_it);
-			else if (opt == NET_OPT_IP)
-				rc = set_ip(if_it, mac_it);
-
-			if (rc)
-				rc2 = rc;
-
-		} //over network interfaces
-
-		if (opt == NET_OPT_GATEWAY)
-		{
-			struct nettool_mac *mac_it;
-
-			// remove gateway first
-			mac_it = get_opt_val_substr(net_opts.macs, NET_OPT_GATEWAY, "remove");
-			while (mac_it != NULL) {
-				if_it = netinfo_search_mac(&netinfo_head, mac_it->mac);
-				if (if_it) {
-					rc = set_gateway(if_it, mac_it);
-					if (rc)
-						rc2 = rc;
-				}
-				mac_it = get_opt_val_substr(mac_it->next, NET_OPT_GATEWAY, "remove");
-			}
-
-			// then set
-			mac_it = get_opt_val_no_substr(net_opts.macs, NET_OPT_GATEWAY, "remove");
-			while (mac_it != NULL) {
-				if_it = netinfo_search_mac(&netinfo_head, mac_it->mac);
-				if (if_it) {
-					rc = set_gateway(if_it, mac_it);
-					if (rc)
-						rc2 = rc;
-				}
-				mac_it = get_opt_val_no_substr(mac_it->next, NET_OPT_GATEWAY, "remove");
-			}
-		}
-
-		if (opt == NET_OPT_SEARCH)
-		{
-			struct nettool_mac *mac_it = get_opt_mac(NULL, opt);
-			int rc;
-			if (mac_it == NULL)
-				continue;
-			//set search domains
-			rc = set_search_domain(mac_it);
-			if (rc)
-				rc2 = rc;
-		}
-
-		if (opt == NET_OPT_HOSTNAME)
-		{
-			struct nettool_mac *mac_it = get_opt_mac(NULL, opt);
-			int rc;
-			if (mac_it == NULL)
-				continue;
-			rc = set_hostname(mac_it);
-			if (rc)
-				rc2 = rc;
-		}
-	}
-
-#ifdef _MAC_
-	SavePrefs();
-#endif
-
-#if defined(_WIN_)
-	//over all scanned devices
-	for (if_it = netinfo_head; if_it != NULL; if_it = if_it->next)
-	{
-#if (NTDDI_VERSION >= NTDDI_LONGHORN)
-		/*
-		 * the adapter restart is required to apply dhcp
-		 * settings on longhorn windows and newer. see
-		 * #PSBM-18905.
-		 * */
-
-		if ((if_it->dhcp4_changed || if_it->dhcp6_changed) &&
-		    (NULL != get_opt_mac(if_it->mac, NET_OPT_DHCP)))
-				do_disable_adapter(if_it);
-#endif // NTDDI_VERSION >= NTDDI_LONGHORN
-		enable_adapter_if_needed(if_it);
-	}
-#endif // _WIN_
-	return rc2;
-}
-
-int clean_parameters()
-{
-
-	struct netinfo *netinfo_head, *if_it;
-
-	netinfo_head = NULL;
-
-	//get ALL information in system
-	get_device_list(&netinfo_head);
-
-
-#ifdef _MAC_
-	OpenEdit();
-#endif
-
-
-		for (if_it = netinfo_head; if_it != NULL; if_it = if_it->next) //over all scanned devices
-		{
-			int rc = 0;
-
-
-			if (!if_it->configured_with_dhcp)
-				continue;
-
-
-			rc = clean(if_it);
-
-
-			if (rc)
-			{
-				goto exit;
-			}
-
-		} //over network interfaces
-
-
-exit:
-#ifdef _MAC_
-	SavePrefs();
-#endif
-	return 0;
-}
-
-int restart_network()
-{
-#ifdef _LIN_
-	detect_distribution();
-#endif
-
-	return restart_guest_network();
-}
-
+	int rc = 1;
 
-#define MUTEX_TIMEOUT	240
-#ifdef _WIN_
-#define MUTEX_NAME	"Global\\prl_nettool_mutex"
-static HANDLE hMutex;
-#else
-#define MUTEX_NAME "/tmp/prl_nettool.lock"
-static int fdlock = -1;
-#endif
+	if (action == GET)
+		rc = print_parameters(ctx);
+	else if (action == SET)
+		rc = nettool_apply(ctx);
+	else if (action == APPLY && plan)
+		rc = (nettool_plan(ctx, 1) < 0);
+	else if (action == APPLY)
+		rc = nettool_converge(ctx);
+	else if  (action == CLEAN)
+		rc = nettool_clean(ctx);
+	else if  (action == RESTART)
+		rc = nettool_restart(ctx);
+	else
+		error(0, "ERROR: unknown action %d", action);
 
-void single_app_lock(void)
-{
-#ifdef _WIN_
-	hMutex = CreateMutexA(NULL, FALSE, MUTEX_NAME);
-	if (hMutex == NULL && GetLastError() == ERROR_ALREADY_EXISTS) {
-		hMutex = OpenMutexA(SYNCHRONIZE, FALSE, MUTEX_NAME);
-	}
-	if (hMutex == NULL) {
-		fprintf(stderr, "WARNING: OpenMutex(\"%s\") = %u\n", MUTEX_NAME, (int)GetLastError());
-	} else {
-		switch (WaitForSingleObject(hMutex, MUTEX_TIMEOUT*1000))
-		{
-		case WAIT_FAILED:
-		case WAIT_ABANDONED:
-			fprintf(stderr, "ERROR: WaitForSingleObject(\"%s\") = %u\n", MUTEX_NAME, (int)GetLastError());
-			exit(2);
-			break;
-		case WAIT_TIMEOUT:
-			fprintf(stderr, "ERROR: timeout waiting for pending operation to finish\n");
-			exit(2);
-			break;
-		}
-	}
-#else
-	struct flock fl;
-
-	fl.l_type = F_WRLCK;
-	fl.l_whence = SEEK_SET;
-	fl.l_start = 0;
-	fl.l_len = 1;
-
-	if ((fdlock = open(MUTEX_NAME, O_WRONLY|O_CREAT, 0600)) == -1) {
-		fprintf(stderr, "WARNING: open(\"%s\") = %d\n", MUTEX_NAME, errno);
-	} else {
-		int count = MUTEX_TIMEOUT;
-		while (fcntl(fdlock, F_SETLK, &fl) == -1) {
-			if (errno == EAGAIN || errno == EACCES) {
-				if (--count == 0) {
-					fprintf(stderr, "ERROR: timeout waiting for pending operation to finish\n");
-					exit(2);
-				}
-				sleep(1);
-			} else {
-				fprintf(stderr, "WARNING: fcntl(\"%s\", F_SETLK) = %d\n", MUTEX_NAME, errno);
-				break;
-			}
-		}
-	}
-#endif
-}
+	if (nettool_timed_out(ctx))
+		timed_out = 1;
 
-void single_app_unlock(void)
-{
-#ifdef _WIN_
-	if (hMutex)
-		ReleaseMutex(hMutex);
-#endif
+	return rc;
 }
 
 int do_work()
 {
-	int rc = 1;
+	int rc = 1, plan, all_netns;
+	enum ACTION action;
+	struct nettool_ctx *ctx;
+	struct namelist *roots, *root_it, *netns, *ns_it;
 
 	debug("%s enter", __FUNCTION__);
 
-	single_app_lock();
+	nettool_lock();
 
-	debug("%s single_app_lock() done", __FUNCTION__);
+	debug("%s nettool_lock() done", __FUNCTION__);
 
 #ifdef _WIN_
 	HANDLE h = OpenEventW(SYNCHRONIZE, FALSE, L"SC_AutoStartComplete");
@@ -680,6 +204,16 @@ int do_work()
 	restore_adapter_state();
 //#endif
 #endif
+	//stopped guests are configured instead of this one
+	roots = net_opts.roots;
+	net_opts.roots = NULL;
+	//so are devices of other network namespaces
+	netns = net_opts.netns;
+	net_opts.netns = NULL;
+	all_netns = net_opts.all_netns;
+	if (all_netns && nettool_list_netns(&netns))
+		error(0, "ERROR: failed to list network namespaces");
+
 	//#PSBM-9930 and #PSBM-35109
 	//sometimes initial pnp configuration of network adapters takes much time
 	//we need to wait at least for GetAdaptersInfo() to be successfull
@@ -696,31 +230,52 @@ int do_work()
 				namelist_add(mac_it->mac, &wait_adapters);
 			mac_it = mac_it->next;
 		}
-		if (wait_adapters != NULL)
-		{
+		if (wait_adapters != NULL && roots == NULL && netns == NULL && !all_netns)
 			wait_for_start(wait_adapters);
-			namelist_clean(&wait_adapters);
-		}
+		namelist_clean(&wait_adapters);
 	}
 
-	if (net_opts.action == GET)
-		rc = print_parameters();
-	else if (net_opts.action == SET)
-		rc = apply_parameters();
-	else if  (net_opts.action == CLEAN)
-		rc = clean_parameters();
-	else if  (net_opts.action == RESTART)
-		rc = restart_network();
+	action = net_opts.action;
+	plan = net_opts.plan;
+	if (action == GET)
+		ctx = nettool_ctx_new();
 	else
-		error(0, "ERROR: unknown action %d", net_opts.action);
+		ctx = nettool_ctx_from_options();
 
-#ifdef _LIN_
-	if (rc == 0 && net_opts.action == SET &&
-		os_script_prefix != NULL && strcmp("debian", os_script_prefix) == 0)
-		rc = restart_debian_netplan_network();
-#endif
+	if (ctx == NULL)
+		error(0, "ERROR: failed to create context");
+	else if (roots != NULL)
+	{
+		rc = 0;
+		for (root_it = roots; root_it != NULL; root_it = root_it->next)
+		{
+			if (nettool_apply_root(ctx, root_it->name))
+				rc = 1;
+			if (nettool_timed_out(ctx))
+				timed_out = 1;
+		}
+	}
+	else if (netns != NULL || all_netns)
+	{
+		rc = 0;
+		for (ns_it = netns; ns_it != NULL; ns_it = ns_it->next)
+		{
+			//output of each namespace follows its tag
+			if (action == GET || plan)
+				printf("NETNS;%s\n", ns_it->name);
+			if (nettool_set_netns(ctx, ns_it->name) ||
+					run_action(ctx, action, plan))
+				rc = 1;
+		}
+	}
+	else
+		rc = run_action(ctx, action, plan);
+
+	nettool_ctx_free(ctx);
+	namelist_clean(&roots);
+	namelist_clean(&netns);
 
-	single_app_unlock();
+	nettool_unlock();
 
 	debug("%s return %d", __FUNCTION__, rc);
 	return rc;
@@ -802,29 +357,37 @@ int main(int argc, char* argv[])
 
 #ifdef _LIN_
 	//save command to syslog
-	char cmd[PATH_MAX], tmp[PATH_MAX];
-	sprintf(cmd, "%s", "prl_nettool");
-	char **ar = argv;
-	while (*ar != NULL)
 	{
-		strcpy(tmp, cmd);
+		size_t len = sizeof("prl_nettool");
+		char **ar;
+		char *cmd;
 
-		if (strchr(*ar, ' ') != NULL)
-			snprintf(cmd, PATH_MAX, "%s \"%s\"", tmp, *ar);
-		else
-			snprintf(cmd, PATH_MAX, "%s %s", tmp, *ar);
+		for (ar = argv; *ar != NULL; ar++)
+			len += strlen(*ar) + 3;
 
-		ar++;
-	}
+		cmd = malloc(len);
+		if (cmd != NULL) {
+			char *p = cmd;
 
-	openlog("prl_nettool", LOG_PID | LOG_CONS, LOG_USER);
-	syslog(LOG_ERR | LOG_USER, "call: %s", cmd);
-	closelog();
+			p += sprintf(p, "%s", "prl_nettool");
+			for (ar = argv; *ar != NULL; ar++) {
+				if (strchr(*ar, ' ') != NULL)
+					p += sprintf(p, " \"%s\"", *ar);
+				else
+					p += sprintf(p, " %s", *ar);
+			}
+
+			openlog("prl_nettool", LOG_PID | LOG_CONS, LOG_USER);
+			syslog(LOG_ERR | LOG_USER, "call: %s", cmd);
+			closelog();
+			free(cmd);
+		}
+	}
 #endif
 
 	parse_options(argv);
 	do_work();
-	return 0;
+	return timed_out ? NET_EXIT_TIMEOUT : 0;
 }
 
 
@@ -46,12 +46,44 @@ static void usage(int err_code)
 							"                              if dhcp was enabled\n" \
 							"   --search-domain <domains> - set search domain \n" \
 							"   --hostname <hostname>     - set hostname\n" \
-							"   --route <MAC> <IP1>[/MASK][=<IP2>][m<metric>] - set route to <IP1> via <IP2> dev <MAC> metric <metric>\n" );
+							"   --route <MAC> <IP1>[/MASK][=<IP2>][m<metric>] - set route to <IP1> via <IP2> dev <MAC> metric <metric>\n" \
+							"   --from-file <path|->      - read commands from file or stdin,\n" \
+							"                              one or more commands per line\n" );
+	fprintf(stderr, "prl_nettool apply --state <path|-> [--plan]\n" \
+							"   state holds set commands for desired configuration,\n" \
+							"   only settings which differ are changed,\n" \
+							"   --plan prints the changes without applying them\n");
 #ifdef _MAC_
 	fprintf(stderr, "prl_nettool clean \n");
 #endif
 #ifdef _LIN_
-	fprintf(stderr, "prl_nettool restart \n");
+	fprintf(stderr, "prl_nettool restart [<MAC> ...]\n" \
+							"   restart only devices with given MACs or whole network\n");
+	fprintf(stderr, "common options:\n" \
+							"   --timeout <sec>           - kill network command running longer,\n" \
+							"                              default %d, 0 - no limit\n" \
+							"   --budget <sec>            - limit time of whole request,\n" \
+							"                              default 0 - no limit\n" \
+							"   --jobs <n>                - configure up to n devices at once,\n" \
+							"                              default %d\n" \
+							"   --transaction             - write configuration first, then\n" \
+							"                              restart each changed device once\n" \
+							"   --delta                   - add and remove only changed addresses\n" \
+							"                              of static device without its restart\n" \
+							"   --fast                    - set addresses, gateways and routes\n" \
+							"                              live and return, write configuration\n" \
+							"                              in background\n" \
+							"   --root <dir>              - write configuration of stopped\n" \
+							"                              guest mounted at dir, may be repeated\n" \
+							"                              to configure many guests at once\n" \
+							"   --ifname <MAC> <name>     - name of device with MAC for --root\n" \
+							"   --netns <name|path>       - get, set or apply addresses, gateways\n" \
+							"                              and routes in network namespace,\n" \
+							"                              may be repeated, output of each one\n" \
+							"                              starts with NETNS;<name|path>\n" \
+							"   --all-netns               - same for all namespaces of ip netns\n" \
+							"   exit code is %d if some command was killed on timeout\n",
+							NET_DEFAULT_TIMEOUT, NET_DEFAULT_JOBS, NET_EXIT_TIMEOUT);
 #endif
 
 
@@ -74,6 +106,17 @@ void set_empty_options()
 	net_opts.debug = 0;
 	net_opts.action = 0;
 	net_opts.compare = 0;
+	net_opts.plan = 0;
+	net_opts.timeout = NET_DEFAULT_TIMEOUT;
+	net_opts.budget = 0;
+	net_opts.jobs = NET_DEFAULT_JOBS;
+	net_opts.transaction = 0;
+	net_opts.delta = 0;
+	net_opts.fast = 0;
+	net_opts.roots = NULL;
+	net_opts.ifnames = NULL;
+	net_opts.netns = NULL;
+	net_opts.all_netns = 0;
 }
 
 void set_option(unsigned int opt)
@@ -105,6 +148,7 @@ void add_opt_mac(unsigned int opt, const char *mac)
 	}
 	mac_it->next = net_opts.macs;
 	mac_it->type = opt;
+	mac_it->value = NULL;
 	mac_it->mac = strdup(mac);
 	if (mac_it->mac == NULL) { //error
 		free((void *)mac_it);
@@ -151,11 +195,115 @@ void add_set_opt(unsigned int opt, const char *mac, const char *value)
 	net_opts.macs = mac_it;
 }
 
+/* add option to set, --dhcp and --dhcpv6 for same MAC are merged
+return 0 - success
+      -1 - error */
+int add_request_opt(unsigned int opt, const char *mac, const char *value)
+{
+	if (opt == NET_OPT_DHCP || opt == NET_OPT_DHCPV6)
+	{
+		struct nettool_mac *opt_mac = get_opt_mac(mac, NET_OPT_DHCP);
+		if (opt_mac && opt_mac->value &&
+			(!strcmp(opt_mac->value, "4") || !strcmp(opt_mac->value, "6")))
+		{
+			free(opt_mac->value);
+			opt_mac->value = strdup("4 6");
+		}
+		else if (opt_mac)
+		{
+			error(0, "Internal error. Wrong --dhcp or --dhcpv6 option");
+			return -1;
+		}
+		else if (opt == NET_OPT_DHCP)
+		{
+			add_set_opt(opt, mac, "4");
+		}
+		else
+		{
+			add_set_opt(NET_OPT_DHCP, mac, "6");
+		}
+		return 0;
+	}
+
+	if ((opt & NET_OPT_GETBYMAC) && mac == NULL)
+		return -1;
+
+	if (value == NULL)
+		return -1;
+
+	add_set_opt(opt, mac, value);
+	return 0;
+}
+
+int add_ifname(const char *mac, const char *name)
+{
+	struct nettool_mac *mac_it;
+
+	for (mac_it = net_opts.ifnames; mac_it != NULL; mac_it = mac_it->next)
+	{
+		if (!strcmp(mac_it->mac, mac))
+		{
+			error(0, "Name of device %s is set twice", mac);
+			return -1;
+		}
+	}
+
+	mac_it = (struct nettool_mac *) malloc(sizeof(struct nettool_mac));
+	if (mac_it == NULL) {
+		error(errno, "Can't allocate memory for nettool_mac_t");
+		return -1;
+	}
+	mac_it->type = 0;
+	mac_it->mac = strdup(mac);
+	mac_it->value = strdup(name);
+	if (mac_it->mac == NULL || mac_it->value == NULL) {
+		error(errno, "Can't allocate memory for device name");
+		free(mac_it->mac);
+		free(mac_it->value);
+		free(mac_it);
+		return -1;
+	}
+	mac_it->next = net_opts.ifnames;
+	net_opts.ifnames = mac_it;
+
+	return 0;
+}
+
+static void free_mac_list(struct nettool_mac *mac_it)
+{
+	struct nettool_mac *next;
+
+	while (mac_it != NULL)
+	{
+		next = mac_it->next;
+		free(mac_it->mac);
+		free(mac_it->value);
+		free(mac_it);
+		mac_it = next;
+	}
+}
+
+void free_options()
+{
+	free_mac_list(net_opts.macs);
+	free_mac_list(net_opts.ifnames);
+	namelist_clean(&net_opts.roots);
+	namelist_clean(&net_opts.netns);
+	set_empty_options();
+}
+
 int is_opt_set(unsigned int opt)
 {
 	return (net_opts.command_flags & opt);
 }
 
+int is_dhcp_opt_set(const char *mac, char family)
+{
+	struct nettool_mac *mac_it = get_opt_mac(mac, NET_OPT_DHCP);
+
+	return (mac_it != NULL && mac_it->value != NULL && strchr(mac_it->value, family) != NULL);
+}
+
 void clean_opt_mac(unsigned int opts)
 {
 	struct nettool_mac *mac_it = net_opts.macs;
@@ -254,8 +402,8 @@ char *clean_ipv6_value(char *str)
 {
 	struct namelist *values = NULL;
 	struct namelist *value;
-	struct namelist *clean_values = NULL;
-	char clean_str[2048];
+	struct namelist *clean_values = NULL, **tail = &clean_values;
+	char *clean_str;
 
 	if (str == NULL || strlen(str) == 0)
 		return 0;
@@ -266,47 +414,55 @@ char *clean_ipv6_value(char *str)
 	{
 		if ((!is_ipv6(value->name)) && (!is_removev6(value->name)))
 		{
-			namelist_add(value->name, &clean_values);
+			namelist_append(value->name, &tail);
 		}
 
 		value = value->next;
 	}
 	namelist_clean(&values);
 
-	print_namelist_to_str(&clean_values, clean_str, sizeof(clean_str));
+	clean_str = namelist_join(&clean_values, " ");
 	namelist_clean(&clean_values);
 
-	return strdup(clean_str);
+	return clean_str;
 }
 
 
-void parse_options(char *argv[])
+static int parse_file(const char *path, int is_support_ipv6);
+
+/* name and line of --from-file record being parsed */
+static const char *record_file;
+static unsigned int record_line;
+
+/* parse arguments starting from argn position
+return 0 - continue
+       1 - stop parsing */
+static int parse_args(char *argv[], unsigned int argn, int is_support_ipv6)
 {
 	unsigned int opt = 0;
-	unsigned int argn = 0;
 	char *value;
-	int is_support_ipv6 = is_ipv6_supported();
-	set_empty_options();
 
-	argv++;
-	argn = 1;
 	while (*argv != NULL) {
 		char *command;
+		int from_file = 0; //action accepting the file
+		unsigned int *limit = NULL;
+		int root = 0, ifname = 0; //options of stopped guests
+		int netns = 0;
 
 		if (!strcmp(*argv, "--all")) {
 			set_option( NET_OPT_ALL );
 			clean_opt_mac( NET_OPT_ALL );
-			return;
+			return 1;
 		}
 		if (!strcmp(*argv, "-V") || !strcmp(*argv, "--version"))
 		{
 			version();
-			return;
+			return 1;
 		}
 		if (!strcmp(*argv, "-h") || !strcmp(*argv, "--help"))
 		{
 			usage(0);
-			return;
+			return 1;
 		}
 
 		opt = 0;
@@ -325,6 +481,9 @@ void parse_options(char *argv[])
 		}else if (argn == 1 && !strcmp(command, "restart"))
 		{
 			net_opts.action = RESTART;
+		}else if (argn == 1 && !strcmp(command, "apply"))
+		{
+			net_opts.action = APPLY;
 		}else if (!strcmp(command, "-v") || !strcmp(command, "--verbose"))
 		{
 			net_opts.verbose = 1;
@@ -371,14 +530,131 @@ void parse_options(char *argv[])
 		{
 			net_opts.compare = 1;
 		}
+		else if (!strcmp(command, "--from-file"))
+		{
+			from_file = SET;
+		}
+		else if (!strcmp(command, "--state"))
+		{
+			from_file = APPLY;
+		}
+		else if (net_opts.action == RESTART && command[0] != '-')
+		{
+			add_opt_mac(NET_OPT_GETBYMAC, command);
+		}
+		else if (net_opts.action == APPLY && !strcmp(command, "--plan"))
+		{
+			net_opts.plan = 1;
+		}
+		else if (!strcmp(command, "--timeout"))
+		{
+			limit = &net_opts.timeout;
+		}
+		else if (!strcmp(command, "--budget"))
+		{
+			limit = &net_opts.budget;
+		}
+		else if (!strcmp(command, "--jobs"))
+		{
+			limit = &net_opts.jobs;
+		}
+		else if (!strcmp(command, "--transaction"))
+		{
+			net_opts.transaction = 1;
+		}
+		else if (!strcmp(command, "--delta"))
+		{
+			net_opts.delta = 1;
+		}
+		else if (!strcmp(command, "--fast"))
+		{
+			net_opts.fast = 1;
+		}
+		else if (!strcmp(command, "--root"))
+		{
+			root = 1;
+		}
+		else if (!strcmp(command, "--ifname"))
+		{
+			ifname = 1;
+		}
+		else if (!strcmp(command, "--netns"))
+		{
+			netns = 1;
+		}
+		else if (!strcmp(command, "--all-netns"))
+		{
+			net_opts.all_netns = 1;
+		}
 		else{
-			error(0, "Unknown argument '%s'", command);
+			if (record_file != NULL)
+				error(0, "Unknown argument '%s' at %s:%u", command,
+					record_file, record_line);
+			else
+				error(0, "Unknown argument '%s'", command);
 			usage(1);
-			return;
+			return 1;
 		}
 
 		argv ++;
 		argn ++;
+		if (limit) {
+			char *end = NULL;
+
+			if (*argv != NULL)
+				*limit = strtoul(*argv, &end, 10);
+			if (*argv == NULL || **argv < '0' || **argv > '9' || *end != '\0') {
+				error(0, "Number should be specified for '%s'", command);
+				usage(1);
+				return 1;
+			}
+			argv ++;
+			argn ++;
+			continue;
+		}
+		if (root || netns) {
+			if (*argv == NULL) {
+				error(0, "%s should be specified for '%s'",
+					root ? "Directory" : "Namespace", command);
+				usage(1);
+				return 1;
+			}
+			if (namelist_add(*argv, root ? &net_opts.roots : &net_opts.netns))
+				exit(1);
+			argv ++;
+			argn ++;
+			continue;
+		}
+		if (ifname) {
+			if (argv[0] == NULL || argv[1] == NULL) {
+				error(0, "MAC and name should be specified for '%s'", command);
+				usage(1);
+				return 1;
+			}
+			if (add_ifname(argv[0], argv[1]))
+				exit(1);
+			argv += 2;
+			argn += 2;
+			continue;
+		}
+		if (from_file) {
+			if (net_opts.action != from_file || record_file != NULL) {
+				error(0, "'%s' can be used only in command line of %s", command,
+					(from_file == SET) ? "set" : "apply");
+				usage(1);
+				return 1;
+			}
+			if (*argv == NULL) {
+				error(0, "File name should be specified for '%s'", command);
+				usage(1);
+				return 1;
+			}
+			if (parse_file(*argv, is_support_ipv6))
+				exit(1);
+			argv ++;
+			argn ++;
+			continue;
+		}
 		if (opt != 0 && net_opts.action == GET){ //to get parameters
 			if (opt & NET_OPT_GETBYMAC) {
 				if (*argv != NULL && *argv[0] != '-')
@@ -393,11 +669,11 @@ void parse_options(char *argv[])
 			if (opt & NET_OPT_GETNOTMAC) {
 				set_option( opt );
 			}
-		}else if (opt != 0 && net_opts.action == SET) {//to set parameters
+		}else if (opt != 0 && (net_opts.action == SET || net_opts.action == APPLY)) {//to set parameters
 			if (*argv == NULL || *argv[0] == '-' ) {
 				error(0, "MAC or value should be specified for '%s'", command);
 				usage(1);
-				return;
+				return 1;
 			}
 
 			if (opt & NET_OPT_GETBYMAC) {
@@ -408,32 +684,14 @@ void parse_options(char *argv[])
 				//for dhcp needed MAC address only
 				if (opt == NET_OPT_DHCP || opt == NET_OPT_DHCPV6)
 				{
-					struct nettool_mac *opt_mac = get_opt_mac(mac, NET_OPT_DHCP);
-					if (opt_mac && opt_mac->value &&
-						(!strcmp(opt_mac->value, "4") || !strcmp(opt_mac->value, "6")))
-					{
-						free(opt_mac->value);
-						opt_mac->value = strdup("4 6");
-					}
-					else if (opt_mac)
+					if (opt == NET_OPT_DHCPV6 && !is_support_ipv6)
 					{
-						error(0, "Internal error. Wrong --dhcp or --dhcpv6 option");
-						return;
-					}
-					else if (opt == NET_OPT_DHCP)
-					{
-						add_set_opt(opt, mac, "4");
+						error(0, "IPv6 is not supported on current OS");
+						exit(3);
 					}
-					else if (opt == NET_OPT_DHCPV6)
-					{
-						if (!is_support_ipv6)
-						{
-							error(0, "IPv6 is not supported on current OS");
-							exit(3);
-						}
 
-						add_set_opt(NET_OPT_DHCP, mac, "6");
-					}
+					if (add_request_opt(opt, mac, NULL))
+						return 1;
 				}
 				else
 				{
@@ -442,7 +700,7 @@ void parse_options(char *argv[])
 					{
 						error(0, "Value should be specified for '%s'", command);
 						usage(1);
-						return;
+						return 1;
 					}
 
 					value = *argv;
@@ -452,21 +710,163 @@ void parse_options(char *argv[])
 						exit(3);
 					}
 
-					add_set_opt(opt, mac, value);
-					if (value != NULL && value != (*argv))
-						free(value);
+					add_request_opt(opt, mac, value);
 					argv ++;
 					argn ++;
 				}
 			}else if (opt & NET_OPT_GETNOTMAC){
 				//search domain without mac. only value
-				add_set_opt(opt, NULL, *argv);
+				add_request_opt(opt, NULL, *argv);
 				argv ++;
 				argn ++;
 			}
 		}
 	}
 
+	return 0;
+}
+
+/* split record to arguments in place, double and single quotes group
+   words, '#' starts comment
+   return number of arguments or -1 on error */
+static int split_record(char *line, char ***args, size_t *size)
+{
+	size_t count = 0;
+	char *p = line;
+
+	for (;;) {
+		char *arg, *out;
+
+		while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+			p++;
+		if (*p == '\0' || *p == '#')
+			break;
+
+		arg = out = p;
+		while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+			if (*p == '"' || *p == '\'') {
+				char quote = *p++;
+				while (*p != '\0' && *p != quote)
+					*out++ = *p++;
+				if (*p != quote)
+					return -1;
+				p++;
+			} else {
+				*out++ = *p++;
+			}
+		}
+		if (*p != '\0')
+			p++;
+		*out = '\0';
+
+		if (count + 2 > *size) {
+			size_t new_size = *size ? *size * 2 : 8;
+			char **tmp = (char **) realloc(*args, new_size * sizeof(char *));
+			if (tmp == NULL) {
+				error(errno, "Can't allocate memory for arguments");
+				return -1;
+			}
+			*args = tmp;
+			*size = new_size;
+		}
+		(*args)[count++] = arg;
+	}
+
+	if (count != 0)
+		(*args)[count] = NULL;
+
+	return (int)count;
+}
+
+/* read line of any length, getline() is not available on all platforms */
+static int read_line(FILE *fp, char **line, size_t *size)
+{
+	size_t len = 0;
+
+	for (;;) {
+		if (*size - len < 2) {
+			size_t new_size = *size ? *size * 2 : 256;
+			char *tmp = (char *) realloc(*line, new_size);
+			if (tmp == NULL) {
+				error(errno, "Can't allocate memory for record");
+				return -1;
+			}
+			*line = tmp;
+			*size = new_size;
+		}
+
+		if (fgets(*line + len, (int)(*size - len), fp) == NULL)
+			return (len == 0) ? -1 : 0;
+
+		len += strlen(*line + len);
+		if (len > 0 && (*line)[len - 1] == '\n')
+			return 0;
+	}
+}
+
+/* read option records from file, '-' - from stdin
+   each line holds options in command line syntax, e.g.
+   --ip <MAC> "<IP/MASK> <IP/MASK>" */
+static int parse_file(const char *path, int is_support_ipv6)
+{
+	FILE *fp;
+	char *line = NULL, **args = NULL;
+	size_t len = 0, size = 0;
+	unsigned int records = 0;
+	int rc = 0;
+
+	if (!strcmp(path, "-"))
+		fp = stdin;
+	else
+		fp = fopen(path, "r");
+
+	if (fp == NULL) {
+		error(errno, "Can't open '%s'", path);
+		return -1;
+	}
+
+	record_file = path;
+	record_line = 0;
+	while (read_line(fp, &line, &len) == 0) {
+		int count;
+
+		record_line++;
+		count = split_record(line, &args, &size);
+		if (count < 0) {
+			error(0, "Wrong record at %s:%u", path, record_line);
+			rc = -1;
+			break;
+		}
+		if (count == 0)
+			continue;
+
+		if (parse_args(args, 2, is_support_ipv6)) {
+			rc = -1;
+			break;
+		}
+		records++;
+	}
+
+	debug("%u records read from '%s'", records, path);
+	record_file = NULL;
+
+	free(args);
+	free(line);
+	if (fp != stdin)
+		fclose(fp);
+
+	return rc;
+}
+
+void parse_options(char *argv[])
+{
+	char *value;
+
+	set_empty_options();
+
+	if (parse_args(argv + 1, 1, is_ipv6_supported()))
+		return;
+
 	if (net_opts.action == GET)
 	{
 		if (net_opts.command_flags == 0 && count_opt_mac(NET_OPT_GETBYMAC) == 0)
@@ -481,6 +881,38 @@ void parse_options(char *argv[])
 			return;
 		}
 	}
+	else if (net_opts.action == APPLY)
+	{
+		if (count_opt_mac(NET_OPT_GETBYMAC) == 0 && count_opt_mac(NET_OPT_GETNOTMAC) == 0)
+		{
+			error(0, "State is empty");
+			usage(0);
+			return;
+		}
+	}
+
+	if ((net_opts.roots != NULL || net_opts.ifnames != NULL) && net_opts.action != SET)
+	{
+		error(0, "'--root' and '--ifname' can be used only with set");
+		usage(1);
+		return;
+	}
+
+	if (net_opts.netns != NULL || net_opts.all_netns)
+	{
+		if (net_opts.roots != NULL)
+		{
+			error(0, "'--netns' can't be used with '--root'");
+			usage(1);
+			return;
+		}
+		if (net_opts.action != GET && net_opts.action != SET && net_opts.action != APPLY)
+		{
+			error(0, "'--netns' can be used only with get, set and apply");
+			usage(1);
+			return;
+		}
+	}
 
 	value = getenv("PRL_NETTOOLS_OPT");
 	if (value && strcasestr(value, "--compare"))
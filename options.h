@@ -48,13 +48,21 @@
 #define NET_STR_OPT_REMOVE	"remove"
 #define NET_STR_OPT_REMOVEV6	"removev6"
 
+/* deadline of one network command, s */
+#define NET_DEFAULT_TIMEOUT	120
+/* number of devices configured at once */
+#define NET_DEFAULT_JOBS	4
+/* exit code of prl_nettool if some command was killed on timeout */
+#define NET_EXIT_TIMEOUT	4
+
 #define CLEAN_OPT(mode, clean_bit)  ((mode) &= ~(clean_bit))
 
 enum ACTION	{
 	GET = 0,
 	SET = 1,
 	CLEAN = 2, /*used for MAX OS X. clean configuration if is congured to DHCP */
-	RESTART = 3 /*used to restart network inside linux guest*/
+	RESTART = 3, /*used to restart network inside linux guest*/
+	APPLY = 4 /*make configuration match state from file*/
 };
 
 struct nettool_mac
@@ -66,12 +74,24 @@ struct nettool_mac
 	char * value; //IP or else
 };
 
+struct namelist;
+
 struct nettool_options
 {
 	unsigned int command_flags;
 	struct nettool_mac *macs;
-	int verbose, debug, compare;
+	int verbose, debug, compare, plan;
+	//limits for external commands, s, 0 - unlimited
+	unsigned int timeout, budget;
+	unsigned int jobs;
+	int transaction; //restart changed devices once after all changes
+	int delta; //add and delete only differing addresses, without restart
+	int fast; //change kernel state first, write configuration in background
 	enum ACTION action;
+	struct namelist *roots; //filesystems of stopped guests to configure
+	struct nettool_mac *ifnames; //device names of stopped guests, in value
+	struct namelist *netns; //network namespaces to run request in
+	int all_netns; //run request in all namespaces of "ip netns"
 };
 
 
@@ -82,6 +102,17 @@ void set_option(unsigned int opt);
 
 void add_opt_mac(unsigned int opt, const char *mac);
 
+void add_set_opt(unsigned int opt, const char *mac, const char *value);
+
+int add_request_opt(unsigned int opt, const char *mac, const char *value);
+
+/* name device with MAC in stopped guest
+return 0 - success
+      -1 - error */
+int add_ifname(const char *mac, const char *name);
+
+void free_options();
+
 int count_opt_mac(unsigned int opts);
 
 /* search option with same type and mac
@@ -96,6 +127,9 @@ void clean_opt_mac(unsigned int opts);
 
 int is_opt_set(unsigned int opt);
 
+/* check DHCP for family '4' or '6' is requested for mac */
+int is_dhcp_opt_set(const char *mac, char family);
+
 void parse_options(char **argv);
 
 int static inline is_remove(const char *name)
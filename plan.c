@@ -0,0 +1,662 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2020 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ *
+ * Diff of requested state against scanned network configuration
+ */
+
+#include "common.h"
+#include "options.h"
+#include "netinfo.h"
+#include "namelist.h"
+#include "plan.h"
+
+#ifdef _LIN_
+#include <pthread.h>
+#endif
+
+extern struct nettool_options net_opts;
+
+struct plan_op *plan_add(unsigned int type, struct netinfo *if_it,
+		const char *value, struct plan_op **plan)
+{
+	struct plan_op *op, *it;
+
+	op = (struct plan_op *) malloc(sizeof(struct plan_op));
+	if (op == NULL) {
+		error(errno, "Can't allocate memory for plan_op");
+		return NULL;
+	}
+	memset(op, 0, sizeof(struct plan_op));
+
+	op->type = type;
+	op->if_it = if_it;
+	op->value = strdup(value);
+	if (op->value == NULL) {
+		error(errno, "Can't allocate memory for value");
+		free(op);
+		return NULL;
+	}
+
+	//keep order of options
+	if (*plan == NULL) {
+		*plan = op;
+	} else {
+		for (it = *plan; it->next != NULL; it = it->next)
+			;
+		it->next = op;
+	}
+
+	return op;
+}
+
+/* scanned values of the device which are managed by options:
+   link-local addresses and values of family which stays on DHCP are skipped */
+static void get_static_values(struct namelist **list, struct namelist **skip,
+		int skip4, int skip6, struct namelist **values)
+{
+	struct namelist *it, **tail = values;
+
+	for (it = *list; it != NULL; it = it->next) {
+		if (it->name == NULL)
+			continue;
+		if (skip != NULL && namelist_search(it->name, skip))
+			continue;
+		if (is_ipv6(it->name) ? skip6 : skip4)
+			continue;
+		namelist_append(it->name, &tail);
+	}
+}
+
+/* words of value absent in current go to add,
+   current values absent in value go to del */
+static void diff_values(struct namelist **current, const char *value,
+		struct namelist **add, struct namelist **del)
+{
+	struct namelist *want = NULL, *it;
+	struct namelist **add_tail = add, **del_tail = del;
+	struct nameset wset, cset;
+	char *wseen = NULL, *cseen = NULL;
+	int i;
+
+	namelist_split(&want, value);
+	if (nameset_init(&wset, &want) != 0)
+		goto clean;
+	if (nameset_init(&cset, current) != 0)
+		goto clean_want;
+	wseen = (char *) calloc(wset.count + 1, 1);
+	cseen = (char *) calloc(cset.count + 1, 1);
+	if (wseen == NULL || cseen == NULL) {
+		error(errno, "Can't allocate memory");
+		goto out;
+	}
+
+	//values are searched in sorted sets and added once
+	for (it = want; it != NULL; it = it->next) {
+		if (is_remove(it->name))
+			continue;
+		i = nameset_find(&wset, it->name);
+		if (nameset_find(&cset, it->name) < 0 && !wseen[i]) {
+			wseen[i] = 1;
+			namelist_append(it->name, &add_tail);
+		}
+	}
+
+	for (it = *current; it != NULL; it = it->next) {
+		i = nameset_find(&cset, it->name);
+		if (nameset_find(&wset, it->name) < 0 && !cseen[i]) {
+			cseen[i] = 1;
+			namelist_append(it->name, &del_tail);
+		}
+	}
+
+out:
+	free(wseen);
+	free(cseen);
+	nameset_clean(&cset);
+clean_want:
+	nameset_clean(&wset);
+clean:
+	namelist_clean(&want);
+}
+
+static int has_family(struct namelist **list, int ipv6)
+{
+	struct namelist *it;
+
+	for (it = *list; it != NULL; it = it->next)
+		if (!is_remove(it->name) && is_ipv6(it->name) == ipv6)
+			return 1;
+
+	return 0;
+}
+
+/* value of the gateway operation should also drop gateways
+   which are not in the state */
+static char *gateway_value(const char *value, struct namelist **add, struct namelist **del)
+{
+	int remove4 = has_family(del, 0) && !has_family(add, 0) && strstr(value, "remove") == NULL;
+	int remove6 = has_family(del, 1) && !has_family(add, 1) && strstr(value, "removev6") == NULL;
+	size_t len = strlen(value) + sizeof(" remove removev6");
+	char *str;
+
+	str = (char *) malloc(len);
+	if (str == NULL) {
+		error(errno, "Can't allocate memory for value");
+		return NULL;
+	}
+
+	snprintf(str, len, "%s%s%s", value,
+		remove4 ? " " NET_STR_OPT_REMOVE : "",
+		remove6 ? " " NET_STR_OPT_REMOVEV6 : "");
+
+	return str;
+}
+
+/* set_dhcp() rewrites configuration of the device,
+   static settings should be set again if IPv4 stays static */
+static int is_rewritten_by_dhcp(struct netinfo *if_it)
+{
+	int want4 = is_dhcp_opt_set(if_it->mac, '4');
+	int want6 = is_dhcp_opt_set(if_it->mac, '6');
+
+	if (get_opt_mac(if_it->mac, NET_OPT_DHCP) == NULL || want4)
+		return 0;
+
+	return (want4 != if_it->configured_with_dhcp || want6 != if_it->configured_with_dhcpv6);
+}
+
+/* pass is used for gateways only: 0 - removal, 1 - set */
+static int plan_device(struct netinfo *if_it, unsigned int opt, int pass,
+		struct plan_op **plan)
+{
+	struct nettool_mac *mac_it = get_opt_mac(if_it->mac, opt);
+	struct namelist *current = NULL, *add = NULL, *del = NULL;
+	int skip4, skip6, full;
+	char *value;
+	struct plan_op *op;
+
+	if (mac_it == NULL || mac_it->value == NULL)
+		return 0;
+
+	value = mac_it->value;
+	skip4 = if_it->configured_with_dhcp && is_dhcp_opt_set(if_it->mac, '4');
+	skip6 = if_it->configured_with_dhcpv6 && is_dhcp_opt_set(if_it->mac, '6');
+
+	switch (opt) {
+	case NET_OPT_DHCP:
+		if_it->dhcp4_changed = is_dhcp_opt_set(if_it->mac, '4') != if_it->configured_with_dhcp;
+		if_it->dhcp6_changed = is_dhcp_opt_set(if_it->mac, '6') != if_it->configured_with_dhcpv6;
+		if (if_it->dhcp4_changed)
+			namelist_add("dhcp", is_dhcp_opt_set(if_it->mac, '4') ? &add : &del);
+		if (if_it->dhcp6_changed)
+			namelist_add("dhcpv6", is_dhcp_opt_set(if_it->mac, '6') ? &add : &del);
+		break;
+	case NET_OPT_IP:
+		get_static_values(&if_it->ip, &if_it->ip_link, skip4, skip6, &current);
+		diff_values(&current, value, &add, &del);
+		//set_ip() switches IPv4 to static
+		if (if_it->configured_with_dhcp && !is_dhcp_opt_set(if_it->mac, '4'))
+			namelist_add("dhcp", &del);
+		break;
+	case NET_OPT_GATEWAY:
+		get_static_values(&if_it->gateway, NULL, skip4, skip6, &current);
+		diff_values(&current, value, &add, &del);
+		break;
+	case NET_OPT_DNS:
+		diff_values(&if_it->dns, value, &add, &del);
+		break;
+	case NET_OPT_ROUTE:
+		if (if_it->route_scanned)
+			route_diff(&if_it->route, value, &add, &del);
+		break;
+	default:
+		return 0;
+	}
+
+	namelist_clean(&current);
+
+	full = (opt == NET_OPT_ROUTE && !if_it->route_scanned) ||
+		(opt != NET_OPT_DHCP && opt != NET_OPT_DNS && is_rewritten_by_dhcp(if_it));
+	if (add == NULL && del == NULL && !full)
+		return 0;
+
+	if (opt == NET_OPT_GATEWAY) {
+		value = gateway_value(mac_it->value, &add, &del);
+		if (value == NULL)
+			goto err;
+		if ((strstr(value, "remove") != NULL) != (pass == 0)) {
+			free(value);
+			goto skip;
+		}
+		op = plan_add(opt, if_it, value, plan);
+		free(value);
+	} else {
+		op = plan_add(opt, if_it, value, plan);
+	}
+	if (op == NULL)
+		goto err;
+
+	op->add = add;
+	op->del = del;
+	op->full = (add == NULL && del == NULL);
+
+	return 1;
+err:
+	namelist_clean(&add);
+	namelist_clean(&del);
+	return -1;
+skip:
+	namelist_clean(&add);
+	namelist_clean(&del);
+	return 0;
+}
+
+static int plan_global(struct netinfo *netinfo_head, unsigned int opt, struct plan_op **plan)
+{
+	struct nettool_mac *mac_it = get_opt_mac(NULL, opt);
+	struct namelist *add = NULL, *del = NULL, *none = NULL;
+	struct plan_op *op;
+
+	if (mac_it == NULL || mac_it->value == NULL)
+		return 0;
+
+	if (opt == NET_OPT_SEARCH) {
+		//search list is the same for all devices
+		diff_values((netinfo_head != NULL) ? &netinfo_head->search : &none,
+				mac_it->value, &add, &del);
+
+		if (add == NULL && del == NULL)
+			return 0;
+	} else if (opt == NET_OPT_HOSTNAME && netinfo_head != NULL &&
+			netinfo_head->hostname[0] != '\0') {
+		if (hostname_match(netinfo_head->hostname, mac_it->value))
+			return 0;
+
+		namelist_add(mac_it->value, &add);
+		namelist_add(netinfo_head->hostname, &del);
+	}
+
+	op = plan_add(opt, NULL, mac_it->value, plan);
+	if (op == NULL) {
+		namelist_clean(&add);
+		namelist_clean(&del);
+		return -1;
+	}
+
+	op->add = add;
+	op->del = del;
+	//hostname was not scanned, set it as whole
+	op->full = (opt == NET_OPT_HOSTNAME && add == NULL);
+
+	return 1;
+}
+
+int plan_build(struct netinfo *netinfo_head, struct plan_op **plan)
+{
+	unsigned int all_flags[] = { NET_OPT_DHCP, NET_OPT_IP, NET_OPT_GATEWAY, NET_OPT_SEARCH,
+				NET_OPT_DNS, NET_OPT_ROUTE, NET_OPT_HOSTNAME, 0};
+	struct netinfo *if_it;
+	int i, pass, rc, count = 0;
+
+	for (i = 0; all_flags[i]; i++)
+	{
+		unsigned int opt = all_flags[i];
+
+		if (count_opt_mac(opt) == 0)
+			continue;
+
+		if (opt & NET_OPT_GETNOTMAC) {
+			rc = plan_global(netinfo_head, opt, plan);
+			if (rc < 0)
+				goto err;
+			count += rc;
+			continue;
+		}
+
+		// remove gateway first, then set
+		for (pass = 0; pass < ((opt == NET_OPT_GATEWAY) ? 2 : 1); pass++)
+		{
+			for (if_it = netinfo_head; if_it != NULL; if_it = if_it->next)
+			{
+				rc = plan_device(if_it, opt, pass, plan);
+				if (rc < 0)
+					goto err;
+				count += rc;
+			}
+		}
+	}
+
+	return count;
+err:
+	plan_clean(plan);
+	return -1;
+}
+
+/* op should wait for earlier operation prev */
+static int plan_depends(struct plan_op *op, struct plan_op *prev)
+{
+	if (op->if_it == prev->if_it)
+		return 1;
+	//gateways are removed first, then set
+	if (op->type == NET_OPT_GATEWAY && prev->type == NET_OPT_GATEWAY)
+		return 1;
+	//both change files common for all devices
+	return (!op->local && !prev->local);
+}
+
+#ifdef _LIN_
+enum { OP_WAITING = 0, OP_RUNNING, OP_DONE };
+
+struct plan_exec
+{
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int count;
+	struct plan_op **ops;
+	int *state;
+	int *rc;
+	int (*run)(struct plan_op *op);
+};
+
+/* return first waiting operation which does not wait for others,
+   -1 if there is no such one, count if all operations are started */
+static int next_op(struct plan_exec *ex)
+{
+	int i, j, started = 1;
+
+	for (i = 0; i < ex->count; i++)
+	{
+		if (ex->state[i] != OP_WAITING)
+			continue;
+		started = 0;
+
+		for (j = 0; j < i; j++)
+			if (ex->state[j] != OP_DONE && plan_depends(ex->ops[i], ex->ops[j]))
+				break;
+		if (j == i)
+			return i;
+	}
+
+	return started ? ex->count : -1;
+}
+
+static void *plan_worker(void *arg)
+{
+	struct plan_exec *ex = (struct plan_exec *)arg;
+	int i, rc;
+
+	pthread_mutex_lock(&ex->lock);
+	while ((i = next_op(ex)) != ex->count)
+	{
+		if (i < 0) {
+			pthread_cond_wait(&ex->cond, &ex->lock);
+			continue;
+		}
+
+		ex->state[i] = OP_RUNNING;
+		pthread_mutex_unlock(&ex->lock);
+
+		rc = ex->run(ex->ops[i]);
+
+		pthread_mutex_lock(&ex->lock);
+		ex->rc[i] = rc;
+		ex->state[i] = OP_DONE;
+		pthread_cond_broadcast(&ex->cond);
+	}
+	pthread_mutex_unlock(&ex->lock);
+
+	return NULL;
+}
+
+/* return -1 if operations can't be run in parallel */
+static int plan_execute_parallel(struct plan_op *plan, int jobs,
+		int (*run)(struct plan_op *op), int *rc2)
+{
+	struct plan_exec ex;
+	struct plan_op *op;
+	pthread_t *threads;
+	int i, nthreads = 0;
+
+	memset(&ex, 0, sizeof(ex));
+	for (op = plan; op != NULL; op = op->next)
+		ex.count++;
+	if (jobs > ex.count)
+		jobs = ex.count;
+	if (jobs < 2)
+		return -1;
+
+	ex.ops = (struct plan_op **) calloc(ex.count, sizeof(struct plan_op *));
+	ex.state = (int *) calloc(ex.count, sizeof(int));
+	ex.rc = (int *) calloc(ex.count, sizeof(int));
+	threads = (pthread_t *) calloc(jobs, sizeof(pthread_t));
+	if (ex.ops == NULL || ex.state == NULL || ex.rc == NULL || threads == NULL) {
+		free(ex.ops);
+		free(ex.state);
+		free(ex.rc);
+		free(threads);
+		return -1;
+	}
+
+	for (op = plan, i = 0; op != NULL; op = op->next, i++)
+		ex.ops[i] = op;
+	ex.run = run;
+	pthread_mutex_init(&ex.lock, NULL);
+	pthread_cond_init(&ex.cond, NULL);
+
+	debug("run %d operations by %d jobs", ex.count, jobs);
+
+	//current thread is one of jobs
+	for (i = 1; i < jobs; i++)
+	{
+		if (pthread_create(&threads[nthreads], NULL, plan_worker, &ex)) {
+			error(errno, "Failed to create thread");
+			break;
+		}
+		nthreads++;
+	}
+	plan_worker(&ex);
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	for (i = 0; i < ex.count; i++)
+		if (ex.rc[i])
+			*rc2 = ex.rc[i];
+
+	pthread_cond_destroy(&ex.cond);
+	pthread_mutex_destroy(&ex.lock);
+	free(ex.ops);
+	free(ex.state);
+	free(ex.rc);
+	free(threads);
+
+	return 0;
+}
+#endif // _LIN_
+
+int plan_execute(struct plan_op *plan, int jobs, int (*run)(struct plan_op *op))
+{
+	struct plan_op *op;
+	int rc, rc2 = 0;
+
+#ifdef _LIN_
+	if (plan_execute_parallel(plan, jobs, run, &rc2) == 0)
+		return rc2;
+#else
+	VARUNUSED(jobs);
+#endif
+
+	for (op = plan; op != NULL; op = op->next)
+	{
+		rc = run(op);
+		if (rc)
+			rc2 = rc;
+	}
+
+	return rc2;
+}
+
+/* operation should be merged into resolver operation */
+static int is_resolver_op(struct plan_op *op, int global_dns)
+{
+	return op->type == NET_OPT_SEARCH || op->type == NET_OPT_HOSTNAME ||
+		(op->type == NET_OPT_DNS && global_dns);
+}
+
+/* nameservers of all devices are the same, so they are set once */
+static int is_same_dns(struct plan_op *plan)
+{
+	struct plan_op *op, *first = NULL;
+
+	for (op = plan; op != NULL; op = op->next) {
+		if (op->type != NET_OPT_DNS)
+			continue;
+		if (first == NULL)
+			first = op;
+		else if (strcmp(op->value, first->value) != 0)
+			return 0;
+	}
+
+	return 1;
+}
+
+int plan_merge_resolver(struct plan_op **plan, int global_dns)
+{
+	struct plan_op **pp, *op, *resolver = NULL, **tail, *dns = NULL;
+	int count = 0, inserted = 0;
+
+	//differing lists are set one by one, the last one wins
+	if (global_dns && !is_same_dns(*plan))
+		global_dns = 0;
+
+	for (op = *plan; op != NULL; op = op->next)
+		if (is_resolver_op(op, global_dns))
+			count++;
+	//nothing to merge
+	if (count < 2)
+		return 0;
+
+	if (plan_add(PLAN_OP_RESOLVER, NULL, "", &resolver) == NULL)
+		return -1;
+	tail = &resolver->merged;
+
+	for (pp = plan; (op = *pp) != NULL; ) {
+		if (!is_resolver_op(op, global_dns)) {
+			pp = &op->next;
+			continue;
+		}
+
+		*pp = op->next;
+		op->next = NULL;
+		if (!inserted) {
+			resolver->next = *pp;
+			*pp = resolver;
+			pp = &resolver->next;
+			inserted = 1;
+		}
+
+		//the first one sets the same servers of all devices
+		if (op->type == NET_OPT_DNS) {
+			if (dns != NULL) {
+				plan_clean(&op);
+				continue;
+			}
+			dns = op;
+		}
+
+		*tail = op;
+		tail = &op->next;
+	}
+
+	return count;
+}
+
+struct plan_op *plan_merged(struct plan_op *op, unsigned int type)
+{
+	for (op = op->merged; op != NULL; op = op->next)
+		if (op->type == type)
+			return op;
+
+	return NULL;
+}
+
+static const char *op_name(unsigned int type)
+{
+	switch (type) {
+	case NET_OPT_DHCP:
+		return "DHCP";
+	case NET_OPT_IP:
+		return "IP";
+	case NET_OPT_GATEWAY:
+		return "GATEWAY";
+	case NET_OPT_SEARCH:
+		return "SEARCHDOMAIN";
+	case NET_OPT_DNS:
+		return "DNS";
+	case NET_OPT_ROUTE:
+		return "ROUTE";
+	case NET_OPT_HOSTNAME:
+		return "HOSTNAME";
+	}
+	return "UNKNOWN";
+}
+
+/* print plan in format of get command:
+   IP;<MAC>;+<added> -<removed>, '=' marks value set as whole */
+void plan_print(struct plan_op *plan)
+{
+	struct plan_op *op;
+	struct namelist *it;
+
+	for (op = plan; op != NULL; op = op->next)
+	{
+		printf("%s;", op_name(op->type));
+		if (op->if_it != NULL)
+			printf("%s;", op->if_it->mac);
+
+		if (op->full)
+			printf("=%s ", op->value);
+		for (it = op->add; it != NULL; it = it->next)
+			printf("+%s ", it->name);
+		for (it = op->del; it != NULL; it = it->next)
+			printf("-%s ", it->name);
+		printf("\n");
+	}
+}
+
+void plan_clean(struct plan_op **plan)
+{
+	struct plan_op *op, *next;
+
+	for (op = *plan; op != NULL; op = next)
+	{
+		next = op->next;
+		namelist_clean(&op->add);
+		namelist_clean(&op->del);
+		plan_clean(&op->merged);
+		free(op->value);
+		free(op);
+	}
+
+	*plan = NULL;
+}
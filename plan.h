@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2015-2017, Parallels International GmbH
+ * Copyright (c) 2017-2020 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ *
+ * Plan of minimal changes turning scanned configuration into requested state
+ */
+
+#ifndef __PLAN_H__
+#define __PLAN_H__
+
+#include "netinfo.h"
+#include "namelist.h"
+#include "options.h"
+
+struct plan_op
+{
+	unsigned int type;	/* NET_OPT_* */
+	struct netinfo *if_it;	/* NULL for search domain and hostname */
+	char *value;		/* value to be passed to set_* function */
+	struct namelist *add, *del;
+	int full;		/* value is set as whole, no diff is known */
+	int local;		/* changes only own device, may run along with other devices */
+	struct plan_op *merged;	/* operations replaced by this one */
+	struct plan_op *next;
+};
+
+/* type of operation which sets nameservers, search domains and hostname
+   of operations merged into it at once */
+#define PLAN_OP_RESOLVER	(NET_OPT_DNS | NET_OPT_SEARCH | NET_OPT_HOSTNAME)
+
+/* append operation to the plan, value is copied */
+struct plan_op *plan_add(unsigned int type, struct netinfo *if_it,
+		const char *value, struct plan_op **plan);
+
+/* diff options of current request against scanned devices
+return number of operations or -1 on error */
+int plan_build(struct netinfo *netinfo_head, struct plan_op **plan);
+
+/* run operations of the plan with run(), up to jobs at once
+   operations of one device, gateways and operations which are not local
+   are run in order of the plan
+return last non-zero result of run() in order of the plan */
+int plan_execute(struct plan_op *plan, int jobs, int (*run)(struct plan_op *op));
+
+/* replace search domain, hostname and, if global_dns is set, nameservers
+   of devices with one PLAN_OP_RESOLVER operation at place of the first of them,
+   nameservers are merged only if all devices have the same value, otherwise
+   operations of devices stay in order and the last one wins
+return number of merged operations or -1 on error */
+int plan_merge_resolver(struct plan_op **plan, int global_dns);
+
+/* merged operation of type, NULL if there is none */
+struct plan_op *plan_merged(struct plan_op *op, unsigned int type);
+
+void plan_print(struct plan_op *plan);
+
+void plan_clean(struct plan_op **plan);
+
+#endif // __PLAN_H__
@@ -0,0 +1,419 @@
+/*
+ * Copyright (c) 2022 Virtuozzo International GmbH. All rights reserved.
+ *
+ * This file is part of OpenVZ. OpenVZ is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * Our contact details: Virtuozzo International GmbH, Vordergasse 59, 8200
+ * Schaffhausen, Switzerland.
+ */
+
+#include "resolvconf.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+#define MAX_LINES           256
+
+#define DNS_TMPL         "nameserver %s"
+#define DNS_TMPL_SCAN    " nameserver %46s"
+#define SEARCH_TMPL      "search %s"
+#define SEARCH_TMPL_SCAN " search %[^\n]s"
+#define PREPEND_TMPL     "prepend %s "
+#define PREPEND_SCAN     " prepend %63s"
+#define LIST_SEPARATORS  " \t\n"
+
+
+static int add_line(struct resolvconf_line *head, const char *str);
+static void del_line(struct resolvconf_line *prev);
+
+/* line starts with name followed by blank or end of line */
+static int is_directive(const char *data, const char *name)
+{
+	size_t len = strlen(name);
+
+	data += strspn(data, " \t");
+	return strncmp(data, name, len) == 0 && strchr(" \t\n", data[len]) != NULL;
+}
+
+void resolvconf_init(struct resolvconf_line *head)
+{
+	if (!head)
+		return;
+
+	head->data = NULL;
+	head->next = NULL;
+}
+
+int resolvconf_load__(struct resolvconf_line *head, const char *path)
+{
+	struct resolvconf_line *line;
+	FILE *f;
+	char *str = NULL;
+	size_t len = 0;
+	int res = 0;
+
+	if (!head || !path)
+		return -EINVAL;
+
+	resolvconf_init(head);
+
+	f = fopen(path, "r");
+	if (f == NULL)
+		return -errno;
+
+	for (line = head; getline(&str, &len, f) >= 0; line = line->next) {
+		res = add_line(line, str);
+		if (res != 0) {
+			resolvconf_free(head);
+			break;
+		}
+	}
+
+	free(str);
+	fclose(f);
+
+	return res;
+}
+
+int resolvconf_save__(struct resolvconf_line *head, const char *path)
+{
+	struct resolvconf_line *line;
+	char tmp[PATH_MAX + sizeof(".tmp")];
+	FILE *f;
+	int fd, res = 0;
+
+	if (!head || !path)
+		return -EINVAL;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp))
+		return -ENAMETOOLONG;
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return -errno;
+
+	f = fdopen(fd, "w");
+	if (f == NULL) {
+		res = -errno;
+		close(fd);
+		unlink(tmp);
+		return res;
+	}
+
+	/* resolver configuration is readable by everyone regardless of umask */
+	if (fchmod(fd, 0644) != 0)
+		res = -errno;
+
+	for (line = head->next; line && res == 0; line = line->next) {
+		if (fputs(line->data, f) == EOF)
+			res = -errno;
+		/* last line of loaded file may have no newline */
+		else if (line->next && line->data[strcspn(line->data, "\n")] == '\0' &&
+				fputc('\n', f) == EOF)
+			res = -errno;
+	}
+
+	if (res == 0 && (fflush(f) != 0 || fsync(fd) != 0))
+		res = -errno;
+	if (fclose(f) != 0 && res == 0)
+		res = -errno;
+	if (res == 0 && rename(tmp, path) != 0)
+		res = -errno;
+	if (res != 0)
+		unlink(tmp);
+
+	return res;
+}
+
+void resolvconf_free(struct resolvconf_line *head)
+{
+	struct resolvconf_line *line, *next;
+
+	if (!head)
+		return;
+
+	for (line = head->next; line; line = next) {
+		next = line->next;
+		free(line->data);
+		free(line);
+	}
+	head->next = NULL;
+}
+
+int resolvconf_set_namserver(struct resolvconf_line *head, const char *dns)
+{
+	struct resolvconf_line *line, *last;
+	char buf[INET6_ADDRSTRLEN + sizeof(DNS_TMPL)];
+	int i;
+
+	if ((!head) || (!dns))
+		return -EINVAL;
+
+	if (strlen(dns) > INET6_ADDRSTRLEN)
+		return -EINVAL;
+
+	last = head;
+	i = 0;
+	for (line = head->next; line; line = line->next) {
+		i++;
+		last = line;
+
+		if (sscanf(line->data, DNS_TMPL_SCAN, buf) != 1)
+			continue;
+
+		if (strcmp(buf, dns) == 0)
+			return 0;
+
+		if (i >= MAX_LINES)
+			return -ERANGE;
+	}
+
+	snprintf(buf, sizeof(buf), DNS_TMPL "\n", dns);
+
+	return add_line(last, buf);
+}
+
+const char *resolvconf_get_search_list(struct resolvconf_line *head)
+{
+	struct resolvconf_line *line;
+	static char *buf;
+	char *p;
+
+	if (!head)
+		return NULL;
+
+	for (line = head->next; line; line = line->next) {
+		if (!is_directive(line->data, "search"))
+			continue;
+
+		/* list is not longer than the line */
+		p = realloc(buf, strlen(line->data) + 1);
+		if (p == NULL)
+			return NULL;
+		buf = p;
+		if (sscanf(line->data, SEARCH_TMPL_SCAN, buf) == 1)
+			return buf;
+	}
+
+	return NULL;
+}
+
+int resolvconf_set_search_list(struct resolvconf_line *head, const char *list)
+{
+	struct resolvconf_line *line, *last;
+	char *buf, *p;
+	int res;
+
+	if ((!head) || (!list))
+		return -EINVAL;
+
+	buf = malloc(sizeof(SEARCH_TMPL "\n") + strlen(list));
+	if (buf == NULL)
+		return -ENOMEM;
+	sprintf(buf, SEARCH_TMPL "\n", list);
+
+	last = head;
+	for (line = head->next; line; line = line->next) {
+		last = line;
+
+		if (!is_directive(line->data, "search"))
+			continue;
+
+		/* empty search line is left as is */
+		p = line->data + strspn(line->data, " \t") + strlen("search");
+		if (p[strspn(p, LIST_SEPARATORS)] == '\0')
+			continue;
+
+		free(line->data);
+		line->data = buf;
+		return 0;
+	}
+
+	res = add_line(last, buf);
+	free(buf);
+
+	return res;
+}
+
+struct resolvconf_line *resolvconf_get_next_dns(struct resolvconf_line *line, const char **dns)
+{
+	static char buf[INET6_ADDRSTRLEN + 1];
+
+	for (line = line->next; line; line = line->next) {
+		if (sscanf(line->data, DNS_TMPL_SCAN, buf) == 1) {
+			*dns = buf;
+			return line;
+		}
+	}
+	*dns = NULL;
+	return NULL;
+}
+
+int resolvconf_set_nameservers(struct resolvconf_line *head, const char *list)
+{
+	struct resolvconf_line *prev, *last;
+	char buf[INET6_ADDRSTRLEN + sizeof(DNS_TMPL)];
+	const char *p;
+	size_t len;
+	int i, res;
+
+	if ((!head) || (!list))
+		return -EINVAL;
+
+	for (prev = head; prev->next; ) {
+		if (sscanf(prev->next->data, DNS_TMPL_SCAN, buf) == 1)
+			del_line(prev);
+		else
+			prev = prev->next;
+	}
+
+	last = prev;
+	i = 0;
+	for (p = list + strspn(list, LIST_SEPARATORS); *p; p += strspn(p, LIST_SEPARATORS)) {
+		len = strcspn(p, LIST_SEPARATORS);
+		if (len > INET6_ADDRSTRLEN)
+			return -EINVAL;
+		if (++i > MAX_LINES)
+			return -ERANGE;
+
+		snprintf(buf, sizeof(buf), "nameserver %.*s\n", (int)len, p);
+		res = add_line(last, buf);
+		if (res != 0)
+			return res;
+		last = last->next;
+		p += len;
+	}
+
+	return 0;
+}
+
+int resolvconf_del_search_list(struct resolvconf_line *head)
+{
+	struct resolvconf_line *prev;
+
+	if (!head)
+		return -EINVAL;
+
+	for (prev = head; prev->next; ) {
+		if (is_directive(prev->next->data, "search"))
+			del_line(prev);
+		else
+			prev = prev->next;
+	}
+
+	return 0;
+}
+
+int resolvconf_set_prepend(struct resolvconf_line *head, const char *option,
+		const char *list, int quote)
+{
+	struct resolvconf_line *prev;
+	char word[64], *buf, *out;
+	const char *p;
+	size_t len;
+	int res;
+
+	if ((!head) || (!option) || (!list))
+		return -EINVAL;
+
+	if (strlen(option) >= sizeof(word))
+		return -EINVAL;
+
+	for (prev = head; prev->next; ) {
+		if (sscanf(prev->next->data, PREPEND_SCAN, word) == 1 &&
+				strcmp(word, option) == 0)
+			del_line(prev);
+		else
+			prev = prev->next;
+	}
+
+	p = list + strspn(list, LIST_SEPARATORS);
+	if (*p == '\0')
+		return 0;
+
+	/* each item gets at most quotes and ", " */
+	buf = malloc(sizeof(PREPEND_TMPL) + strlen(option) + 4 * strlen(p) + sizeof(";\n"));
+	if (buf == NULL)
+		return -ENOMEM;
+
+	out = buf + sprintf(buf, PREPEND_TMPL, option);
+	while (*p) {
+		len = strcspn(p, LIST_SEPARATORS);
+		out += sprintf(out, quote ? "\"%.*s\"" : "%.*s", (int)len, p);
+		p += len;
+		p += strspn(p, LIST_SEPARATORS);
+		if (*p)
+			out += sprintf(out, ", ");
+	}
+	strcpy(out, ";\n");
+
+	res = add_line(prev, buf);
+	free(buf);
+
+	return res;
+}
+
+const char *resolvconf_base__(const char *path, const char *run, const char *base)
+{
+	char buf[PATH_MAX];
+	ssize_t len;
+
+	if (!path || !run || !base)
+		return path;
+
+	len = readlink(path, buf, sizeof(buf) - 1);
+	if (len < 0)
+		return path;
+	buf[len] = '\0';
+
+	return strcmp(buf, run) == 0 ? base : path;
+}
+
+static int add_line(struct resolvconf_line *head, const char *str)
+{
+	struct resolvconf_line *line;
+
+	line = malloc(sizeof(*line));
+	if (line == NULL)
+		return -ENOMEM;
+
+	line->data = strdup(str);
+	if (line->data == NULL) {
+		free(line);
+		return -ENOMEM;
+	}
+
+	line->next = NULL;
+	head->next = line;
+
+	return 0;
+}
+
+static void del_line(struct resolvconf_line *prev)
+{
+	struct resolvconf_line *line = prev->next;
+
+	prev->next = line->next;
+	free(line->data);
+	free(line);
+}
@@ -30,17 +30,32 @@ struct resolvconf_line {
 };
 
 #define RESOLVCONF_PATH "/etc/resolv.conf"
+/* resolv.conf generated by resolvconf package and its static part */
+#define RESOLVCONF_RUN_PATH "/etc/resolvconf/run/resolv.conf"
+#define RESOLVCONF_BASE_PATH "/etc/resolvconf/resolv.conf.d/base"
 
 #define resolvconf_dns_foreach(head, dns) for (struct resolvconf_line *line = resolvconf_get_next_dns(head, &dns); line; line = resolvconf_get_next_dns(line, &dns))
 
 extern void resolvconf_init(struct resolvconf_line *head);
 extern int resolvconf_load__(struct resolvconf_line *head, const char *path);
+/* lines are written to temporary file which is renamed over path,
+   link at path is replaced too, file it points to is left as is */
 extern int resolvconf_save__(struct resolvconf_line *head, const char *path);
 extern void resolvconf_free(struct resolvconf_line *head);
 extern int resolvconf_set_namserver(struct resolvconf_line *head, const char *dns);
 extern const char *resolvconf_get_search_list(struct resolvconf_line *head);
 extern int resolvconf_set_search_list(struct resolvconf_line *head, const char *list);
 extern struct resolvconf_line *resolvconf_get_next_dns(struct resolvconf_line *line, const char **dns);
+/* replace all nameserver lines with space separated list, empty list removes them */
+extern int resolvconf_set_nameservers(struct resolvconf_line *head, const char *list);
+extern int resolvconf_del_search_list(struct resolvconf_line *head);
+/* dhclient.conf: replace "prepend <option> ...;" with items of space separated
+   list joined by ", ", quoted if quote is set, empty list removes directive */
+extern int resolvconf_set_prepend(struct resolvconf_line *head, const char *option,
+		const char *list, int quote);
+/* file which should be edited instead of path: static part of configuration
+   if path is a link to file generated from it */
+extern const char *resolvconf_base__(const char *path, const char *run, const char *base);
 
 static inline int resolvconf_load(struct resolvconf_line *head)
 {
@@ -52,4 +67,9 @@ static inline int resolvconf_save(struct resolvconf_line *head)
 	return resolvconf_save__(head, RESOLVCONF_PATH);
 }
 
+static inline const char *resolvconf_base(void)
+{
+	return resolvconf_base__(RESOLVCONF_PATH, RESOLVCONF_RUN_PATH, RESOLVCONF_BASE_PATH);
+}
+
 #endif
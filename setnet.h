@@ -76,6 +76,38 @@ int restart_guest_network();
 
 #ifdef _LIN_
 
-int restart_debian_netplan_network();
+/* nameservers are common for all devices */
+int is_resolver_global(void);
+
+/* set nameservers, search domains and hostname in one pass,
+   NULL value is left as it is, if_it is NULL for global values */
+int set_resolver(struct netinfo *if_it, const char *dns, const char *search,
+		const char *hostname);
+
+/* write configuration which operations of backend keep in memory */
+int commit_config(void);
+
+/* apply netplan configuration of changed devices only */
+int restart_debian_netplan_network(struct netinfo *netinfo_head);
+
+/* restart single device */
+int restart_device(struct netinfo *if_it);
+
+/* bring up device which configuration was written in transaction */
+int activate_device(struct netinfo *if_it);
+
+/* addresses of device are changed live by --delta or --fast, without restart */
+int is_ip_delta(struct netinfo *if_it);
+
+/* set addresses, gateways or routes of params in kernel only and mark
+   them in if_it->live, set_* functions then write only configuration
+return 0 on success, 1 if option can't be set live, error otherwise */
+int set_live(struct netinfo *if_it, struct nettool_mac *params);
+
+/* add and delete only values of add and del of addresses or routes
+   in kernel and mark them in if_it->live like set_live()
+return 0 on success, 1 if they can't be changed live, error otherwise */
+int set_delta(struct netinfo *if_it, unsigned int type, struct namelist *add,
+		struct namelist *del);
 
 #endif